@@ -71,6 +71,7 @@ check_include_file(termios.h HAVE_TERMIOS_H)
 check_include_file(unistd.h HAVE_UNISTD_H)
 check_include_file(valgrind/valgrind.h HAVE_VALGRIND_VALGRIND_H)
 check_include_file(zlib.h HAVE_ZLIB_H)
+check_include_file(zstd.h HAVE_ZSTD_H)
 check_include_file(fenv.h HAVE_FENV_H)
 check_symbol_exists(FE_ALL_EXCEPT "fenv.h" HAVE_DECL_FE_ALL_EXCEPT)
 check_symbol_exists(FE_INEXACT "fenv.h" HAVE_DECL_FE_INEXACT)
@@ -135,6 +136,11 @@ if( NOT PURE_WINDOWS AND NOT LLVM_USE_SANITIZER MATCHES "Memory.*")
   else()
     set(HAVE_LIBZ 0)
   endif()
+  if (LLVM_ENABLE_ZSTD)
+    check_library_exists(zstd ZSTD_compress "" HAVE_LIBZSTD)
+  else()
+    set(HAVE_LIBZSTD 0)
+  endif()
   # Skip libedit if using ASan as it contains memory leaks.
   if (LLVM_ENABLE_LIBEDIT AND HAVE_HISTEDIT_H AND NOT LLVM_USE_SANITIZER MATCHES ".*Address.*")
     check_library_exists(edit el_init "" HAVE_LIBEDIT)
@@ -513,6 +519,13 @@ if (LLVM_ENABLE_ZLIB )
   endif()
 endif()
 
+if (LLVM_ENABLE_ZSTD )
+  # Check if zstd is available in the system.
+  if ( NOT HAVE_ZSTD_H OR NOT HAVE_LIBZSTD )
+    set(LLVM_ENABLE_ZSTD 0)
+  endif()
+endif()
+
 if (LLVM_ENABLE_DOXYGEN)
   message(STATUS "Doxygen enabled.")
   find_package(Doxygen REQUIRED)
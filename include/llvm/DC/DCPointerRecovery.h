@@ -0,0 +1,32 @@
+//===-- llvm/DC/DCPointerRecovery.h - Recover pointers ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Lifted code computes the address of every memory access with integer
+// arithmetic on the registers, and casts it to a pointer with inttoptr. Alias
+// analysis and SCEV don't see through that, so loads can't be hoisted, and
+// loops can't be vectorized.
+//
+// This pass finds the base of each address, and rewrites the address as
+// getelementptr i8 off a single inttoptr of the base. Bases carried by loop
+// registers get a pointer phi of their own, so that pointer induction
+// variables are visible to SCEV.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DC_DCPOINTERRECOVERY_H
+#define LLVM_DC_DCPOINTERRECOVERY_H
+
+namespace llvm {
+class FunctionPass;
+
+FunctionPass *createDCPointerRecoveryPass();
+
+} // end namespace llvm
+
+#endif
@@ -0,0 +1,35 @@
+//===-- llvm/DC/DCRegSetOpt.h - Regset-aware cleanups -----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Optimize the accesses of translated functions to their register set, using
+// what the target knows about the registers, and that generic passes can't
+// infer from the IR:
+// - some bits of a register are always zero (e.g., the status flags in a
+//   register that only holds the control bits of a flags register). Making
+//   that explicit lets InstCombine fold flag extractions to the flag itself.
+// - callers don't observe some registers when a function returns (e.g., the
+//   scratch registers of the calling convention). Their stores to the regset
+//   right before returning are dead. This assumes the translated functions
+//   follow the calling convention, so it is only done when requested.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DC_DCREGSETOPT_H
+#define LLVM_DC_DCREGSETOPT_H
+
+namespace llvm {
+class DCTranslator;
+class FunctionPass;
+
+FunctionPass *createDCRegSetOptPass(const DCTranslator &DT,
+                                    bool AssumeCallingConv);
+
+} // end namespace llvm
+
+#endif
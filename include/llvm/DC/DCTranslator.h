@@ -19,6 +19,7 @@
 #ifndef LLVM_DC_DCTRANSLATOR_H
 #define LLVM_DC_DCTRANSLATOR_H
 
+#include "llvm/ADT/APInt.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/StringSet.h"
@@ -64,7 +65,11 @@ public:
   /// Construct a DCTranslator for a target.
   /// \param Ctx  The LLVMContext to emit the IR with.
   /// \param DL   The DataLayout to use for the produced IR.
-  /// \param OptLevel How optimized the output should be (0-3).
+  /// \param OptLevel How optimized the output should be (0-3):
+  ///   0: no optimization, registers are allocas.
+  ///   1: registers promoted to SSA values.
+  ///   2: redundant register and flag computations removed.
+  ///   3: also global value numbering, and dead store and CFG cleanups.
   DCTranslator(LLVMContext &Ctx, const DataLayout &DL, unsigned OptLevel,
                const MCInstrInfo &MII, const MCRegisterInfo &MRI,
                const MCSubtargetInfo &STI, MCInstPrinter &MIP,
@@ -91,6 +96,14 @@ public:
 
   Function *getFunction(StringRef Name);
 
+  /// Return the bits of register \p RegNo that are always zero, as a value of
+  /// the register's size. None by default.
+  virtual APInt getRegKnownZeroBits(unsigned RegNo) const;
+
+  /// Return whether callers can observe the value of register \p RegNo after
+  /// a function returns, when it follows the platform calling convention.
+  virtual bool isRegObservedOnReturn(unsigned RegNo) const { return true; }
+
 protected:
   virtual std::unique_ptr<DCModule> createDCModule(Module &M) = 0;
 
@@ -105,6 +118,10 @@ protected:
 
   // Create and setup a new module for translation.
   void initializeTranslationModule();
+
+private:
+  // Add the passes run on each translated function to CurrentFPM.
+  void addFunctionPasses();
 };
 
 } // end namespace llvm
@@ -0,0 +1,105 @@
+//===- DWARFAddressIndex.h --------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DEBUGINFO_DWARF_DWARFADDRESSINDEX_H
+#define LLVM_DEBUGINFO_DWARF_DWARFADDRESSINDEX_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/DebugInfo/DIContext.h"
+#include "llvm/Support/Error.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class DWARFContext;
+class raw_ostream;
+
+/// A precomputed address to (file, line, inlining chain) table.
+///
+/// The index is built once from a DWARFContext by evaluating the context at
+/// every address where its answer may change: the bounds of the address
+/// ranges, the line table rows and the ranges of the subroutine DIEs. After
+/// that, getLineInfoForAddress and getInliningInfoForAddress are answered
+/// with a binary search and give the same results as the DWARFContext
+/// queries they replace, without having to parse DIEs or line tables.
+///
+/// The index can be serialized and read back, so tools that repeatedly
+/// symbolize the same binary can keep it on disk next to the binary.
+class DWARFAddressIndex {
+public:
+  /// Build the index for all the compile units of \p Context.
+  static std::unique_ptr<DWARFAddressIndex> build(DWARFContext &Context);
+
+  /// Read an index written by write(). \p Signature must match the signature
+  /// the index was written with, otherwise the index is considered stale.
+  static Expected<std::unique_ptr<DWARFAddressIndex>>
+  read(StringRef Buffer, uint64_t Signature);
+
+  /// Compute a signature identifying the contents of an object file, used to
+  /// detect stale indexes.
+  static uint64_t computeSignature(StringRef ObjectData);
+
+  /// Serialize the index, tagging it with \p Signature.
+  void write(raw_ostream &OS, uint64_t Signature) const;
+
+  DILineInfo getLineInfoForAddress(uint64_t Address,
+                                   DILineInfoSpecifier Spec) const;
+  DIInliningInfo getInliningInfoForAddress(uint64_t Address,
+                                           DILineInfoSpecifier Spec) const;
+
+  /// Number of address ranges with distinct debug info.
+  size_t size() const { return Entries.size(); }
+
+private:
+  /// One level of an inlining chain. Names are offsets into StringData.
+  struct Frame {
+    uint32_t ShortName;
+    uint32_t LinkageName;
+    uint32_t FileName;
+    uint32_t AbsoluteFileName;
+    uint32_t Line;
+    uint32_t Column;
+    uint32_t Discriminator;
+    uint32_t StartLine;
+  };
+
+  enum EntryFlags : uint32_t {
+    /// The address is covered by a line table but not by a subroutine DIE.
+    /// Its single frame only exists when file/line info is requested.
+    LineOnly = 1u << 0,
+  };
+
+  /// The debug info for the addresses in [Address, next entry's Address).
+  struct Entry {
+    uint64_t Address;
+    uint32_t Chain;
+    uint32_t Flags;
+  };
+
+  const Entry *lookup(uint64_t Address) const;
+  StringRef getString(uint32_t Offset) const;
+  DILineInfo getFrame(uint32_t FrameIndex, DILineInfoSpecifier Spec) const;
+
+  /// Null-terminated strings referenced by the frames.
+  std::string StringData;
+  std::vector<Frame> Frames;
+  /// Chain I is made of the frames ChainFrames[ChainStarts[I]] up to
+  /// ChainFrames[ChainStarts[I + 1]], innermost first. Chain 0 is empty.
+  std::vector<uint32_t> ChainStarts;
+  std::vector<uint32_t> ChainFrames;
+  /// Sorted by address.
+  std::vector<Entry> Entries;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_DEBUGINFO_DWARF_DWARFADDRESSINDEX_H
@@ -24,6 +24,9 @@ public:
   void generate(DWARFContext *CTX);
   uint32_t findAddress(uint64_t Address) const;
 
+  /// Append the start and end addresses of all ranges to \p Bounds.
+  void collectRangeBounds(std::vector<uint64_t> &Bounds) const;
+
 private:
   void clear();
   void extract(DataExtractor DebugArangesData);
@@ -269,6 +269,11 @@ public:
   void getInlinedChainForAddress(uint64_t Address,
                                  SmallVectorImpl<DWARFDie> &InlinedChain);
 
+  /// Append to \p Bounds the start and end addresses of the ranges of all
+  /// subroutine DIEs of this unit (or of its split DWARF unit), i.e. the
+  /// addresses where the result of getInlinedChainForAddress may change.
+  void collectSubroutineRangeBounds(std::vector<uint64_t> &Bounds);
+
   /// getUnitSection - Return the DWARFUnitSection containing this unit.
   const DWARFUnitSectionBase &getUnitSection() const { return UnitSection; }
 
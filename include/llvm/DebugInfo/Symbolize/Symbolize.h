@@ -16,6 +16,7 @@
 #include "llvm/DebugInfo/Symbolize/SymbolizableModule.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/ErrorOr.h"
+#include <list>
 #include <map>
 #include <memory>
 #include <string>
@@ -36,6 +37,13 @@ public:
     bool RelativeAddresses : 1;
     std::string DefaultArch;
     std::vector<std::string> DsymHints;
+    /// The maximum total size in bytes of the binaries kept open, or 0 for
+    /// no limit. The least recently used modules are closed to stay under
+    /// it.
+    uint64_t MaxCacheSize = 0;
+    /// Answer DWARF queries from a precomputed address index, loaded from
+    /// (or saved to) a ".addrindex" file next to the debug object.
+    bool UseAddressIndex = false;
     Options(FunctionNameKind PrintFunctions = FunctionNameKind::LinkageName,
             bool UseSymbolTable = true, bool Demangle = true,
             bool RelativeAddresses = false, std::string DefaultArch = "")
@@ -89,7 +97,28 @@ private:
   Expected<ObjectFile *> getOrCreateObject(const std::string &Path,
                                           const std::string &ArchName);
 
-  std::map<std::string, std::unique_ptr<SymbolizableModule>> Modules;
+  /// \brief Closes the least recently used modules until the binaries
+  /// kept open fit in Opts.MaxCacheSize, or only one module is left.
+  void enforceCacheSize();
+
+  /// \brief Drops the object files and binaries that no cached module uses
+  /// anymore.
+  void pruneObjectCaches();
+
+  struct CachedModule {
+    /// Null if the module failed to load.
+    std::unique_ptr<SymbolizableModule> Module;
+    ObjectPair Objects;
+    /// Position in ModuleLRU, for the modules that were loaded.
+    std::list<std::string>::iterator LRUPos;
+  };
+  std::map<std::string, CachedModule> Modules;
+
+  /// \brief The names of the loaded modules, most recently used first.
+  std::list<std::string> ModuleLRU;
+
+  /// \brief The total size of the binaries in BinaryForPath.
+  uint64_t CacheSize = 0;
 
   /// \brief Contains cached results of getOrCreateObjectPair().
   std::map<std::pair<std::string, std::string>, ObjectPair>
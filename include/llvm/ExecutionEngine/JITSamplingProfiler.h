@@ -0,0 +1,196 @@
+//===- JITSamplingProfiler.h - Sampling profiler for JITed code -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the declaration of a statistical profiler that finds the
+// hot functions among JITed code.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_JITSAMPLINGPROFILER_H
+#define LLVM_EXECUTIONENGINE_JITSAMPLINGPROFILER_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Mutex.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if LLVM_ENABLE_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace llvm {
+
+class raw_ostream;
+
+/// A statistical profiler for JITed code.
+///
+/// The profiler learns where JITed functions live through the JITEventListener
+/// interface: register it with an ExecutionEngine, or forward the
+/// notifications of an ORC object layer to it. Once started, it samples the
+/// program counter at a regular interval, and attributes each sample to the
+/// JITed function that contains it.
+///
+/// Samples are taken with a hardware cycle counter, through perf_event_open,
+/// on Linux hosts that allow it, and with a SIGPROF interval timer otherwise.
+/// The counter only samples the thread that started the profiler, the timer
+/// samples the whole process. At most one profiler can use the timer at a
+/// time.
+///
+/// Samples are buffered until the next call to update(), which folds them into
+/// a hotness score per function:
+///
+///   Hotness = Hotness * Decay + (samples since the previous update)
+///
+/// so that the score tracks the recent behavior of the program. update() can
+/// be called by the client, for instance before making a recompilation
+/// decision, or periodically on a background thread. Samples that don't fit
+/// in the buffers between two updates are dropped.
+class JITSamplingProfiler : public JITEventListener {
+public:
+  struct Options {
+    /// Use the hardware cycle counter, where available.
+    bool UseHardwareCounters = true;
+
+    /// Cycles between two hardware counter samples.
+    uint64_t CyclesPerSample = 1000000;
+
+    /// CPU time between two timer samples, in microseconds.
+    unsigned TimerIntervalUs = 1000;
+
+    /// Factor applied to every hotness score at each update.
+    double Decay = 0.5;
+
+    /// If non-zero, call update() every UpdateIntervalMs milliseconds on a
+    /// background thread, then the update callback if there is one.
+    unsigned UpdateIntervalMs = 0;
+  };
+
+  enum class SampleSource { None, HardwareCounter, Timer };
+
+  /// The profile of a JITed function.
+  struct FunctionProfile {
+    std::string Name;
+    uint64_t Address;
+    uint64_t Size;
+    /// Samples attributed to the function since it was emitted.
+    uint64_t Samples;
+    /// The decayed sample count.
+    double Hotness;
+  };
+
+  typedef std::function<void(JITSamplingProfiler &)> UpdateCallbackT;
+
+  JITSamplingProfiler() : JITSamplingProfiler(Options()) {}
+  explicit JITSamplingProfiler(const Options &Opts);
+  JITSamplingProfiler(const JITSamplingProfiler &) = delete;
+  void operator=(const JITSamplingProfiler &) = delete;
+  ~JITSamplingProfiler() override;
+
+  /// \brief Start sampling.
+  ///
+  /// Fails if the profiler is already running, or if no sample source is
+  /// available on this host.
+  Error start();
+
+  /// \brief Stop sampling, and fold the remaining samples into the profile.
+  void stop();
+
+  /// \brief Return where samples come from, or None if not running.
+  SampleSource getSampleSource() const { return Source; }
+
+  /// \brief Set a function to call after each background update.
+  ///
+  /// The callback runs on the background thread, and can query the profiler.
+  void setUpdateCallback(UpdateCallbackT Callback);
+
+  /// \brief Record a sample at \p Addr, as if the sampler had taken it.
+  ///
+  /// This lets clients feed the profile with samples from their own source.
+  void recordSample(uint64_t Addr);
+
+  /// \brief Attribute the samples taken since the previous update to their
+  ///        functions, and decay the hotness scores.
+  void update();
+
+  /// \brief Return the hotness of the function \p Name, 0 if it is unknown.
+  double getHotness(StringRef Name) const;
+
+  /// \brief Return the hotness of the function containing \p Addr, 0 if
+  ///        there is none.
+  double getHotness(uint64_t Addr) const;
+
+  /// \brief Return the profiles of the (at most) \p N hottest functions,
+  ///        hottest first. Functions that were never sampled are left out.
+  std::vector<FunctionProfile> getHottestFunctions(unsigned N) const;
+
+  /// \brief Return the number of samples that didn't hit JITed code.
+  uint64_t getNumUnattributedSamples() const;
+
+  /// \brief Print the \p N hottest functions to \p OS.
+  void print(raw_ostream &OS, unsigned N = 20) const;
+
+  void NotifyObjectEmitted(const object::ObjectFile &Obj,
+                           const RuntimeDyld::LoadedObjectInfo &L) override;
+  void NotifyFreeingObject(const object::ObjectFile &Obj) override;
+
+private:
+  struct FunctionInfo {
+    std::string Name;
+    uint64_t Size;
+    uint64_t Samples = 0;
+    uint64_t PendingSamples = 0;
+    double Hotness = 0;
+  };
+
+  class HardwareSampler;
+
+  typedef std::map<uint64_t, FunctionInfo> FunctionMapT;
+
+  FunctionMapT::iterator findFunction(uint64_t Addr);
+  FunctionMapT::const_iterator findFunction(uint64_t Addr) const;
+  void recordSampleLocked(uint64_t Addr);
+  void drainSamplesLocked();
+  void stopUpdateThread();
+
+  Options Opts;
+  SampleSource Source = SampleSource::None;
+  std::unique_ptr<HardwareSampler> HWSampler;
+  uint64_t TimerTail = 0;
+
+  /// The JITed functions, by start address.
+  FunctionMapT Functions;
+  StringMap<uint64_t> FunctionAddrs;
+  /// The start addresses of the functions of each object, by object data.
+  DenseMap<const char *, std::vector<uint64_t>> ObjectFunctions;
+  uint64_t UnattributedSamples = 0;
+  mutable sys::Mutex ProfileMutex;
+
+  UpdateCallbackT UpdateCallback;
+#if LLVM_ENABLE_THREADS
+  std::mutex UpdateThreadMutex;
+  std::condition_variable UpdateThreadCV;
+  bool StopUpdateThread = false;
+  std::thread UpdateThread;
+#endif
+};
+
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_JITSAMPLINGPROFILER_H
@@ -0,0 +1,390 @@
+//===- ConcurrentIRCompileLayer.h - Compile IR in parallel ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Contains the definition for an IR compiling layer that compiles modules in
+// the background, on several threads at once.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_ORC_CONCURRENTIRCOMPILELAYER_H
+#define LLVM_EXECUTIONENGINE_ORC_CONCURRENTIRCOMPILELAYER_H
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/Mangler.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include <cassert>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if LLVM_ENABLE_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#endif
+
+namespace llvm {
+namespace orc {
+
+/// @brief Concurrent IR compiling layer.
+///
+///   This layer accepts sets of LLVM IR Modules (via addModuleSet), and queues
+/// each of them to be compiled in the background by a pool of worker threads,
+/// each of which compiles with its own TargetMachine. The resulting object is
+/// only added to the layer below, which must implement the object layer
+/// concept, the first time the address of one of its symbols is requested
+/// (via JITSymbol::getAddress), so that looking a symbol up only waits for the
+/// module that defines it to be compiled.
+///
+///   Modules that share an LLVMContext are never compiled at the same time,
+/// and the client must not use the context of a module, or the module itself,
+/// until the module has been compiled: clients that want their modules
+/// compiled in parallel, or to keep building IR while they are, need to give
+/// each module its own context.
+template <typename BaseLayerT> class ConcurrentIRCompileLayer {
+public:
+  /// @brief Builds the TargetMachine for a worker thread.
+  using TargetMachineBuilder = std::function<std::unique_ptr<TargetMachine>()>;
+
+  using BaseLayerHandleT = typename BaseLayerT::ObjHandleT;
+  using CompileResult = SimpleCompiler::CompileResult;
+
+private:
+  class CompiledModuleSet {
+  public:
+    CompiledModuleSet(Module &M) : M(M) {}
+    virtual ~CompiledModuleSet() = default;
+
+    JITSymbol find(StringRef Name, bool ExportedSymbolsOnly,
+                   ConcurrentIRCompileLayer &L) {
+      switch (EmitState) {
+      case NotEmitted: {
+        auto I = Symbols.find(Name);
+        if (I == Symbols.end() ||
+            (ExportedSymbolsOnly && !I->second.isExported()))
+          return nullptr;
+        // FIXME: Use capture-init when we move to C++14.
+        std::string PName = Name;
+        auto GetAddress =
+          [this, ExportedSymbolsOnly, PName, &L]() -> JITTargetAddress {
+            if (this->EmitState == Emitting)
+              return 0;
+            L.emit(*this);
+            auto Sym = L.BaseLayer.findSymbolIn(Handle, PName,
+                                                ExportedSymbolsOnly);
+            return Sym.getAddress();
+          };
+        return JITSymbol(std::move(GetAddress), I->second);
+      }
+      case Emitting:
+        // Any symbol of this module would have been found by the RuntimeDyld
+        // instance doing the lookup, see LazyEmittingLayer.
+        return nullptr;
+      case Emitted:
+        return L.BaseLayer.findSymbolIn(Handle, Name, ExportedSymbolsOnly);
+      }
+      llvm_unreachable("Invalid emit-state.");
+    }
+
+    template <typename ModuleSetT, typename MemoryManagerPtrT,
+              typename SymbolResolverPtrT>
+    static std::unique_ptr<CompiledModuleSet>
+    create(ModuleSetT Ms, MemoryManagerPtrT MemMgr,
+           SymbolResolverPtrT Resolver);
+
+    virtual BaseLayerHandleT addToBaseLayer(BaseLayerT &BaseLayer,
+                                            CompileResult Obj) = 0;
+
+    /// The module being compiled.
+    Module &M;
+
+    /// The object compiled from M, once it is ready.
+    std::future<CompileResult> Object;
+
+    /// The mangled names and flags of the definitions in M.
+    StringMap<JITSymbolFlags> Symbols;
+
+    enum { NotEmitted, Emitting, Emitted } EmitState = NotEmitted;
+    BaseLayerHandleT Handle;
+  };
+
+  template <typename ModuleSetT, typename MemoryManagerPtrT,
+            typename SymbolResolverPtrT>
+  class CompiledModuleSetImpl : public CompiledModuleSet {
+  public:
+    CompiledModuleSetImpl(ModuleSetT Ms, MemoryManagerPtrT MemMgr,
+                          SymbolResolverPtrT Resolver)
+        : CompiledModuleSet(*Ms.front()), Ms(std::move(Ms)),
+          MemMgr(std::move(MemMgr)), Resolver(std::move(Resolver)) {}
+
+    BaseLayerHandleT addToBaseLayer(BaseLayerT &BaseLayer,
+                                    CompileResult Obj) override {
+      // The modules are not needed any more once they have been compiled.
+      Ms.clear();
+      return BaseLayer.addObject(
+          std::make_shared<CompileResult>(std::move(Obj)), std::move(MemMgr),
+          std::move(Resolver));
+    }
+
+  private:
+    ModuleSetT Ms;
+    MemoryManagerPtrT MemMgr;
+    SymbolResolverPtrT Resolver;
+  };
+
+  using ModuleSetListT = std::list<std::unique_ptr<CompiledModuleSet>>;
+
+public:
+  /// @brief Handle to a set of compiled modules.
+  using ModuleSetHandleT = typename ModuleSetListT::iterator;
+
+  /// @brief Construct a ConcurrentIRCompileLayer with the given BaseLayer,
+  ///        compiling on NumThreads threads with TargetMachines built by
+  ///        BuildTM.
+  ConcurrentIRCompileLayer(
+      BaseLayerT &BaseLayer, TargetMachineBuilder BuildTM,
+      unsigned NumThreads = heavyweight_hardware_concurrency())
+      : BaseLayer(BaseLayer) {
+#if LLVM_ENABLE_THREADS
+    assert(NumThreads > 0 && "Need at least one thread to compile on");
+    for (unsigned I = 0; I != NumThreads; ++I)
+      WorkerTMs.push_back(BuildTM());
+    for (auto &TM : WorkerTMs)
+      Workers.emplace_back([this, &TM]() { runWorker(*TM); });
+#else
+    (void)NumThreads;
+    TM = BuildTM();
+#endif
+  }
+
+  ~ConcurrentIRCompileLayer() {
+#if LLVM_ENABLE_THREADS
+    {
+      std::lock_guard<std::mutex> Lock(QueueLock);
+      Stopping = true;
+    }
+    QueueChanged.notify_all();
+    for (auto &Worker : Workers)
+      Worker.join();
+#endif
+  }
+
+  /// @brief Queue the module in the given module set to be compiled, and
+  ///        record its definitions.
+  ///
+  /// @return A handle for the added modules.
+  template <typename ModuleSetT, typename MemoryManagerPtrT,
+            typename SymbolResolverPtrT>
+  ModuleSetHandleT addModuleSet(ModuleSetT Ms,
+                                MemoryManagerPtrT MemMgr,
+                                SymbolResolverPtrT Resolver) {
+    assert(Ms.size() == 1);
+    auto H = ModuleSetList.insert(
+        ModuleSetList.end(),
+        CompiledModuleSet::create(std::move(Ms), std::move(MemMgr),
+                                  std::move(Resolver)));
+    CompiledModuleSet &Set = **H;
+
+    // Record the definitions of the module before handing it over to the
+    // workers: Mangler needs the module.
+    Mangler Mang;
+    for (const auto &GO : Set.M.global_objects()) {
+      // Modules don't "provide" decls or common symbols.
+      if (GO.isDeclaration() || GO.hasCommonLinkage())
+        continue;
+      std::string MangledName;
+      {
+        raw_string_ostream MangledNameStream(MangledName);
+        Mang.getNameWithPrefix(MangledNameStream, &GO, false);
+      }
+      Set.Symbols[MangledName] = JITSymbolFlags::fromGlobalValue(GO);
+      PendingSymbols.insert(std::make_pair(MangledName, &Set));
+    }
+
+    std::promise<CompileResult> Promise;
+    Set.Object = Promise.get_future();
+#if LLVM_ENABLE_THREADS
+    {
+      std::lock_guard<std::mutex> Lock(QueueLock);
+      Queue.push_back(CompileJob{&Set.M, std::move(Promise)});
+    }
+    QueueChanged.notify_one();
+#else
+    Promise.set_value(SimpleCompiler(*TM)(Set.M));
+#endif
+
+    return H;
+  }
+
+  /// @brief Remove the module set associated with the handle H, waiting for
+  ///        it to be compiled if it is being compiled.
+  void removeModuleSet(ModuleSetHandleT H) {
+    CompiledModuleSet &Set = **H;
+    if (Set.EmitState == CompiledModuleSet::NotEmitted) {
+      if (!cancel(Set))
+        Set.Object.wait();
+      removePendingSymbols(Set);
+    } else
+      BaseLayer.removeObject(Set.Handle);
+    ModuleSetList.erase(H);
+  }
+
+  /// @brief Search for the given named symbol.
+  /// @param Name The name of the symbol to search for.
+  /// @param ExportedSymbolsOnly If true, search only for exported symbols.
+  /// @return A handle for the given named symbol, if it exists. If the module
+  ///         defining it has not been added to the base layer yet, getting
+  ///         the address of the symbol waits for it to be compiled and adds
+  ///         it.
+  JITSymbol findSymbol(const std::string &Name, bool ExportedSymbolsOnly) {
+    if (auto Symbol = BaseLayer.findSymbol(Name, ExportedSymbolsOnly))
+      return Symbol;
+
+    auto I = PendingSymbols.find(Name);
+    if (I == PendingSymbols.end())
+      return nullptr;
+    return I->second->find(Name, ExportedSymbolsOnly, *this);
+  }
+
+  /// @brief Get the address of the given symbol in the context of the set of
+  ///        compiled modules represented by the handle H.
+  JITSymbol findSymbolIn(ModuleSetHandleT H, const std::string &Name,
+                         bool ExportedSymbolsOnly) {
+    return (*H)->find(Name, ExportedSymbolsOnly, *this);
+  }
+
+  /// @brief Wait for the module set represented by the given handle to be
+  ///        compiled, then emit and finalize it.
+  /// @param H Handle for module set to emit/finalize.
+  void emitAndFinalize(ModuleSetHandleT H) {
+    CompiledModuleSet &Set = **H;
+    assert(Set.EmitState != CompiledModuleSet::Emitting &&
+           "Cannot emitAndFinalize while already emitting");
+    emit(Set);
+    BaseLayer.emitAndFinalize(Set.Handle);
+  }
+
+private:
+  void emit(CompiledModuleSet &Set) {
+    if (Set.EmitState != CompiledModuleSet::NotEmitted)
+      return;
+    Set.EmitState = CompiledModuleSet::Emitting;
+    CompileResult Obj = Set.Object.get();
+    removePendingSymbols(Set);
+    Set.Handle = Set.addToBaseLayer(BaseLayer, std::move(Obj));
+    Set.EmitState = CompiledModuleSet::Emitted;
+  }
+
+  void removePendingSymbols(CompiledModuleSet &Set) {
+    for (const auto &Symbol : Set.Symbols) {
+      auto I = PendingSymbols.find(Symbol.first());
+      if (I != PendingSymbols.end() && I->second == &Set)
+        PendingSymbols.erase(I);
+    }
+  }
+
+#if LLVM_ENABLE_THREADS
+  struct CompileJob {
+    Module *M;
+    std::promise<CompileResult> Result;
+  };
+
+  /// Drop the compile job of Set if no worker has started it. Returns false
+  /// if one has.
+  bool cancel(CompiledModuleSet &Set) {
+    std::lock_guard<std::mutex> Lock(QueueLock);
+    for (auto I = Queue.begin(), E = Queue.end(); I != E; ++I)
+      if (I->M == &Set.M) {
+        Queue.erase(I);
+        return true;
+      }
+    return false;
+  }
+
+  void runWorker(TargetMachine &WorkerTM) {
+    SimpleCompiler Compile(WorkerTM);
+    std::unique_lock<std::mutex> Lock(QueueLock);
+    while (!Stopping) {
+      // Take the first job whose context is not in use by another worker.
+      auto I = Queue.begin(), E = Queue.end();
+      while (I != E && BusyContexts.count(&I->M->getContext()))
+        ++I;
+      if (I == E) {
+        QueueChanged.wait(Lock);
+        continue;
+      }
+
+      CompileJob Job = std::move(*I);
+      Queue.erase(I);
+      LLVMContext *Context = &Job.M->getContext();
+      BusyContexts.insert(Context);
+      Lock.unlock();
+
+      Job.Result.set_value(Compile(*Job.M));
+
+      Lock.lock();
+      BusyContexts.erase(Context);
+      // Jobs for this context may be runnable now.
+      QueueChanged.notify_all();
+    }
+  }
+#else
+  bool cancel(CompiledModuleSet &Set) { return false; }
+#endif
+
+  BaseLayerT &BaseLayer;
+  ModuleSetListT ModuleSetList;
+
+  /// The module sets defining the symbols that are not in the base layer yet.
+  StringMap<CompiledModuleSet *> PendingSymbols;
+
+#if LLVM_ENABLE_THREADS
+  std::mutex QueueLock;
+  std::condition_variable QueueChanged;
+  std::list<CompileJob> Queue;
+  std::set<LLVMContext *> BusyContexts;
+  bool Stopping = false;
+
+  std::vector<std::unique_ptr<TargetMachine>> WorkerTMs;
+  std::vector<std::thread> Workers;
+#else
+  std::unique_ptr<TargetMachine> TM;
+#endif
+};
+
+template <typename BaseLayerT>
+template <typename ModuleSetT, typename MemoryManagerPtrT,
+          typename SymbolResolverPtrT>
+std::unique_ptr<
+    typename ConcurrentIRCompileLayer<BaseLayerT>::CompiledModuleSet>
+ConcurrentIRCompileLayer<BaseLayerT>::CompiledModuleSet::create(
+    ModuleSetT Ms, MemoryManagerPtrT MemMgr, SymbolResolverPtrT Resolver) {
+  using CMS = CompiledModuleSetImpl<ModuleSetT, MemoryManagerPtrT,
+                                    SymbolResolverPtrT>;
+  return llvm::make_unique<CMS>(std::move(Ms), std::move(MemMgr),
+                                std::move(Resolver));
+}
+
+} // end namespace orc
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_ORC_CONCURRENTIRCOMPILELAYER_H
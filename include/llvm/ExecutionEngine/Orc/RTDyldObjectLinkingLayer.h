@@ -105,6 +105,10 @@ public:
   /// @brief Functor for receiving finalization notifications.
   using NotifyFinalizedFtor = std::function<void(ObjHandleT)>;
 
+  /// @brief Functor for receiving notifications that the memory of a set of
+  ///        objects is about to be freed.
+  using NotifyFreedFtor = std::function<void(ObjHandleT)>;
+
 private:
 
 
@@ -229,12 +233,19 @@ private:
 public:
 
   /// @brief Construct an ObjectLinkingLayer with the given NotifyLoaded,
-  ///        and NotifyFinalized functors.
+  ///        NotifyFinalized and NotifyFreed functors.
   RTDyldObjectLinkingLayer(
       NotifyLoadedFtor NotifyLoaded = NotifyLoadedFtor(),
-      NotifyFinalizedFtor NotifyFinalized = NotifyFinalizedFtor())
+      NotifyFinalizedFtor NotifyFinalized = NotifyFinalizedFtor(),
+      NotifyFreedFtor NotifyFreed = NotifyFreedFtor())
       : NotifyLoaded(std::move(NotifyLoaded)),
-        NotifyFinalized(std::move(NotifyFinalized)) {}
+        NotifyFinalized(std::move(NotifyFinalized)),
+        NotifyFreed(std::move(NotifyFreed)) {}
+
+  ~RTDyldObjectLinkingLayer() {
+    while (!LinkedObjList.empty())
+      removeObject(LinkedObjList.begin());
+  }
 
   /// @brief Set the 'ProcessAllSections' flag.
   ///
@@ -296,6 +307,8 @@ public:
   /// required to detect or resolve such issues it should be added at a higher
   /// layer.
   void removeObject(ObjHandleT H) {
+    if (NotifyFreed)
+      NotifyFreed(H);
     // How do we invalidate the symbols in H?
     LinkedObjList.erase(H);
   }
@@ -343,6 +356,7 @@ private:
   LinkedObjectListT LinkedObjList;
   NotifyLoadedFtor NotifyLoaded;
   NotifyFinalizedFtor NotifyFinalized;
+  NotifyFreedFtor NotifyFreed;
   bool ProcessAllSections = false;
 };
 
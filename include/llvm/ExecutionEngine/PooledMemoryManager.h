@@ -0,0 +1,207 @@
+//===- PooledMemoryManager.h - Pooled memory manager for RtDyld -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the declaration of a memory manager that allocates the
+// sections of many small JITed objects out of a few large shared arenas.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_POOLEDMEMORYMANAGER_H
+#define LLVM_EXECUTIONENGINE_POOLEDMEMORYMANAGER_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/Support/Memory.h"
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace llvm {
+
+/// Large arenas of JIT memory, shared by any number of PooledMemoryManagers.
+///
+/// SectionMemoryManager maps fresh memory for every object that doesn't fit
+/// in its free list, and protects each of its sections separately. A JIT that
+/// loads many small objects, one per function say, ends up with code spread
+/// over many partly used pages, and with several mprotect calls per object.
+///
+/// This pool instead reserves large slabs, bump-allocates the sections of all
+/// the objects out of them, and keeps code, read-only data and read-write data
+/// apart:
+///
+/// - Code is written through a read-write view of its slab and run from a
+///   second, read-execute view of the same pages, where the system supports
+///   it. Code pages are then never writable, never need re-protecting, and
+///   code from consecutive objects shares pages. Otherwise, code is protected
+///   like read-only data.
+/// - Read-only data, and code without a second view, are protected once per
+///   finalize() call, with a single mprotect over everything allocated since
+///   the previous call, whatever the number of objects and sections.
+/// - Small read-write data blocks come in power of two size classes, and are
+///   recycled when their memory manager is destroyed. Code and read-only data
+///   are never recycled: their pages are no longer writable.
+///
+/// The pool is not thread safe. Memory allocated by any of its managers is
+/// made executable or read-only by the next finalizeMemory call on any of
+/// them, so an object must be relocated before another one is finalized, as
+/// RuntimeDyld and RTDyldObjectLinkingLayer do.
+class JITMemoryPool {
+public:
+  struct Options {
+    /// Bytes of address space reserved at a time for each kind of memory.
+    size_t SlabSize = 64 * 1024 * 1024;
+
+    /// Align slabs to huge pages and ask for them to be backed by huge pages,
+    /// to cut down on iTLB misses when running a lot of JITed code.
+    bool UseHugePages = false;
+
+    /// Map code slabs twice, see above. Falls back to protecting code pages
+    /// when the system doesn't support it.
+    bool UseDualMapping = true;
+  };
+
+  enum class Purpose { Code, ROData, RWData };
+
+  JITMemoryPool() : JITMemoryPool(Options()) {}
+  explicit JITMemoryPool(const Options &Opts);
+  JITMemoryPool(const JITMemoryPool &) = delete;
+  void operator=(const JITMemoryPool &) = delete;
+  ~JITMemoryPool();
+
+  /// \brief Allocate \p Size writable bytes for \p P.
+  ///
+  /// The value of \p Alignment must be a power of two. If \p Alignment is
+  /// zero a default alignment of 16 will be used. Returns null on failure.
+  uint8_t *allocate(Purpose P, uintptr_t Size, unsigned Alignment);
+
+  /// \brief Give a block returned by allocate(P, Size, Alignment) back to the
+  /// pool for reuse. Only small read-write data blocks are reused.
+  void deallocate(Purpose P, uint8_t *Addr, uintptr_t Size,
+                  unsigned Alignment);
+
+  /// \brief Return the address that code allocated at \p Addr runs from.
+  /// This is \p Addr itself unless code is dual mapped.
+  uint64_t getExecutableAddress(const uint8_t *Addr) const;
+
+  /// \brief Make all the code and read-only data allocated since the last
+  /// call executable, respectively read-only.
+  std::error_code finalize();
+
+  /// Whether code is written and run through different mappings.
+  bool isCodeDualMapped() const { return CodeDualMapped; }
+
+  /// Number of protectMappedMemory calls made so far.
+  unsigned getNumProtectCalls() const { return NumProtectCalls; }
+
+private:
+  /// The smallest size class, and the number of classes. Class I holds blocks
+  /// of MinClassSize << I bytes, aligned to their size.
+  static const uintptr_t MinClassSize = 16;
+  static const unsigned NumSizeClasses = 9;
+
+  struct Slab {
+    /// The memory we write to.
+    sys::MemoryBlock Writable;
+    /// The executable view of Writable, if code is dual mapped.
+    sys::MemoryBlock Alias;
+  };
+
+  struct Arena {
+    /// Permissions of the memory once finalized.
+    unsigned Permissions;
+
+    SmallVector<Slab, 4> Slabs;
+
+    /// The unallocated part of the last slab.
+    uintptr_t Cur = 0;
+    uintptr_t End = 0;
+
+    /// Memory handed out since the last finalize() that still has to be
+    /// protected: [PendingBegin, Cur) in the last slab, and PendingMem in the
+    /// previous slabs.
+    uintptr_t PendingBegin = 0;
+    SmallVector<sys::MemoryBlock, 2> PendingMem;
+
+    /// Recycled blocks, per size class. Only used for read-write data.
+    SmallVector<uint8_t *, 0> FreeBlocks[NumSizeClasses];
+  };
+
+  static unsigned getSizeClass(uintptr_t Size, unsigned Alignment);
+
+  Arena &getArena(Purpose P);
+  bool addSlab(Arena &A, uintptr_t MinSize);
+  uint8_t *bumpAllocate(Arena &A, uintptr_t Size, uintptr_t Alignment);
+  std::error_code finalizeArena(Arena &A);
+
+  Options Opts;
+  bool CodeDualMapped;
+  unsigned NumProtectCalls = 0;
+
+  Arena CodeMem;
+  Arena RODataMem;
+  Arena RWDataMem;
+};
+
+/// A memory manager for RuntimeDyld that allocates out of a JITMemoryPool.
+///
+/// Any number of these can share a pool: in a JIT that loads one object per
+/// module or per function, giving each its own PooledMemoryManager over a
+/// common pool packs all of their code together.
+///
+/// As with SectionMemoryManager, code cannot be run before finalizeMemory
+/// has been called.
+class PooledMemoryManager : public RTDyldMemoryManager {
+public:
+  /// Allocate out of \p Pool, which must outlive this memory manager.
+  explicit PooledMemoryManager(JITMemoryPool &Pool) : Pool(Pool) {}
+  PooledMemoryManager(const PooledMemoryManager &) = delete;
+  void operator=(const PooledMemoryManager &) = delete;
+  ~PooledMemoryManager() override;
+
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               StringRef SectionName) override;
+
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID, StringRef SectionName,
+                               bool IsReadOnly) override;
+
+  /// \brief Point RuntimeDyld at the executable view of the code sections of
+  /// \p Obj when code is dual mapped, so that code is relocated for and run
+  /// from there.
+  void notifyObjectLoaded(RuntimeDyld &RTDyld,
+                          const object::ObjectFile &Obj) override;
+  using RTDyldMemoryManager::notifyObjectLoaded;
+
+  /// \brief Apply the permissions of all the pending memory of the pool.
+  ///
+  /// \returns true if an error occurred, false otherwise.
+  bool finalizeMemory(std::string *ErrMsg = nullptr) override;
+
+private:
+  JITMemoryPool &Pool;
+
+  /// Code sections allocated since the last notifyObjectLoaded.
+  SmallVector<uint8_t *, 4> UnmappedCode;
+
+  struct RWDataBlock {
+    uint8_t *Addr;
+    uintptr_t Size;
+    unsigned Alignment;
+  };
+
+  /// Read-write data blocks to give back to the pool.
+  std::vector<RWDataBlock> RWDataBlocks;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_POOLEDMEMORYMANAGER_H
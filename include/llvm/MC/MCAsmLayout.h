@@ -75,6 +75,10 @@ public:
   /// \brief Get the offset of the given fragment inside its containing section.
   uint64_t getFragmentOffset(const MCFragment *F) const;
 
+  /// \brief Get the number of fragments of \p Sec that have been laid out,
+  /// i.e., the layout order of the first fragment that hasn't been.
+  unsigned getNumValidFragments(const MCSection *Sec) const;
+
   /// @}
   /// \name Utility Functions
   /// @{
@@ -147,6 +147,22 @@ private:
 
   VersionMinInfoType VersionMinInfo;
 
+  /// Relaxation bookkeeping for one section, to avoid re-evaluating the
+  /// fragments whose inputs haven't changed since the previous pass.
+  struct SectionRelaxState {
+    /// The layout order of the first fragment whose size changed in the
+    /// previous pass over the section, or ~0U if none did.
+    unsigned FirstChanged = 0;
+
+    /// For each fragment, the last layout order in the section that its
+    /// relaxation depends on, or ~0U if it may depend on anything else.
+    std::vector<unsigned> Reach;
+  };
+
+  /// The relaxation state of each section, indexed by layout order. Only
+  /// valid during layout.
+  std::vector<SectionRelaxState> RelaxStates;
+
   /// Evaluate a fixup to a relocatable expression and the value which should be
   /// placed into the fixup.
   ///
@@ -192,6 +208,10 @@ private:
                               MCCVInlineLineTableFragment &DF);
   bool relaxCVDefRange(MCAsmLayout &Layout, MCCVDefRangeFragment &DF);
 
+  /// Compute the last layout order in its section that the relaxation of
+  /// \p F depends on, or ~0U if it may depend on anything else.
+  unsigned computeRelaxationReach(const MCFragment &F) const;
+
   /// finishLayout - Finalize a layout, including fragment lowering.
   void finishLayout(MCAsmLayout &Layout);
 
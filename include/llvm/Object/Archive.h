@@ -14,6 +14,7 @@
 #ifndef LLVM_OBJECT_ARCHIVE_H
 #define LLVM_OBJECT_ARCHIVE_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/iterator_range.h"
@@ -22,6 +23,7 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Threading.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
@@ -258,6 +260,9 @@ public:
   }
 
   // check if a symbol is in the archive
+  //
+  // The first lookup indexes the symbol table by name, so that the following
+  // ones don't scan it.
   Expected<Optional<Child>> findSym(StringRef name) const;
 
   bool isEmpty() const;
@@ -281,6 +286,12 @@ private:
   unsigned Format : 3;
   unsigned IsThin : 1;
   mutable std::vector<std::unique_ptr<MemoryBuffer>> ThinBuffers;
+
+  // The first symbol of the symbol table with each name, built by the first
+  // findSym.
+  mutable DenseMap<StringRef, Symbol> SymbolMap;
+  mutable llvm::once_flag SymbolMapFlag;
+  void buildSymbolMap() const;
 };
 
 } // end namespace object
@@ -13,6 +13,7 @@
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Compression.h"
 
 namespace llvm {
 namespace object {
@@ -55,10 +56,11 @@ private:
   Decompressor(StringRef Data);
 
   Error consumeCompressedGnuHeader();
-  Error consumeCompressedZLibHeader(bool Is64Bit, bool IsLittleEndian);
+  Error consumeCompressedSectionHeader(bool Is64Bit, bool IsLittleEndian);
 
   StringRef SectionData;
   uint64_t DecompressedSize;
+  compression::Format Format = compression::Format::Zlib;
 };
 
 } // end namespace object
@@ -46,6 +46,55 @@ uint32_t crc32(StringRef Buffer);
 
 }  // End of namespace zlib
 
+namespace zstd {
+
+enum CompressionLevel {
+  BestSpeedCompression,
+  DefaultCompression,
+  BestSizeCompression
+};
+
+bool isAvailable();
+
+Error compress(StringRef InputBuffer, SmallVectorImpl<char> &CompressedBuffer,
+               CompressionLevel Level = DefaultCompression);
+
+Error uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                 size_t &UncompressedSize);
+
+Error uncompress(StringRef InputBuffer,
+                 SmallVectorImpl<char> &UncompressedBuffer,
+                 size_t UncompressedSize);
+
+}  // End of namespace zstd
+
+/// Entry points that select the backend at run time, for formats that record
+/// which algorithm their data was compressed with.
+namespace compression {
+
+enum class Format {
+  Zlib,
+  Zstd,
+};
+
+/// Returns the name of \p F, for diagnostics.
+StringRef getName(Format F);
+
+bool isAvailable(Format F);
+
+/// Compress \p InputBuffer with the default level of \p F.
+Error compress(Format F, StringRef InputBuffer,
+               SmallVectorImpl<char> &CompressedBuffer);
+
+Error uncompress(Format F, StringRef InputBuffer, char *UncompressedBuffer,
+                 size_t &UncompressedSize);
+
+Error uncompress(Format F, StringRef InputBuffer,
+                 SmallVectorImpl<char> &UncompressedBuffer,
+                 size_t UncompressedSize);
+
+}  // End of namespace compression
+
 } // End of namespace llvm
 
 #endif
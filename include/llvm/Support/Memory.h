@@ -48,7 +48,14 @@ namespace sys {
     enum ProtectionFlags {
       MF_READ  = 0x1000000,
       MF_WRITE = 0x2000000,
-      MF_EXEC  = 0x4000000
+      MF_EXEC  = 0x4000000,
+      MF_RWE_MASK = 0x7000000,
+
+      /// The memory is a large, long-lived allocation that should be backed
+      /// by huge pages where the system supports it. The block is then
+      /// aligned and sized to a huge page. This is only a hint: it is ignored
+      /// by protectMappedMemory and on systems without huge pages.
+      MF_HUGE_HINT = 0x0000001
     };
 
     /// This method allocates a block of memory that is suitable for loading
@@ -80,6 +87,26 @@ namespace sys {
                                             unsigned Flags,
                                             std::error_code &EC);
 
+    /// This method allocates a block of memory that is mapped twice: once
+    /// read-write, returned in \p Writable, and once with the protection
+    /// \p Flags, returned in \p Alias. Both mappings share the same physical
+    /// pages, so a JIT can write code through \p Writable and run it from
+    /// \p Alias without any page ever being both writable and executable,
+    /// and without changing page protections once code has been written.
+    /// \p Flags may include MF_HUGE_HINT.
+    ///
+    /// Both blocks must be released with releaseMappedMemory.
+    ///
+    /// \r error_success if the function was successful, or an error_code
+    /// describing the failure. errc::function_not_supported is returned on
+    /// systems where this isn't implemented.
+    ///
+    /// @brief Allocate doubly mapped memory.
+    static std::error_code allocateDualMappedMemory(size_t NumBytes,
+                                                    unsigned Flags,
+                                                    MemoryBlock &Writable,
+                                                    MemoryBlock &Alias);
+
     /// This method releases a block of memory that was allocated with the
     /// allocateMappedMemory method. It should not be used to release any
     /// memory block allocated any other way.
@@ -34,7 +34,8 @@ public:
   /// Get the current time and memory usage.  If Start is true we get the memory
   /// usage before the time, otherwise we get time before memory usage.  This
   /// matters if the time to get the memory usage is significant and shouldn't
-  /// be counted as part of a duration.
+  /// be counted as part of a duration.  With -fast-timers, only the wall time
+  /// is measured, using a monotonic clock instead of getrusage.
   static TimeRecord getCurrentTime(bool Start = true);
 
   double getProcessTime() const { return UserTime + SystemTime; }
@@ -81,6 +82,7 @@ class Timer {
   bool Running;             ///< Is the timer currently running?
   bool Triggered;           ///< Has the timer ever been triggered?
   TimerGroup *TG = nullptr; ///< The TimerGroup this Timer is in.
+  unsigned TraceNameID = 0; ///< Name of the trace events, 0 if unassigned.
 
   Timer **Prev;             ///< Pointer to \p Next of previous timer in group.
   Timer *Next;              ///< Next timer in the group.
@@ -210,6 +212,11 @@ public:
   /// Prints all timers as JSON key/value pairs, and clears them all out.
   static const char *printAllJSONValues(raw_ostream &OS, const char *delim);
 
+  /// Prints the regions measured by all timers since -timer-trace-file was
+  /// enabled as a Chrome trace-event JSON document, and clears them out.  The
+  /// trace file itself is written by llvm_shutdown().
+  static void printAllTraceEvents(raw_ostream &OS);
+
   /// Ensure global timer group lists are initialized. This function is mostly
   /// used by the Statistic code to influence the construction and destruction
   /// order of the global timer lists.
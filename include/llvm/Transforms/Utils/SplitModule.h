@@ -34,10 +34,14 @@ class StringRef;
 ///   module.
 /// - Internal symbols defined in module-level inline asm should be visible to
 ///   each partition.
+///
+/// If ClusterCallGraphSCCs is set, the functions of each call graph SCC are
+/// kept in the same partition, so that the interprocedural optimizations of a
+/// partition see whole recursion cycles.
 void SplitModule(
     std::unique_ptr<Module> M, unsigned N,
     function_ref<void(std::unique_ptr<Module> MPart)> ModuleCallback,
-    bool PreserveLocals = false);
+    bool PreserveLocals = false, bool ClusterCallGraphSCCs = false);
 
 } // End llvm namespace
 
@@ -14,9 +14,13 @@
 #define LLVM_XRAY_TRACE_H
 
 #include <cstdint>
+#include <iterator>
+#include <memory>
 #include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/iterator_range.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/XRay/XRayRecord.h"
@@ -65,6 +69,143 @@ public:
 /// |Filename|.
 Expected<Trace> loadTraceFile(StringRef Filename, bool Sort = false);
 
+/// A TraceBuffer is a region of an XRay log whose records can be decoded
+/// without looking at the rest of the file. A naive-mode log is a single
+/// buffer, while a Flight Data Recorder mode log has one buffer for each thread
+/// buffer flushed by the runtime.
+struct TraceBuffer {
+  /// The raw bytes of the buffer, pointing into the memory-mapped log.
+  StringRef Data;
+
+  /// Records which were decoded up front, for logs in a format that cannot be
+  /// decoded on demand (YAML).
+  ArrayRef<XRayRecord> Records;
+
+  /// The thread that wrote this buffer. Only meaningful for FDR-mode logs.
+  uint32_t TId = 0;
+
+  /// The TSC of the first record in the buffer, used to order the buffers
+  /// written by the same thread. Only meaningful for FDR-mode logs.
+  uint64_t BaseTSC = 0;
+};
+
+/// A TraceReader provides streaming access to the records of an XRay log. The
+/// log is memory-mapped and records are decoded on demand, one buffer at a
+/// time, so the size of the trace does not bound the size of the log that can
+/// be processed.
+///
+/// Since every buffer carries its own decoding state, the buffers of a
+/// TraceReader may be iterated concurrently from several threads.
+///
+/// Usage:
+///
+///   if (auto ReaderOrErr = openTraceFile("xray-log.something.xray")) {
+///     auto &R = **ReaderOrErr;
+///     for (const TraceBuffer &B : R.buffers()) {
+///       Error Err = Error::success();
+///       for (const XRayRecord &Rec : R.records(B, Err)) {
+///         // ... do something with Rec here.
+///       }
+///       if (Err)
+///         // Handle the error here.
+///     }
+///   }
+///
+class TraceReader {
+public:
+  enum class LogFormat { NAIVE, FDR, YAML };
+
+  /// An input iterator over the records of a single TraceBuffer. Decoding
+  /// errors are reported through the Error the iterator was created with, at
+  /// which point the iterator compares equal to the end of the buffer.
+  class record_iterator
+      : public std::iterator<std::input_iterator_tag, const XRayRecord> {
+    friend class TraceReader;
+
+    const TraceReader *Reader = nullptr;
+    const TraceBuffer *Buffer = nullptr;
+    uint64_t Offset = UINT64_MAX;
+    XRayRecord Current;
+    Error *Err = nullptr;
+
+    // The decoding state of Flight Data Recorder mode buffers, private to the
+    // reader. Copies of an iterator share it, as input iterators may.
+    struct DecodeState;
+    std::shared_ptr<DecodeState> State;
+
+    record_iterator(const TraceReader *Reader, const TraceBuffer *Buffer,
+                    Error *Err);
+
+    // Decodes the next record of the buffer into Current, or moves the
+    // iterator to the end of the buffer if there are none left.
+    void advance();
+
+  public:
+    record_iterator() = default;
+
+    const XRayRecord &operator*() const { return Current; }
+    const XRayRecord *operator->() const { return &Current; }
+
+    bool operator==(const record_iterator &Other) const {
+      // Iterators that stopped on an error have been moved to the end of the
+      // buffer, so this also does the right thing for those.
+      return Buffer == Other.Buffer && Offset == Other.Offset;
+    }
+    bool operator!=(const record_iterator &Other) const {
+      return !(*this == Other);
+    }
+
+    // Code in loops with record_iterators must check the Error after the loop
+    // to tell the end of the buffer from a decoding failure.
+    record_iterator &operator++() {
+      advance();
+      return *this;
+    }
+  };
+
+private:
+  std::unique_ptr<sys::fs::mapped_file_region> MappedFile;
+  XRayFileHeader FileHeader;
+  LogFormat Format = LogFormat::NAIVE;
+  std::vector<TraceBuffer> Buffers;
+  std::vector<XRayRecord> DecodedRecords;
+
+  friend Expected<std::unique_ptr<TraceReader>> openTraceFile(StringRef);
+
+public:
+  /// Provides access to the XRay trace file header.
+  const XRayFileHeader &getFileHeader() const { return FileHeader; }
+
+  LogFormat getFormat() const { return Format; }
+
+  /// The independently decodable buffers of the log, in file order.
+  ArrayRef<TraceBuffer> buffers() const { return Buffers; }
+
+  /// Groups the buffers by the thread that wrote them, with the buffers of
+  /// each group ordered by their first TSC. No thread has records in more than
+  /// one group, so the groups can be processed concurrently. There is always at
+  /// least one group, and logs that are not in FDR mode form a single group.
+  std::vector<std::vector<const TraceBuffer *>> getThreadBufferGroups() const;
+
+  record_iterator records_begin(const TraceBuffer &B, Error &Err) const {
+    return record_iterator(this, &B, &Err);
+  }
+  record_iterator records_end(const TraceBuffer &B) const {
+    record_iterator I;
+    I.Buffer = &B;
+    return I;
+  }
+  iterator_range<record_iterator> records(const TraceBuffer &B,
+                                          Error &Err) const {
+    return make_range(records_begin(B, Err), records_end(B));
+  }
+};
+
+/// Opens the XRay log in |Filename| for streaming. Only the file header and the
+/// boundaries of the buffers are read up front; records are decoded as they
+/// are iterated over.
+Expected<std::unique_ptr<TraceReader>> openTraceFile(StringRef Filename);
+
 } // namespace xray
 } // namespace llvm
 
@@ -29,11 +29,15 @@
 #include "llvm/IR/UseListOrder.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/MC/StringTableBuilder.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/SHA1.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cctype>
 #include <map>
 using namespace llvm;
@@ -44,6 +48,11 @@ cl::opt<unsigned>
     IndexThreshold("bitcode-mdindex-threshold", cl::Hidden, cl::init(25),
                    cl::desc("Number of metadatas above which we emit an index "
                             "to enable lazy-loading"));
+
+cl::opt<unsigned>
+    WriterThreads("bitcode-writer-threads", cl::Hidden, cl::init(1),
+                  cl::desc("Number of threads encoding function blocks "
+                           "(0 = one per hardware thread)"));
 /// These are manifest constants used by the bitcode writer. They do not need to
 /// be kept in sync with the reader, but need to be consistent within this file.
 enum {
@@ -172,6 +181,19 @@ public:
   void write();
 
 private:
+  /// Constructs a ModuleBitcodeWriter that only writes function blocks of
+  /// \p Parent's module to \p Stream, with the same value numbering.
+  ModuleBitcodeWriter(const ModuleBitcodeWriter &Parent,
+                      SmallVectorImpl<char> &Buffer,
+                      StringTableBuilder &StrtabBuilder,
+                      BitstreamWriter &Stream)
+      : BitcodeWriterBase(Stream, StrtabBuilder), Buffer(Buffer), M(Parent.M),
+        VE(Parent.M, Parent.VE.shouldPreserveUseListOrder(),
+           /*PredictUseListOrder=*/false),
+        Index(nullptr), GenerateHash(false), ModHash(nullptr),
+        BitcodeStartBit(Stream.GetCurrentBitNo()),
+        GlobalValueId(VE.getValues().size()) {}
+
   uint64_t bitcodeStartBit() { return BitcodeStartBit; }
 
   void writeAttributeGroupTable();
@@ -279,6 +301,11 @@ private:
   void
   writeFunction(const Function &F,
                 DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
+  void writeFunctionBlocks(
+      DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
+  void writeDetachedFunctionBlocks(ArrayRef<const Function *> Functions,
+                                   MutableArrayRef<UseListOrderStack> Orders,
+                                   std::vector<uint64_t> &Offsets);
   void writeBlockInfo();
   void writePerModuleFunctionSummaryRecord(SmallVector<uint64_t, 64> &NameVals,
                                            GlobalValueSummary *Summary,
@@ -2947,6 +2974,129 @@ void ModuleBitcodeWriter::writeFunction(
   Stream.ExitBlock();
 }
 
+/// Emit the function bodies, in module order.
+///
+/// With -bitcode-writer-threads, the functions are split into ranges of
+/// similar size. The first range is written to the module stream directly
+/// while the others are encoded concurrently into private streams, each with
+/// its own ValueEnumerator, and then copied into the module stream. Function
+/// blocks start and end on a word boundary and do not depend on anything
+/// written before them besides the block info abbreviations, so the result
+/// is identical to writing them in sequence.
+void ModuleBitcodeWriter::writeFunctionBlocks(
+    DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex) {
+  std::vector<const Function *> Functions;
+  for (const Function &F : M)
+    if (!F.isDeclaration())
+      Functions.push_back(&F);
+
+  unsigned Threads =
+      WriterThreads ? WriterThreads.getValue()
+                    : heavyweight_hardware_concurrency();
+  Threads = std::min<size_t>(Threads, Functions.size());
+  if (Threads <= 1 || Stream.GetCurrentBitNo() % 32 != 0) {
+    for (const Function *F : Functions)
+      writeFunction(*F, FunctionToBitcodeIndex);
+    return;
+  }
+
+  // writeFunction pops the use-list orders of each function off the top of
+  // the stack. Split them up front so the functions can be written in any
+  // order, by any writer.
+  std::vector<UseListOrderStack> Orders(Functions.size());
+  for (size_t I = 0, E = Functions.size(); I != E; ++I) {
+    while (!VE.UseListOrders.empty() &&
+           VE.UseListOrders.back().F == Functions[I]) {
+      Orders[I].push_back(std::move(VE.UseListOrders.back()));
+      VE.UseListOrders.pop_back();
+    }
+    std::reverse(Orders[I].begin(), Orders[I].end());
+  }
+
+  // Split the functions into ranges with about the same number of
+  // instructions.
+  std::vector<uint64_t> Sizes;
+  uint64_t TotalSize = 0;
+  for (const Function *F : Functions) {
+    uint64_t Size = 1;
+    for (const BasicBlock &BB : *F)
+      Size += BB.size();
+    Sizes.push_back(Size);
+    TotalSize += Size;
+  }
+  std::vector<size_t> RangeStarts(1, 0);
+  uint64_t SizeSoFar = 0;
+  for (size_t I = 0, E = Functions.size(); I != E; ++I) {
+    if (I != RangeStarts.back() &&
+        SizeSoFar >= TotalSize * RangeStarts.size() / Threads)
+      RangeStarts.push_back(I);
+    SizeSoFar += Sizes[I];
+  }
+  RangeStarts.push_back(Functions.size());
+  size_t NumRanges = RangeStarts.size() - 1;
+
+  struct DetachedBlocks {
+    SmallVector<char, 0> Buffer;
+    /// Start bit of each function block, plus the end of the last one.
+    std::vector<uint64_t> Offsets;
+  };
+  std::vector<DetachedBlocks> Blocks(NumRanges);
+  ArrayRef<const Function *> AllFunctions(Functions);
+  MutableArrayRef<UseListOrderStack> AllOrders(Orders);
+  {
+    ThreadPool Pool(NumRanges - 1);
+    for (size_t R = 1; R != NumRanges; ++R)
+      Pool.async([&, R] {
+        size_t Start = RangeStarts[R], Count = RangeStarts[R + 1] - Start;
+        StringTableBuilder UnusedStrtab(StringTableBuilder::RAW);
+        BitstreamWriter RangeStream(Blocks[R].Buffer);
+        ModuleBitcodeWriter RangeWriter(*this, Blocks[R].Buffer, UnusedStrtab,
+                                        RangeStream);
+        RangeWriter.writeDetachedFunctionBlocks(
+            AllFunctions.slice(Start, Count), AllOrders.slice(Start, Count),
+            Blocks[R].Offsets);
+      });
+
+    for (size_t I = 0, E = RangeStarts[1]; I != E; ++I) {
+      VE.UseListOrders = std::move(Orders[I]);
+      writeFunction(*Functions[I], FunctionToBitcodeIndex);
+    }
+    Pool.wait();
+  }
+
+  for (size_t R = 1; R != NumRanges; ++R) {
+    const DetachedBlocks &B = Blocks[R];
+    for (size_t I = RangeStarts[R], E = RangeStarts[R + 1]; I != E; ++I) {
+      FunctionToBitcodeIndex[Functions[I]] = Stream.GetCurrentBitNo();
+      uint64_t Begin = B.Offsets[I - RangeStarts[R]];
+      uint64_t End = B.Offsets[I - RangeStarts[R] + 1];
+      for (uint64_t Bit = Begin; Bit != End; Bit += 32)
+        Stream.Emit(support::endian::read32le(&B.Buffer[Bit / 8]), 32);
+    }
+  }
+}
+
+/// Write the function blocks of \p Functions to this writer's private
+/// stream, recording where each of them starts in \p Offsets.
+void ModuleBitcodeWriter::writeDetachedFunctionBlocks(
+    ArrayRef<const Function *> Functions,
+    MutableArrayRef<UseListOrderStack> Orders,
+    std::vector<uint64_t> &Offsets) {
+  // Register the same block info abbreviations as the module stream, and
+  // nest the functions in a block with the same abbreviation width as the
+  // module block, so that they are encoded bit for bit the same.
+  writeBlockInfo();
+  Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
+  DenseMap<const Function *, uint64_t> FunctionToBitcodeIndex;
+  for (size_t I = 0, E = Functions.size(); I != E; ++I) {
+    VE.UseListOrders = std::move(Orders[I]);
+    Offsets.push_back(Stream.GetCurrentBitNo());
+    writeFunction(*Functions[I], FunctionToBitcodeIndex);
+  }
+  Offsets.push_back(Stream.GetCurrentBitNo());
+  Stream.ExitBlock();
+}
+
 // Emit blockinfo, which defines the standard abbreviations etc.
 void ModuleBitcodeWriter::writeBlockInfo() {
   // We only want to emit block info records for blocks that have multiple
@@ -3708,9 +3858,7 @@ void ModuleBitcodeWriter::write() {
 
   // Emit function bodies.
   DenseMap<const Function *, uint64_t> FunctionToBitcodeIndex;
-  for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
-    if (!F->isDeclaration())
-      writeFunction(*F, FunctionToBitcodeIndex);
+  writeFunctionBlocks(FunctionToBitcodeIndex);
 
   // Need to write after the above call to WriteFunction which populates
   // the summary information in the index.
@@ -288,9 +288,10 @@ static bool isIntOrIntVectorValue(const std::pair<const Value*, unsigned> &V) {
 }
 
 ValueEnumerator::ValueEnumerator(const Module &M,
-                                 bool ShouldPreserveUseListOrder)
+                                 bool ShouldPreserveUseListOrder,
+                                 bool PredictUseListOrder)
     : ShouldPreserveUseListOrder(ShouldPreserveUseListOrder) {
-  if (ShouldPreserveUseListOrder)
+  if (ShouldPreserveUseListOrder && PredictUseListOrder)
     UseListOrders = predictUseListOrder(M);
 
   // Enumerate the global variables.
@@ -141,7 +141,10 @@ private:
   ValueEnumerator(const ValueEnumerator &) = delete;
   void operator=(const ValueEnumerator &) = delete;
 public:
-  ValueEnumerator(const Module &M, bool ShouldPreserveUseListOrder);
+  /// If \p PredictUseListOrder is false, UseListOrders is left empty even
+  /// when preserving use-list order; the caller is expected to fill it in.
+  ValueEnumerator(const Module &M, bool ShouldPreserveUseListOrder,
+                  bool PredictUseListOrder = true);
 
   void dump() const;
   void print(raw_ostream &OS, const ValueMapType &Map, const char *Name) const;
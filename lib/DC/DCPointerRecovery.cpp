@@ -0,0 +1,242 @@
+//===-- lib/DC/DCPointerRecovery.cpp - Recover pointers ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DC/DCPointerRecovery.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "dc-pointer-recovery"
+
+STATISTIC(NumRecoveredAddrs, "Number of addresses rewritten as GEPs");
+STATISTIC(NumPointerPHIs, "Number of pointer phis created for bases");
+
+// How deep to look into the additions computing an address.
+static const unsigned MaxAddrDepth = 8;
+
+namespace llvm {
+void initializeDCPointerRecoveryPass(PassRegistry &);
+}
+
+namespace {
+/// An address, as Base + the sum of Indices + Offset.
+struct DecomposedAddr {
+  Value *Base = nullptr;
+  SmallVector<Value *, 4> Indices;
+  uint64_t Offset = 0;
+};
+
+/// \brief Legacy pass rewriting the integer addresses of lifted code as GEPs.
+class DCPointerRecovery : public FunctionPass {
+  IntegerType *IntPtrTy;
+  PointerType *I8PtrTy;
+
+  // The i8* equal to each base.
+  DenseMap<Value *, Value *> BasePtrs;
+
+public:
+  static char ID;
+
+  DCPointerRecovery() : FunctionPass(ID) {
+    initializeDCPointerRecoveryPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnFunction(Function &F) override;
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+private:
+  DecomposedAddr decompose(Value *Addr);
+  void collectTerms(Value *V, DecomposedAddr &A,
+                    SmallVectorImpl<Value *> &Leaves, unsigned Depth);
+
+  /// Return the i8* equal to the integer \p Base, creating it if needed.
+  Value *getBasePtr(Value *Base);
+
+  /// Compute the address \p A as GEPs, before \p InsertPt.
+  Value *materialize(const DecomposedAddr &A, Instruction *InsertPt);
+};
+} // end anonymous namespace
+
+void DCPointerRecovery::collectTerms(Value *V, DecomposedAddr &A,
+                                     SmallVectorImpl<Value *> &Leaves,
+                                     unsigned Depth) {
+  if (auto *C = dyn_cast<ConstantInt>(V)) {
+    A.Offset += C->getZExtValue();
+    return;
+  }
+  if (auto *BO = dyn_cast<BinaryOperator>(V)) {
+    if (Depth < MaxAddrDepth && BO->getOpcode() == Instruction::Add) {
+      collectTerms(BO->getOperand(0), A, Leaves, Depth + 1);
+      collectTerms(BO->getOperand(1), A, Leaves, Depth + 1);
+      return;
+    }
+    auto *C = dyn_cast<ConstantInt>(BO->getOperand(1));
+    if (Depth < MaxAddrDepth && C && BO->getOpcode() == Instruction::Sub) {
+      collectTerms(BO->getOperand(0), A, Leaves, Depth + 1);
+      A.Offset -= C->getZExtValue();
+      return;
+    }
+  }
+  Leaves.push_back(V);
+}
+
+/// Return whether \p V is an index scaled by a constant, which is unlikely to
+/// be a base.
+static bool isScaledIndex(Value *V) {
+  auto *BO = dyn_cast<BinaryOperator>(V);
+  return BO && isa<ConstantInt>(BO->getOperand(1)) &&
+         (BO->getOpcode() == Instruction::Mul ||
+          BO->getOpcode() == Instruction::Shl);
+}
+
+DecomposedAddr DCPointerRecovery::decompose(Value *Addr) {
+  DecomposedAddr A;
+  SmallVector<Value *, 4> Leaves;
+  collectTerms(Addr, A, Leaves, 0);
+
+  // The base register comes first in the lifted addresses, but prefer any
+  // unscaled term to a scaled index.
+  auto BaseI = find_if(Leaves, [](Value *V) { return !isScaledIndex(V); });
+  if (BaseI != Leaves.end()) {
+    A.Base = *BaseI;
+    Leaves.erase(BaseI);
+  } else if (A.Offset != 0 || Leaves.empty()) {
+    // An absolute address, e.g., of a global array, or a constant such as
+    // the 0 a counter used as a base starts at.
+    A.Base = ConstantInt::get(IntPtrTy, A.Offset);
+    A.Offset = 0;
+  } else {
+    A.Base = Leaves.front();
+    Leaves.erase(Leaves.begin());
+  }
+  A.Indices.append(Leaves.begin(), Leaves.end());
+  return A;
+}
+
+static std::string getPtrName(Value *V) {
+  return V->hasName() ? (V->getName() + ".ptr").str() : "";
+}
+
+Value *DCPointerRecovery::getBasePtr(Value *Base) {
+  auto It = BasePtrs.find(Base);
+  if (It != BasePtrs.end())
+    return It->second;
+
+  if (auto *C = dyn_cast<Constant>(Base))
+    return BasePtrs[Base] = ConstantExpr::getIntToPtr(C, I8PtrTy);
+
+  // A base carried by a phi, e.g., a pointer incremented in a loop, gets a
+  // pointer phi, whose incoming values are the addresses of the phi's. But a
+  // null incoming pointer, e.g., of a counter that starts at 0, would make
+  // SimplifyCFG take the accesses off the phi as undefined on that edge: cast
+  // such a phi instead.
+  auto IsNullAddr = [&](Value *V) {
+    DecomposedAddr A = decompose(V);
+    auto *C = dyn_cast<Constant>(A.Base);
+    return A.Indices.empty() && !A.Offset && C && C->isNullValue();
+  };
+  auto *PN = dyn_cast<PHINode>(Base);
+  if (PN && none_of(PN->incoming_values(), IsNullAddr)) {
+    auto *PtrPN = PHINode::Create(I8PtrTy, PN->getNumIncomingValues(),
+                                  getPtrName(PN), PN);
+    BasePtrs[Base] = PtrPN;
+    for (unsigned I = 0, E = PN->getNumIncomingValues(); I != E; ++I) {
+      BasicBlock *BB = PN->getIncomingBlock(I);
+      int Idx = PtrPN->getBasicBlockIndex(BB);
+      Value *In =
+          Idx >= 0 ? PtrPN->getIncomingValue(Idx)
+                   : materialize(decompose(PN->getIncomingValue(I)),
+                                 BB->getTerminator());
+      PtrPN->addIncoming(In, BB);
+    }
+    ++NumPointerPHIs;
+    return PtrPN;
+  }
+
+  Instruction *InsertPt;
+  if (auto *Arg = dyn_cast<Argument>(Base)) {
+    InsertPt = &*Arg->getParent()->getEntryBlock().getFirstInsertionPt();
+  } else if (PN) {
+    InsertPt = &*PN->getParent()->getFirstInsertionPt();
+  } else {
+    auto *I = cast<Instruction>(Base);
+    assert(!isa<TerminatorInst>(I) && "Address computed by a terminator?");
+    InsertPt = I->getNextNode();
+  }
+  return BasePtrs[Base] =
+             new IntToPtrInst(Base, I8PtrTy, getPtrName(Base), InsertPt);
+}
+
+Value *DCPointerRecovery::materialize(const DecomposedAddr &A,
+                                      Instruction *InsertPt) {
+  Value *Ptr = getBasePtr(A.Base);
+  IRBuilder<> Builder(InsertPt);
+  for (Value *Idx : A.Indices)
+    Ptr = Builder.CreateGEP(Builder.getInt8Ty(), Ptr, Idx);
+  if (A.Offset)
+    Ptr = Builder.CreateGEP(Builder.getInt8Ty(), Ptr,
+                            ConstantInt::get(IntPtrTy, A.Offset));
+  return Ptr;
+}
+
+bool DCPointerRecovery::runOnFunction(Function &F) {
+  if (skipFunction(F))
+    return false;
+
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  IntPtrTy = DL.getIntPtrType(F.getContext());
+  I8PtrTy = Type::getInt8PtrTy(F.getContext());
+  BasePtrs.clear();
+
+  SmallVector<IntToPtrInst *, 16> Casts;
+  for (Instruction &I : instructions(F))
+    if (auto *ITP = dyn_cast<IntToPtrInst>(&I))
+      if (ITP->getSrcTy() == IntPtrTy && ITP->getAddressSpace() == 0)
+        Casts.push_back(ITP);
+
+  bool Changed = false;
+  for (IntToPtrInst *ITP : Casts) {
+    Value *Addr = ITP->getOperand(0);
+    DecomposedAddr A = decompose(Addr);
+
+    // Leave the casts of bases and of absolute addresses alone.
+    if (A.Indices.empty() && !A.Offset &&
+        (isa<Constant>(A.Base) || (A.Base == Addr && !isa<PHINode>(Addr))))
+      continue;
+
+    Value *Ptr = materialize(A, ITP);
+    Ptr = IRBuilder<>(ITP).CreateBitCast(Ptr, ITP->getType());
+    ITP->replaceAllUsesWith(Ptr);
+    ITP->eraseFromParent();
+    ++NumRecoveredAddrs;
+    Changed = true;
+  }
+  return Changed;
+}
+
+char DCPointerRecovery::ID = 0;
+INITIALIZE_PASS(DCPointerRecovery, "dc-pointer-recovery",
+                "Recover Pointers in DC Translated Code", false, false)
+
+FunctionPass *llvm::createDCPointerRecoveryPass() {
+  return new DCPointerRecovery();
+}
@@ -0,0 +1,188 @@
+//===-- lib/DC/DCRegSetOpt.cpp - Regset-aware cleanups ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DC/DCRegSetOpt.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/DC/DCRegisterSetDesc.h"
+#include "llvm/DC/DCTranslator.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "dc-regset-opt"
+
+STATISTIC(NumKnownZeroLoads, "Number of regset loads with known zero bits");
+STATISTIC(NumDeadReturnStores, "Number of regset stores dead on return");
+
+namespace llvm {
+void initializeDCRegSetOptPass(PassRegistry &);
+}
+
+namespace {
+/// \brief Legacy pass optimizing the regset accesses of translated functions.
+class DCRegSetOpt : public FunctionPass {
+  const DCTranslator *DT;
+  bool AssumeCallingConv;
+
+  // The register in each field of the regset.
+  std::vector<unsigned> FieldRegs;
+
+public:
+  static char ID;
+
+  DCRegSetOpt(const DCTranslator *DT = nullptr, bool AssumeCallingConv = false)
+      : FunctionPass(ID), DT(DT), AssumeCallingConv(AssumeCallingConv) {
+    initializeDCRegSetOptPass(*PassRegistry::getPassRegistry());
+    if (!DT)
+      return;
+    const DCRegisterSetDesc &RSD = DT->getRegSetDesc();
+    FieldRegs.resize(RSD.RegSetType->getNumElements());
+    for (unsigned RegNo = 1; RegNo != RSD.NumRegs; ++RegNo)
+      if (RSD.RegOffsetsInSet[RegNo] != -1)
+        FieldRegs[RSD.RegOffsetsInSet[RegNo]] = RegNo;
+  }
+
+  bool runOnFunction(Function &F) override;
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+private:
+  /// Return the register whose regset field \p Ptr points to, 0 if it isn't a
+  /// regset field.
+  unsigned getRegForPtr(Value *Ptr, Value *RegSet) const;
+
+  bool addKnownZeroBits(Value *RegSet);
+  bool removeStoresDeadOnReturn(Function &F, Value *RegSet);
+};
+} // end anonymous namespace
+
+unsigned DCRegSetOpt::getRegForPtr(Value *Ptr, Value *RegSet) const {
+  auto *GEP = dyn_cast<GetElementPtrInst>(Ptr);
+  if (!GEP || GEP->getPointerOperand() != RegSet || GEP->getNumIndices() != 2)
+    return 0;
+  auto *Idx0 = dyn_cast<ConstantInt>(GEP->getOperand(1));
+  auto *Idx1 = dyn_cast<ConstantInt>(GEP->getOperand(2));
+  if (!Idx0 || !Idx0->isZero() || !Idx1 ||
+      Idx1->getZExtValue() >= FieldRegs.size())
+    return 0;
+  return FieldRegs[Idx1->getZExtValue()];
+}
+
+/// Mask the known zero bits out of the loaded registers, so that InstCombine
+/// sees them.
+bool DCRegSetOpt::addKnownZeroBits(Value *RegSet) {
+  SmallVector<LoadInst *, 4> Loads;
+  for (User *U : RegSet->users()) {
+    unsigned RegNo = getRegForPtr(U, RegSet);
+    if (!RegNo || DT->getRegKnownZeroBits(RegNo) == 0)
+      continue;
+    for (User *PtrU : U->users())
+      if (auto *LI = dyn_cast<LoadInst>(PtrU))
+        if (LI->getPointerOperand() == U)
+          Loads.push_back(LI);
+  }
+
+  bool Changed = false;
+  for (LoadInst *LI : Loads) {
+    unsigned RegNo = getRegForPtr(LI->getPointerOperand(), RegSet);
+    APInt KnownZero = DT->getRegKnownZeroBits(RegNo);
+    if (!LI->getType()->isIntegerTy(KnownZero.getBitWidth()))
+      continue;
+
+    // Don't mask the same load twice.
+    if (LI->hasOneUse()) {
+      auto *And = dyn_cast<BinaryOperator>(*LI->user_begin());
+      if (And && And->getOpcode() == Instruction::And)
+        if (auto *Mask = dyn_cast<ConstantInt>(And->getOperand(1)))
+          if ((Mask->getValue() & KnownZero) == 0)
+            continue;
+    }
+
+    // Leave the stores of the value back to the regset alone: DSE removes
+    // them, which it can't do once they store the masked value.
+    SmallVector<Use *, 8> Uses;
+    for (Use &U : LI->uses()) {
+      auto *SI = dyn_cast<StoreInst>(U.getUser());
+      if (!SI || SI->getPointerOperand() != LI->getPointerOperand())
+        Uses.push_back(&U);
+    }
+    if (Uses.empty())
+      continue;
+
+    IRBuilder<> Builder(LI->getNextNode());
+    Value *Masked = Builder.CreateAnd(LI, ~KnownZero);
+    for (Use *U : Uses)
+      U->set(Masked);
+    ++NumKnownZeroLoads;
+    Changed = true;
+  }
+  return Changed;
+}
+
+/// Remove the stores to the regset that callers can't observe, that are only
+/// followed by other regset stores before returning.
+bool DCRegSetOpt::removeStoresDeadOnReturn(Function &F, Value *RegSet) {
+  bool Changed = false;
+  for (BasicBlock &BB : F) {
+    if (!isa<ReturnInst>(BB.getTerminator()))
+      continue;
+
+    SmallVector<StoreInst *, 4> DeadStores;
+    for (auto I = ++BB.rbegin(), E = BB.rend(); I != E; ++I) {
+      if (auto *SI = dyn_cast<StoreInst>(&*I)) {
+        unsigned RegNo = getRegForPtr(SI->getPointerOperand(), RegSet);
+        if (RegNo && !DT->isRegObservedOnReturn(RegNo))
+          DeadStores.push_back(SI);
+        continue;
+      }
+      if (I->mayReadFromMemory() || I->mayHaveSideEffects())
+        break;
+    }
+
+    for (StoreInst *SI : DeadStores) {
+      DEBUG(dbgs() << "Removing store dead on return: " << *SI << "\n");
+      SI->eraseFromParent();
+      ++NumDeadReturnStores;
+      Changed = true;
+    }
+  }
+  return Changed;
+}
+
+bool DCRegSetOpt::runOnFunction(Function &F) {
+  if (!DT || skipFunction(F) || F.arg_size() != 1)
+    return false;
+
+  Value *RegSet = &*F.arg_begin();
+  if (RegSet->getType() != DT->getRegSetDesc().RegSetType->getPointerTo())
+    return false;
+
+  bool Changed = addKnownZeroBits(RegSet);
+  if (AssumeCallingConv)
+    Changed |= removeStoresDeadOnReturn(F, RegSet);
+  return Changed;
+}
+
+char DCRegSetOpt::ID = 0;
+INITIALIZE_PASS(DCRegSetOpt, "dc-regset-opt",
+                "Optimize DC Register Set Accesses", false, false)
+
+FunctionPass *llvm::createDCRegSetOptPass(const DCTranslator &DT,
+                                          bool AssumeCallingConv) {
+  return new DCRegSetOpt(&DT, AssumeCallingConv);
+}
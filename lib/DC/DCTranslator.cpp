@@ -14,15 +14,19 @@
 #include "llvm/DC/DCFunction.h"
 #include "llvm/DC/DCInstruction.h"
 #include "llvm/DC/DCModule.h"
+#include "llvm/DC/DCPointerRecovery.h"
+#include "llvm/DC/DCRegSetOpt.h"
 #include "llvm/MC/MCAnalysis/MCFunction.h"
 #include "llvm/MC/MCAnalysis/MCObjectDisassembler.h"
 #include "llvm/MC/MCAnalysis/MCObjectSymbolizer.h"
 #include "llvm/MC/MCInstrInfo.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scalar/GVN.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include <algorithm>
 #include <memory>
@@ -31,6 +35,13 @@ using namespace llvm;
 
 #define DEBUG_TYPE "dctranslator"
 
+static cl::opt<bool> AssumeCallingConv(
+    "dc-assume-calling-conv",
+    cl::desc("Assume translated functions follow the platform calling "
+             "convention, so that the registers it doesn't preserve are dead "
+             "on return"),
+    cl::init(false));
+
 DCTranslator::DCTranslator(LLVMContext &Ctx, const DataLayout &DL,
                            unsigned OptLevel, const MCInstrInfo &MII,
                            const MCRegisterInfo &MRI,
@@ -58,16 +69,48 @@ void DCTranslator::initializeTranslationModule() {
   DCM = createDCModule(*CurrentModule);
 
   CurrentFPM.reset(new legacy::FunctionPassManager(CurrentModule));
-  if (OptLevel >= 1)
-    CurrentFPM->add(createPromoteMemoryToRegisterPass());
-  if (OptLevel >= 2)
-    CurrentFPM->add(createDeadCodeEliminationPass());
-  if (OptLevel >= 3)
-    CurrentFPM->add(createInstructionCombiningPass());
+  addFunctionPasses();
+}
+
+void DCTranslator::addFunctionPasses() {
+  if (OptLevel == 0)
+    return;
+
+  // Lifted code accesses each register through an alloca, and the regset
+  // around calls and returns.
+  CurrentFPM->add(createSROAPass());
+  if (OptLevel == 1)
+    return;
+
+  // Every instruction computes all the condition codes and flags it defines,
+  // most of which are never used. Remove them before InstCombine, which then
+  // folds the flags extracted from the materialized flags register.
+  CurrentFPM->add(createEarlyCSEPass());
+  CurrentFPM->add(createDCRegSetOptPass(*this, AssumeCallingConv));
+  CurrentFPM->add(createInstructionCombiningPass());
+  if (OptLevel == 2)
+    return;
+
+  // The regset is noalias: GVN forwards the regset stores around calls to the
+  // loads, and DSE removes the stores that are overwritten.
+  CurrentFPM->add(createGVNPass());
+  CurrentFPM->add(createDeadStoreEliminationPass());
+
+  // With the guest addresses as GEPs off their base, alias analysis can tell
+  // guest memory accesses apart, and loop invariant loads can be hoisted.
+  CurrentFPM->add(createDCPointerRecoveryPass());
+  CurrentFPM->add(createEarlyCSEPass());
+  CurrentFPM->add(createLICMPass());
+  CurrentFPM->add(createCFGSimplificationPass());
+  CurrentFPM->add(createInstructionCombiningPass());
 }
 
 DCTranslator::~DCTranslator() {}
 
+APInt DCTranslator::getRegKnownZeroBits(unsigned RegNo) const {
+  return APInt(RegSetDesc.RegSizes[RegNo], 0);
+}
+
 Function *DCTranslator::getFunction(StringRef Name) {
   for (auto &M : ModuleSet)
     if (Function *F = M->getFunction(Name))
@@ -0,0 +1,335 @@
+//===- DWARFAddressIndex.cpp ----------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DebugInfo/DWARF/DWARFAddressIndex.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/Support/DataExtractor.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/JamCRC.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <tuple>
+
+using namespace llvm;
+
+typedef DILineInfoSpecifier::FileLineInfoKind FileLineInfoKind;
+typedef DILineInfoSpecifier::FunctionNameKind FunctionNameKind;
+
+static const char IndexMagic[4] = {'D', 'W', 'A', 'I'};
+static const uint32_t IndexVersion = 1;
+
+std::unique_ptr<DWARFAddressIndex>
+DWARFAddressIndex::build(DWARFContext &Context) {
+  // The answers of the context only change at the bounds of the ranges used
+  // to find the compile unit, the line table row or the inlined chain of an
+  // address. Collect them all and evaluate the context at each of them.
+  std::vector<uint64_t> Bounds;
+  Context.getDebugAranges()->collectRangeBounds(Bounds);
+  for (const auto &CU : Context.compile_units()) {
+    CU->collectSubroutineRangeBounds(Bounds);
+    if (const auto *LineTable = Context.getLineTableForUnit(CU.get())) {
+      for (const auto &Row : LineTable->Rows)
+        Bounds.push_back(Row.Address);
+      for (const auto &Seq : LineTable->Sequences) {
+        Bounds.push_back(Seq.LowPC);
+        Bounds.push_back(Seq.HighPC);
+      }
+    }
+  }
+  std::sort(Bounds.begin(), Bounds.end());
+  Bounds.erase(std::unique(Bounds.begin(), Bounds.end()), Bounds.end());
+
+  std::unique_ptr<DWARFAddressIndex> Index(new DWARFAddressIndex());
+
+  StringMap<uint32_t> StringIds;
+  auto GetString = [&](StringRef S) {
+    auto Res = StringIds.insert(std::make_pair(S, Index->StringData.size()));
+    if (Res.second) {
+      Index->StringData.append(S.begin(), S.end());
+      Index->StringData.push_back('\0');
+    }
+    return Res.first->second;
+  };
+
+  typedef std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t,
+                     uint32_t, uint32_t, uint32_t>
+      FrameKey;
+  std::map<FrameKey, uint32_t> FrameIds;
+  auto GetFrame = [&](const Frame &F) {
+    FrameKey Key(F.ShortName, F.LinkageName, F.FileName, F.AbsoluteFileName,
+                 F.Line, F.Column, F.Discriminator, F.StartLine);
+    auto Res = FrameIds.insert(
+        std::make_pair(Key, static_cast<uint32_t>(Index->Frames.size())));
+    if (Res.second)
+      Index->Frames.push_back(F);
+    return Res.first->second;
+  };
+
+  // Chain 0 is the empty chain.
+  std::map<std::vector<uint32_t>, uint32_t> ChainIds;
+  ChainIds[std::vector<uint32_t>()] = 0;
+  Index->ChainStarts.push_back(0);
+  Index->ChainStarts.push_back(0);
+  auto GetChain = [&](const std::vector<uint32_t> &Chain) {
+    auto Res = ChainIds.insert(std::make_pair(
+        Chain, static_cast<uint32_t>(Index->ChainStarts.size() - 1)));
+    if (Res.second) {
+      Index->ChainFrames.insert(Index->ChainFrames.end(), Chain.begin(),
+                                Chain.end());
+      Index->ChainStarts.push_back(Index->ChainFrames.size());
+    }
+    return Res.first->second;
+  };
+
+  // The file names, function names and the existence of a line-only frame
+  // depend on the specifier, so query with every flavor the index can
+  // answer later.
+  DILineInfoSpecifier LinkageSpec(FileLineInfoKind::AbsoluteFilePath,
+                                  FunctionNameKind::LinkageName);
+  DILineInfoSpecifier ShortSpec(FileLineInfoKind::Default,
+                                FunctionNameKind::ShortName);
+  DILineInfoSpecifier NoLineSpec(FileLineInfoKind::None,
+                                 FunctionNameKind::None);
+  std::vector<uint32_t> Chain;
+  for (uint64_t Address : Bounds) {
+    DIInliningInfo Linkage =
+        Context.getInliningInfoForAddress(Address, LinkageSpec);
+    DIInliningInfo Short = Context.getInliningInfoForAddress(Address, ShortSpec);
+    uint32_t NumFrames = Linkage.getNumberOfFrames();
+    assert(Short.getNumberOfFrames() == NumFrames &&
+           "Inlined chain depends on the specifier");
+
+    Chain.clear();
+    for (uint32_t I = 0; I != NumFrames; ++I) {
+      const DILineInfo &L = Linkage.getFrame(I);
+      const DILineInfo &S = Short.getFrame(I);
+      Frame F;
+      F.ShortName = GetString(S.FunctionName);
+      F.LinkageName = GetString(L.FunctionName);
+      F.FileName = GetString(S.FileName);
+      F.AbsoluteFileName = GetString(L.FileName);
+      F.Line = L.Line;
+      F.Column = L.Column;
+      F.Discriminator = L.Discriminator;
+      F.StartLine = L.StartLine;
+      Chain.push_back(GetFrame(F));
+    }
+
+    Entry E;
+    E.Address = Address;
+    E.Chain = GetChain(Chain);
+    E.Flags = 0;
+    if (NumFrames && Context.getInliningInfoForAddress(Address, NoLineSpec)
+                             .getNumberOfFrames() == 0)
+      E.Flags |= LineOnly;
+    // Adjacent ranges with the same info are merged.
+    if (!Index->Entries.empty() && Index->Entries.back().Chain == E.Chain &&
+        Index->Entries.back().Flags == E.Flags)
+      continue;
+    Index->Entries.push_back(E);
+  }
+  return Index;
+}
+
+uint64_t DWARFAddressIndex::computeSignature(StringRef ObjectData) {
+  JamCRC CRC;
+  CRC.update(makeArrayRef(ObjectData.data(), ObjectData.size()));
+  return (static_cast<uint64_t>(ObjectData.size()) << 32) | CRC.getCRC();
+}
+
+void DWARFAddressIndex::write(raw_ostream &OS, uint64_t Signature) const {
+  support::endian::Writer<support::little> W(OS);
+  OS.write(IndexMagic, sizeof(IndexMagic));
+  W.write<uint32_t>(IndexVersion);
+  W.write<uint64_t>(Signature);
+
+  W.write<uint32_t>(StringData.size());
+  OS.write(StringData.data(), StringData.size());
+
+  W.write<uint32_t>(Frames.size());
+  for (const Frame &F : Frames) {
+    W.write<uint32_t>(F.ShortName);
+    W.write<uint32_t>(F.LinkageName);
+    W.write<uint32_t>(F.FileName);
+    W.write<uint32_t>(F.AbsoluteFileName);
+    W.write<uint32_t>(F.Line);
+    W.write<uint32_t>(F.Column);
+    W.write<uint32_t>(F.Discriminator);
+    W.write<uint32_t>(F.StartLine);
+  }
+
+  W.write<uint32_t>(ChainStarts.size());
+  W.write<uint32_t>(ChainStarts);
+  W.write<uint32_t>(ChainFrames.size());
+  W.write<uint32_t>(ChainFrames);
+
+  W.write<uint32_t>(Entries.size());
+  for (const Entry &E : Entries) {
+    W.write<uint64_t>(E.Address);
+    W.write<uint32_t>(E.Chain);
+    W.write<uint32_t>(E.Flags);
+  }
+}
+
+static Error malformedIndex(const Twine &Msg) {
+  return make_error<StringError>("malformed address index: " + Msg,
+                                 inconvertibleErrorCode());
+}
+
+Expected<std::unique_ptr<DWARFAddressIndex>>
+DWARFAddressIndex::read(StringRef Buffer, uint64_t Signature) {
+  DataExtractor Data(Buffer, /*IsLittleEndian=*/true, 8);
+  uint32_t Offset = 0;
+  if (!Data.isValidOffsetForDataOfSize(0, 16) ||
+      !Buffer.startswith(StringRef(IndexMagic, sizeof(IndexMagic))))
+    return malformedIndex("bad magic");
+  Offset += sizeof(IndexMagic);
+  if (Data.getU32(&Offset) != IndexVersion)
+    return malformedIndex("unsupported version");
+  if (Data.getU64(&Offset) != Signature)
+    return make_error<StringError>("address index is out of date",
+                                   inconvertibleErrorCode());
+
+  std::unique_ptr<DWARFAddressIndex> Index(new DWARFAddressIndex());
+  // Read a count followed by that many records of RecordSize bytes.
+  auto ReadCount = [&](uint32_t RecordSize, uint32_t &Count) {
+    if (!Data.isValidOffsetForDataOfSize(Offset, 4))
+      return false;
+    Count = Data.getU32(&Offset);
+    return uint64_t(Count) * RecordSize <= Buffer.size() - Offset;
+  };
+
+  uint32_t Count;
+  if (!ReadCount(1, Count))
+    return malformedIndex("truncated string table");
+  Index->StringData = Buffer.substr(Offset, Count);
+  Offset += Count;
+  if (!Index->StringData.empty() && Index->StringData.back() != '\0')
+    return malformedIndex("unterminated string table");
+
+  if (!ReadCount(sizeof(Frame), Count))
+    return malformedIndex("truncated frame table");
+  Index->Frames.resize(Count);
+  for (Frame &F : Index->Frames) {
+    F.ShortName = Data.getU32(&Offset);
+    F.LinkageName = Data.getU32(&Offset);
+    F.FileName = Data.getU32(&Offset);
+    F.AbsoluteFileName = Data.getU32(&Offset);
+    F.Line = Data.getU32(&Offset);
+    F.Column = Data.getU32(&Offset);
+    F.Discriminator = Data.getU32(&Offset);
+    F.StartLine = Data.getU32(&Offset);
+    for (uint32_t S : {F.ShortName, F.LinkageName, F.FileName,
+                       F.AbsoluteFileName})
+      if (S >= Index->StringData.size())
+        return malformedIndex("string offset out of range");
+  }
+
+  if (!ReadCount(4, Count) || Count == 0)
+    return malformedIndex("truncated chain table");
+  Index->ChainStarts.resize(Count);
+  for (uint32_t &Start : Index->ChainStarts)
+    Start = Data.getU32(&Offset);
+  if (!ReadCount(4, Count))
+    return malformedIndex("truncated chain table");
+  Index->ChainFrames.resize(Count);
+  for (uint32_t &FrameIndex : Index->ChainFrames) {
+    FrameIndex = Data.getU32(&Offset);
+    if (FrameIndex >= Index->Frames.size())
+      return malformedIndex("frame index out of range");
+  }
+  if (!std::is_sorted(Index->ChainStarts.begin(), Index->ChainStarts.end()) ||
+      Index->ChainStarts.back() != Index->ChainFrames.size())
+    return malformedIndex("invalid chain table");
+
+  if (!ReadCount(sizeof(Entry), Count))
+    return malformedIndex("truncated address table");
+  Index->Entries.resize(Count);
+  for (Entry &E : Index->Entries) {
+    E.Address = Data.getU64(&Offset);
+    E.Chain = Data.getU32(&Offset);
+    E.Flags = Data.getU32(&Offset);
+    if (E.Chain + 1 >= Index->ChainStarts.size())
+      return malformedIndex("chain index out of range");
+  }
+  if (!std::is_sorted(Index->Entries.begin(), Index->Entries.end(),
+                      [](const Entry &L, const Entry &R) {
+                        return L.Address < R.Address;
+                      }))
+    return malformedIndex("address table is not sorted");
+  return std::move(Index);
+}
+
+const DWARFAddressIndex::Entry *
+DWARFAddressIndex::lookup(uint64_t Address) const {
+  auto It = std::upper_bound(
+      Entries.begin(), Entries.end(), Address,
+      [](uint64_t A, const Entry &E) { return A < E.Address; });
+  if (It == Entries.begin())
+    return nullptr;
+  return &*std::prev(It);
+}
+
+StringRef DWARFAddressIndex::getString(uint32_t Offset) const {
+  return StringRef(StringData.data() + Offset);
+}
+
+DILineInfo DWARFAddressIndex::getFrame(uint32_t FrameIndex,
+                                       DILineInfoSpecifier Spec) const {
+  const Frame &F = Frames[FrameIndex];
+  DILineInfo Result;
+  switch (Spec.FNKind) {
+  case FunctionNameKind::None:
+    break;
+  case FunctionNameKind::ShortName:
+    Result.FunctionName = getString(F.ShortName);
+    break;
+  case FunctionNameKind::LinkageName:
+    Result.FunctionName = getString(F.LinkageName);
+    break;
+  }
+  Result.StartLine = F.StartLine;
+  if (Spec.FLIKind != FileLineInfoKind::None) {
+    Result.FileName = getString(Spec.FLIKind == FileLineInfoKind::Default
+                                    ? F.FileName
+                                    : F.AbsoluteFileName);
+    Result.Line = F.Line;
+    Result.Column = F.Column;
+    Result.Discriminator = F.Discriminator;
+  }
+  return Result;
+}
+
+DIInliningInfo
+DWARFAddressIndex::getInliningInfoForAddress(uint64_t Address,
+                                             DILineInfoSpecifier Spec) const {
+  DIInliningInfo InliningInfo;
+  const Entry *E = lookup(Address);
+  if (!E)
+    return InliningInfo;
+  if ((E->Flags & LineOnly) && Spec.FLIKind == FileLineInfoKind::None)
+    return InliningInfo;
+  for (uint32_t I = ChainStarts[E->Chain], End = ChainStarts[E->Chain + 1];
+       I != End; ++I)
+    InliningInfo.addFrame(getFrame(ChainFrames[I], Spec));
+  return InliningInfo;
+}
+
+DILineInfo
+DWARFAddressIndex::getLineInfoForAddress(uint64_t Address,
+                                         DILineInfoSpecifier Spec) const {
+  DIInliningInfo InliningInfo = getInliningInfoForAddress(Address, Spec);
+  if (InliningInfo.getNumberOfFrames() == 0)
+    return DILineInfo();
+  return InliningInfo.getFrame(0);
+}
@@ -664,6 +664,9 @@ static bool getFunctionNameAndStartLineForAddress(DWARFCompileUnit *CU,
 
 DILineInfo DWARFContext::getLineInfoForAddress(uint64_t Address,
                                                DILineInfoSpecifier Spec) {
+  if (AddressIndex)
+    return AddressIndex->getLineInfoForAddress(Address, Spec);
+
   DILineInfo Result;
 
   DWARFCompileUnit *CU = getCompileUnitForAddress(Address);
@@ -729,6 +732,9 @@ DWARFContext::getLineInfoForAddressRange(uint64_t Address, uint64_t Size,
 DIInliningInfo
 DWARFContext::getInliningInfoForAddress(uint64_t Address,
                                         DILineInfoSpecifier Spec) {
+  if (AddressIndex)
+    return AddressIndex->getInliningInfoForAddress(Address, Spec);
+
   DIInliningInfo InliningInfo;
 
   DWARFCompileUnit *CU = getCompileUnitForAddress(Address);
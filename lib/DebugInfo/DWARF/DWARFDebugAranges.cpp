@@ -110,6 +110,14 @@ void DWARFDebugAranges::construct() {
   EmptyEndpoints.swap(Endpoints);
 }
 
+void DWARFDebugAranges::collectRangeBounds(
+    std::vector<uint64_t> &Bounds) const {
+  for (const auto &R : Aranges) {
+    Bounds.push_back(R.LowPC);
+    Bounds.push_back(R.HighPC());
+  }
+}
+
 uint32_t DWARFDebugAranges::findAddress(uint64_t Address) const {
   if (!Aranges.empty()) {
     Range range(Address);
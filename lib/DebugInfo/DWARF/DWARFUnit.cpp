@@ -412,6 +412,20 @@ DWARFUnit::getInlinedChainForAddress(uint64_t Address,
   }
 }
 
+void DWARFUnit::collectSubroutineRangeBounds(std::vector<uint64_t> &Bounds) {
+  parseDWO();
+  DWARFUnit *U = DWO ? DWO.get() : this;
+  for (unsigned I = 0, E = U->getNumDIEs(); I != E; ++I) {
+    DWARFDie Die = U->getDIEAtIndex(I);
+    if (!Die.isSubroutineDIE())
+      continue;
+    for (const auto &R : Die.getAddressRanges()) {
+      Bounds.push_back(R.LowPC);
+      Bounds.push_back(R.HighPC);
+    }
+  }
+}
+
 const DWARFUnitIndex &llvm::getDWARFUnitIndex(DWARFContext &Context,
                                               DWARFSectionKind Kind) {
   if (Kind == DW_SECT_INFO)
@@ -16,6 +16,9 @@
 #include "SymbolizableObjectFile.h"
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Triple.h"
 #include "llvm/BinaryFormat/COFF.h"
 #include "llvm/Config/config.h"
 #include "llvm/DebugInfo/DWARF/DWARFContext.h"
@@ -32,6 +35,7 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
@@ -138,6 +142,62 @@ void LLVMSymbolizer::flush() {
   BinaryForPath.clear();
   ObjectPairForPathArch.clear();
   Modules.clear();
+  ModuleLRU.clear();
+  CacheSize = 0;
+}
+
+void LLVMSymbolizer::enforceCacheSize() {
+  pruneObjectCaches();
+  while (CacheSize > Opts.MaxCacheSize && ModuleLRU.size() > 1) {
+    Modules.erase(ModuleLRU.back());
+    ModuleLRU.pop_back();
+    pruneObjectCaches();
+  }
+}
+
+void LLVMSymbolizer::pruneObjectCaches() {
+  SmallPtrSet<const ObjectFile *, 16> Live;
+  for (const auto &M : Modules) {
+    Live.insert(M.second.Objects.first);
+    Live.insert(M.second.Objects.second);
+  }
+
+  // Failures are kept, they don't hold any memory.
+  for (auto I = ObjectPairForPathArch.begin();
+       I != ObjectPairForPathArch.end();) {
+    if (I->second.first && !Live.count(I->second.first))
+      I = ObjectPairForPathArch.erase(I);
+    else
+      ++I;
+  }
+  for (auto I = ObjectForUBPathAndArch.begin();
+       I != ObjectForUBPathAndArch.end();) {
+    if (I->second && !Live.count(I->second.get()))
+      I = ObjectForUBPathAndArch.erase(I);
+    else
+      ++I;
+  }
+  for (auto I = BinaryForPath.begin(); I != BinaryForPath.end();) {
+    Binary *Bin = I->second.getBinary();
+    bool Used = !Bin;
+    if (Bin && Bin->isObject()) {
+      Used = Live.count(cast<ObjectFile>(Bin));
+    } else if (Bin && isa<MachOUniversalBinary>(Bin)) {
+      // A universal binary is used as long as one of its slices is.
+      for (auto UB = ObjectForUBPathAndArch.lower_bound(
+               std::make_pair(I->first, std::string()));
+           !Used && UB != ObjectForUBPathAndArch.end() &&
+           UB->first.first == I->first;
+           ++UB)
+        Used = UB->second != nullptr;
+    }
+    if (Used) {
+      ++I;
+      continue;
+    }
+    CacheSize -= Bin->getData().size();
+    I = BinaryForPath.erase(I);
+  }
 }
 
 namespace {
@@ -332,6 +392,7 @@ LLVMSymbolizer::getOrCreateObject(const std::string &Path,
       return BinOrErr.takeError();
     }
     Bin = BinOrErr->getBinary();
+    CacheSize += Bin->getData().size();
     BinaryForPath.insert(std::make_pair(Path, std::move(BinOrErr.get())));
   } else {
     Bin = I->second.getBinary();
@@ -363,11 +424,55 @@ LLVMSymbolizer::getOrCreateObject(const std::string &Path,
   return errorCodeToError(object_error::arch_not_found);
 }
 
+/// Load the address index kept next to the debug object \p Obj, or build it
+/// and try to save it there for the next run.
+static void loadAddressIndex(DWARFContext &Context, const ObjectFile &Obj) {
+  std::string IndexPath = Obj.getFileName();
+  // Slices of a universal binary share its file name.
+  if (Obj.isMachO())
+    IndexPath += ("." + Triple::getArchTypeName(
+                            static_cast<Triple::ArchType>(Obj.getArch())))
+                     .str();
+  IndexPath += ".addrindex";
+  uint64_t Signature = DWARFAddressIndex::computeSignature(Obj.getData());
+
+  if (auto BufOrErr = MemoryBuffer::getFile(IndexPath)) {
+    auto IndexOrErr =
+        DWARFAddressIndex::read((*BufOrErr)->getBuffer(), Signature);
+    if (IndexOrErr) {
+      Context.setAddressIndex(std::move(*IndexOrErr));
+      return;
+    }
+    consumeError(IndexOrErr.takeError());
+  }
+
+  std::unique_ptr<DWARFAddressIndex> Index = DWARFAddressIndex::build(Context);
+  // Failing to save the index only costs a rebuild next time. Write to a
+  // temporary file so that concurrent symbolizers never see a partial index.
+  int FD;
+  SmallString<128> TempPath;
+  if (!sys::fs::createUniqueFile(IndexPath + "-%%%%%%.tmp", FD, TempPath)) {
+    bool Failed;
+    {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      Index->write(OS, Signature);
+      OS.close();
+      Failed = OS.has_error();
+      OS.clear_error();
+    }
+    if (Failed || sys::fs::rename(TempPath, IndexPath))
+      sys::fs::remove(TempPath);
+  }
+  Context.setAddressIndex(std::move(Index));
+}
+
 Expected<SymbolizableModule *>
 LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName) {
   const auto &I = Modules.find(ModuleName);
   if (I != Modules.end()) {
-    return I->second.get();
+    if (I->second.Module)
+      ModuleLRU.splice(ModuleLRU.begin(), ModuleLRU, I->second.LRUPos);
+    return I->second.Module.get();
   }
   std::string BinaryName = ModuleName;
   std::string ArchName = Opts.DefaultArch;
@@ -383,8 +488,7 @@ LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName) {
   auto ObjectsOrErr = getOrCreateObjectPair(BinaryName, ArchName);
   if (!ObjectsOrErr) {
     // Failed to find valid object file.
-    Modules.insert(
-        std::make_pair(ModuleName, std::unique_ptr<SymbolizableModule>()));
+    Modules.insert(std::make_pair(ModuleName, CachedModule()));
     return ObjectsOrErr.takeError();
   }
   ObjectPair Objects = ObjectsOrErr.get();
@@ -401,27 +505,32 @@ LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName) {
       std::unique_ptr<IPDBSession> Session;
       if (auto Err = loadDataForEXE(PDB_ReaderType::DIA,
                                     Objects.first->getFileName(), Session)) {
-        Modules.insert(
-            std::make_pair(ModuleName, std::unique_ptr<SymbolizableModule>()));
+        Modules.insert(std::make_pair(ModuleName, CachedModule()));
         return std::move(Err);
       }
       Context.reset(new PDBContext(*CoffObject, std::move(Session)));
     }
   }
-  if (!Context)
-    Context.reset(new DWARFContextInMemory(*Objects.second));
+  if (!Context) {
+    auto DWARFCtx = llvm::make_unique<DWARFContextInMemory>(*Objects.second);
+    if (Opts.UseAddressIndex)
+      loadAddressIndex(*DWARFCtx, *Objects.second);
+    Context = std::move(DWARFCtx);
+  }
   assert(Context);
   auto InfoOrErr =
       SymbolizableObjectFile::create(Objects.first, std::move(Context));
-  std::unique_ptr<SymbolizableModule> SymMod;
-  if (InfoOrErr)
-    SymMod = std::move(InfoOrErr.get());
-  auto InsertResult =
-      Modules.insert(std::make_pair(ModuleName, std::move(SymMod)));
+  auto InsertResult = Modules.insert(std::make_pair(ModuleName, CachedModule()));
   assert(InsertResult.second);
   if (auto EC = InfoOrErr.getError())
     return errorCodeToError(EC);
-  return InsertResult.first->second.get();
+  CachedModule &Cached = InsertResult.first->second;
+  Cached.Module = std::move(InfoOrErr.get());
+  Cached.Objects = Objects;
+  Cached.LRUPos = ModuleLRU.insert(ModuleLRU.begin(), ModuleName);
+  if (Opts.MaxCacheSize)
+    enforceCacheSize();
+  return Cached.Module.get();
 }
 
 namespace {
@@ -0,0 +1,344 @@
+//===- FastExecution.cpp - Run the bytecode of the fast interpreter -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the dispatch loop of the fast interpreter. With GCC
+// compatible compilers it is direct threaded: every handler jumps straight to
+// the next one through the address stored in place of the opcode. Otherwise
+// it falls back to a switch.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FastInterpreter.h"
+#include "Interpreter.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+using namespace llvm;
+
+#if defined(__GNUC__)
+#define LLVM_FAST_INTERPRETER_THREADED 1
+// Labels as values are a GNU extension.
+#pragma GCC diagnostic ignored "-Wpedantic"
+#else
+#define LLVM_FAST_INTERPRETER_THREADED 0
+#endif
+
+//===----------------------------------------------------------------------===//
+//                     Various Helper Functions
+//===----------------------------------------------------------------------===//
+
+static inline float asFloat(uint64_t V) {
+  return BitsToFloat(static_cast<uint32_t>(V));
+}
+
+static inline double asDouble(uint64_t V) { return BitsToDouble(V); }
+
+static inline uint64_t fromFloat(float F) { return FloatToBits(F); }
+
+static inline uint64_t fromDouble(double D) { return DoubleToBits(D); }
+
+template <typename T> static inline uint64_t load(uint64_t Addr) {
+  T V;
+  memcpy(&V, reinterpret_cast<void *>(static_cast<uintptr_t>(Addr)),
+         sizeof(T));
+  return V;
+}
+
+template <typename T> static inline void store(uint64_t V, uint64_t Addr) {
+  T Narrow = static_cast<T>(V);
+  memcpy(reinterpret_cast<void *>(static_cast<uintptr_t>(Addr)), &Narrow,
+         sizeof(T));
+}
+
+// Byte offset of the low Bytes bytes of a uint64_t.
+static inline unsigned lowBytesOffset(uint64_t Bytes) {
+  return sys::IsLittleEndianHost ? 0 : sizeof(uint64_t) - Bytes;
+}
+
+template <typename T>
+static bool evaluateFCmp(uint64_t Predicate, T A, T B) {
+  bool Unordered = std::isnan(A) || std::isnan(B);
+  switch (Predicate) {
+  case FCmpInst::FCMP_FALSE: return false;
+  case FCmpInst::FCMP_OEQ:   return A == B;
+  case FCmpInst::FCMP_OGT:   return A > B;
+  case FCmpInst::FCMP_OGE:   return A >= B;
+  case FCmpInst::FCMP_OLT:   return A < B;
+  case FCmpInst::FCMP_OLE:   return A <= B;
+  case FCmpInst::FCMP_ONE:   return !Unordered && A != B;
+  case FCmpInst::FCMP_ORD:   return !Unordered;
+  case FCmpInst::FCMP_UNO:   return Unordered;
+  case FCmpInst::FCMP_UEQ:   return Unordered || A == B;
+  case FCmpInst::FCMP_UGT:   return Unordered || A > B;
+  case FCmpInst::FCMP_UGE:   return Unordered || A >= B;
+  case FCmpInst::FCMP_ULT:   return Unordered || A < B;
+  case FCmpInst::FCMP_ULE:   return Unordered || A <= B;
+  case FCmpInst::FCMP_UNE:   return A != B;
+  case FCmpInst::FCMP_TRUE:  return true;
+  default:
+    llvm_unreachable("Invalid FCmp predicate!");
+  }
+}
+
+//===----------------------------------------------------------------------===//
+//                        Dispatch and Execution Code
+//===----------------------------------------------------------------------===//
+
+uint64_t FastInterpreter::execute(FastFunction &FF, uint64_t *Frame) {
+  AllocaHolder Allocas;
+
+#if LLVM_FAST_INTERPRETER_THREADED
+  static void *const Handlers[] = {
+#define FAST_INTERPRETER_LABEL(Name) &&Do##Name,
+      FAST_INTERPRETER_OPCODES(FAST_INTERPRETER_LABEL)
+#undef FAST_INTERPRETER_LABEL
+  };
+  if (!FF.Linked) {
+    for (uint32_t Start : FF.InstStarts)
+      FF.Code[Start] = reinterpret_cast<uintptr_t>(Handlers[FF.Code[Start]]);
+    FF.Linked = true;
+  }
+#endif
+
+  const uint64_t *Code = FF.Code.data();
+  const uint64_t *PC = Code;
+
+// Operand N of the current instruction, as a slot and as an immediate.
+#define R(N) Frame[PC[N]]
+#define IMM(N) PC[N]
+
+#if LLVM_FAST_INTERPRETER_THREADED
+#define HANDLER(Name) Do##Name:
+#define DISPATCH()                                                             \
+  goto *reinterpret_cast<void *>(static_cast<uintptr_t>(*PC))
+  DISPATCH();
+#else
+#define HANDLER(Name) case FastFunction::Name:
+#define DISPATCH() goto Dispatch
+Dispatch:
+  switch (static_cast<FastFunction::Opcode>(*PC)) {
+#endif
+
+#define NEXT(N)                                                                \
+  do {                                                                         \
+    PC += (N);                                                                 \
+    DISPATCH();                                                                \
+  } while (0)
+
+  HANDLER(Mov) R(1) = R(2); NEXT(3);
+  HANDLER(AddImm) R(1) = R(2) + IMM(3); NEXT(4);
+
+  HANDLER(Add64) R(1) = R(2) + R(3); NEXT(4);
+  HANDLER(Add32) R(1) = static_cast<uint32_t>(R(2) + R(3)); NEXT(4);
+  HANDLER(AddN) R(1) = (R(2) + R(3)) & IMM(4); NEXT(5);
+  HANDLER(Sub64) R(1) = R(2) - R(3); NEXT(4);
+  HANDLER(Sub32) R(1) = static_cast<uint32_t>(R(2) - R(3)); NEXT(4);
+  HANDLER(SubN) R(1) = (R(2) - R(3)) & IMM(4); NEXT(5);
+  HANDLER(Mul64) R(1) = R(2) * R(3); NEXT(4);
+  HANDLER(Mul32) R(1) = static_cast<uint32_t>(R(2) * R(3)); NEXT(4);
+  HANDLER(MulN) R(1) = (R(2) * R(3)) & IMM(4); NEXT(5);
+  HANDLER(UDiv) R(1) = R(2) / R(3); NEXT(4);
+  HANDLER(URem) R(1) = R(2) % R(3); NEXT(4);
+
+  // INT64_MIN / -1 traps on some hosts, it has to wrap around.
+  HANDLER(SDiv64) {
+    int64_t A = R(2), B = R(3);
+    R(1) = B == -1 ? 0 - R(2) : static_cast<uint64_t>(A / B);
+    NEXT(4);
+  }
+  HANDLER(SDiv32) {
+    int64_t A = static_cast<int32_t>(R(2)), B = static_cast<int32_t>(R(3));
+    R(1) = static_cast<uint32_t>(A / B);
+    NEXT(4);
+  }
+  HANDLER(SDivN) {
+    int64_t A = SignExtend64(R(2), IMM(4)), B = SignExtend64(R(3), IMM(4));
+    R(1) = static_cast<uint64_t>(A / B) & IMM(5);
+    NEXT(6);
+  }
+  HANDLER(SRem64) {
+    int64_t A = R(2), B = R(3);
+    R(1) = B == -1 ? 0 : static_cast<uint64_t>(A % B);
+    NEXT(4);
+  }
+  HANDLER(SRem32) {
+    int64_t A = static_cast<int32_t>(R(2)), B = static_cast<int32_t>(R(3));
+    R(1) = static_cast<uint32_t>(A % B);
+    NEXT(4);
+  }
+  HANDLER(SRemN) {
+    int64_t A = SignExtend64(R(2), IMM(4)), B = SignExtend64(R(3), IMM(4));
+    R(1) = static_cast<uint64_t>(A % B) & IMM(5);
+    NEXT(6);
+  }
+
+  HANDLER(And) R(1) = R(2) & R(3); NEXT(4);
+  HANDLER(Or) R(1) = R(2) | R(3); NEXT(4);
+  HANDLER(Xor) R(1) = R(2) ^ R(3); NEXT(4);
+
+  HANDLER(Shl64) R(1) = R(2) << (R(3) & 63); NEXT(4);
+  HANDLER(Shl32) R(1) = static_cast<uint32_t>(R(2) << (R(3) & 31)); NEXT(4);
+  HANDLER(ShlN) R(1) = (R(2) << (R(3) & IMM(4))) & IMM(5); NEXT(6);
+  HANDLER(LShr) R(1) = R(2) >> (R(3) & IMM(4)); NEXT(5);
+  HANDLER(AShr64)
+    R(1) = static_cast<uint64_t>(static_cast<int64_t>(R(2)) >> (R(3) & 63));
+    NEXT(4);
+  HANDLER(AShr32)
+    R(1) = static_cast<uint32_t>(static_cast<int32_t>(R(2)) >> (R(3) & 31));
+    NEXT(4);
+  HANDLER(AShrN)
+    R(1) = static_cast<uint64_t>(SignExtend64(R(2), IMM(4)) >>
+                                 (R(3) & IMM(5))) & IMM(6);
+    NEXT(7);
+
+  HANDLER(ICmpEQ) R(1) = R(2) == R(3); NEXT(4);
+  HANDLER(ICmpNE) R(1) = R(2) != R(3); NEXT(4);
+  HANDLER(ICmpULT) R(1) = R(2) < R(3); NEXT(4);
+  HANDLER(ICmpULE) R(1) = R(2) <= R(3); NEXT(4);
+  HANDLER(ICmpSLT64)
+    R(1) = static_cast<int64_t>(R(2)) < static_cast<int64_t>(R(3));
+    NEXT(4);
+  HANDLER(ICmpSLE64)
+    R(1) = static_cast<int64_t>(R(2)) <= static_cast<int64_t>(R(3));
+    NEXT(4);
+  HANDLER(ICmpSLT32)
+    R(1) = static_cast<int32_t>(R(2)) < static_cast<int32_t>(R(3));
+    NEXT(4);
+  HANDLER(ICmpSLE32)
+    R(1) = static_cast<int32_t>(R(2)) <= static_cast<int32_t>(R(3));
+    NEXT(4);
+  HANDLER(ICmpSLTN)
+    R(1) = SignExtend64(R(2), IMM(4)) < SignExtend64(R(3), IMM(4));
+    NEXT(5);
+  HANDLER(ICmpSLEN)
+    R(1) = SignExtend64(R(2), IMM(4)) <= SignExtend64(R(3), IMM(4));
+    NEXT(5);
+
+  HANDLER(Trunc) R(1) = R(2) & IMM(3); NEXT(4);
+  HANDLER(SExt)
+    R(1) = static_cast<uint64_t>(SignExtend64(R(2), IMM(3))) & IMM(4);
+    NEXT(5);
+  HANDLER(Select) R(1) = R(2) ? R(3) : R(4); NEXT(5);
+
+  HANDLER(FAddF32) R(1) = fromFloat(asFloat(R(2)) + asFloat(R(3))); NEXT(4);
+  HANDLER(FSubF32) R(1) = fromFloat(asFloat(R(2)) - asFloat(R(3))); NEXT(4);
+  HANDLER(FMulF32) R(1) = fromFloat(asFloat(R(2)) * asFloat(R(3))); NEXT(4);
+  HANDLER(FDivF32) R(1) = fromFloat(asFloat(R(2)) / asFloat(R(3))); NEXT(4);
+  HANDLER(FRemF32)
+    R(1) = fromFloat(fmodf(asFloat(R(2)), asFloat(R(3))));
+    NEXT(4);
+  HANDLER(FAddF64) R(1) = fromDouble(asDouble(R(2)) + asDouble(R(3))); NEXT(4);
+  HANDLER(FSubF64) R(1) = fromDouble(asDouble(R(2)) - asDouble(R(3))); NEXT(4);
+  HANDLER(FMulF64) R(1) = fromDouble(asDouble(R(2)) * asDouble(R(3))); NEXT(4);
+  HANDLER(FDivF64) R(1) = fromDouble(asDouble(R(2)) / asDouble(R(3))); NEXT(4);
+  HANDLER(FRemF64)
+    R(1) = fromDouble(fmod(asDouble(R(2)), asDouble(R(3))));
+    NEXT(4);
+  HANDLER(FCmpF32)
+    R(1) = evaluateFCmp(IMM(4), asFloat(R(2)), asFloat(R(3)));
+    NEXT(5);
+  HANDLER(FCmpF64)
+    R(1) = evaluateFCmp(IMM(4), asDouble(R(2)), asDouble(R(3)));
+    NEXT(5);
+
+  HANDLER(FPExt) R(1) = fromDouble(asFloat(R(2))); NEXT(3);
+  HANDLER(FPTrunc) R(1) = fromFloat(static_cast<float>(asDouble(R(2)))); NEXT(3);
+  HANDLER(FPToSIF32)
+    R(1) = static_cast<uint64_t>(static_cast<int64_t>(asFloat(R(2)))) & IMM(3);
+    NEXT(4);
+  HANDLER(FPToSIF64)
+    R(1) = static_cast<uint64_t>(static_cast<int64_t>(asDouble(R(2)))) & IMM(3);
+    NEXT(4);
+  HANDLER(FPToUIF32) R(1) = static_cast<uint64_t>(asFloat(R(2))) & IMM(3); NEXT(4);
+  HANDLER(FPToUIF64) R(1) = static_cast<uint64_t>(asDouble(R(2))) & IMM(3); NEXT(4);
+  HANDLER(SIToF32)
+    R(1) = fromFloat(static_cast<float>(SignExtend64(R(2), IMM(3))));
+    NEXT(4);
+  HANDLER(SIToF64)
+    R(1) = fromDouble(static_cast<double>(SignExtend64(R(2), IMM(3))));
+    NEXT(4);
+  HANDLER(UIToF32) R(1) = fromFloat(static_cast<float>(R(2))); NEXT(3);
+  HANDLER(UIToF64) R(1) = fromDouble(static_cast<double>(R(2))); NEXT(3);
+
+  HANDLER(Load8) R(1) = load<uint8_t>(R(2)); NEXT(3);
+  HANDLER(Load16) R(1) = load<uint16_t>(R(2)); NEXT(3);
+  HANDLER(Load32) R(1) = load<uint32_t>(R(2)); NEXT(3);
+  HANDLER(Load64) R(1) = load<uint64_t>(R(2)); NEXT(3);
+  HANDLER(LoadN) {
+    uint64_t V = 0;
+    memcpy(reinterpret_cast<char *>(&V) + lowBytesOffset(IMM(3)),
+           reinterpret_cast<void *>(static_cast<uintptr_t>(R(2))), IMM(3));
+    R(1) = V & IMM(4);
+    NEXT(5);
+  }
+  HANDLER(Store8) store<uint8_t>(R(1), R(2)); NEXT(3);
+  HANDLER(Store16) store<uint16_t>(R(1), R(2)); NEXT(3);
+  HANDLER(Store32) store<uint32_t>(R(1), R(2)); NEXT(3);
+  HANDLER(Store64) store<uint64_t>(R(1), R(2)); NEXT(3);
+  HANDLER(StoreN) {
+    uint64_t V = R(1);
+    memcpy(reinterpret_cast<void *>(static_cast<uintptr_t>(R(2))),
+           reinterpret_cast<char *>(&V) + lowBytesOffset(IMM(3)), IMM(3));
+    NEXT(4);
+  }
+
+  HANDLER(Alloca) {
+    // Avoid malloc-ing zero bytes, as the Interpreter does.
+    void *Memory = malloc(std::max<uint64_t>(1, R(2) * IMM(3)));
+    Allocas.add(Memory);
+    R(1) = reinterpret_cast<uintptr_t>(Memory);
+    NEXT(4);
+  }
+  HANDLER(GEP1) R(1) = R(2) + IMM(3) + R(4) * IMM(5); NEXT(6);
+  HANDLER(GEP) {
+    uint64_t Addr = R(2) + IMM(3);
+    uint64_t NumIndices = IMM(4);
+    for (const uint64_t *Idx = PC + 5, *End = Idx + 3 * NumIndices; Idx != End;
+         Idx += 3)
+      Addr += SignExtend64(Frame[Idx[0]], Idx[2]) * Idx[1];
+    R(1) = Addr;
+    NEXT(5 + 3 * NumIndices);
+  }
+
+  HANDLER(Br) PC = Code + IMM(1); DISPATCH();
+  HANDLER(CondBr) PC = Code + (R(1) ? IMM(2) : IMM(3)); DISPATCH();
+  HANDLER(Switch) {
+    uint64_t V = R(1);
+    uint64_t Target = IMM(2);
+    for (const uint64_t *Case = PC + 4, *End = Case + 2 * IMM(3); Case != End;
+         Case += 2)
+      if (Case[0] == V) {
+        Target = Case[1];
+        break;
+      }
+    PC = Code + Target;
+    DISPATCH();
+  }
+  HANDLER(Ret) return R(1);
+  HANDLER(RetVoid) return 0;
+  HANDLER(Call) call(FF.Calls[IMM(1)], Frame); NEXT(2);
+  HANDLER(Unreachable)
+    report_fatal_error("Program executed an 'unreachable' instruction!");
+
+#if !LLVM_FAST_INTERPRETER_THREADED
+  }
+  llvm_unreachable("Unknown fast interpreter opcode!");
+#endif
+
+#undef NEXT
+#undef DISPATCH
+#undef HANDLER
+#undef IMM
+#undef R
+}
@@ -0,0 +1,908 @@
+//===- FastInterpreter.cpp - Translate functions to bytecode --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file translates functions to the bytecode of the fast interpreter, and
+// implements the calls between bytecode, the IR interpreter and external
+// functions.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FastInterpreter.h"
+#include "Interpreter.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/IntrinsicLowering.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/InstVisitor.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <cstring>
+using namespace llvm;
+
+#define DEBUG_TYPE "interpreter"
+
+STATISTIC(NumTranslated, "Number of functions translated to bytecode");
+STATISTIC(NumNotTranslated, "Number of functions left to the IR interpreter");
+
+//===----------------------------------------------------------------------===//
+//                     Various Helper Functions
+//===----------------------------------------------------------------------===//
+
+static uint64_t getMask(unsigned Width) {
+  return Width == 64 ? ~UINT64_C(0) : (UINT64_C(1) << Width) - 1;
+}
+
+// The mask the Interpreter applies to out of range shift amounts.
+static uint64_t getShiftAmountMask(unsigned Width) {
+  return NextPowerOf2(Width - 1) - 1;
+}
+
+static uint64_t toSlot(const GenericValue &GV, Type *Ty) {
+  switch (Ty->getTypeID()) {
+  case Type::IntegerTyID:
+    return GV.IntVal.zextOrTrunc(Ty->getIntegerBitWidth()).getZExtValue();
+  case Type::FloatTyID:
+    return FloatToBits(GV.FloatVal);
+  case Type::DoubleTyID:
+    return DoubleToBits(GV.DoubleVal);
+  case Type::PointerTyID:
+    return reinterpret_cast<uintptr_t>(GV.PointerVal);
+  default:
+    llvm_unreachable("Type not supported by the fast interpreter!");
+  }
+}
+
+static GenericValue fromSlot(uint64_t V, Type *Ty) {
+  GenericValue GV;
+  switch (Ty->getTypeID()) {
+  case Type::IntegerTyID:
+    GV.IntVal = APInt(Ty->getIntegerBitWidth(), V);
+    break;
+  case Type::FloatTyID:
+    GV.FloatVal = BitsToFloat(static_cast<uint32_t>(V));
+    break;
+  case Type::DoubleTyID:
+    GV.DoubleVal = BitsToDouble(V);
+    break;
+  case Type::PointerTyID:
+    GV.PointerVal = reinterpret_cast<void *>(static_cast<uintptr_t>(V));
+    break;
+  default:
+    llvm_unreachable("Type not supported by the fast interpreter!");
+  }
+  return GV;
+}
+
+// Intrinsics IntrinsicLowering turns into supported code.
+static bool isLowerableIntrinsic(Intrinsic::ID ID) {
+  switch (ID) {
+  default:
+    return false;
+  case Intrinsic::expect:
+  case Intrinsic::ctpop:
+  case Intrinsic::bswap:
+  case Intrinsic::ctlz:
+  case Intrinsic::cttz:
+  case Intrinsic::stacksave:
+  case Intrinsic::stackrestore:
+  case Intrinsic::prefetch:
+  case Intrinsic::pcmarker:
+  case Intrinsic::readcyclecounter:
+  case Intrinsic::annotation:
+  case Intrinsic::ptr_annotation:
+  case Intrinsic::assume:
+  case Intrinsic::var_annotation:
+  case Intrinsic::memcpy:
+  case Intrinsic::memmove:
+  case Intrinsic::memset:
+  case Intrinsic::sqrt:
+  case Intrinsic::log:
+  case Intrinsic::log2:
+  case Intrinsic::log10:
+  case Intrinsic::exp:
+  case Intrinsic::exp2:
+  case Intrinsic::pow:
+  case Intrinsic::sin:
+  case Intrinsic::cos:
+  case Intrinsic::floor:
+  case Intrinsic::ceil:
+  case Intrinsic::trunc:
+  case Intrinsic::round:
+  case Intrinsic::copysign:
+  case Intrinsic::flt_rounds:
+  case Intrinsic::invariant_start:
+  case Intrinsic::lifetime_start:
+  case Intrinsic::invariant_end:
+  case Intrinsic::lifetime_end:
+    return true;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+//                     Translation to bytecode
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+class FunctionTranslator : public InstVisitor<FunctionTranslator, bool> {
+  typedef FastFunction FF_;
+
+  const DataLayout &DL;
+  IntrinsicLowering &IL;
+  FastFunction &FF;
+
+  DenseMap<Value *, unsigned> Slots;
+  std::vector<Constant *> Constants;
+  SmallVector<unsigned, 8> TempSlots;
+
+  /// Where each block starts, and the operands to point there.
+  DenseMap<BasicBlock *, uint64_t> BlockStarts;
+  SmallVector<std::pair<size_t, BasicBlock *>, 16> BlockFixups;
+  BasicBlock *NextBB = nullptr;
+
+public:
+  FunctionTranslator(const DataLayout &DL, IntrinsicLowering &IL,
+                     FastFunction &FF)
+      : DL(DL), IL(IL), FF(FF) {}
+
+  /// Translate FF.F into FF, except for the values of the constants, which
+  /// go in the first slots of the frame in the order of getConstants().
+  bool translate();
+
+  ArrayRef<Constant *> getConstants() const { return Constants; }
+
+  bool visitReturnInst(ReturnInst &I);
+  bool visitBranchInst(BranchInst &I);
+  bool visitSwitchInst(SwitchInst &I);
+  bool visitUnreachableInst(UnreachableInst &I);
+  bool visitBinaryOperator(BinaryOperator &I);
+  bool visitICmpInst(ICmpInst &I);
+  bool visitFCmpInst(FCmpInst &I);
+  bool visitAllocaInst(AllocaInst &I);
+  bool visitLoadInst(LoadInst &I);
+  bool visitStoreInst(StoreInst &I);
+  bool visitGetElementPtrInst(GetElementPtrInst &I);
+  bool visitPHINode(PHINode &PN) { return true; } // Done on the edges.
+  bool visitCastInst(CastInst &I);
+  bool visitSelectInst(SelectInst &I);
+  bool visitCallInst(CallInst &I);
+  bool visitDbgInfoIntrinsic(DbgInfoIntrinsic &I) { return true; }
+
+  bool visitInstruction(Instruction &I) {
+    DEBUG(dbgs() << "Fast interpreter can't run: " << I << "\n");
+    return false;
+  }
+
+private:
+  bool isSupportedType(Type *Ty) const;
+  bool isSupportedOperand(Value *V) const;
+  bool isSupported(Instruction &I) const;
+
+  unsigned getIntWidth(Type *Ty) const {
+    return Ty->isPointerTy() ? 64 : Ty->getIntegerBitWidth();
+  }
+
+  void assignSlots();
+  unsigned getSlot(Value *V) const {
+    auto I = Slots.find(V);
+    assert(I != Slots.end() && "Value without a slot!");
+    return I->second;
+  }
+
+  void emit(FF_::Opcode Op, ArrayRef<uint64_t> Operands) {
+    FF.InstStarts.push_back(FF.Code.size());
+    FF.Code.push_back(Op);
+    FF.Code.insert(FF.Code.end(), Operands.begin(), Operands.end());
+  }
+
+  void emitJump(BasicBlock *To) {
+    emit(FF_::Br, {0});
+    BlockFixups.push_back(std::make_pair(FF.Code.size() - 1, To));
+  }
+
+  bool hasEdgeMoves(BasicBlock *From, BasicBlock *To) const;
+  void emitEdgeMoves(BasicBlock *From, BasicBlock *To);
+  void emitEdge(size_t TargetOperand, BasicBlock *From, BasicBlock *To);
+
+  void emitSignedLess(bool OrEqual, unsigned D, unsigned A, unsigned B,
+                      unsigned Width);
+};
+
+} // end anonymous namespace
+
+bool FunctionTranslator::isSupportedType(Type *Ty) const {
+  if (IntegerType *ITy = dyn_cast<IntegerType>(Ty))
+    return ITy->getBitWidth() <= 64;
+  if (Ty->isPointerTy())
+    return DL.getPointerTypeSizeInBits(Ty) == 64;
+  return Ty->isFloatTy() || Ty->isDoubleTy();
+}
+
+bool FunctionTranslator::isSupportedOperand(Value *V) const {
+  if (isa<BasicBlock>(V))
+    return true;
+  if (!isSupportedType(V->getType()))
+    return false;
+  if (isa<Constant>(V))
+    return isa<GlobalValue>(V) || isa<ConstantInt>(V) || isa<ConstantFP>(V) ||
+           isa<ConstantPointerNull>(V) || isa<UndefValue>(V) ||
+           isa<ConstantExpr>(V);
+  return true;
+}
+
+// Whether I has types the bytecode can represent, and calls no intrinsic that
+// can't be lowered to something it can run. Which instructions the bytecode
+// can run is up to the visitor.
+bool FunctionTranslator::isSupported(Instruction &I) const {
+  if (isa<DbgInfoIntrinsic>(I))
+    return true;
+
+  if (!I.getType()->isVoidTy() && !isSupportedType(I.getType()))
+    return false;
+
+  if (CallInst *CI = dyn_cast<CallInst>(&I)) {
+    if (CI->isInlineAsm())
+      return false;
+    Function *F = CI->getCalledFunction();
+    if (F && F->isIntrinsic() && !isLowerableIntrinsic(F->getIntrinsicID()))
+      return false;
+    for (Value *Arg : CI->arg_operands())
+      if (!isSupportedOperand(Arg))
+        return false;
+    return isSupportedOperand(CI->getCalledValue());
+  }
+
+  for (Value *Op : I.operands())
+    if (!isSupportedOperand(Op))
+      return false;
+  return true;
+}
+
+void FunctionTranslator::assignSlots() {
+  Function &F = *FF.F;
+
+  for (Instruction &I : instructions(F)) {
+    if (isa<DbgInfoIntrinsic>(I))
+      continue;
+    for (Value *Op : I.operands()) {
+      Constant *C = dyn_cast<Constant>(Op);
+      if (!C || Slots.count(C))
+        continue;
+      Slots[C] = Constants.size();
+      Constants.push_back(C);
+    }
+  }
+
+  unsigned NumSlots = Constants.size();
+  for (Argument &A : F.args())
+    Slots[&A] = NumSlots++;
+  FF.NumArgs = F.arg_size();
+
+  for (Instruction &I : instructions(F))
+    if (!I.getType()->isVoidTy())
+      Slots[&I] = NumSlots++;
+  FF.NumSlots = NumSlots;
+}
+
+bool FunctionTranslator::translate() {
+  Function &F = *FF.F;
+
+  for (Argument &A : F.args())
+    if (!isSupportedType(A.getType()))
+      return false;
+  if (!F.getReturnType()->isVoidTy() && !isSupportedType(F.getReturnType()))
+    return false;
+
+  SmallVector<CallInst *, 8> Intrinsics;
+  for (Instruction &I : instructions(F)) {
+    if (!isSupported(I)) {
+      DEBUG(dbgs() << "Fast interpreter can't run: " << I << "\n");
+      return false;
+    }
+    if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(&I))
+      if (!isa<DbgInfoIntrinsic>(II))
+        Intrinsics.push_back(II);
+  }
+
+  // The Interpreter lowers intrinsics as it runs into them; do it up front.
+  for (CallInst *CI : Intrinsics)
+    IL.LowerIntrinsicCall(CI);
+
+  assignSlots();
+
+  for (auto BBI = F.begin(), BBE = F.end(); BBI != BBE; ++BBI) {
+    BasicBlock &BB = *BBI;
+    NextBB = std::next(BBI) == BBE ? nullptr : &*std::next(BBI);
+    BlockStarts[&BB] = FF.Code.size();
+    for (Instruction &I : BB)
+      if (!visit(I))
+        return false;
+  }
+
+  for (auto &Fixup : BlockFixups)
+    FF.Code[Fixup.first] = BlockStarts[Fixup.second];
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                     Terminator Instruction Translation
+//===----------------------------------------------------------------------===//
+
+bool FunctionTranslator::hasEdgeMoves(BasicBlock *From, BasicBlock *To) const {
+  for (PHINode &PN : To->phis())
+    if (PN.getIncomingValueForBlock(From) != &PN)
+      return true;
+  return false;
+}
+
+// Set the PHI nodes of To as if control went from From to To. This is a
+// parallel copy: when a PHI node reads another PHI node of To, everything goes
+// through temporaries first.
+void FunctionTranslator::emitEdgeMoves(BasicBlock *From, BasicBlock *To) {
+  SmallVector<std::pair<unsigned, unsigned>, 8> Moves;
+  bool ReadsPHIs = false;
+  for (PHINode &PN : To->phis()) {
+    Value *In = PN.getIncomingValueForBlock(From);
+    if (In == &PN)
+      continue;
+    if (PHINode *InPN = dyn_cast<PHINode>(In))
+      ReadsPHIs |= InPN->getParent() == To;
+    Moves.push_back(std::make_pair(getSlot(&PN), getSlot(In)));
+  }
+
+  if (!ReadsPHIs) {
+    for (auto &Move : Moves)
+      emit(FF_::Mov, {Move.first, Move.second});
+    return;
+  }
+
+  while (TempSlots.size() < Moves.size())
+    TempSlots.push_back(FF.NumSlots++);
+  for (unsigned I = 0, E = Moves.size(); I != E; ++I)
+    emit(FF_::Mov, {TempSlots[I], Moves[I].second});
+  for (unsigned I = 0, E = Moves.size(); I != E; ++I)
+    emit(FF_::Mov, {Moves[I].first, TempSlots[I]});
+}
+
+// Point the branch target operand at TargetOperand to To, through the moves
+// for its PHI nodes if there are any.
+void FunctionTranslator::emitEdge(size_t TargetOperand, BasicBlock *From,
+                                  BasicBlock *To) {
+  if (!hasEdgeMoves(From, To)) {
+    BlockFixups.push_back(std::make_pair(TargetOperand, To));
+    return;
+  }
+  FF.Code[TargetOperand] = FF.Code.size();
+  emitEdgeMoves(From, To);
+  emitJump(To);
+}
+
+bool FunctionTranslator::visitReturnInst(ReturnInst &I) {
+  if (Value *V = I.getReturnValue())
+    emit(FF_::Ret, {getSlot(V)});
+  else
+    emit(FF_::RetVoid, {});
+  return true;
+}
+
+bool FunctionTranslator::visitBranchInst(BranchInst &I) {
+  BasicBlock *BB = I.getParent();
+  if (I.isUnconditional()) {
+    BasicBlock *Dest = I.getSuccessor(0);
+    emitEdgeMoves(BB, Dest);
+    if (Dest != NextBB)
+      emitJump(Dest);
+    return true;
+  }
+
+  emit(FF_::CondBr, {getSlot(I.getCondition()), 0, 0});
+  size_t TrueOperand = FF.Code.size() - 2;
+  size_t FalseOperand = FF.Code.size() - 1;
+  emitEdge(TrueOperand, BB, I.getSuccessor(0));
+  emitEdge(FalseOperand, BB, I.getSuccessor(1));
+  return true;
+}
+
+bool FunctionTranslator::visitSwitchInst(SwitchInst &I) {
+  BasicBlock *BB = I.getParent();
+  SmallVector<uint64_t, 16> Operands;
+  Operands.push_back(getSlot(I.getCondition()));
+  Operands.push_back(0);
+  Operands.push_back(I.getNumCases());
+  for (auto Case : I.cases()) {
+    Operands.push_back(Case.getCaseValue()->getZExtValue());
+    Operands.push_back(0);
+  }
+  emit(FF_::Switch, Operands);
+
+  size_t Start = FF.Code.size() - Operands.size();
+  emitEdge(Start + 1, BB, I.getDefaultDest());
+  unsigned CaseNum = 0;
+  for (auto Case : I.cases())
+    emitEdge(Start + 4 + 2 * CaseNum++, BB, Case.getCaseSuccessor());
+  return true;
+}
+
+bool FunctionTranslator::visitUnreachableInst(UnreachableInst &I) {
+  emit(FF_::Unreachable, {});
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                     Arithmetic and Comparison Translation
+//===----------------------------------------------------------------------===//
+
+bool FunctionTranslator::visitBinaryOperator(BinaryOperator &I) {
+  Type *Ty = I.getType();
+  unsigned D = getSlot(&I);
+  unsigned A = getSlot(I.getOperand(0));
+  unsigned B = getSlot(I.getOperand(1));
+
+  if (Ty->isFloatingPointTy()) {
+    bool F64 = Ty->isDoubleTy();
+    switch (I.getOpcode()) {
+    case Instruction::FAdd:
+      emit(F64 ? FF_::FAddF64 : FF_::FAddF32, {D, A, B});
+      return true;
+    case Instruction::FSub:
+      emit(F64 ? FF_::FSubF64 : FF_::FSubF32, {D, A, B});
+      return true;
+    case Instruction::FMul:
+      emit(F64 ? FF_::FMulF64 : FF_::FMulF32, {D, A, B});
+      return true;
+    case Instruction::FDiv:
+      emit(F64 ? FF_::FDivF64 : FF_::FDivF32, {D, A, B});
+      return true;
+    case Instruction::FRem:
+      emit(F64 ? FF_::FRemF64 : FF_::FRemF32, {D, A, B});
+      return true;
+    default:
+      return visitInstruction(I);
+    }
+  }
+
+  unsigned W = Ty->getIntegerBitWidth();
+  uint64_t Mask = getMask(W);
+  switch (I.getOpcode()) {
+  case Instruction::Add:
+    if (W == 64)
+      emit(FF_::Add64, {D, A, B});
+    else if (W == 32)
+      emit(FF_::Add32, {D, A, B});
+    else
+      emit(FF_::AddN, {D, A, B, Mask});
+    return true;
+  case Instruction::Sub:
+    if (W == 64)
+      emit(FF_::Sub64, {D, A, B});
+    else if (W == 32)
+      emit(FF_::Sub32, {D, A, B});
+    else
+      emit(FF_::SubN, {D, A, B, Mask});
+    return true;
+  case Instruction::Mul:
+    if (W == 64)
+      emit(FF_::Mul64, {D, A, B});
+    else if (W == 32)
+      emit(FF_::Mul32, {D, A, B});
+    else
+      emit(FF_::MulN, {D, A, B, Mask});
+    return true;
+  case Instruction::UDiv:
+    emit(FF_::UDiv, {D, A, B});
+    return true;
+  case Instruction::URem:
+    emit(FF_::URem, {D, A, B});
+    return true;
+  case Instruction::SDiv:
+    if (W == 64)
+      emit(FF_::SDiv64, {D, A, B});
+    else if (W == 32)
+      emit(FF_::SDiv32, {D, A, B});
+    else
+      emit(FF_::SDivN, {D, A, B, W, Mask});
+    return true;
+  case Instruction::SRem:
+    if (W == 64)
+      emit(FF_::SRem64, {D, A, B});
+    else if (W == 32)
+      emit(FF_::SRem32, {D, A, B});
+    else
+      emit(FF_::SRemN, {D, A, B, W, Mask});
+    return true;
+  case Instruction::And:
+    emit(FF_::And, {D, A, B});
+    return true;
+  case Instruction::Or:
+    emit(FF_::Or, {D, A, B});
+    return true;
+  case Instruction::Xor:
+    emit(FF_::Xor, {D, A, B});
+    return true;
+  case Instruction::Shl:
+    if (W == 64)
+      emit(FF_::Shl64, {D, A, B});
+    else if (W == 32)
+      emit(FF_::Shl32, {D, A, B});
+    else
+      emit(FF_::ShlN, {D, A, B, getShiftAmountMask(W), Mask});
+    return true;
+  case Instruction::LShr:
+    emit(FF_::LShr, {D, A, B, getShiftAmountMask(W)});
+    return true;
+  case Instruction::AShr:
+    if (W == 64)
+      emit(FF_::AShr64, {D, A, B});
+    else if (W == 32)
+      emit(FF_::AShr32, {D, A, B});
+    else
+      emit(FF_::AShrN, {D, A, B, W, getShiftAmountMask(W), Mask});
+    return true;
+  default:
+    return visitInstruction(I);
+  }
+}
+
+void FunctionTranslator::emitSignedLess(bool OrEqual, unsigned D, unsigned A,
+                                        unsigned B, unsigned Width) {
+  if (Width == 64)
+    emit(OrEqual ? FF_::ICmpSLE64 : FF_::ICmpSLT64, {D, A, B});
+  else if (Width == 32)
+    emit(OrEqual ? FF_::ICmpSLE32 : FF_::ICmpSLT32, {D, A, B});
+  else
+    emit(OrEqual ? FF_::ICmpSLEN : FF_::ICmpSLTN, {D, A, B, Width});
+}
+
+bool FunctionTranslator::visitICmpInst(ICmpInst &I) {
+  unsigned D = getSlot(&I);
+  unsigned A = getSlot(I.getOperand(0));
+  unsigned B = getSlot(I.getOperand(1));
+  unsigned W = getIntWidth(I.getOperand(0)->getType());
+
+  switch (I.getPredicate()) {
+  case ICmpInst::ICMP_EQ:
+    emit(FF_::ICmpEQ, {D, A, B});
+    return true;
+  case ICmpInst::ICMP_NE:
+    emit(FF_::ICmpNE, {D, A, B});
+    return true;
+  case ICmpInst::ICMP_ULT:
+    emit(FF_::ICmpULT, {D, A, B});
+    return true;
+  case ICmpInst::ICMP_ULE:
+    emit(FF_::ICmpULE, {D, A, B});
+    return true;
+  case ICmpInst::ICMP_UGT:
+    emit(FF_::ICmpULT, {D, B, A});
+    return true;
+  case ICmpInst::ICMP_UGE:
+    emit(FF_::ICmpULE, {D, B, A});
+    return true;
+  case ICmpInst::ICMP_SLT:
+    emitSignedLess(false, D, A, B, W);
+    return true;
+  case ICmpInst::ICMP_SLE:
+    emitSignedLess(true, D, A, B, W);
+    return true;
+  case ICmpInst::ICMP_SGT:
+    emitSignedLess(false, D, B, A, W);
+    return true;
+  case ICmpInst::ICMP_SGE:
+    emitSignedLess(true, D, B, A, W);
+    return true;
+  default:
+    return visitInstruction(I);
+  }
+}
+
+bool FunctionTranslator::visitFCmpInst(FCmpInst &I) {
+  bool F64 = I.getOperand(0)->getType()->isDoubleTy();
+  emit(F64 ? FF_::FCmpF64 : FF_::FCmpF32,
+       {getSlot(&I), getSlot(I.getOperand(0)), getSlot(I.getOperand(1)),
+        static_cast<uint64_t>(I.getPredicate())});
+  return true;
+}
+
+bool FunctionTranslator::visitCastInst(CastInst &I) {
+  Type *SrcTy = I.getSrcTy();
+  Type *DstTy = I.getDestTy();
+  unsigned D = getSlot(&I);
+  unsigned A = getSlot(I.getOperand(0));
+
+  switch (I.getOpcode()) {
+  case Instruction::Trunc:
+  case Instruction::PtrToInt:
+    if (getIntWidth(DstTy) == 64)
+      emit(FF_::Mov, {D, A});
+    else
+      emit(FF_::Trunc, {D, A, getMask(getIntWidth(DstTy))});
+    return true;
+  case Instruction::ZExt:
+  case Instruction::IntToPtr:
+  case Instruction::BitCast:
+  case Instruction::AddrSpaceCast:
+    emit(FF_::Mov, {D, A});
+    return true;
+  case Instruction::SExt:
+    emit(FF_::SExt,
+         {D, A, getIntWidth(SrcTy), getMask(getIntWidth(DstTy))});
+    return true;
+  case Instruction::FPExt:
+    emit(FF_::FPExt, {D, A});
+    return true;
+  case Instruction::FPTrunc:
+    emit(FF_::FPTrunc, {D, A});
+    return true;
+  case Instruction::FPToSI:
+    emit(SrcTy->isDoubleTy() ? FF_::FPToSIF64 : FF_::FPToSIF32,
+         {D, A, getMask(getIntWidth(DstTy))});
+    return true;
+  case Instruction::FPToUI:
+    emit(SrcTy->isDoubleTy() ? FF_::FPToUIF64 : FF_::FPToUIF32,
+         {D, A, getMask(getIntWidth(DstTy))});
+    return true;
+  case Instruction::SIToFP:
+    emit(DstTy->isDoubleTy() ? FF_::SIToF64 : FF_::SIToF32,
+         {D, A, getIntWidth(SrcTy)});
+    return true;
+  case Instruction::UIToFP:
+    emit(DstTy->isDoubleTy() ? FF_::UIToF64 : FF_::UIToF32, {D, A});
+    return true;
+  default:
+    return visitInstruction(I);
+  }
+}
+
+bool FunctionTranslator::visitSelectInst(SelectInst &I) {
+  emit(FF_::Select, {getSlot(&I), getSlot(I.getCondition()),
+                     getSlot(I.getTrueValue()), getSlot(I.getFalseValue())});
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                     Memory Instruction Translation
+//===----------------------------------------------------------------------===//
+
+bool FunctionTranslator::visitAllocaInst(AllocaInst &I) {
+  emit(FF_::Alloca, {getSlot(&I), getSlot(I.getArraySize()),
+                     DL.getTypeAllocSize(I.getAllocatedType())});
+  return true;
+}
+
+bool FunctionTranslator::visitLoadInst(LoadInst &I) {
+  unsigned D = getSlot(&I);
+  unsigned P = getSlot(I.getPointerOperand());
+  uint64_t Bits = DL.getTypeSizeInBits(I.getType());
+  switch (Bits) {
+  case 8:
+    emit(FF_::Load8, {D, P});
+    break;
+  case 16:
+    emit(FF_::Load16, {D, P});
+    break;
+  case 32:
+    emit(FF_::Load32, {D, P});
+    break;
+  case 64:
+    emit(FF_::Load64, {D, P});
+    break;
+  default:
+    emit(FF_::LoadN, {D, P, DL.getTypeStoreSize(I.getType()), getMask(Bits)});
+    break;
+  }
+  return true;
+}
+
+bool FunctionTranslator::visitStoreInst(StoreInst &I) {
+  Value *V = I.getValueOperand();
+  unsigned S = getSlot(V);
+  unsigned P = getSlot(I.getPointerOperand());
+  switch (DL.getTypeSizeInBits(V->getType())) {
+  case 8:
+    emit(FF_::Store8, {S, P});
+    break;
+  case 16:
+    emit(FF_::Store16, {S, P});
+    break;
+  case 32:
+    emit(FF_::Store32, {S, P});
+    break;
+  case 64:
+    emit(FF_::Store64, {S, P});
+    break;
+  default:
+    emit(FF_::StoreN, {S, P, DL.getTypeStoreSize(V->getType())});
+    break;
+  }
+  return true;
+}
+
+// Fold the constant indices of I into a single offset, and scale the others.
+bool FunctionTranslator::visitGetElementPtrInst(GetElementPtrInst &I) {
+  uint64_t Offset = 0;
+  SmallVector<uint64_t, 6> Indices;
+  for (auto GTI = gep_type_begin(I), GTE = gep_type_end(I); GTI != GTE;
+       ++GTI) {
+    Value *Idx = GTI.getOperand();
+    if (StructType *STy = GTI.getStructTypeOrNull()) {
+      unsigned Field = cast<ConstantInt>(Idx)->getZExtValue();
+      Offset += DL.getStructLayout(STy)->getElementOffset(Field);
+      continue;
+    }
+    uint64_t Scale = DL.getTypeAllocSize(GTI.getIndexedType());
+    if (ConstantInt *CI = dyn_cast<ConstantInt>(Idx)) {
+      Offset += Scale * CI->getSExtValue();
+      continue;
+    }
+    Indices.push_back(getSlot(Idx));
+    Indices.push_back(Scale);
+    Indices.push_back(getIntWidth(Idx->getType()));
+  }
+
+  unsigned D = getSlot(&I);
+  unsigned P = getSlot(I.getPointerOperand());
+  if (Indices.empty()) {
+    if (Offset)
+      emit(FF_::AddImm, {D, P, Offset});
+    else
+      emit(FF_::Mov, {D, P});
+  } else if (Indices.size() == 3 && Indices[2] == 64) {
+    emit(FF_::GEP1, {D, P, Offset, Indices[0], Indices[1]});
+  } else {
+    SmallVector<uint64_t, 12> Operands = {D, P, Offset, Indices.size() / 3};
+    Operands.append(Indices.begin(), Indices.end());
+    emit(FF_::GEP, Operands);
+  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                     Call Translation
+//===----------------------------------------------------------------------===//
+
+bool FunctionTranslator::visitCallInst(CallInst &I) {
+  FastCallSite CS;
+  CS.Callee = I.getCalledFunction();
+  CS.CalleeSlot = CS.Callee ? 0 : getSlot(I.getCalledValue());
+  if (CS.Callee && CS.Callee->isIntrinsic())
+    return visitInstruction(I);
+
+  CS.ResultType = I.getType();
+  CS.ResultSlot = I.getType()->isVoidTy() ? ~0U : getSlot(&I);
+  for (Value *Arg : I.arg_operands()) {
+    CS.ArgSlots.push_back(getSlot(Arg));
+    CS.ArgTypes.push_back(Arg->getType());
+  }
+
+  emit(FF_::Call, {FF.Calls.size()});
+  FF.Calls.push_back(std::move(CS));
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                     Calls
+//===----------------------------------------------------------------------===//
+
+FastInterpreter::FastInterpreter(Interpreter &Interp, IntrinsicLowering &IL)
+    : Interp(Interp), IL(IL) {}
+
+FastInterpreter::~FastInterpreter() {}
+
+bool FastInterpreter::isSupported(const DataLayout &DL) {
+  return sizeof(void *) == 8 && DL.getPointerSizeInBits() == 64 &&
+         DL.isLittleEndian() == sys::IsLittleEndianHost;
+}
+
+FastFunction *FastInterpreter::getFastFunction(Function *F) {
+  auto I = Functions.find(F);
+  if (I != Functions.end())
+    return I->second.get();
+
+  auto FF = llvm::make_unique<FastFunction>();
+  FF->F = F;
+  FunctionTranslator Translator(Interp.getDataLayout(), IL, *FF);
+  if (!Translator.translate()) {
+    ++NumNotTranslated;
+    Functions[F] = nullptr;
+    return nullptr;
+  }
+  for (Constant *C : Translator.getConstants())
+    FF->Constants.push_back(toSlot(Interp.getConstantValue(C), C->getType()));
+
+  ++NumTranslated;
+  DEBUG(dbgs() << "Translated " << F->getName() << " to "
+               << FF->InstStarts.size() << " bytecode instructions\n");
+  FastFunction *Result = FF.get();
+  Functions[F] = std::move(FF);
+  return Result;
+}
+
+GenericValue FastInterpreter::interpret(Function *F,
+                                        ArrayRef<GenericValue> ArgVals) {
+  assert(Interp.ECStack.empty() &&
+         "The IR interpreter never calls into bytecode!");
+  Interp.callFunction(F, ArgVals);
+  Interp.run();
+  return Interp.ExitValue;
+}
+
+uint64_t FastInterpreter::execute(FastFunction &FF, ArrayRef<uint64_t> Args) {
+  SmallVector<uint64_t, 64> Frame(FF.NumSlots);
+  std::copy(FF.Constants.begin(), FF.Constants.end(), Frame.begin());
+  size_t NumArgs = std::min<size_t>(Args.size(), FF.NumArgs);
+  std::copy(Args.begin(), Args.begin() + NumArgs,
+            Frame.begin() + FF.Constants.size());
+  return execute(FF, Frame.data());
+}
+
+void FastInterpreter::call(FastCallSite &CS, uint64_t *Frame) {
+  Function *Callee = CS.Callee;
+  FastFunction *Target;
+  if (Callee) {
+    if (!CS.Resolved) {
+      CS.Target = Callee->isDeclaration() ? nullptr : getFastFunction(Callee);
+      CS.Resolved = true;
+    }
+    Target = CS.Target;
+  } else {
+    // As in the Interpreter, function pointers point to the IR.
+    Callee = reinterpret_cast<Function *>(
+        static_cast<uintptr_t>(Frame[CS.CalleeSlot]));
+    Target = Callee->isDeclaration() ? nullptr : getFastFunction(Callee);
+  }
+
+  uint64_t Result;
+  if (Target) {
+    SmallVector<uint64_t, 8> Args;
+    for (unsigned Slot : CS.ArgSlots)
+      Args.push_back(Frame[Slot]);
+    Result = execute(*Target, Args);
+  } else {
+    SmallVector<GenericValue, 8> ArgVals;
+    for (unsigned I = 0, E = CS.ArgSlots.size(); I != E; ++I)
+      ArgVals.push_back(fromSlot(Frame[CS.ArgSlots[I]], CS.ArgTypes[I]));
+    GenericValue GV = Callee->isDeclaration()
+                          ? Interp.callExternalFunction(Callee, ArgVals)
+                          : interpret(Callee, ArgVals);
+    if (CS.ResultSlot == ~0U)
+      return;
+    Result = toSlot(GV, CS.ResultType);
+  }
+
+  if (CS.ResultSlot != ~0U)
+    Frame[CS.ResultSlot] = Result;
+}
+
+GenericValue FastInterpreter::runFunction(Function *F,
+                                          ArrayRef<GenericValue> ArgVals) {
+  FastFunction *FF = F->isDeclaration() ? nullptr : getFastFunction(F);
+  if (!FF)
+    return interpret(F, ArgVals);
+
+  FunctionType *FTy = F->getFunctionType();
+  SmallVector<uint64_t, 8> Args;
+  for (unsigned I = 0, E = std::min<size_t>(ArgVals.size(), FTy->getNumParams());
+       I != E; ++I)
+    Args.push_back(toSlot(ArgVals[I], FTy->getParamType(I)));
+  uint64_t Result = execute(*FF, Args);
+
+  Type *RetTy = F->getReturnType();
+  if (RetTy->isVoidTy()) {
+    GenericValue GV;
+    memset(&GV.Untyped, 0, sizeof(GV.Untyped));
+    return GV;
+  }
+  return fromSlot(Result, RetTy);
+}
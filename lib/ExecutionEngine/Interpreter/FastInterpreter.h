@@ -0,0 +1,219 @@
+//===-- FastInterpreter.h - Bytecode interpreter ----------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This header defines the fast interpreter, which translates each function to
+// a register-based bytecode the first time it is called, and runs that instead
+// of visiting the IR.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_EXECUTIONENGINE_INTERPRETER_FASTINTERPRETER_H
+#define LLVM_LIB_EXECUTIONENGINE_INTERPRETER_FASTINTERPRETER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ExecutionEngine/GenericValue.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace llvm {
+
+class DataLayout;
+class Function;
+struct FastFunction;
+class FunctionType;
+class Interpreter;
+class IntrinsicLowering;
+class Type;
+
+// The bytecode instructions, with their operands. An operand is either a
+// frame slot (d, a, b, ...), the slot the result goes to being first, or an
+// immediate. Integers are kept zero-extended in their slots, so that
+// instructions only need to know the width of their operands when it matters
+// to them: i32 and i64 have their own versions of those, and other widths pass
+// the width or the mask of the result along.
+#define FAST_INTERPRETER_OPCODES(X)                                            \
+  X(Mov)        /* d a */                                                      \
+  X(AddImm)     /* d a imm */                                                  \
+  X(Add64)      /* d a b */                                                    \
+  X(Add32)      /* d a b */                                                    \
+  X(AddN)       /* d a b mask */                                               \
+  X(Sub64)      /* d a b */                                                    \
+  X(Sub32)      /* d a b */                                                    \
+  X(SubN)       /* d a b mask */                                               \
+  X(Mul64)      /* d a b */                                                    \
+  X(Mul32)      /* d a b */                                                    \
+  X(MulN)       /* d a b mask */                                               \
+  X(UDiv)       /* d a b */                                                    \
+  X(URem)       /* d a b */                                                    \
+  X(SDiv64)     /* d a b */                                                    \
+  X(SDiv32)     /* d a b */                                                    \
+  X(SDivN)      /* d a b width mask */                                         \
+  X(SRem64)     /* d a b */                                                    \
+  X(SRem32)     /* d a b */                                                    \
+  X(SRemN)      /* d a b width mask */                                         \
+  X(And)        /* d a b */                                                    \
+  X(Or)         /* d a b */                                                    \
+  X(Xor)        /* d a b */                                                    \
+  X(Shl64)      /* d a b */                                                    \
+  X(Shl32)      /* d a b */                                                    \
+  X(ShlN)       /* d a b amountmask mask */                                    \
+  X(LShr)       /* d a b amountmask */                                         \
+  X(AShr64)     /* d a b */                                                    \
+  X(AShr32)     /* d a b */                                                    \
+  X(AShrN)      /* d a b width amountmask mask */                              \
+  X(ICmpEQ)     /* d a b */                                                    \
+  X(ICmpNE)     /* d a b */                                                    \
+  X(ICmpULT)    /* d a b */                                                    \
+  X(ICmpULE)    /* d a b */                                                    \
+  X(ICmpSLT64)  /* d a b */                                                    \
+  X(ICmpSLE64)  /* d a b */                                                    \
+  X(ICmpSLT32)  /* d a b */                                                    \
+  X(ICmpSLE32)  /* d a b */                                                    \
+  X(ICmpSLTN)   /* d a b width */                                              \
+  X(ICmpSLEN)   /* d a b width */                                              \
+  X(Trunc)      /* d a mask */                                                 \
+  X(SExt)       /* d a width mask */                                           \
+  X(Select)     /* d c a b */                                                  \
+  X(FAddF32)    /* d a b */                                                    \
+  X(FSubF32)    /* d a b */                                                    \
+  X(FMulF32)    /* d a b */                                                    \
+  X(FDivF32)    /* d a b */                                                    \
+  X(FRemF32)    /* d a b */                                                    \
+  X(FAddF64)    /* d a b */                                                    \
+  X(FSubF64)    /* d a b */                                                    \
+  X(FMulF64)    /* d a b */                                                    \
+  X(FDivF64)    /* d a b */                                                    \
+  X(FRemF64)    /* d a b */                                                    \
+  X(FCmpF32)    /* d a b predicate */                                          \
+  X(FCmpF64)    /* d a b predicate */                                          \
+  X(FPExt)      /* d a */                                                      \
+  X(FPTrunc)    /* d a */                                                      \
+  X(FPToSIF32)  /* d a mask */                                                 \
+  X(FPToSIF64)  /* d a mask */                                                 \
+  X(FPToUIF32)  /* d a mask */                                                 \
+  X(FPToUIF64)  /* d a mask */                                                 \
+  X(SIToF32)    /* d a width */                                                \
+  X(SIToF64)    /* d a width */                                                \
+  X(UIToF32)    /* d a */                                                      \
+  X(UIToF64)    /* d a */                                                      \
+  X(Load8)      /* d p */                                                      \
+  X(Load16)     /* d p */                                                      \
+  X(Load32)     /* d p */                                                      \
+  X(Load64)     /* d p */                                                      \
+  X(LoadN)      /* d p bytes mask */                                           \
+  X(Store8)     /* v p */                                                      \
+  X(Store16)    /* v p */                                                      \
+  X(Store32)    /* v p */                                                      \
+  X(Store64)    /* v p */                                                      \
+  X(StoreN)     /* v p bytes */                                                \
+  X(Alloca)     /* d count size */                                             \
+  X(GEP1)       /* d p offset index scale */                                   \
+  X(GEP)        /* d p offset n (index scale width)... */                      \
+  X(Br)         /* target */                                                   \
+  X(CondBr)     /* c target target */                                          \
+  X(Switch)     /* c default n (value target)... */                            \
+  X(Ret)        /* a */                                                        \
+  X(RetVoid)    /* */                                                          \
+  X(Call)       /* callsite */                                                 \
+  X(Unreachable) /* */
+
+/// A call instruction, resolved as far as it can be at translation time.
+struct FastCallSite {
+  /// The callee, or null for an indirect call through CalleeSlot.
+  Function *Callee;
+  unsigned CalleeSlot;
+
+  /// The slot the result goes to, or ~0U if the call returns void.
+  unsigned ResultSlot;
+  Type *ResultType;
+
+  SmallVector<unsigned, 4> ArgSlots;
+  SmallVector<Type *, 4> ArgTypes;
+
+  /// The translation of Callee, once it has been looked up.
+  FastFunction *Target = nullptr;
+  bool Resolved = false;
+};
+
+/// The translation of a function.
+///
+/// A frame holds the constants used by the function first, then its
+/// arguments, then the values of its instructions and some temporaries. Every
+/// slot is 64 bits wide.
+struct FastFunction {
+  enum Opcode : uint64_t {
+#define FAST_INTERPRETER_ENUM(Name) Name,
+    FAST_INTERPRETER_OPCODES(FAST_INTERPRETER_ENUM)
+#undef FAST_INTERPRETER_ENUM
+  };
+
+  Function *F;
+
+  /// The instructions. Opcodes are replaced by the address of their handlers
+  /// the first time the function is run when using direct threading, so
+  /// InstStarts records where each instruction starts.
+  std::vector<uint64_t> Code;
+  std::vector<uint32_t> InstStarts;
+  bool Linked = false;
+
+  /// The initial values of the first slots of the frame.
+  std::vector<uint64_t> Constants;
+  unsigned NumArgs = 0;
+  unsigned NumSlots = 0;
+
+  std::vector<FastCallSite> Calls;
+};
+
+/// Runs functions translated to bytecode, and hands the functions it can't
+/// translate over to the Interpreter it belongs to.
+///
+/// Integers wider than 64 bits, vectors, aggregates, floating point types
+/// other than float and double, variable arguments, exception handling and
+/// atomic read-modify-write instructions are not supported.
+class FastInterpreter {
+public:
+  FastInterpreter(Interpreter &Interp, IntrinsicLowering &IL);
+  ~FastInterpreter();
+
+  /// Whether the fast interpreter can run code for \p DL on this host.
+  static bool isSupported(const DataLayout &DL);
+
+  /// Run \p F to completion, as Interpreter::runFunction would.
+  GenericValue runFunction(Function *F, ArrayRef<GenericValue> ArgVals);
+
+private:
+  /// Return the translation of \p F, or null if it can't be translated.
+  FastFunction *getFastFunction(Function *F);
+
+  /// Run \p FF with the frame \p Frame, whose constants and arguments are set
+  /// up, and return its result.
+  uint64_t execute(FastFunction &FF, uint64_t *Frame);
+
+  /// Run \p FF with arguments \p Args.
+  uint64_t execute(FastFunction &FF, ArrayRef<uint64_t> Args);
+
+  /// Make the call \p CS from the frame \p Frame, and store its result.
+  void call(FastCallSite &CS, uint64_t *Frame);
+
+  /// Run \p F on the Interpreter.
+  GenericValue interpret(Function *F, ArrayRef<GenericValue> ArgVals);
+
+  Interpreter &Interp;
+  IntrinsicLowering &IL;
+
+  /// Translated functions, and null for those that can't be.
+  DenseMap<Function *, std::unique_ptr<FastFunction>> Functions;
+};
+
+} // End llvm namespace
+
+#endif
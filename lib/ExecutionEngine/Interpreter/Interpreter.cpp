@@ -14,12 +14,20 @@
 //===----------------------------------------------------------------------===//
 
 #include "Interpreter.h"
+#include "FastInterpreter.h"
 #include "llvm/CodeGen/IntrinsicLowering.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include <cstring>
 using namespace llvm;
 
+static cl::opt<bool> UseFastInterpreter(
+    "fast-interpreter",
+    cl::desc("Translate functions to a register-based bytecode and run that "
+             "instead of the IR"),
+    cl::init(false));
+
 namespace {
 
 static struct RegisterInterp {
@@ -62,6 +70,9 @@ Interpreter::Interpreter(std::unique_ptr<Module> M)
   emitGlobals();
 
   IL = new IntrinsicLowering(getDataLayout());
+
+  if (UseFastInterpreter && FastInterpreter::isSupported(getDataLayout()))
+    Fast = llvm::make_unique<FastInterpreter>(*this, *IL);
 }
 
 Interpreter::~Interpreter() {
@@ -70,6 +81,12 @@ Interpreter::~Interpreter() {
 
 void Interpreter::runAtExitHandlers () {
   while (!AtExitHandlers.empty()) {
+    if (Fast) {
+      Function *F = AtExitHandlers.back();
+      AtExitHandlers.pop_back();
+      Fast->runFunction(F, None);
+      continue;
+    }
     callFunction(AtExitHandlers.back(), None);
     AtExitHandlers.pop_back();
     run();
@@ -93,6 +110,9 @@ GenericValue Interpreter::runFunction(Function *F,
   ArrayRef<GenericValue> ActualArgs =
       ArgValues.slice(0, std::min(ArgValues.size(), ArgCount));
 
+  if (Fast)
+    return Fast->runFunction(F, ActualArgs);
+
   // Set up the function call.
   callFunction(F, ActualArgs);
 
@@ -25,6 +25,7 @@
 #include "llvm/Support/raw_ostream.h"
 namespace llvm {
 
+class FastInterpreter;
 class IntrinsicLowering;
 template<typename T> class generic_gep_type_iterator;
 class ConstantExpr;
@@ -74,9 +75,14 @@ struct ExecutionContext {
 // Interpreter - This class represents the entirety of the interpreter.
 //
 class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
+  friend class FastInterpreter;
+
   GenericValue ExitValue;          // The return value of the called function
   IntrinsicLowering *IL;
 
+  // The bytecode interpreter runFunction goes through, if it is enabled.
+  std::unique_ptr<FastInterpreter> Fast;
+
   // The runtime stack of executing code.  The top of the stack is the current
   // function record.
   std::vector<ExecutionContext> ECStack;
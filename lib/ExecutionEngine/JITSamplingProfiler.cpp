@@ -0,0 +1,472 @@
+//===- JITSamplingProfiler.cpp - Sampling profiler for JITed code ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the statistical profiler for JITed code, sampling with
+// perf_event_open or with a SIGPROF timer.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/JITSamplingProfiler.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <system_error>
+
+#ifdef LLVM_ON_UNIX
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+using namespace llvm::object;
+
+//===----------------------------------------------------------------------===//
+// SIGPROF timer sampling
+//===----------------------------------------------------------------------===//
+
+// The signal handler can't allocate or take locks: it appends the interrupted
+// PC to a static ring, which the profiler drains when it updates.
+
+static const unsigned NumTimerSamples = 4096;
+static std::atomic<uint64_t> TimerSamples[NumTimerSamples];
+static std::atomic<uint64_t> TimerHead;
+static std::atomic<bool> TimerInUse;
+
+#if defined(__linux__) && defined(__x86_64__)
+#define PC_FROM_UCONTEXT(UC) (UC)->uc_mcontext.gregs[REG_RIP]
+#elif defined(__linux__) && defined(__i386__)
+#define PC_FROM_UCONTEXT(UC) (UC)->uc_mcontext.gregs[REG_EIP]
+#elif defined(__linux__) && defined(__aarch64__)
+#define PC_FROM_UCONTEXT(UC) (UC)->uc_mcontext.pc
+#elif defined(__APPLE__) && defined(__x86_64__)
+#define PC_FROM_UCONTEXT(UC) (UC)->uc_mcontext->__ss.__rip
+#elif defined(__APPLE__) && defined(__aarch64__)
+#define PC_FROM_UCONTEXT(UC) (UC)->uc_mcontext->__ss.__pc
+#endif
+
+#ifdef PC_FROM_UCONTEXT
+static struct sigaction PrevSIGPROFAction;
+
+static void handleSIGPROF(int, siginfo_t *, void *Context) {
+  uint64_t PC = (uint64_t)PC_FROM_UCONTEXT((ucontext_t *)Context);
+  uint64_t I = TimerHead.fetch_add(1, std::memory_order_relaxed);
+  TimerSamples[I % NumTimerSamples].store(PC, std::memory_order_release);
+}
+
+static std::error_code startTimer(unsigned IntervalUs) {
+  struct sigaction SA;
+  SA.sa_sigaction = handleSIGPROF;
+  SA.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&SA.sa_mask);
+  if (sigaction(SIGPROF, &SA, &PrevSIGPROFAction))
+    return std::error_code(errno, std::generic_category());
+
+  struct itimerval Timer;
+  Timer.it_interval.tv_sec = IntervalUs / 1000000;
+  Timer.it_interval.tv_usec = IntervalUs % 1000000;
+  Timer.it_value = Timer.it_interval;
+  if (setitimer(ITIMER_PROF, &Timer, nullptr)) {
+    std::error_code EC(errno, std::generic_category());
+    sigaction(SIGPROF, &PrevSIGPROFAction, nullptr);
+    return EC;
+  }
+  return std::error_code();
+}
+
+static void stopTimer() {
+  struct itimerval Timer = {};
+  setitimer(ITIMER_PROF, &Timer, nullptr);
+  sigaction(SIGPROF, &PrevSIGPROFAction, nullptr);
+}
+#endif // PC_FROM_UCONTEXT
+
+//===----------------------------------------------------------------------===//
+// Hardware counter sampling
+//===----------------------------------------------------------------------===//
+
+/// Samples the cycle counter of the current thread, and reads the sampled PCs
+/// from the ring buffer the kernel writes them to.
+class JITSamplingProfiler::HardwareSampler {
+public:
+#if defined(__linux__)
+  static std::unique_ptr<HardwareSampler> create(uint64_t Period) {
+    struct perf_event_attr Attr = {};
+    Attr.size = sizeof(Attr);
+    Attr.type = PERF_TYPE_HARDWARE;
+    Attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    Attr.sample_period = Period;
+    Attr.sample_type = PERF_SAMPLE_IP;
+    Attr.exclude_kernel = 1;
+    Attr.exclude_hv = 1;
+    Attr.disabled = 1;
+    int FD = syscall(__NR_perf_event_open, &Attr, /*pid=*/0, /*cpu=*/-1,
+                     /*group_fd=*/-1, /*flags=*/0);
+    if (FD < 0)
+      return nullptr;
+
+    size_t PageSize = sysconf(_SC_PAGESIZE);
+    size_t MapSize = (1 + NumDataPages) * PageSize;
+    void *Ring = mmap(nullptr, MapSize, PROT_READ | PROT_WRITE, MAP_SHARED, FD,
+                      0);
+    if (Ring == MAP_FAILED) {
+      close(FD);
+      return nullptr;
+    }
+    std::unique_ptr<HardwareSampler> Sampler(
+        new HardwareSampler(FD, Ring, PageSize, MapSize));
+    if (ioctl(FD, PERF_EVENT_IOC_ENABLE, 0))
+      return nullptr;
+    return Sampler;
+  }
+
+  ~HardwareSampler() {
+    ioctl(FD, PERF_EVENT_IOC_DISABLE, 0);
+    munmap(Ring, MapSize);
+    close(FD);
+  }
+
+  template <typename SinkT> void drain(SinkT Sink) {
+    auto *Meta = static_cast<perf_event_mmap_page *>(Ring);
+    const char *Data = static_cast<const char *>(Ring) + PageSize;
+    size_t DataSize = MapSize - PageSize;
+    uint64_t Head = __atomic_load_n(&Meta->data_head, __ATOMIC_ACQUIRE);
+    uint64_t Tail = Meta->data_tail;
+
+    // Records can wrap around the end of the ring.
+    auto Read = [&](void *Dst, uint64_t Pos, size_t Size) {
+      char *Out = static_cast<char *>(Dst);
+      for (size_t I = 0; I != Size; ++I)
+        Out[I] = Data[(Pos + I) % DataSize];
+    };
+
+    while (Tail < Head) {
+      struct perf_event_header Header;
+      Read(&Header, Tail, sizeof(Header));
+      if (Header.size < sizeof(Header))
+        break;
+      if (Header.type == PERF_RECORD_SAMPLE &&
+          Header.size >= sizeof(Header) + sizeof(uint64_t)) {
+        uint64_t IP;
+        Read(&IP, Tail + sizeof(Header), sizeof(IP));
+        Sink(IP);
+      }
+      Tail += Header.size;
+    }
+    __atomic_store_n(&Meta->data_tail, Head, __ATOMIC_RELEASE);
+  }
+
+private:
+  // 256KB of samples, a power of two as the kernel requires.
+  static const size_t NumDataPages = 64;
+
+  HardwareSampler(int FD, void *Ring, size_t PageSize, size_t MapSize)
+      : FD(FD), Ring(Ring), PageSize(PageSize), MapSize(MapSize) {}
+
+  int FD;
+  void *Ring;
+  size_t PageSize;
+  size_t MapSize;
+#else
+  static std::unique_ptr<HardwareSampler> create(uint64_t Period) {
+    return nullptr;
+  }
+
+  template <typename SinkT> void drain(SinkT Sink) {}
+#endif
+};
+
+//===----------------------------------------------------------------------===//
+// JITSamplingProfiler
+//===----------------------------------------------------------------------===//
+
+JITSamplingProfiler::JITSamplingProfiler(const Options &Opts) : Opts(Opts) {}
+
+JITSamplingProfiler::~JITSamplingProfiler() { stop(); }
+
+Error JITSamplingProfiler::start() {
+  MutexGuard Lock(ProfileMutex);
+  if (Source != SampleSource::None)
+    return make_error<StringError>("profiler already started",
+                                   inconvertibleErrorCode());
+
+  if (Opts.UseHardwareCounters &&
+      (HWSampler = HardwareSampler::create(Opts.CyclesPerSample))) {
+    Source = SampleSource::HardwareCounter;
+  } else {
+#ifdef PC_FROM_UCONTEXT
+    if (TimerInUse.exchange(true))
+      return make_error<StringError>(
+          "the profiling timer is used by another profiler",
+          inconvertibleErrorCode());
+    TimerTail = TimerHead.load();
+    if (std::error_code EC = startTimer(std::max(Opts.TimerIntervalUs, 1u))) {
+      TimerInUse = false;
+      return errorCodeToError(EC);
+    }
+    Source = SampleSource::Timer;
+#else
+    return make_error<StringError>("sampling is not supported on this host",
+                                   inconvertibleErrorCode());
+#endif
+  }
+
+#if LLVM_ENABLE_THREADS
+  if (Opts.UpdateIntervalMs) {
+    StopUpdateThread = false;
+    UpdateThread = std::thread([this]() {
+      std::unique_lock<std::mutex> Lock(UpdateThreadMutex);
+      while (!UpdateThreadCV.wait_for(
+          Lock, std::chrono::milliseconds(Opts.UpdateIntervalMs),
+          [this]() { return StopUpdateThread; })) {
+        update();
+        if (UpdateCallback)
+          UpdateCallback(*this);
+      }
+    });
+  }
+#endif
+
+  return Error::success();
+}
+
+void JITSamplingProfiler::stopUpdateThread() {
+#if LLVM_ENABLE_THREADS
+  if (!UpdateThread.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> Lock(UpdateThreadMutex);
+    StopUpdateThread = true;
+  }
+  UpdateThreadCV.notify_all();
+  UpdateThread.join();
+#endif
+}
+
+void JITSamplingProfiler::stop() {
+  // The update thread takes the profile lock: stop it first.
+  stopUpdateThread();
+
+  MutexGuard Lock(ProfileMutex);
+  switch (Source) {
+  case SampleSource::None:
+    return;
+  case SampleSource::HardwareCounter:
+    drainSamplesLocked();
+    HWSampler.reset();
+    break;
+  case SampleSource::Timer:
+#ifdef PC_FROM_UCONTEXT
+    stopTimer();
+#endif
+    drainSamplesLocked();
+    TimerInUse = false;
+    break;
+  }
+  Source = SampleSource::None;
+}
+
+void JITSamplingProfiler::setUpdateCallback(UpdateCallbackT Callback) {
+#if LLVM_ENABLE_THREADS
+  std::lock_guard<std::mutex> Lock(UpdateThreadMutex);
+#endif
+  UpdateCallback = std::move(Callback);
+}
+
+JITSamplingProfiler::FunctionMapT::iterator
+JITSamplingProfiler::findFunction(uint64_t Addr) {
+  auto I = Functions.upper_bound(Addr);
+  if (I == Functions.begin())
+    return Functions.end();
+  --I;
+  if (Addr - I->first >= I->second.Size)
+    return Functions.end();
+  return I;
+}
+
+JITSamplingProfiler::FunctionMapT::const_iterator
+JITSamplingProfiler::findFunction(uint64_t Addr) const {
+  return const_cast<JITSamplingProfiler *>(this)->findFunction(Addr);
+}
+
+void JITSamplingProfiler::recordSampleLocked(uint64_t Addr) {
+  auto I = findFunction(Addr);
+  if (I == Functions.end()) {
+    ++UnattributedSamples;
+    return;
+  }
+  ++I->second.PendingSamples;
+}
+
+void JITSamplingProfiler::recordSample(uint64_t Addr) {
+  MutexGuard Lock(ProfileMutex);
+  recordSampleLocked(Addr);
+}
+
+void JITSamplingProfiler::drainSamplesLocked() {
+  switch (Source) {
+  case SampleSource::None:
+    break;
+  case SampleSource::HardwareCounter:
+    HWSampler->drain([this](uint64_t Addr) { recordSampleLocked(Addr); });
+    break;
+  case SampleSource::Timer: {
+    uint64_t Head = TimerHead.load(std::memory_order_acquire);
+    // Samples overwritten since the last drain are lost.
+    if (Head - TimerTail > NumTimerSamples)
+      TimerTail = Head - NumTimerSamples;
+    for (; TimerTail != Head; ++TimerTail) {
+      // A handler running concurrently might not have stored its sample yet:
+      // it is dropped.
+      uint64_t Addr = TimerSamples[TimerTail % NumTimerSamples].exchange(
+          0, std::memory_order_acquire);
+      if (Addr)
+        recordSampleLocked(Addr);
+    }
+    break;
+  }
+  }
+}
+
+void JITSamplingProfiler::update() {
+  MutexGuard Lock(ProfileMutex);
+  drainSamplesLocked();
+  for (auto &KV : Functions) {
+    FunctionInfo &FI = KV.second;
+    FI.Hotness = FI.Hotness * Opts.Decay + FI.PendingSamples;
+    FI.Samples += FI.PendingSamples;
+    FI.PendingSamples = 0;
+  }
+}
+
+double JITSamplingProfiler::getHotness(StringRef Name) const {
+  MutexGuard Lock(ProfileMutex);
+  auto I = FunctionAddrs.find(Name);
+  if (I == FunctionAddrs.end())
+    return 0;
+  return Functions.find(I->second)->second.Hotness;
+}
+
+double JITSamplingProfiler::getHotness(uint64_t Addr) const {
+  MutexGuard Lock(ProfileMutex);
+  auto I = findFunction(Addr);
+  return I == Functions.end() ? 0 : I->second.Hotness;
+}
+
+std::vector<JITSamplingProfiler::FunctionProfile>
+JITSamplingProfiler::getHottestFunctions(unsigned N) const {
+  std::vector<FunctionProfile> Profiles;
+  {
+    MutexGuard Lock(ProfileMutex);
+    for (auto &KV : Functions)
+      if (KV.second.Samples)
+        Profiles.push_back({KV.second.Name, KV.first, KV.second.Size,
+                            KV.second.Samples, KV.second.Hotness});
+  }
+
+  auto Hotter = [](const FunctionProfile &LHS, const FunctionProfile &RHS) {
+    if (LHS.Hotness != RHS.Hotness)
+      return LHS.Hotness > RHS.Hotness;
+    return LHS.Samples > RHS.Samples;
+  };
+  if (Profiles.size() > N) {
+    std::partial_sort(Profiles.begin(), Profiles.begin() + N, Profiles.end(),
+                      Hotter);
+    Profiles.resize(N);
+  } else {
+    std::sort(Profiles.begin(), Profiles.end(), Hotter);
+  }
+  return Profiles;
+}
+
+uint64_t JITSamplingProfiler::getNumUnattributedSamples() const {
+  MutexGuard Lock(ProfileMutex);
+  return UnattributedSamples;
+}
+
+void JITSamplingProfiler::print(raw_ostream &OS, unsigned N) const {
+  OS << "   Hotness    Samples  Address            Function\n";
+  for (const FunctionProfile &FP : getHottestFunctions(N))
+    OS << format("%10.2f %10llu  0x%016llx %s\n", FP.Hotness,
+                 (unsigned long long)FP.Samples,
+                 (unsigned long long)FP.Address, FP.Name.c_str());
+  OS << "Samples outside of JITed code: " << getNumUnattributedSamples()
+     << "\n";
+}
+
+void JITSamplingProfiler::NotifyObjectEmitted(
+    const ObjectFile &Obj, const RuntimeDyld::LoadedObjectInfo &L) {
+  // The debug object has the load addresses of the sections.
+  OwningBinary<ObjectFile> DebugObjOwner = L.getObjectForDebug(Obj);
+  const ObjectFile *DebugObj = DebugObjOwner.getBinary();
+  if (!DebugObj)
+    return;
+
+  MutexGuard Lock(ProfileMutex);
+  std::vector<uint64_t> &Addrs = ObjectFunctions[Obj.getData().data()];
+  for (const std::pair<SymbolRef, uint64_t> &P :
+       computeSymbolSizes(*DebugObj)) {
+    SymbolRef Sym = P.first;
+    Expected<SymbolRef::Type> TypeOrErr = Sym.getType();
+    if (!TypeOrErr) {
+      consumeError(TypeOrErr.takeError());
+      continue;
+    }
+    if (*TypeOrErr != SymbolRef::ST_Function || !P.second)
+      continue;
+
+    Expected<StringRef> NameOrErr = Sym.getName();
+    if (!NameOrErr) {
+      consumeError(NameOrErr.takeError());
+      continue;
+    }
+    Expected<uint64_t> AddrOrErr = Sym.getAddress();
+    if (!AddrOrErr) {
+      consumeError(AddrOrErr.takeError());
+      continue;
+    }
+
+    FunctionInfo &FI = Functions[*AddrOrErr];
+    FI = FunctionInfo();
+    FI.Name = *NameOrErr;
+    FI.Size = P.second;
+    FunctionAddrs[FI.Name] = *AddrOrErr;
+    Addrs.push_back(*AddrOrErr);
+  }
+}
+
+void JITSamplingProfiler::NotifyFreeingObject(const ObjectFile &Obj) {
+  MutexGuard Lock(ProfileMutex);
+  auto I = ObjectFunctions.find(Obj.getData().data());
+  if (I == ObjectFunctions.end())
+    return;
+  for (uint64_t Addr : I->second) {
+    auto FI = Functions.find(Addr);
+    if (FI == Functions.end())
+      continue;
+    auto NameI = FunctionAddrs.find(FI->second.Name);
+    if (NameI != FunctionAddrs.end() && NameI->second == Addr)
+      FunctionAddrs.erase(NameI);
+    Functions.erase(FI);
+  }
+  ObjectFunctions.erase(I);
+}
@@ -0,0 +1,235 @@
+//===- PooledMemoryManager.cpp - Pooled memory manager for RtDyld ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the pooled memory manager, which allocates the sections
+// of many small JITed objects out of a few large shared arenas.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/PooledMemoryManager.h"
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
+#include <algorithm>
+
+namespace llvm {
+
+JITMemoryPool::JITMemoryPool(const Options &Opts)
+    : Opts(Opts), CodeDualMapped(Opts.UseDualMapping) {
+  CodeMem.Permissions = sys::Memory::MF_READ | sys::Memory::MF_EXEC;
+  RODataMem.Permissions = sys::Memory::MF_READ;
+  RWDataMem.Permissions = sys::Memory::MF_READ | sys::Memory::MF_WRITE;
+}
+
+JITMemoryPool::~JITMemoryPool() {
+  for (Arena *A : {&CodeMem, &RODataMem, &RWDataMem}) {
+    for (Slab &S : A->Slabs) {
+      sys::Memory::releaseMappedMemory(S.Writable);
+      sys::Memory::releaseMappedMemory(S.Alias);
+    }
+  }
+}
+
+unsigned JITMemoryPool::getSizeClass(uintptr_t Size, unsigned Alignment) {
+  uintptr_t ClassSize =
+      PowerOf2Ceil(std::max<uintptr_t>(std::max<uintptr_t>(Size, Alignment),
+                                       MinClassSize));
+  return Log2_64(ClassSize / MinClassSize);
+}
+
+JITMemoryPool::Arena &JITMemoryPool::getArena(Purpose P) {
+  switch (P) {
+  case Purpose::Code:
+    return CodeMem;
+  case Purpose::ROData:
+    return RODataMem;
+  case Purpose::RWData:
+    return RWDataMem;
+  }
+  llvm_unreachable("Unknown memory purpose!");
+}
+
+bool JITMemoryPool::addSlab(Arena &A, uintptr_t MinSize) {
+  size_t Size = std::max<size_t>(Opts.SlabSize, MinSize);
+  unsigned HugeFlag = Opts.UseHugePages ? sys::Memory::MF_HUGE_HINT : 0;
+
+  Slab S;
+  std::error_code EC;
+  if (&A == &CodeMem && CodeDualMapped) {
+    EC = sys::Memory::allocateDualMappedMemory(Size, A.Permissions | HugeFlag,
+                                               S.Writable, S.Alias);
+    // Only give up on dual mapping before any code was written: code already
+    // handed out relies on it.
+    if (EC && !CodeMem.Slabs.empty())
+      return false;
+    if (EC)
+      CodeDualMapped = false;
+  }
+  if (!S.Writable.base()) {
+    S.Writable = sys::Memory::allocateMappedMemory(
+        Size, nullptr,
+        sys::Memory::MF_READ | sys::Memory::MF_WRITE | HugeFlag, EC);
+    if (EC)
+      return false;
+  }
+
+  // What is left of the current slab is abandoned, but what was allocated out
+  // of it still has to be finalized.
+  if (A.Cur != A.PendingBegin)
+    A.PendingMem.push_back(
+        sys::MemoryBlock((void *)A.PendingBegin, A.Cur - A.PendingBegin));
+
+  A.Slabs.push_back(S);
+  A.PendingBegin = A.Cur = (uintptr_t)S.Writable.base();
+  A.End = A.Cur + S.Writable.size();
+  return true;
+}
+
+uint8_t *JITMemoryPool::bumpAllocate(Arena &A, uintptr_t Size,
+                                     uintptr_t Alignment) {
+  uintptr_t Addr = alignTo(A.Cur, Alignment);
+  if (A.Slabs.empty() || Addr + Size > A.End) {
+    if (!addSlab(A, Size + Alignment))
+      return nullptr;
+    Addr = alignTo(A.Cur, Alignment);
+  }
+  A.Cur = Addr + Size;
+  return (uint8_t *)Addr;
+}
+
+uint8_t *JITMemoryPool::allocate(Purpose P, uintptr_t Size,
+                                 unsigned Alignment) {
+  if (!Alignment)
+    Alignment = 16;
+
+  assert(!(Alignment & (Alignment - 1)) && "Alignment must be a power of two.");
+
+  Arena &A = getArena(P);
+  if (P == Purpose::RWData) {
+    unsigned Class = getSizeClass(Size, Alignment);
+    if (Class < NumSizeClasses) {
+      if (!A.FreeBlocks[Class].empty())
+        return A.FreeBlocks[Class].pop_back_val();
+      uintptr_t ClassSize = MinClassSize << Class;
+      return bumpAllocate(A, ClassSize, ClassSize);
+    }
+  }
+  return bumpAllocate(A, Size, Alignment);
+}
+
+void JITMemoryPool::deallocate(Purpose P, uint8_t *Addr, uintptr_t Size,
+                               unsigned Alignment) {
+  if (P != Purpose::RWData || !Addr)
+    return;
+  if (!Alignment)
+    Alignment = 16;
+  unsigned Class = getSizeClass(Size, Alignment);
+  if (Class < NumSizeClasses)
+    RWDataMem.FreeBlocks[Class].push_back(Addr);
+}
+
+uint64_t JITMemoryPool::getExecutableAddress(const uint8_t *Addr) const {
+  uintptr_t A = (uintptr_t)Addr;
+  if (CodeDualMapped) {
+    for (const Slab &S : CodeMem.Slabs) {
+      uintptr_t Base = (uintptr_t)S.Writable.base();
+      if (A >= Base && A < Base + S.Writable.size())
+        return (uintptr_t)S.Alias.base() + (A - Base);
+    }
+  }
+  return A;
+}
+
+std::error_code JITMemoryPool::finalizeArena(Arena &A) {
+  if (A.Cur != A.PendingBegin)
+    A.PendingMem.push_back(
+        sys::MemoryBlock((void *)A.PendingBegin, A.Cur - A.PendingBegin));
+
+  if (&A == &CodeMem && CodeDualMapped) {
+    // The executable view is always executable; it only needs to see what was
+    // written through the other one.
+    for (sys::MemoryBlock &MB : A.PendingMem)
+      sys::Memory::InvalidateInstructionCache(
+          (void *)getExecutableAddress((const uint8_t *)MB.base()), MB.size());
+    A.PendingMem.clear();
+    A.PendingBegin = A.Cur;
+    return std::error_code();
+  }
+
+  for (sys::MemoryBlock &MB : A.PendingMem) {
+    ++NumProtectCalls;
+    if (std::error_code EC =
+            sys::Memory::protectMappedMemory(MB, A.Permissions))
+      return EC;
+  }
+  A.PendingMem.clear();
+
+  // The rest of the last protected page can't be written to anymore.
+  static const size_t PageSize = sys::Process::getPageSize();
+  if (!A.Slabs.empty())
+    A.Cur = std::min<uintptr_t>(alignTo(A.Cur, PageSize), A.End);
+  A.PendingBegin = A.Cur;
+  return std::error_code();
+}
+
+std::error_code JITMemoryPool::finalize() {
+  if (std::error_code EC = finalizeArena(CodeMem))
+    return EC;
+  return finalizeArena(RODataMem);
+}
+
+PooledMemoryManager::~PooledMemoryManager() {
+  for (RWDataBlock &B : RWDataBlocks)
+    Pool.deallocate(JITMemoryPool::Purpose::RWData, B.Addr, B.Size,
+                    B.Alignment);
+}
+
+uint8_t *PooledMemoryManager::allocateCodeSection(uintptr_t Size,
+                                                  unsigned Alignment,
+                                                  unsigned SectionID,
+                                                  StringRef SectionName) {
+  uint8_t *Addr =
+      Pool.allocate(JITMemoryPool::Purpose::Code, Size, Alignment);
+  if (Addr && Pool.isCodeDualMapped())
+    UnmappedCode.push_back(Addr);
+  return Addr;
+}
+
+uint8_t *PooledMemoryManager::allocateDataSection(uintptr_t Size,
+                                                  unsigned Alignment,
+                                                  unsigned SectionID,
+                                                  StringRef SectionName,
+                                                  bool IsReadOnly) {
+  if (IsReadOnly)
+    return Pool.allocate(JITMemoryPool::Purpose::ROData, Size, Alignment);
+
+  uint8_t *Addr =
+      Pool.allocate(JITMemoryPool::Purpose::RWData, Size, Alignment);
+  if (Addr)
+    RWDataBlocks.push_back({Addr, Size, Alignment});
+  return Addr;
+}
+
+void PooledMemoryManager::notifyObjectLoaded(RuntimeDyld &RTDyld,
+                                             const object::ObjectFile &Obj) {
+  for (uint8_t *Addr : UnmappedCode)
+    RTDyld.mapSectionAddress(Addr, Pool.getExecutableAddress(Addr));
+  UnmappedCode.clear();
+}
+
+bool PooledMemoryManager::finalizeMemory(std::string *ErrMsg) {
+  if (std::error_code EC = Pool.finalize()) {
+    if (ErrMsg)
+      *ErrMsg = EC.message();
+    return true;
+  }
+  return false;
+}
+
+} // namespace llvm
@@ -22,12 +22,21 @@
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/Parallel.h"
 
 using namespace llvm;
 using namespace llvm::object;
 
 #define DEBUG_TYPE "dyld"
 
+// Below this many relocations, resolving them on other threads costs more than
+// it saves.
+static const size_t MinConcurrentRelocations = 4096;
+
+// Relocations at addresses this far apart can be resolved on different
+// threads.
+static const unsigned ConcurrentRelocationChunkShift = 16;
+
 namespace {
 
 enum RuntimeDyldErrorCode {
@@ -127,19 +136,32 @@ void RuntimeDyldImpl::resolveRelocations() {
       dumpSectionMemory(Sections[i], "before relocations");
   );
 
-  // First, resolve relocations associated with external symbols.
-  resolveExternalSymbols();
-
-  // Iterate over all outstanding relocations
-  for (auto it = Relocations.begin(), e = Relocations.end(); it != e; ++it) {
-    // The Section here (Sections[i]) refers to the section in which the
-    // symbol for the relocation is located.  The SectionID in the relocation
-    // entry provides the section to which the relocation will be applied.
-    int Idx = it->first;
-    uint64_t Addr = Sections[Idx].getLoadAddress();
-    DEBUG(dbgs() << "Resolving relocations Section #" << Idx << "\t"
-                 << format("%p", (uintptr_t)Addr) << "\n");
-    resolveRelocationList(it->second, Addr);
+  size_t NumRelocations = 0;
+  for (const auto &Entry : ExternalSymbolRelocations)
+    NumRelocations += Entry.second.size();
+  for (const auto &Entry : Relocations)
+    NumRelocations += Entry.second.size();
+
+  // Resolving relocations concurrently would interleave the debug output.
+  if (LLVM_ENABLE_THREADS && !DebugFlag &&
+      NumRelocations >= MinConcurrentRelocations &&
+      canResolveRelocationsConcurrently()) {
+    resolveRelocationsConcurrently();
+  } else {
+    // First, resolve relocations associated with external symbols.
+    resolveExternalSymbols();
+
+    // Iterate over all outstanding relocations
+    for (auto it = Relocations.begin(), e = Relocations.end(); it != e; ++it) {
+      // The Section here (Sections[i]) refers to the section in which the
+      // symbol for the relocation is located.  The SectionID in the relocation
+      // entry provides the section to which the relocation will be applied.
+      int Idx = it->first;
+      uint64_t Addr = Sections[Idx].getLoadAddress();
+      DEBUG(dbgs() << "Resolving relocations Section #" << Idx << "\t"
+                   << format("%p", (uintptr_t)Addr) << "\n");
+      resolveRelocationList(it->second, Addr);
+    }
   }
   Relocations.clear();
 
@@ -309,6 +331,7 @@ RuntimeDyldImpl::loadObjectImpl(const object::ObjectFile &Obj) {
 
   // Parse and process relocations
   DEBUG(dbgs() << "Parse relocations:\n");
+  ObjSymbolEntries.clear();
   for (section_iterator SI = Obj.section_begin(), SE = Obj.section_end();
        SI != SE; ++SI) {
     StubMap Stubs;
@@ -344,6 +367,7 @@ RuntimeDyldImpl::loadObjectImpl(const object::ObjectFile &Obj) {
     if (Checker)
       Checker->registerStubMap(Obj.getFileName(), SectionID, Stubs);
   }
+  ObjSymbolEntries.clear();
 
   // Give the subclasses a chance to tie-up any loose ends.
   if (auto Err = finalizeLoad(Obj, LocalSections))
@@ -953,7 +977,63 @@ void RuntimeDyldImpl::resolveRelocationList(const RelocationList &Relocs,
   }
 }
 
-void RuntimeDyldImpl::resolveExternalSymbols() {
+void RuntimeDyldImpl::resolveRelocationsConcurrently() {
+  // Look up the external symbols first, as the resolver may load more objects.
+  std::vector<std::pair<RelocationList, uint64_t>> ExternalRelocations;
+  resolveExternalSymbols(&ExternalRelocations);
+
+  // Split the relocations by the section and the chunk of it they apply to,
+  // keeping the order in which resolveRelocations would apply them, and
+  // resolve the chunks in parallel.
+  typedef std::vector<std::pair<const RelocationEntry *, uint64_t>> Chunk;
+  std::vector<Chunk> Chunks;
+  DenseMap<std::pair<unsigned, uint64_t>, unsigned> ChunkIndices;
+  auto AddRelocationList = [&](const RelocationList &Relocs, uint64_t Value) {
+    for (const RelocationEntry &RE : Relocs) {
+      // Ignore relocations for sections that were not loaded
+      if (Sections[RE.SectionID].getAddress() == nullptr)
+        continue;
+      auto Key = std::make_pair(RE.SectionID,
+                                RE.Offset >> ConcurrentRelocationChunkShift);
+      auto Inserted = ChunkIndices.insert(std::make_pair(Key, Chunks.size()));
+      if (Inserted.second)
+        Chunks.emplace_back();
+      Chunks[Inserted.first->second].push_back(std::make_pair(&RE, Value));
+    }
+  };
+  for (const auto &Entry : ExternalRelocations)
+    AddRelocationList(Entry.first, Entry.second);
+  for (const auto &Entry : Relocations)
+    AddRelocationList(Entry.second, Sections[Entry.first].getLoadAddress());
+
+#if LLVM_ENABLE_THREADS
+  parallel::for_each(parallel::par, Chunks.begin(), Chunks.end(),
+                     [this](const Chunk &C) {
+                       for (const auto &R : C)
+                         resolveRelocation(*R.first, R.second);
+                     });
+#else
+  for (const Chunk &C : Chunks)
+    for (const auto &R : C)
+      resolveRelocation(*R.first, R.second);
+#endif
+}
+
+const SymbolTableEntry *
+RuntimeDyldImpl::lookupObjSymbol(const SymbolRef &Sym, StringRef Name) {
+  DataRefImpl Ref = Sym.getRawDataRefImpl();
+  auto Inserted = ObjSymbolEntries.insert(
+      std::make_pair(std::make_pair(Ref.d.a, Ref.d.b), nullptr));
+  if (Inserted.second) {
+    RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(Name);
+    if (Loc != GlobalSymbolTable.end())
+      Inserted.first->second = &Loc->second;
+  }
+  return Inserted.first->second;
+}
+
+void RuntimeDyldImpl::resolveExternalSymbols(
+    std::vector<std::pair<RelocationList, uint64_t>> *Resolved) {
   while (!ExternalSymbolRelocations.empty()) {
     StringMap<RelocationList>::iterator i = ExternalSymbolRelocations.begin();
 
@@ -963,7 +1043,10 @@ void RuntimeDyldImpl::resolveExternalSymbols() {
       DEBUG(dbgs() << "Resolving absolute relocations."
                    << "\n");
       RelocationList &Relocs = i->second;
-      resolveRelocationList(Relocs, 0);
+      if (Resolved)
+        Resolved->emplace_back(std::move(Relocs), 0);
+      else
+        resolveRelocationList(Relocs, 0);
     } else {
       uint64_t Addr = 0;
       RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(Name);
@@ -1003,7 +1086,10 @@ void RuntimeDyldImpl::resolveExternalSymbols() {
         // This list may have been updated when we called getSymbolAddress, so
         // don't change this code to get the list earlier.
         RelocationList &Relocs = i->second;
-        resolveRelocationList(Relocs, Addr);
+        if (Resolved)
+          Resolved->emplace_back(std::move(Relocs), Addr);
+        else
+          resolveRelocationList(Relocs, Addr);
       }
     }
 
@@ -1076,9 +1076,9 @@ RuntimeDyldELF::processRelocationRef(
   SymbolRef::Type SymType = SymbolRef::ST_Unknown;
 
   // Search for the symbol in the global symbol table
-  RTDyldSymbolTable::const_iterator gsi = GlobalSymbolTable.end();
+  const SymbolTableEntry *GlobalSym = nullptr;
   if (Symbol != Obj.symbol_end()) {
-    gsi = GlobalSymbolTable.find(TargetName.data());
+    GlobalSym = lookupObjSymbol(*Symbol, TargetName);
     Expected<SymbolRef::Type> SymTypeOrErr = Symbol->getType();
     if (!SymTypeOrErr) {
       std::string Buf;
@@ -1089,8 +1089,8 @@ RuntimeDyldELF::processRelocationRef(
     }
     SymType = *SymTypeOrErr;
   }
-  if (gsi != GlobalSymbolTable.end()) {
-    const auto &SymInfo = gsi->second;
+  if (GlobalSym) {
+    const auto &SymInfo = *GlobalSym;
     Value.SectionID = SymInfo.getSectionID();
     Value.Offset = SymInfo.getOffset();
     Value.Addend = SymInfo.getOffset() + Addend;
@@ -159,6 +159,11 @@ private:
   bool relocationNeedsGot(const RelocationRef &R) const override;
   bool relocationNeedsStub(const RelocationRef &R) const override;
 
+  bool canResolveRelocationsConcurrently() const override {
+    return Arch == Triple::x86_64 || Arch == Triple::x86 ||
+           Arch == Triple::aarch64 || Arch == Triple::aarch64_be;
+  }
+
 public:
   RuntimeDyldELF(RuntimeDyld::MemoryManager &MemMgr,
                  JITSymbolResolver &Resolver);
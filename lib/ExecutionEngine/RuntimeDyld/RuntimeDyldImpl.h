@@ -14,6 +14,7 @@
 #ifndef LLVM_LIB_EXECUTIONENGINE_RUNTIMEDYLD_RUNTIMEDYLDIMPL_H
 #define LLVM_LIB_EXECUTIONENGINE_RUNTIMEDYLD_RUNTIMEDYLDIMPL_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Triple.h"
@@ -284,6 +285,12 @@ protected:
   // modules.  This map is indexed by symbol name.
   StringMap<RelocationList> ExternalSymbolRelocations;
 
+  // The GlobalSymbolTable entries of the symbols of the object being loaded,
+  // or null for symbols that are not in the table, by the raw reference of the
+  // symbol. Relocations tend to refer to the same symbols over and over, and
+  // this saves hashing their names every time.
+  DenseMap<std::pair<uint32_t, uint32_t>, const SymbolTableEntry *>
+      ObjSymbolEntries;
 
   typedef std::map<RelocationValueRef, uintptr_t> StubMap;
 
@@ -402,6 +409,20 @@ protected:
   /// \brief Resolves relocations from Relocs list with address from Value.
   void resolveRelocationList(const RelocationList &Relocs, uint64_t Value);
 
+  /// \brief Resolves all outstanding relocations, applying the relocations of
+  ///        different parts of the sections on different threads.
+  void resolveRelocationsConcurrently();
+
+  /// \brief Return true if resolveRelocation only ever writes to the bytes
+  ///        being relocated, so that relocations at different places can be
+  ///        resolved at the same time.
+  virtual bool canResolveRelocationsConcurrently() const { return false; }
+
+  /// \brief Return the GlobalSymbolTable entry for the symbol Sym of the
+  ///        object being loaded, named Name, or null if there is none.
+  const SymbolTableEntry *lookupObjSymbol(const SymbolRef &Sym,
+                                          StringRef Name);
+
   /// \brief A object file specific relocation resolver
   /// \param RE The relocation to be resolved
   /// \param Value Target symbol address to apply the relocation action
@@ -416,8 +437,11 @@ protected:
                        const ObjectFile &Obj, ObjSectionToIDMap &ObjSectionToID,
                        StubMap &Stubs) = 0;
 
-  /// \brief Resolve relocations to external symbols.
-  void resolveExternalSymbols();
+  /// \brief Resolve relocations to external symbols. If Resolved is not null,
+  ///        the relocation lists are moved there with the addresses of their
+  ///        symbols instead of being resolved.
+  void resolveExternalSymbols(
+      std::vector<std::pair<RelocationList, uint64_t>> *Resolved = nullptr);
 
   // \brief Compute an upper bound of the memory that is required to load all
   // sections
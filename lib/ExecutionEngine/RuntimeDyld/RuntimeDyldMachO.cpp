@@ -110,10 +110,9 @@ RuntimeDyldMachO::getRelocationValueRef(
       TargetName = *TargetNameOrErr;
     else
       return TargetNameOrErr.takeError();
-    RTDyldSymbolTable::const_iterator SI =
-      GlobalSymbolTable.find(TargetName.data());
-    if (SI != GlobalSymbolTable.end()) {
-      const auto &SymInfo = SI->second;
+    if (const SymbolTableEntry *GlobalSym =
+            lookupObjSymbol(*Symbol, TargetName)) {
+      const auto &SymInfo = *GlobalSym;
       Value.SectionID = SymInfo.getSectionID();
       Value.Offset = SymInfo.getOffset() + RE.Addend;
     } else {
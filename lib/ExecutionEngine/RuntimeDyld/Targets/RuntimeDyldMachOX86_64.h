@@ -84,6 +84,8 @@ public:
     return ++RelI;
   }
 
+  bool canResolveRelocationsConcurrently() const override { return true; }
+
   void resolveRelocation(const RelocationEntry &RE, uint64_t Value) override {
     DEBUG(dumpRelocationToResolve(RE, Value));
     const SectionEntry &Section = Sections[RE.SectionID];
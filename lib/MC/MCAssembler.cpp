@@ -37,6 +37,7 @@
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
@@ -68,6 +69,8 @@ STATISTIC(FragmentLayouts, "Number of fragment layouts");
 STATISTIC(ObjectBytes, "Number of emitted object file bytes");
 STATISTIC(RelaxationSteps, "Number of assembler layout and relaxation steps");
 STATISTIC(RelaxedInstructions, "Number of relaxed instructions");
+STATISTIC(SkippedRelaxations,
+          "Number of fragment relaxation checks skipped as unchanged");
 
 } // end namespace stats
 } // end anonymous namespace
@@ -102,6 +105,7 @@ void MCAssembler::reset() {
   SubsectionsViaSymbols = false;
   IncrementalLinkerCompatible = false;
   ELFHeaderEFlags = 0;
+  RelaxStates.clear();
   LOHContainer.reset();
   VersionMinInfo.Major = 0;
 
@@ -692,10 +696,25 @@ void MCAssembler::layout(MCAsmLayout &Layout) {
       Frag.setLayoutOrder(FragmentIndex++);
   }
 
+  // Record what the relaxation of each fragment depends on. The size of an
+  // org fragment may depend on any offset, so the sections with one are
+  // always fully re-evaluated.
+  RelaxStates.assign(Layout.getSectionOrder().size(), SectionRelaxState());
+  for (MCSection *Sec : Layout.getSectionOrder()) {
+    if (any_of(*Sec, [](const MCFragment &F) { return isa<MCOrgFragment>(F); }))
+      continue;
+    std::vector<unsigned> &Reach = RelaxStates[Sec->getLayoutOrder()].Reach;
+    for (const MCFragment &Frag : *Sec)
+      Reach.push_back(computeRelaxationReach(Frag));
+  }
+
   // Layout until everything fits.
   while (layoutOnce(Layout))
-    if (getContext().hadError())
+    if (getContext().hadError()) {
+      RelaxStates.clear();
       return;
+    }
+  RelaxStates.clear();
 
   DEBUG_WITH_TYPE("mc-dump", {
       errs() << "assembler backend - post-relaxation\n--\n";
@@ -886,15 +905,83 @@ bool MCAssembler::relaxCVDefRange(MCAsmLayout &Layout,
   return OldSize != F.getContents().size();
 }
 
+/// Return the last layout order in \p Sec that evaluating \p E depends on, or
+/// ~0U if it may depend on anything outside of \p Sec.
+static unsigned getExprReach(const MCExpr &E, const MCSection &Sec) {
+  switch (E.getKind()) {
+  case MCExpr::Constant:
+    return 0;
+  case MCExpr::SymbolRef: {
+    const MCSymbol &Sym = cast<MCSymbolRefExpr>(E).getSymbol();
+    if (Sym.isVariable() || !Sym.isInSection(/*SetUsed=*/false))
+      return ~0U;
+    const MCFragment *F = Sym.getFragment(/*SetUsed=*/false);
+    return F->getParent() == &Sec ? F->getLayoutOrder() : ~0U;
+  }
+  case MCExpr::Unary:
+    return getExprReach(*cast<MCUnaryExpr>(E).getSubExpr(), Sec);
+  case MCExpr::Binary: {
+    const MCBinaryExpr &BE = cast<MCBinaryExpr>(E);
+    return std::max(getExprReach(*BE.getLHS(), Sec),
+                    getExprReach(*BE.getRHS(), Sec));
+  }
+  case MCExpr::Target:
+    return ~0U;
+  }
+  llvm_unreachable("Invalid assembly expression kind!");
+}
+
+unsigned MCAssembler::computeRelaxationReach(const MCFragment &F) const {
+  const MCSection &Sec = *F.getParent();
+  unsigned Reach = F.getLayoutOrder();
+  switch (F.getKind()) {
+  default:
+    return ~0U;
+  case MCFragment::FT_Relaxable:
+    for (const MCFixup &Fixup : cast<MCRelaxableFragment>(F).getFixups())
+      Reach = std::max(Reach, getExprReach(*Fixup.getValue(), Sec));
+    return Reach;
+  case MCFragment::FT_Dwarf:
+    return std::max(
+        Reach, getExprReach(cast<MCDwarfLineAddrFragment>(F).getAddrDelta(),
+                            Sec));
+  case MCFragment::FT_DwarfFrame:
+    return std::max(
+        Reach, getExprReach(cast<MCDwarfCallFrameFragment>(F).getAddrDelta(),
+                            Sec));
+  case MCFragment::FT_LEB:
+    return std::max(Reach,
+                    getExprReach(cast<MCLEBFragment>(F).getValue(), Sec));
+  }
+}
+
 bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec) {
+  SectionRelaxState &State = RelaxStates[Sec.getLayoutOrder()];
+
   // Holds the first fragment which needed relaxing during this layout. It will
   // remain NULL if none were relaxed.
   // When a fragment is relaxed, all the fragments following it should get
   // invalidated because their offset is going to change.
   MCFragment *FirstRelaxedFragment = nullptr;
 
+  // Check everything again after an error, so that it's reported each time.
+  bool CanSkip = !State.Reach.empty() && !getContext().hadError();
+
   // Attempt to relax all the fragments in the section.
   for (MCSection::iterator I = Sec.begin(), IE = Sec.end(); I != IE; ++I) {
+    // Until something is relaxed in this pass, a fragment that, with all it
+    // depends on, precedes the first fragment that changed size in the
+    // previous pass sees the same offsets as when it was last checked. If
+    // they are laid out already, checking it again has no effect.
+    if (CanSkip && !FirstRelaxedFragment) {
+      unsigned Reach = State.Reach[I->getLayoutOrder()];
+      if (Reach < State.FirstChanged &&
+          Reach < Layout.getNumValidFragments(&Sec)) {
+        ++stats::SkippedRelaxations;
+        continue;
+      }
+    }
+
     // Check if this is a fragment that needs relaxation.
     bool RelaxedFrag = false;
     switch(I->getKind()) {
@@ -904,6 +991,8 @@ bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec) {
       assert(!getRelaxAll() &&
              "Did not expect a MCRelaxableFragment in RelaxAll mode");
       RelaxedFrag = relaxInstruction(Layout, *cast<MCRelaxableFragment>(I));
+      if (RelaxedFrag && !State.Reach.empty())
+        State.Reach[I->getLayoutOrder()] = computeRelaxationReach(*I);
       break;
     case MCFragment::FT_Dwarf:
       RelaxedFrag = relaxDwarfLineAddr(Layout,
@@ -928,6 +1017,8 @@ bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec) {
     if (RelaxedFrag && !FirstRelaxedFragment)
       FirstRelaxedFragment = &*I;
   }
+  State.FirstChanged =
+      FirstRelaxedFragment ? FirstRelaxedFragment->getLayoutOrder() : ~0U;
   if (FirstRelaxedFragment) {
     Layout.invalidateFragmentsFrom(FirstRelaxedFragment);
     return true;
@@ -80,6 +80,11 @@ uint64_t MCAsmLayout::getFragmentOffset(const MCFragment *F) const {
   return F->Offset;
 }
 
+unsigned MCAsmLayout::getNumValidFragments(const MCSection *Sec) const {
+  const MCFragment *LastValid = LastValidFragment.lookup(Sec);
+  return LastValid ? LastValid->getLayoutOrder() + 1 : 0;
+}
+
 // Simple getSymbolOffset helper for the non-varibale case.
 static bool getLabelOffset(const MCAsmLayout &Layout, const MCSymbol &S,
                            bool ReportError, uint64_t &Val) {
@@ -971,20 +971,24 @@ uint32_t Archive::getNumberOfSymbols() const {
   return read32le(buf);
 }
 
+void Archive::buildSymbolMap() const {
+  SymbolMap.reserve(getNumberOfSymbols());
+  // Keep the first symbol with each name, which is the one a scan of the
+  // symbol table would find.
+  for (const Symbol &Sym : symbols())
+    SymbolMap.insert(std::make_pair(Sym.getName(), Sym));
+}
+
 Expected<Optional<Archive::Child>> Archive::findSym(StringRef name) const {
-  Archive::symbol_iterator bs = symbol_begin();
-  Archive::symbol_iterator es = symbol_end();
-
-  for (; bs != es; ++bs) {
-    StringRef SymName = bs->getName();
-    if (SymName == name) {
-      if (auto MemberOrErr = bs->getMember())
-        return Child(*MemberOrErr);
-      else
-        return MemberOrErr.takeError();
-    }
-  }
-  return Optional<Child>();
+  llvm::call_once(SymbolMapFlag, [this] { buildSymbolMap(); });
+
+  auto It = SymbolMap.find(name);
+  if (It == SymbolMap.end())
+    return Optional<Child>();
+  if (auto MemberOrErr = It->second.getMember())
+    return Child(*MemberOrErr);
+  else
+    return MemberOrErr.takeError();
 }
 
 // Returns true if archive file contains no member file.
@@ -10,7 +10,6 @@
 #include "llvm/Object/Decompressor.h"
 #include "llvm/BinaryFormat/ELF.h"
 #include "llvm/Object/ELFObjectFile.h"
-#include "llvm/Support/Compression.h"
 #include "llvm/Support/DataExtractor.h"
 #include "llvm/Support/Endian.h"
 
@@ -20,14 +19,15 @@ using namespace object;
 
 Expected<Decompressor> Decompressor::create(StringRef Name, StringRef Data,
                                             bool IsLE, bool Is64Bit) {
-  if (!zlib::isAvailable())
-    return createError("zlib is not available");
-
   Decompressor D(Data);
-  Error Err = isGnuStyle(Name) ? D.consumeCompressedGnuHeader()
-                               : D.consumeCompressedZLibHeader(Is64Bit, IsLE);
+  Error Err = isGnuStyle(Name)
+                  ? D.consumeCompressedGnuHeader()
+                  : D.consumeCompressedSectionHeader(Is64Bit, IsLE);
   if (Err)
     return std::move(Err);
+  if (!compression::isAvailable(D.Format))
+    return createError(
+        (compression::getName(D.Format) + " is not available").str());
   return D;
 }
 
@@ -49,8 +49,8 @@ Error Decompressor::consumeCompressedGnuHeader() {
   return Error::success();
 }
 
-Error Decompressor::consumeCompressedZLibHeader(bool Is64Bit,
-                                                bool IsLittleEndian) {
+Error Decompressor::consumeCompressedSectionHeader(bool Is64Bit,
+                                                   bool IsLittleEndian) {
   using namespace ELF;
   uint64_t HdrSize = Is64Bit ? sizeof(Elf64_Chdr) : sizeof(Elf32_Chdr);
   if (SectionData.size() < HdrSize)
@@ -58,10 +58,17 @@ Error Decompressor::consumeCompressedZLibHeader(bool Is64Bit,
 
   DataExtractor Extractor(SectionData, IsLittleEndian, 0);
   uint32_t Offset = 0;
-  if (Extractor.getUnsigned(&Offset, Is64Bit ? sizeof(Elf64_Word)
-                                             : sizeof(Elf32_Word)) !=
-      ELFCOMPRESS_ZLIB)
+  switch (Extractor.getUnsigned(&Offset, Is64Bit ? sizeof(Elf64_Word)
+                                                 : sizeof(Elf32_Word))) {
+  case ELFCOMPRESS_ZLIB:
+    Format = compression::Format::Zlib;
+    break;
+  case ELFCOMPRESS_ZSTD:
+    Format = compression::Format::Zstd;
+    break;
+  default:
     return createError("unsupported compression type");
+  }
 
   // Skip Elf64_Chdr::ch_reserved field.
   if (Is64Bit)
@@ -90,5 +97,5 @@ bool Decompressor::isCompressedELFSection(uint64_t Flags, StringRef Name) {
 
 Error Decompressor::decompress(MutableArrayRef<char> Buffer) {
   size_t Size = Buffer.size();
-  return zlib::uncompress(SectionData, Buffer.data(), Size);
+  return compression::uncompress(Format, SectionData, Buffer.data(), Size);
 }
@@ -14,6 +14,7 @@
 #include "llvm/Support/Compression.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
 #include "llvm/Config/config.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Error.h"
@@ -21,13 +22,20 @@
 #if LLVM_ENABLE_ZLIB == 1 && HAVE_ZLIB_H
 #include <zlib.h>
 #endif
+#if LLVM_ENABLE_ZSTD == 1 && HAVE_ZSTD_H
+#include <zstd.h>
+#endif
 
 using namespace llvm;
 
-#if LLVM_ENABLE_ZLIB == 1 && HAVE_LIBZ
-static Error createError(StringRef Err) {
+#if (LLVM_ENABLE_ZLIB == 1 && HAVE_LIBZ) ||                                    \
+    (LLVM_ENABLE_ZSTD == 1 && HAVE_LIBZSTD)
+static Error createError(const Twine &Err) {
   return make_error<StringError>(Err, inconvertibleErrorCode());
 }
+#endif
+
+#if LLVM_ENABLE_ZLIB == 1 && HAVE_LIBZ
 
 static int encodeZlibCompressionLevel(zlib::CompressionLevel Level) {
   switch (Level) {
@@ -119,3 +127,123 @@ uint32_t zlib::crc32(StringRef Buffer) {
 }
 #endif
 
+#if LLVM_ENABLE_ZSTD == 1 && HAVE_LIBZSTD
+static int encodeZstdCompressionLevel(zstd::CompressionLevel Level) {
+  switch (Level) {
+    case zstd::BestSpeedCompression: return 1;
+    case zstd::DefaultCompression: return ZSTD_CLEVEL_DEFAULT;
+    case zstd::BestSizeCompression: return 19;
+  }
+  llvm_unreachable("Invalid zstd::CompressionLevel!");
+}
+
+bool zstd::isAvailable() { return true; }
+
+Error zstd::compress(StringRef InputBuffer,
+                     SmallVectorImpl<char> &CompressedBuffer,
+                     CompressionLevel Level) {
+  size_t CompressedBufferSize = ::ZSTD_compressBound(InputBuffer.size());
+  CompressedBuffer.resize(CompressedBufferSize);
+  size_t CompressedSize =
+      ::ZSTD_compress(CompressedBuffer.data(), CompressedBufferSize,
+                      InputBuffer.data(), InputBuffer.size(),
+                      encodeZstdCompressionLevel(Level));
+  if (::ZSTD_isError(CompressedSize))
+    return createError(Twine("zstd error: ") +
+                       ::ZSTD_getErrorName(CompressedSize));
+  // Tell MemorySanitizer that zstd output buffer is fully initialized.
+  // This avoids a false report when running LLVM with uninstrumented zstd.
+  __msan_unpoison(CompressedBuffer.data(), CompressedSize);
+  CompressedBuffer.resize(CompressedSize);
+  return Error::success();
+}
+
+Error zstd::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                       size_t &UncompressedSize) {
+  size_t Res = ::ZSTD_decompress(UncompressedBuffer, UncompressedSize,
+                                 InputBuffer.data(), InputBuffer.size());
+  if (::ZSTD_isError(Res))
+    return createError(Twine("zstd error: ") + ::ZSTD_getErrorName(Res));
+  UncompressedSize = Res;
+  // Tell MemorySanitizer that zstd output buffer is fully initialized.
+  // This avoids a false report when running LLVM with uninstrumented zstd.
+  __msan_unpoison(UncompressedBuffer, UncompressedSize);
+  return Error::success();
+}
+
+Error zstd::uncompress(StringRef InputBuffer,
+                       SmallVectorImpl<char> &UncompressedBuffer,
+                       size_t UncompressedSize) {
+  UncompressedBuffer.resize(UncompressedSize);
+  Error E =
+      uncompress(InputBuffer, UncompressedBuffer.data(), UncompressedSize);
+  UncompressedBuffer.resize(UncompressedSize);
+  return E;
+}
+
+#else
+bool zstd::isAvailable() { return false; }
+Error zstd::compress(StringRef InputBuffer,
+                     SmallVectorImpl<char> &CompressedBuffer,
+                     CompressionLevel Level) {
+  llvm_unreachable("zstd::compress is unavailable");
+}
+Error zstd::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                       size_t &UncompressedSize) {
+  llvm_unreachable("zstd::uncompress is unavailable");
+}
+Error zstd::uncompress(StringRef InputBuffer,
+                       SmallVectorImpl<char> &UncompressedBuffer,
+                       size_t UncompressedSize) {
+  llvm_unreachable("zstd::uncompress is unavailable");
+}
+#endif
+
+StringRef compression::getName(Format F) {
+  switch (F) {
+  case Format::Zlib: return "zlib";
+  case Format::Zstd: return "zstd";
+  }
+  llvm_unreachable("Invalid compression::Format!");
+}
+
+bool compression::isAvailable(Format F) {
+  switch (F) {
+  case Format::Zlib: return zlib::isAvailable();
+  case Format::Zstd: return zstd::isAvailable();
+  }
+  llvm_unreachable("Invalid compression::Format!");
+}
+
+Error compression::compress(Format F, StringRef InputBuffer,
+                            SmallVectorImpl<char> &CompressedBuffer) {
+  switch (F) {
+  case Format::Zlib: return zlib::compress(InputBuffer, CompressedBuffer);
+  case Format::Zstd: return zstd::compress(InputBuffer, CompressedBuffer);
+  }
+  llvm_unreachable("Invalid compression::Format!");
+}
+
+Error compression::uncompress(Format F, StringRef InputBuffer,
+                              char *UncompressedBuffer,
+                              size_t &UncompressedSize) {
+  switch (F) {
+  case Format::Zlib:
+    return zlib::uncompress(InputBuffer, UncompressedBuffer, UncompressedSize);
+  case Format::Zstd:
+    return zstd::uncompress(InputBuffer, UncompressedBuffer, UncompressedSize);
+  }
+  llvm_unreachable("Invalid compression::Format!");
+}
+
+Error compression::uncompress(Format F, StringRef InputBuffer,
+                              SmallVectorImpl<char> &UncompressedBuffer,
+                              size_t UncompressedSize) {
+  switch (F) {
+  case Format::Zlib:
+    return zlib::uncompress(InputBuffer, UncompressedBuffer, UncompressedSize);
+  case Format::Zstd:
+    return zstd::uncompress(InputBuffer, UncompressedBuffer, UncompressedSize);
+  }
+  llvm_unreachable("Invalid compression::Format!");
+}
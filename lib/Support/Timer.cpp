@@ -20,8 +20,11 @@
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Support/raw_ostream.h"
+#include <limits>
+#include <mutex>
 using namespace llvm;
 
 // This ugly hack is brought to you courtesy of constructor/destructor ordering
@@ -48,6 +51,18 @@ namespace {
   InfoOutputFilename("info-output-file", cl::value_desc("filename"),
                      cl::desc("File to append -stats and -timer output to"),
                    cl::Hidden, cl::location(getLibSupportInfoOutputFilename()));
+
+  static cl::opt<bool>
+  FastTimers("fast-timers",
+             cl::desc("Only measure wall time in timers, with a monotonic "
+                      "clock instead of getrusage"),
+             cl::Hidden);
+
+  static cl::opt<std::string>
+  TraceOutputFilename("timer-trace-file", cl::value_desc("filename"),
+                      cl::desc("Write the regions measured by timers to this "
+                               "file as Chrome trace events"),
+                      cl::Hidden);
 }
 
 std::unique_ptr<raw_fd_ostream> llvm::CreateInfoOutputFile() {
@@ -82,6 +97,130 @@ struct CreateDefaultTimerGroup {
 static ManagedStatic<TimerGroup, CreateDefaultTimerGroup> DefaultTimerGroup;
 static TimerGroup *getDefaultTimerGroup() { return &*DefaultTimerGroup; }
 
+//===----------------------------------------------------------------------===//
+//   Trace Event Implementation
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// A region measured by a timer.  Times are wall times in seconds.
+struct TraceEvent {
+  unsigned NameID;
+  double Start;
+  double End;
+};
+
+/// The events recorded by one thread.  The lock is only contended while the
+/// trace is being printed.
+struct TraceBuffer {
+  std::mutex Lock;
+  uint64_t ThreadID;
+  std::vector<TraceEvent> Events;
+};
+
+class TraceRecorder {
+  sys::SmartMutex<true> Lock;
+  /// The description and group name of each timer, indexed by NameID - 1.
+  std::vector<std::pair<std::string, std::string>> Names;
+  StringMap<unsigned> NameIDs;
+  std::vector<std::unique_ptr<TraceBuffer>> Buffers;
+
+public:
+  ~TraceRecorder();
+
+  unsigned getNameID(StringRef Description, StringRef GroupName);
+  TraceBuffer &getThreadBuffer();
+  void print(raw_ostream &OS);
+};
+
+} // end anonymous namespace
+
+static ManagedStatic<TraceRecorder> Trace;
+
+/// The buffer of the current thread.  Buffers are owned by Trace and live as
+/// long as it does.
+static LLVM_THREAD_LOCAL TraceBuffer *ThreadTraceBuffer = nullptr;
+
+TraceRecorder::~TraceRecorder() {
+  ThreadTraceBuffer = nullptr;
+  if (TraceOutputFilename.empty())
+    return;
+  std::error_code EC;
+  raw_fd_ostream OS(TraceOutputFilename, EC, sys::fs::F_Text);
+  if (EC) {
+    errs() << "Error opening timer-trace-file '" << TraceOutputFilename
+           << "': " << EC.message() << '\n';
+    return;
+  }
+  print(OS);
+}
+
+unsigned TraceRecorder::getNameID(StringRef Description, StringRef GroupName) {
+  sys::SmartScopedLock<true> L(Lock);
+  unsigned &ID = NameIDs[(GroupName + Twine('\0') + Description).str()];
+  if (!ID) {
+    Names.emplace_back(Description, GroupName);
+    ID = Names.size();
+  }
+  return ID;
+}
+
+TraceBuffer &TraceRecorder::getThreadBuffer() {
+  if (!ThreadTraceBuffer) {
+    sys::SmartScopedLock<true> L(Lock);
+    Buffers.push_back(llvm::make_unique<TraceBuffer>());
+    Buffers.back()->ThreadID = get_threadid();
+    ThreadTraceBuffer = Buffers.back().get();
+  }
+  return *ThreadTraceBuffer;
+}
+
+static void printJSONString(raw_ostream &OS, StringRef S) {
+  OS << '"';
+  for (unsigned char C : S) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+void TraceRecorder::print(raw_ostream &OS) {
+  sys::SmartScopedLock<true> L(Lock);
+
+  // Timestamps are relative to the first recorded event.
+  double Base = std::numeric_limits<double>::max();
+  for (auto &Buffer : Buffers) {
+    std::lock_guard<std::mutex> BL(Buffer->Lock);
+    for (const TraceEvent &E : Buffer->Events)
+      Base = std::min(Base, E.Start);
+  }
+
+  OS << "{\"traceEvents\":[";
+  const char *Delim = "\n";
+  for (auto &Buffer : Buffers) {
+    std::lock_guard<std::mutex> BL(Buffer->Lock);
+    for (const TraceEvent &E : Buffer->Events) {
+      const auto &Name = Names[E.NameID - 1];
+      OS << Delim << "{\"name\":";
+      printJSONString(OS, Name.first);
+      OS << ",\"cat\":";
+      printJSONString(OS, Name.second);
+      OS << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << Buffer->ThreadID
+         << format(",\"ts\":%.3f,\"dur\":%.3f}", (E.Start - Base) * 1e6,
+                   (E.End - E.Start) * 1e6);
+      Delim = ",\n";
+    }
+    Buffer->Events.clear();
+  }
+  OS << "\n]}\n";
+}
+
+void TimerGroup::printAllTraceEvents(raw_ostream &OS) { Trace->print(OS); }
+
 //===----------------------------------------------------------------------===//
 // Timer Implementation
 //===----------------------------------------------------------------------===//
@@ -95,6 +234,7 @@ void Timer::init(StringRef Name, StringRef Description, TimerGroup &tg) {
   this->Name.assign(Name.begin(), Name.end());
   this->Description.assign(Description.begin(), Description.end());
   Running = Triggered = false;
+  TraceNameID = 0;
   TG = &tg;
   TG->addTimer(*this);
 }
@@ -112,6 +252,19 @@ static inline size_t getMemUsage() {
 TimeRecord TimeRecord::getCurrentTime(bool Start) {
   using Seconds = std::chrono::duration<double, std::ratio<1>>;
   TimeRecord Result;
+
+  if (FastTimers) {
+    // steady_clock is read from the vDSO on most systems, while getrusage is a
+    // real system call.
+    if (Start)
+      Result.MemUsed = getMemUsage();
+    Result.WallTime =
+        Seconds(std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (!Start)
+      Result.MemUsed = getMemUsage();
+    return Result;
+  }
+
   sys::TimePoint<> now;
   std::chrono::nanoseconds user, sys;
 
@@ -138,7 +291,16 @@ void Timer::startTimer() {
 void Timer::stopTimer() {
   assert(Running && "Cannot stop a paused timer");
   Running = false;
-  Time += TimeRecord::getCurrentTime(false);
+  TimeRecord Now = TimeRecord::getCurrentTime(false);
+  if (!TraceOutputFilename.empty()) {
+    if (!TraceNameID)
+      TraceNameID = Trace->getNameID(Description, TG->Name);
+    TraceBuffer &Buffer = Trace->getThreadBuffer();
+    std::lock_guard<std::mutex> L(Buffer.Lock);
+    Buffer.Events.push_back(
+        {TraceNameID, StartTime.getWallTime(), Now.getWallTime()});
+  }
+  Time += Now;
   Time -= StartTime;
 }
 
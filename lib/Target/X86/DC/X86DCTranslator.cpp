@@ -12,6 +12,8 @@
 #include "X86DCFunction.h"
 #include "X86DCInstruction.h"
 #include "X86DCModule.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/MC/MCSubtargetInfo.h"
 
 #define GET_REGISTER_SEMA
 #include "X86GenSema.inc"
@@ -29,6 +31,43 @@ X86DCTranslator::X86DCTranslator(LLVMContext &Ctx, const DataLayout &DL,
 
 X86DCTranslator::~X86DCTranslator() {}
 
+APInt X86DCTranslator::getRegKnownZeroBits(unsigned RegNo) const {
+  // The status flags are only ever in EFLAGS, CtlSysEFLAGS has the others.
+  if (RegNo == X86::CtlSysEFLAGS) {
+    APInt StatusFlags(getRegSetDesc().RegSizes[RegNo], 0);
+    for (unsigned SF : {X86::CF, X86::PF, X86::AF, X86::ZF, X86::SF, X86::OF})
+      StatusFlags.setBit(SF);
+    return StatusFlags;
+  }
+  return DCTranslator::getRegKnownZeroBits(RegNo);
+}
+
+bool X86DCTranslator::isRegObservedOnReturn(unsigned RegNo) const {
+  // The status flags aren't preserved by calls, the control flags are in
+  // CtlSysEFLAGS.
+  if (RegNo == X86::EFLAGS)
+    return false;
+
+  // Neither are the scratch registers that don't hold return values.
+  const Triple &TT = getSubtargetInfo().getTargetTriple();
+  switch (RegNo) {
+  case X86::RCX:
+    return false;
+  case X86::RSI:
+  case X86::RDI:
+    return TT.getArch() != Triple::x86_64 || TT.isOSWindows();
+  case X86::RDX:
+    return TT.getArch() != Triple::x86_64 || !TT.isOSWindows();
+  case X86::R8:
+  case X86::R9:
+  case X86::R10:
+  case X86::R11:
+    return TT.getArch() != Triple::x86_64;
+  default:
+    return true;
+  }
+}
+
 std::unique_ptr<DCModule> X86DCTranslator::createDCModule(Module &M) {
   return make_unique<X86DCModule>(*this, M);
 }
@@ -22,6 +22,9 @@ public:
 
   virtual ~X86DCTranslator();
 
+  APInt getRegKnownZeroBits(unsigned RegNo) const override;
+  bool isRegObservedOnReturn(unsigned RegNo) const override;
+
 private:
   std::unique_ptr<DCModule> createDCModule(Module &M) override;
 
@@ -19,7 +19,9 @@
 #include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/Analysis/CallGraph.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalAlias.h"
@@ -78,7 +80,7 @@ static void addAllGlobalValueUsers(ClusterMapType &GVtoClusterMap,
 // Try to balance pack those partitions into N files since this roughly equals
 // thread balancing for the backend codegen step.
 static void findPartitions(Module *M, ClusterIDMapType &ClusterIDMap,
-                           unsigned N) {
+                           unsigned N, bool ClusterCallGraphSCCs) {
   // At this point module should have the proper mix of globals and locals.
   // As we attempt to partition this module, we must not change any
   // locals to globals.
@@ -129,6 +131,23 @@ static void findPartitions(Module *M, ClusterIDMapType &ClusterIDMap,
   std::for_each(M->global_begin(), M->global_end(), recordGVSet);
   std::for_each(M->alias_begin(), M->alias_end(), recordGVSet);
 
+  // Keep the mutually recursive functions together.
+  if (ClusterCallGraphSCCs) {
+    CallGraph CG(*M);
+    for (auto I = scc_begin(&CG); !I.isAtEnd(); ++I) {
+      const Function *Leader = nullptr;
+      for (CallGraphNode *Node : *I) {
+        const Function *F = Node->getFunction();
+        if (!F || F->isDeclaration())
+          continue;
+        if (Leader)
+          GVtoClusterMap.unionSets(Leader, F);
+        else
+          Leader = F;
+      }
+    }
+  }
+
   // Assigned all GVs to merged clusters while balancing number of objects in
   // each.
   auto CompareClusters = [](const std::pair<unsigned, unsigned> &a,
@@ -228,7 +247,7 @@ static bool isInPartition(const GlobalValue *GV, unsigned I, unsigned N) {
 void llvm::SplitModule(
     std::unique_ptr<Module> M, unsigned N,
     function_ref<void(std::unique_ptr<Module> MPart)> ModuleCallback,
-    bool PreserveLocals) {
+    bool PreserveLocals, bool ClusterCallGraphSCCs) {
   if (!PreserveLocals) {
     for (Function &F : *M)
       externalize(&F);
@@ -243,7 +262,7 @@ void llvm::SplitModule(
   // This performs splitting without a need for externalization, which might not
   // always be possible.
   ClusterIDMapType ClusterIDMap;
-  findPartitions(M.get(), ClusterIDMap, N);
+  findPartitions(M.get(), ClusterIDMap, N, ClusterCallGraphSCCs);
 
   // FIXME: We should be able to reuse M as the last partition instead of
   // cloning it.
@@ -15,7 +15,9 @@
 #include "llvm/Support/DataExtractor.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Process.h"
 #include "llvm/XRay/YAMLXRayRecord.h"
+#include <map>
 
 using namespace llvm;
 using namespace llvm::xray;
@@ -54,8 +56,8 @@ Error readBinaryFormatHeader(StringRef Data, XRayFileHeader &FileHeader) {
   return Error::success();
 }
 
-Error loadNaiveFormatLog(StringRef Data, XRayFileHeader &FileHeader,
-                         std::vector<XRayRecord> &Records) {
+// Checks that Data is large enough to be a naive-mode log.
+Error checkNaiveFormatLogSize(StringRef Data) {
   // Check that there is at least a header
   if (Data.size() < 32)
     return make_error<StringError>(
@@ -66,46 +68,46 @@ Error loadNaiveFormatLog(StringRef Data, XRayFileHeader &FileHeader,
     return make_error<StringError>(
         "Invalid-sized XRay data.",
         std::make_error_code(std::errc::invalid_argument));
+  return Error::success();
+}
 
-  if (auto E = readBinaryFormatHeader(Data, FileHeader))
-    return E;
-
-  // Each record after the header will be 32 bytes, in the following format:
-  //
-  //   (2)   uint16 : record type
-  //   (1)   uint8  : cpu id
-  //   (1)   uint8  : type
-  //   (4)   sint32 : function id
-  //   (8)   uint64 : tsc
-  //   (4)   uint32 : thread id
-  //   (12)  -      : padding
-  for (auto S = Data.drop_front(32); !S.empty(); S = S.drop_front(32)) {
-    DataExtractor RecordExtractor(S, true, 8);
-    uint32_t OffsetPtr = 0;
-    Records.emplace_back();
-    auto &Record = Records.back();
-    Record.RecordType = RecordExtractor.getU16(&OffsetPtr);
-    Record.CPU = RecordExtractor.getU8(&OffsetPtr);
-    auto Type = RecordExtractor.getU8(&OffsetPtr);
-    switch (Type) {
-    case 0:
-      Record.Type = RecordTypes::ENTER;
-      break;
-    case 1:
-      Record.Type = RecordTypes::EXIT;
-      break;
-    default:
-      return make_error<StringError>(
-          Twine("Unknown record type '") + Twine(int{Type}) + "'",
-          std::make_error_code(std::errc::executable_format_error));
-    }
-    Record.FuncId = RecordExtractor.getSigned(&OffsetPtr, sizeof(int32_t));
-    Record.TSC = RecordExtractor.getU64(&OffsetPtr);
-    Record.TId = RecordExtractor.getU32(&OffsetPtr);
+// Decodes a single record from the 32 bytes at the start of S.
+//
+// Each record after the header will be 32 bytes, in the following format:
+//
+//   (2)   uint16 : record type
+//   (1)   uint8  : cpu id
+//   (1)   uint8  : type
+//   (4)   sint32 : function id
+//   (8)   uint64 : tsc
+//   (4)   uint32 : thread id
+//   (12)  -      : padding
+Error readNaiveFormatRecord(StringRef S, XRayRecord &Record) {
+  DataExtractor RecordExtractor(S, true, 8);
+  uint32_t OffsetPtr = 0;
+  Record.RecordType = RecordExtractor.getU16(&OffsetPtr);
+  Record.CPU = RecordExtractor.getU8(&OffsetPtr);
+  auto Type = RecordExtractor.getU8(&OffsetPtr);
+  switch (Type) {
+  case 0:
+    Record.Type = RecordTypes::ENTER;
+    break;
+  case 1:
+    Record.Type = RecordTypes::EXIT;
+    break;
+  default:
+    return make_error<StringError>(
+        Twine("Unknown record type '") + Twine(int{Type}) + "'",
+        std::make_error_code(std::errc::executable_format_error));
   }
+  Record.FuncId = RecordExtractor.getSigned(&OffsetPtr, sizeof(int32_t));
+  Record.TSC = RecordExtractor.getU64(&OffsetPtr);
+  Record.TId = RecordExtractor.getU32(&OffsetPtr);
   return Error::success();
 }
 
+namespace {
+
 /// When reading from a Flight Data Recorder mode log, metadata records are
 /// sparse compared to packed function records, so we must maintain state as we
 /// read through the sequence of entries. This allows the reader to denormalize
@@ -134,6 +136,8 @@ struct FDRState {
   uint64_t CurrentBufferConsumed;
 };
 
+} // end anonymous namespace
+
 Twine fdrStateToTwine(const FDRState::Token &state) {
   switch (state) {
   case FDRState::Token::NEW_BUFFER_RECORD_OR_EOF:
@@ -286,16 +290,15 @@ Error processFDRMetadataRecord(FDRState &State, uint8_t RecordFirstByte,
   return Error::success();
 }
 
-/// Reads a function record from an FDR format log, appending a new XRayRecord
-/// to the vector being populated and updating the State with a new value
-/// reference value to interpret TSC deltas.
+/// Reads a function record from an FDR format log into Record and updates the
+/// State with a new value reference value to interpret TSC deltas.
 ///
 /// The XRayRecord constructed includes information from the function record
 /// processed here as well as Thread ID and CPU ID formerly extracted into
 /// State.
 Error processFDRFunctionRecord(FDRState &State, uint8_t RecordFirstByte,
                                DataExtractor &RecordExtractor,
-                               std::vector<XRayRecord> &Records) {
+                               XRayRecord &Record) {
   switch (State.Expects) {
   case FDRState::Token::NEW_BUFFER_RECORD_OR_EOF:
     return make_error<StringError>(
@@ -310,8 +313,6 @@ Error processFDRFunctionRecord(FDRState &State, uint8_t RecordFirstByte,
         "Malformed log. Received Function Record before first CPU record.",
         std::make_error_code(std::errc::executable_format_error));
   default:
-    Records.emplace_back();
-    auto &Record = Records.back();
     Record.RecordType = 0; // Record is type NORMAL.
     // Strip off record type bit and use the next three bits.
     uint8_t RecordType = (RecordFirstByte >> 1) & 0x07;
@@ -353,10 +354,37 @@ Error processFDRFunctionRecord(FDRState &State, uint8_t RecordFirstByte,
   return Error::success();
 }
 
-/// Reads a log in FDR mode for version 1 of this binary format. FDR mode is
-/// defined as part of the compiler-rt project in xray_fdr_logging.h, and such
-/// a log consists of the familiar 32 bit XRayHeader, followed by sequences of
-/// of interspersed 16 byte Metadata Records and 8 byte Function Records.
+// Checks that Data is large enough to be an FDR-mode log.
+Error checkFDRLogSize(StringRef Data) {
+  if (Data.size() < 32)
+    return make_error<StringError>(
+        "Not enough bytes for an XRay log.",
+        std::make_error_code(std::errc::invalid_argument));
+
+  // For an FDR log, there are records sized 16 and 8 bytes.
+  // There actually may be no records if no non-trivial functions are
+  // instrumented.
+  if (Data.size() % 8 != 0)
+    return make_error<StringError>(
+        "Invalid-sized XRay data.",
+        std::make_error_code(std::errc::invalid_argument));
+  return Error::success();
+}
+
+// The size of each thread buffer in an FDR-mode log is stored in the free-form
+// data of the file header.
+uint64_t getFDRBufferSize(const XRayFileHeader &FileHeader) {
+  StringRef ExtraDataRef(FileHeader.FreeFormData, 16);
+  DataExtractor ExtraDataExtractor(ExtraDataRef, true, 8);
+  uint32_t ExtraDataOffset = 0;
+  return ExtraDataExtractor.getU64(&ExtraDataOffset);
+}
+
+/// Reads one record of a log in FDR mode for version 1 of this binary format.
+/// FDR mode is defined as part of the compiler-rt project in
+/// xray_fdr_logging.h, and such a log consists of the familiar 32 bit
+/// XRayHeader, followed by sequences of of interspersed 16 byte Metadata
+/// Records and 8 byte Function Records.
 ///
 /// The following is an attempt to document the grammar of the format, which is
 /// parsed by this function for little-endian machines. Since the format makes
@@ -379,68 +407,53 @@ Error processFDRFunctionRecord(FDRState &State, uint8_t RecordFirstByte,
 /// FunctionSequence: NewCPUId | TSCWrap | FunctionRecord
 /// TSCWrap: 16 byte metadata record with a full 64 bit TSC reading.
 /// FunctionRecord: 8 byte record with FunctionId, entry/exit, and TSC delta.
-Error loadFDRLog(StringRef Data, XRayFileHeader &FileHeader,
-                 std::vector<XRayRecord> &Records) {
-  if (Data.size() < 32)
-    return make_error<StringError>(
-        "Not enough bytes for an XRay log.",
-        std::make_error_code(std::errc::invalid_argument));
-
-  // For an FDR log, there are records sized 16 and 8 bytes.
-  // There actually may be no records if no non-trivial functions are
-  // instrumented.
-  if (Data.size() % 8 != 0)
-    return make_error<StringError>(
-        "Invalid-sized XRay data.",
-        std::make_error_code(std::errc::invalid_argument));
-
-  if (auto E = readBinaryFormatHeader(Data, FileHeader))
-    return E;
-
-  uint64_t BufferSize = 0;
-  {
-    StringRef ExtraDataRef(FileHeader.FreeFormData, 16);
-    DataExtractor ExtraDataExtractor(ExtraDataRef, true, 8);
-    uint32_t ExtraDataOffset = 0;
-    BufferSize = ExtraDataExtractor.getU64(&ExtraDataOffset);
-  }
-  FDRState State{0,          0, 0, FDRState::Token::NEW_BUFFER_RECORD_OR_EOF,
-                 BufferSize, 0};
-  // RecordSize will tell the loop how far to seek ahead based on the record
-  // type that we have just read.
-  size_t RecordSize = 0;
-  for (auto S = Data.drop_front(32); !S.empty(); S = S.drop_front(RecordSize)) {
-    DataExtractor RecordExtractor(S, true, 8);
-    uint32_t OffsetPtr = 0;
-    if (State.Expects == FDRState::Token::SCAN_TO_END_OF_THREAD_BUF) {
-      RecordSize = State.CurrentBufferSize - State.CurrentBufferConsumed;
-      if (S.size() < State.CurrentBufferSize - State.CurrentBufferConsumed) {
-        return make_error<StringError>(
-            Twine("Incomplete thread buffer. Expected ") +
-                Twine(State.CurrentBufferSize - State.CurrentBufferConsumed) +
-                " remaining bytes but found " + Twine(S.size()),
-            make_error_code(std::errc::invalid_argument));
-      }
-      State.CurrentBufferConsumed = 0;
-      State.Expects = FDRState::Token::NEW_BUFFER_RECORD_OR_EOF;
-      continue;
-    }
-    uint8_t BitField = RecordExtractor.getU8(&OffsetPtr);
-    bool isMetadataRecord = BitField & 0x01uL;
-    if (isMetadataRecord) {
-      RecordSize = 16;
-      if (auto E = processFDRMetadataRecord(State, BitField, RecordExtractor,
-                                            RecordSize))
-        return E;
-      State.CurrentBufferConsumed += RecordSize;
-    } else { // Process Function Record
-      RecordSize = 8;
-      if (auto E = processFDRFunctionRecord(State, BitField, RecordExtractor,
-                                            Records))
-        return E;
-      State.CurrentBufferConsumed += RecordSize;
+///
+/// The record is read from the start of S, and RecordSize is set to the number
+/// of bytes it spans. HasRecord is set if a function record was decoded into
+/// Record.
+Error readFDRRecord(FDRState &State, StringRef S, size_t &RecordSize,
+                    XRayRecord &Record, bool &HasRecord) {
+  HasRecord = false;
+  DataExtractor RecordExtractor(S, true, 8);
+  uint32_t OffsetPtr = 0;
+  if (State.Expects == FDRState::Token::SCAN_TO_END_OF_THREAD_BUF) {
+    RecordSize = State.CurrentBufferSize - State.CurrentBufferConsumed;
+    if (S.size() < State.CurrentBufferSize - State.CurrentBufferConsumed) {
+      return make_error<StringError>(
+          Twine("Incomplete thread buffer. Expected ") +
+              Twine(State.CurrentBufferSize - State.CurrentBufferConsumed) +
+              " remaining bytes but found " + Twine(S.size()),
+          make_error_code(std::errc::invalid_argument));
     }
+    State.CurrentBufferConsumed = 0;
+    State.Expects = FDRState::Token::NEW_BUFFER_RECORD_OR_EOF;
+    return Error::success();
   }
+  uint8_t BitField = RecordExtractor.getU8(&OffsetPtr);
+  bool isMetadataRecord = BitField & 0x01uL;
+  if (isMetadataRecord) {
+    RecordSize = 16;
+    if (auto E = processFDRMetadataRecord(State, BitField, RecordExtractor,
+                                          RecordSize))
+      return E;
+  } else { // Process Function Record
+    RecordSize = 8;
+    if (auto E =
+            processFDRFunctionRecord(State, BitField, RecordExtractor, Record))
+      return E;
+    HasRecord = true;
+  }
+  if (S.size() < RecordSize)
+    return make_error<StringError>(
+        Twine("Truncated record. Expected ") + Twine(RecordSize) +
+            " bytes but found " + Twine(S.size()),
+        make_error_code(std::errc::executable_format_error));
+  State.CurrentBufferConsumed += RecordSize;
+  return Error::success();
+}
+
+// Checks that State is a valid state to be in at the end of the log.
+Error checkFDREndState(const FDRState &State) {
   // There are two conditions
   if (State.Expects != FDRState::Token::NEW_BUFFER_RECORD_OR_EOF &&
       !(State.Expects == FDRState::Token::SCAN_TO_END_OF_THREAD_BUF &&
@@ -451,10 +464,43 @@ Error loadFDRLog(StringRef Data, XRayFileHeader &FileHeader,
             ". Remaining expected bytes in thread buffer total " +
             Twine(State.CurrentBufferSize - State.CurrentBufferConsumed),
         std::make_error_code(std::errc::executable_format_error));
-
   return Error::success();
 }
 
+// Splits the thread buffers of an FDR-mode log into separate TraceBuffers. Only
+// the leading metadata records of each buffer are read, to find the thread
+// that wrote it and its first TSC.
+void splitFDRBuffers(StringRef Data, uint64_t BufferSize,
+                     std::vector<TraceBuffer> &Buffers) {
+  StringRef Body = Data.drop_front(32);
+  // Without a usable buffer size, the whole log is decoded as one buffer, which
+  // is what the sequential reader would have done.
+  if (BufferSize == 0 || BufferSize % 8 != 0) {
+    Buffers.emplace_back();
+    Buffers.back().Data = Body;
+    return;
+  }
+
+  for (uint64_t Off = 0; Off < Body.size(); Off += BufferSize) {
+    Buffers.emplace_back();
+    auto &B = Buffers.back();
+    B.Data = Body.substr(Off, BufferSize);
+
+    // NewBuffer (kind 0) followed by WallClockTime, then NewCPUId (kind 2).
+    // Malformed buffers are left for the record decoder to diagnose.
+    DataExtractor BufferExtractor(B.Data, true, 8);
+    uint32_t OffsetPtr = 0;
+    if (B.Data.size() < 48 || BufferExtractor.getU8(&OffsetPtr) != 0x01)
+      continue;
+    B.TId = BufferExtractor.getU16(&OffsetPtr);
+    OffsetPtr = 32;
+    if (BufferExtractor.getU8(&OffsetPtr) != ((2 << 1) | 0x01))
+      continue;
+    OffsetPtr += 2; // Skip over the CPU id.
+    B.BaseTSC = BufferExtractor.getU64(&OffsetPtr);
+  }
+}
+
 Error loadYAMLLog(StringRef Data, XRayFileHeader &FileHeader,
                   std::vector<XRayRecord> &Records) {
   // Load the documents from the MappedFile.
@@ -484,7 +530,93 @@ Error loadYAMLLog(StringRef Data, XRayFileHeader &FileHeader,
   return Error::success();
 }
 
-Expected<Trace> llvm::xray::loadTraceFile(StringRef Filename, bool Sort) {
+struct TraceReader::record_iterator::DecodeState {
+  FDRState FDR;
+};
+
+TraceReader::record_iterator::record_iterator(const TraceReader *Reader,
+                                             const TraceBuffer *Buffer,
+                                             Error *Err)
+    : Reader(Reader), Buffer(Buffer), Offset(0), Err(Err) {
+  if (Reader->getFormat() == LogFormat::FDR)
+    State = std::make_shared<DecodeState>(DecodeState{
+        {0, 0, 0, FDRState::Token::NEW_BUFFER_RECORD_OR_EOF,
+         getFDRBufferSize(Reader->getFileHeader()), 0}});
+  advance();
+}
+
+void TraceReader::record_iterator::advance() {
+  assert(Err && "Can't increment iterator with no Error attached");
+  ErrorAsOutParameter ErrAsOutParam(Err);
+  auto Fail = [&](Error E) {
+    Offset = UINT64_MAX;
+    *Err = std::move(E);
+    Err = nullptr;
+  };
+
+  switch (Reader->getFormat()) {
+  case LogFormat::YAML:
+    if (Offset >= Buffer->Records.size()) {
+      Offset = UINT64_MAX;
+      return;
+    }
+    Current = Buffer->Records[Offset++];
+    return;
+  case LogFormat::NAIVE:
+    if (Offset >= Buffer->Data.size()) {
+      Offset = UINT64_MAX;
+      return;
+    }
+    if (auto E = readNaiveFormatRecord(Buffer->Data.substr(Offset, 32), Current))
+      return Fail(std::move(E));
+    Offset += 32;
+    return;
+  case LogFormat::FDR:
+    // Skip over metadata records until we find the next function record.
+    while (Offset < Buffer->Data.size()) {
+      size_t RecordSize = 0;
+      bool HasRecord = false;
+      if (auto E = readFDRRecord(State->FDR, Buffer->Data.drop_front(Offset),
+                                 RecordSize, Current, HasRecord))
+        return Fail(std::move(E));
+      Offset += RecordSize;
+      if (HasRecord)
+        return;
+    }
+    if (auto E = checkFDREndState(State->FDR))
+      return Fail(std::move(E));
+    Offset = UINT64_MAX;
+    return;
+  }
+}
+
+std::vector<std::vector<const TraceBuffer *>>
+TraceReader::getThreadBufferGroups() const {
+  std::vector<std::vector<const TraceBuffer *>> Groups;
+  if (Format != LogFormat::FDR) {
+    Groups.emplace_back();
+    for (const auto &B : Buffers)
+      Groups.back().push_back(&B);
+    return Groups;
+  }
+
+  std::map<uint32_t, std::vector<const TraceBuffer *>> ThreadBuffers;
+  for (const auto &B : Buffers)
+    ThreadBuffers[B.TId].push_back(&B);
+  for (auto &TB : ThreadBuffers) {
+    std::stable_sort(TB.second.begin(), TB.second.end(),
+                     [](const TraceBuffer *L, const TraceBuffer *R) {
+                       return L->BaseTSC < R->BaseTSC;
+                     });
+    Groups.push_back(std::move(TB.second));
+  }
+  if (Groups.empty())
+    Groups.emplace_back();
+  return Groups;
+}
+
+Expected<std::unique_ptr<TraceReader>>
+llvm::xray::openTraceFile(StringRef Filename) {
   int Fd;
   if (auto EC = sys::fs::openFileForRead(Filename, Fd)) {
     return make_error<StringError>(
@@ -503,10 +635,11 @@ Expected<Trace> llvm::xray::loadTraceFile(StringRef Filename, bool Sort) {
         std::make_error_code(std::errc::executable_format_error));
   }
 
-  // Attempt to mmap the file.
+  // Attempt to mmap the file. The mapping outlives the file descriptor.
   std::error_code EC;
-  sys::fs::mapped_file_region MappedFile(
+  auto MappedFile = llvm::make_unique<sys::fs::mapped_file_region>(
       Fd, sys::fs::mapped_file_region::mapmode::readonly, FileSize, 0, EC);
+  sys::Process::SafelyCloseFileDescriptor(Fd);
   if (EC) {
     return make_error<StringError>(
         Twine("Cannot read log from '") + Filename + "'", EC);
@@ -525,28 +658,56 @@ Expected<Trace> llvm::xray::loadTraceFile(StringRef Filename, bool Sort) {
   //
   // Only if we can't load either the binary or the YAML format will we yield an
   // error.
-  StringRef Magic(MappedFile.data(), 4);
-  DataExtractor HeaderExtractor(Magic, true, 8);
+  StringRef Data(MappedFile->data(), MappedFile->size());
+  DataExtractor HeaderExtractor(Data.take_front(4), true, 8);
   uint32_t OffsetPtr = 0;
   uint16_t Version = HeaderExtractor.getU16(&OffsetPtr);
   uint16_t Type = HeaderExtractor.getU16(&OffsetPtr);
 
   enum BinaryFormatType { NAIVE_FORMAT = 0, FLIGHT_DATA_RECORDER_FORMAT = 1 };
 
-  Trace T;
+  std::unique_ptr<TraceReader> R(new TraceReader());
   if (Version == 1 && Type == NAIVE_FORMAT) {
-    if (auto E =
-            loadNaiveFormatLog(StringRef(MappedFile.data(), MappedFile.size()),
-                               T.FileHeader, T.Records))
+    if (auto E = checkNaiveFormatLogSize(Data))
       return std::move(E);
+    if (auto E = readBinaryFormatHeader(Data, R->FileHeader))
+      return std::move(E);
+    R->Format = TraceReader::LogFormat::NAIVE;
+    R->Buffers.emplace_back();
+    R->Buffers.back().Data = Data.drop_front(32);
   } else if (Version == 1 && Type == FLIGHT_DATA_RECORDER_FORMAT) {
-    if (auto E = loadFDRLog(StringRef(MappedFile.data(), MappedFile.size()),
-                            T.FileHeader, T.Records))
+    if (auto E = checkFDRLogSize(Data))
+      return std::move(E);
+    if (auto E = readBinaryFormatHeader(Data, R->FileHeader))
       return std::move(E);
+    R->Format = TraceReader::LogFormat::FDR;
+    splitFDRBuffers(Data, getFDRBufferSize(R->FileHeader), R->Buffers);
   } else {
-    if (auto E = loadYAMLLog(StringRef(MappedFile.data(), MappedFile.size()),
-                             T.FileHeader, T.Records))
+    if (auto E = loadYAMLLog(Data, R->FileHeader, R->DecodedRecords))
       return std::move(E);
+    R->Format = TraceReader::LogFormat::YAML;
+    R->Buffers.emplace_back();
+    R->Buffers.back().Records = R->DecodedRecords;
+  }
+
+  R->MappedFile = std::move(MappedFile);
+  return std::move(R);
+}
+
+Expected<Trace> llvm::xray::loadTraceFile(StringRef Filename, bool Sort) {
+  auto ReaderOrErr = openTraceFile(Filename);
+  if (!ReaderOrErr)
+    return ReaderOrErr.takeError();
+  auto &R = **ReaderOrErr;
+
+  Trace T;
+  T.FileHeader = R.getFileHeader();
+  for (const auto &B : R.buffers()) {
+    Error Err = Error::success();
+    T.Records.insert(T.Records.end(), R.records_begin(B, Err),
+                     R.records_end(B));
+    if (Err)
+      return std::move(Err);
   }
 
   if (Sort)
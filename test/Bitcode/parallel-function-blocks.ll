@@ -0,0 +1,72 @@
+; Encoding function blocks on several threads produces the same bitcode.
+; RUN: llvm-as < %s > %t.1.bc
+; RUN: llvm-as -bitcode-writer-threads=3 < %s > %t.3.bc
+; RUN: cmp %t.1.bc %t.3.bc
+; RUN: llvm-as -preserve-bc-uselistorder=false < %s > %t.1.bc
+; RUN: llvm-as -preserve-bc-uselistorder=false -bitcode-writer-threads=3 < %s > %t.3.bc
+; RUN: cmp %t.1.bc %t.3.bc
+; RUN: llvm-dis < %t.3.bc | FileCheck %s
+
+@g = global i32 0
+@ptr = global i8* blockaddress(@indirect, %target)
+
+; CHECK: define i32 @add(i32 %a, i32 %b)
+define i32 @add(i32 %a, i32 %b) !dbg !4 {
+  %sum = add i32 %a, %b, !dbg !7
+  %twice = add i32 %sum, %sum, !dbg !7
+  store i32 %twice, i32* @g, !dbg !8
+  ret i32 %sum, !dbg !8
+}
+
+; CHECK: define void @indirect(i8* %dest)
+define void @indirect(i8* %dest) {
+entry:
+  indirectbr i8* %dest, [label %target]
+target:
+  ret void
+}
+
+; CHECK: define float @constants(float %x)
+define float @constants(float %x) {
+  %y = fmul float %x, 2.500000e+00
+  %z = fadd float %y, 1.000000e+00
+  ret float %z
+}
+
+; CHECK: define i32 @calls(i32 %n)
+define i32 @calls(i32 %n) {
+entry:
+  %c = icmp eq i32 %n, 0
+  br i1 %c, label %done, label %loop
+loop:
+  %i = phi i32 [ %n, %entry ], [ %next, %loop ]
+  %r = call i32 @add(i32 %i, i32 %i)
+  %next = sub i32 %i, 1
+  %c2 = icmp eq i32 %next, 0
+  br i1 %c2, label %done, label %loop
+done:
+  %res = phi i32 [ 0, %entry ], [ %r, %loop ]
+  ret i32 %res
+}
+
+; CHECK: define void @uses()
+define void @uses() {
+  %a = load i32, i32* @g
+  %b = load i32, i32* @g
+  store i32 %b, i32* @g
+  store i32 %a, i32* @g
+  ret void
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "add.c", directory: "/tmp")
+!2 = !{}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = distinct !DISubprogram(name: "add", scope: !1, file: !1, line: 1, type: !5, isLocal: false, isDefinition: true, scopeLine: 1, isOptimized: false, unit: !0, variables: !2)
+!5 = !DISubroutineType(types: !6)
+!6 = !{null}
+!7 = !DILocation(line: 2, column: 3, scope: !4)
+!8 = !DILocation(line: 3, column: 3, scope: !4)
@@ -0,0 +1,16 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o - | llvm-dec - | FileCheck %s --check-prefix=DEFAULT
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o - | llvm-dec - -mcpu=haswell -mattr=-avx2,+bmi | FileCheck %s
+
+# The translated module describes the target it is meant to be compiled for.
+
+# DEFAULT: target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+# DEFAULT-NOT: "target-cpu"
+# DEFAULT-NOT: "target-features"
+
+# CHECK: target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+# CHECK: define void @fn_0({{.*}}) #[[ATTRS:[0-9]+]]
+# CHECK: attributes #[[ATTRS]] = { {{.*}}"target-cpu"="haswell" "target-features"="-avx2,+bmi" }
+
+f:
+add rdi, rsi
+ret
@@ -6,9 +6,13 @@ ret
 
 
 # CHECK-LABEL: @fn_0
-# CHECK: [[ZMMBC:%[^ ]+]] = bitcast <16 x float> %ZMM0_init to <4 x i128>
-# CHECK: %XMM0_0 = extractelement <4 x i128> [[ZMMBC]], i32 0
-# CHECK: [[XMM0:%[0-9]+]] = bitcast i128 %XMM0_0 to <2 x i64>
+# CHECK: [[ZMMBC:%[^ ]+]] = bitcast <16 x float>* %ZMM0_ptr to i512*
+# CHECK: [[ZMM0:%[^ ]+]] = load i512, i512* [[ZMMBC]]
+# CHECK: [[ZHI:%[0-9]+]] = and i512 [[ZMM0]], -340282366920938463463374607431768211456
+# CHECK: [[XMM0_0:%[0-9]+]] = trunc i512 [[ZMM0]] to i128
+# CHECK: [[XMM0:%[0-9]+]] = bitcast i128 [[XMM0_0]] to <2 x i64>
 # CHECK: [[MOVQ:%[0-9]+]] = insertelement <2 x i64> [[XMM0]], i64 %RDI_init, i32 0
 # CHECK: %XMM0_1 = bitcast <2 x i64> [[MOVQ]] to i128
-# CHECK: [[ZSHUF:%[^ ]+]] = zext i128 %XMM0_1 to i512
+# CHECK: [[ZXMM:%[^ ]+]] = zext i128 %XMM0_1 to i512
+# CHECK: %ZMM0_1 = or i512 [[ZHI]], [[ZXMM]]
+# CHECK: store i512 %ZMM0_1, i512* [[ZMMBC]]
@@ -0,0 +1,40 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t
+#RUN: llvm-dec %t -O2 | FileCheck %s --check-prefix=O2
+#RUN: llvm-dec %t -O3 | FileCheck %s --check-prefix=O3
+#RUN: llvm-dec %t -O3 -dc-assume-calling-conv | FileCheck %s --check-prefix=CC
+
+f:
+cmp rdi, rsi
+jmp 2f
+2:
+jb 1f
+mov rax, rdi
+1:
+ret
+
+# The status flags aren't in CtlSysEFLAGS: CF is used directly, rather than
+# extracted from the EFLAGS materialized at the end of bb_0.
+# O2-LABEL: define void @fn_0
+# O2: %CtlSysEFLAGS_init = load i32, i32* %CtlSysEFLAGS_ptr
+# O2: and i32 %CtlSysEFLAGS_init, -2262
+# O2: %CF_0 = extractvalue { i64, i1 } %{{[0-9]+}}, 1
+# O2-LABEL: bb_5:
+# O2-NEXT: br i1 %CF_0, label %bb_A, label %bb_7
+
+# Registers that aren't modified aren't stored back.
+# O3-LABEL: define void @fn_0
+# O3: select i1 %CF_0
+# O3-NOT: store i32 %CtlSysEFLAGS_init
+# O3: store i32 %EFLAGS_0, i32* %EFLAGS_ptr
+# O3-NEXT: store i64 %{{.*}}, i64* %RAX_ptr
+# O3-NEXT: store i64 %{{.*}}, i64* %RIP_ptr
+# O3-NEXT: store i64 %{{.*}}, i64* %RSP_ptr
+# O3-NEXT: ret void
+
+# Callers don't observe the flags on return.
+# CC-LABEL: define void @fn_0
+# CC-NOT: store i32 %EFLAGS_0
+# CC: store i64 %{{.*}}, i64* %RAX_ptr
+# CC-NEXT: store i64 %{{.*}}, i64* %RIP_ptr
+# CC-NEXT: store i64 %{{.*}}, i64* %RSP_ptr
+# CC-NEXT: ret void
@@ -0,0 +1,83 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t
+#RUN: llvm-dec %t -O3 | FileCheck %s
+#RUN: llvm-dec %t -O3 -dc-assume-calling-conv | opt -loop-vectorize -S | FileCheck %s --check-prefix=VEC
+
+# A copy loop: the pointers are carried by rsi and rdi.
+f:
+1:
+mov r8, qword ptr [rsi]
+mov qword ptr [rdi], r8
+add rsi, 8
+add rdi, 8
+dec rcx
+jne 1b
+ret
+
+# The same, indexed by rax, with a displacement.
+g:
+xor eax, eax
+2:
+mov r8, qword ptr [rsi + 8*rax]
+add r8, qword ptr [rdi + 8*rax + 16]
+mov qword ptr [rdi + 8*rax], r8
+inc rax
+cmp rax, rcx
+jne 2b
+ret
+
+# A table read with an unscaled counter that starts at 0 as the base: a null
+# incoming pointer would make the loop look undefined, so the counter is cast.
+h:
+xor eax, eax
+xor r9d, r9d
+3:
+add r9, qword ptr [rax + 4096]
+add rax, 8
+cmp rax, rcx
+jne 3b
+mov rax, r9
+ret
+
+# CHECK-LABEL: define void @fn_0
+# CHECK: %RSI_init.ptr = inttoptr i64 %RSI_init to i8*
+# CHECK: %RDI_init.ptr = inttoptr i64 %RDI_init to i8*
+# CHECK-LABEL: bb_0:
+# CHECK-DAG: %RSI.0.ptr = phi i8* [ %RSI_init.ptr, %entry_fn_0 ], [ [[RSI_NEXT:%[0-9]+]], %bb_0 ]
+# CHECK-DAG: %RDI.0.ptr = phi i8* [ %RDI_init.ptr, %entry_fn_0 ], [ [[RDI_NEXT:%[0-9]+]], %bb_0 ]
+# CHECK-DAG: [[RSI_NEXT]] = getelementptr i8, i8* %RSI.0.ptr, i64 8
+# CHECK-DAG: [[RDI_NEXT]] = getelementptr i8, i8* %RDI.0.ptr, i64 8
+# CHECK: br i1
+
+# CHECK-LABEL: define void @fn_14
+# CHECK: %RSI_init.ptr = inttoptr i64 %RSI_init to i8*
+# CHECK: %RDI_init.ptr = inttoptr i64 %RDI_init to i8*
+# CHECK-LABEL: bb_16:
+# CHECK: [[IDX:%[0-9]+]] = shl i64 %RAX.0, 3
+# CHECK: [[SRC:%[0-9]+]] = getelementptr i8, i8* %RSI_init.ptr, i64 [[IDX]]
+# CHECK: [[DST:%[0-9]+]] = getelementptr i8, i8* %RDI_init.ptr, i64 [[IDX]]
+# CHECK: getelementptr i8, i8* [[DST]], i64 16
+# CHECK-NOT: inttoptr
+# CHECK: [[DSTI64:%[0-9]+]] = bitcast i8* [[DST]] to i64*
+# CHECK: store i64 %R8_1, i64* [[DSTI64]]
+# CHECK: br i1
+
+# CHECK-LABEL: define void @fn_2C
+# CHECK-NOT: unreachable
+# CHECK-LABEL: bb_31:
+# CHECK-NOT: phi i8*
+# CHECK: %RAX.0.ptr = inttoptr i64 %RAX.0 to i8*
+# CHECK: [[ELT:%[0-9]+]] = getelementptr i8, i8* %RAX.0.ptr, i64 4096
+# CHECK: [[ELTI64:%[0-9]+]] = bitcast i8* [[ELT]] to i64*
+# CHECK: load i64, i64* [[ELTI64]]
+# CHECK: br i1
+
+# Both loops are vectorized, with runtime checks that the source and the
+# destination don't overlap.
+# VEC-LABEL: define void @fn_0
+# VEC: vector.memcheck:
+# VEC: load <2 x i64>
+# VEC: store <2 x i64>
+# VEC-LABEL: define void @fn_14
+# VEC: vector.memcheck:
+# VEC: load <2 x i64>
+# VEC: store <2 x i64>
@@ -0,0 +1,205 @@
+; RUN: %lli -force-interpreter -fast-interpreter %s | FileCheck %s
+; RUN: %lli -force-interpreter %s | FileCheck %s
+
+; The fast interpreter and the IR interpreter agree.
+
+@.int = private constant [4 x i8] c"%d\0A\00"
+@.long = private constant [5 x i8] c"%ld\0A\00"
+@.dbl = private constant [4 x i8] c"%f\0A\00"
+
+%pair = type { i8, i16, i24, i1 }
+
+declare i32 @printf(i8*, ...)
+declare i32 @llvm.ctpop.i32(i32)
+
+define void @print(i64 %v) {
+  %fmt = getelementptr [5 x i8], [5 x i8]* @.long, i64 0, i64 0
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %v)
+  ret void
+}
+
+define i32 @fib(i32 %n) {
+entry:
+  %small = icmp slt i32 %n, 2
+  br i1 %small, label %done, label %rec
+
+rec:
+  %n1 = sub i32 %n, 1
+  %n2 = sub i32 %n, 2
+  %f1 = call i32 @fib(i32 %n1)
+  %f2 = call i32 @fib(i32 %n2)
+  %f = add i32 %f1, %f2
+  ret i32 %f
+
+done:
+  ret i32 %n
+}
+
+; The PHIs swap places on every iteration.
+define i64 @swaps(i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %a = phi i64 [ 1, %entry ], [ %b, %loop ]
+  %b = phi i64 [ 2, %entry ], [ %a, %loop ]
+  %i.next = add i64 %i, 1
+  %more = icmp ult i64 %i.next, %n
+  br i1 %more, label %loop, label %exit
+
+exit:
+  %r = mul i64 %a, 10
+  %s = add i64 %r, %b
+  ret i64 %s
+}
+
+define i32 @classify(i16 %x) {
+entry:
+  switch i16 %x, label %other [
+    i16 1, label %one
+    i16 -1, label %minus.one
+  ]
+
+one:
+  br label %exit
+
+minus.one:
+  br label %exit
+
+other:
+  br label %exit
+
+exit:
+  %r = phi i32 [ 10, %one ], [ 20, %minus.one ], [ 30, %other ]
+  ret i32 %r
+}
+
+; Needs the IR interpreter.
+define i128 @wide(i128 %x) {
+  %r = mul i128 %x, 18446744073709551616
+  ret i128 %r
+}
+
+define i64 @call.wide(i64 %x) {
+  %w = zext i64 %x to i128
+  %m = call i128 @wide(i128 %w)
+  %h = lshr i128 %m, 64
+  %r = trunc i128 %h to i64
+  ret i64 %r
+}
+
+define i32 @main() {
+entry:
+  %ifmt = getelementptr [4 x i8], [4 x i8]* @.int, i64 0, i64 0
+  %dfmt = getelementptr [4 x i8], [4 x i8]* @.dbl, i64 0, i64 0
+
+; CHECK: 6765
+  %fib = call i32 @fib(i32 20)
+  call i32 (i8*, ...) @printf(i8* %ifmt, i32 %fib)
+
+; CHECK-NEXT: 12
+; CHECK-NEXT: 21
+  %s1 = call i64 @swaps(i64 3)
+  call void @print(i64 %s1)
+  %s2 = call i64 @swaps(i64 4)
+  call void @print(i64 %s2)
+
+; CHECK-NEXT: 10
+; CHECK-NEXT: 20
+; CHECK-NEXT: 30
+  %c1 = call i32 @classify(i16 1)
+  call i32 (i8*, ...) @printf(i8* %ifmt, i32 %c1)
+  %c2 = call i32 @classify(i16 65535)
+  call i32 (i8*, ...) @printf(i8* %ifmt, i32 %c2)
+  %c3 = call i32 @classify(i16 7)
+  call i32 (i8*, ...) @printf(i8* %ifmt, i32 %c3)
+
+; Odd widths wrap around and sign extend.
+; CHECK-NEXT: 44
+; CHECK-NEXT: -3
+; CHECK-NEXT: -2
+; CHECK-NEXT: -1
+; CHECK-NEXT: 16777215
+  %b = add i8 200, 100
+  %bz = zext i8 %b to i64
+  call void @print(i64 %bz)
+  %d = sdiv i16 -7, 2
+  %ds = sext i16 %d to i64
+  call void @print(i64 %ds)
+  %sh = ashr i24 -8, 2
+  %shs = sext i24 %sh to i64
+  call void @print(i64 %shs)
+  %t = icmp sgt i5 -3, 4
+  %ts = sext i1 %t to i64
+  %nt = xor i64 %ts, -1
+  call void @print(i64 %nt)
+  %z = sub i24 0, 1
+  %zz = zext i24 %z to i64
+  call void @print(i64 %zz)
+
+; Memory.
+; CHECK-NEXT: 7
+; CHECK-NEXT: 1000
+; CHECK-NEXT: 123456
+; CHECK-NEXT: 1
+  %p = alloca %pair
+  %p0 = getelementptr %pair, %pair* %p, i32 0, i32 0
+  %p1 = getelementptr %pair, %pair* %p, i32 0, i32 1
+  %p2 = getelementptr %pair, %pair* %p, i32 0, i32 2
+  %p3 = getelementptr %pair, %pair* %p, i32 0, i32 3
+  store i8 7, i8* %p0
+  store i16 1000, i16* %p1
+  store i24 123456, i24* %p2
+  store i1 true, i1* %p3
+  %v0 = load i8, i8* %p0
+  %v0z = zext i8 %v0 to i64
+  call void @print(i64 %v0z)
+  %v1 = load i16, i16* %p1
+  %v1z = zext i16 %v1 to i64
+  call void @print(i64 %v1z)
+  %v2 = load i24, i24* %p2
+  %v2z = zext i24 %v2 to i64
+  call void @print(i64 %v2z)
+  %v3 = load i1, i1* %p3
+  %v3z = zext i1 %v3 to i64
+  call void @print(i64 %v3z)
+
+; CHECK-NEXT: 30
+  %arr = alloca i32, i32 8
+  %idx = add i64 %bz, -39
+  %e = getelementptr i32, i32* %arr, i64 %idx
+  store i32 30, i32* %e
+  %e.again = getelementptr i32, i32* %arr, i32 5
+  %ev = load i32, i32* %e.again
+  call i32 (i8*, ...) @printf(i8* %ifmt, i32 %ev)
+
+; Floating point.
+; CHECK-NEXT: 2.750000
+; CHECK-NEXT: -2
+; CHECK-NEXT: 1
+  %f = sitofp i32 -11 to float
+  %fd = fdiv float %f, -4.0
+  %fx = fpext float %fd to double
+  call i32 (i8*, ...) @printf(i8* %dfmt, double %fx)
+  %neg = fsub double 0.0, %fx
+  %ni = fptosi double %neg to i32
+  call i32 (i8*, ...) @printf(i8* %ifmt, i32 %ni)
+  %lt = fcmp olt double %neg, %fx
+  %ltz = zext i1 %lt to i32
+  call i32 (i8*, ...) @printf(i8* %ifmt, i32 %ltz)
+
+; Indirect calls, intrinsics and calls to the IR interpreter.
+; CHECK-NEXT: 55
+; CHECK-NEXT: 4
+; CHECK-NEXT: 42
+  %fp = select i1 %lt, i32 (i32)* @fib, i32 (i32)* null
+  %f10 = call i32 %fp(i32 10)
+  call i32 (i8*, ...) @printf(i8* %ifmt, i32 %f10)
+  %pop = call i32 @llvm.ctpop.i32(i32 240)
+  call i32 (i8*, ...) @printf(i8* %ifmt, i32 %pop)
+  %w = call i64 @call.wide(i64 42)
+  call void @print(i64 %w)
+
+  ret i32 0
+}
@@ -0,0 +1,29 @@
+; Parsing the inputs on several threads does not change the linked module,
+; nor the order of the diagnostics.
+
+; RUN: llvm-as %S/Inputs/linkage.c.ll -o %t.c.bc
+; RUN: llvm-link -S %s %S/Inputs/linkage.b.ll %t.c.bc %S/type-unique-odr-a.ll %S/type-unique-odr-b.ll -o %t.j1.ll
+; RUN: llvm-link -S -j 3 %s %S/Inputs/linkage.b.ll %t.c.bc %S/type-unique-odr-a.ll %S/type-unique-odr-b.ll -o %t.j3.ll
+; RUN: cmp %t.j1.ll %t.j3.ll
+; RUN: FileCheck %s < %t.j3.ll
+
+; RUN: llvm-link -S -only-needed -internalize %s %S/Inputs/linkage.b.ll %t.c.bc -override %S/Inputs/linkage.d.ll -o %t.j1.ll
+; RUN: llvm-link -S -only-needed -internalize -j 2 %s %S/Inputs/linkage.b.ll %t.c.bc -override %S/Inputs/linkage.d.ll -o %t.j2.ll
+; RUN: cmp %t.j1.ll %t.j2.ll
+
+; RUN: llvm-link -disable-lazy-loading %s %t.c.bc %S/type-unique-odr-a.ll -o %t.j1.bc
+; RUN: llvm-link -disable-lazy-loading -j 2 %s %t.c.bc %S/type-unique-odr-a.ll -o %t.j2.bc
+; RUN: cmp %t.j1.bc %t.j2.bc
+
+; RUN: not llvm-link -j 2 %s %t.missing.bc %t.c.bc -o %t.bc 2>&1 | FileCheck %s --check-prefix=MISSING
+
+; CHECK: define void @parallel_load()
+; CHECK: define i32 @foo()
+; CHECK: define void @_Z3bazv()
+; CHECK: define void @_Z1fv()
+
+; MISSING: error loading file '{{.*}}.missing.bc'
+
+define void @parallel_load() {
+  ret void
+}
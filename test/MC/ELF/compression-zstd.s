@@ -0,0 +1,43 @@
+// RUN: llvm-mc -filetype=obj -compress-debug-sections=zstd -triple x86_64-pc-linux-gnu < %s -o %t
+// RUN: llvm-objdump -s %t | FileCheck %s
+// RUN: llvm-dwarfdump -debug-dump=str %t | FileCheck --check-prefix=STR %s
+// RUN: llvm-readobj -sections %t | FileCheck --check-prefix=FLAGS %s
+
+// REQUIRES: zstd
+
+// Small sections are left alone.
+// CHECK: Contents of section .debug_abbrev:
+// CHECK-NEXT: 0000 0111001b 0e0000
+
+// The compression header starts with ELFCOMPRESS_ZSTD.
+// CHECK: Contents of section .debug_str:
+// CHECK-NEXT: 0000 02000000 00000000 4d000000 00000000
+
+// STR: perfectly compressable data sample *****************************************
+
+// FLAGS:      Name: .debug_str
+// FLAGS-NEXT: Type: SHT_PROGBITS
+// FLAGS-NEXT: Flags [
+// FLAGS-NEXT:   SHF_COMPRESSED
+
+	.section	.debug_abbrev,"",@progbits
+.Lsection_abbrev:
+	.byte	1                       # Abbreviation Code
+	.byte	17                      # DW_TAG_compile_unit
+	.byte	0                       # DW_CHILDREN_no
+	.byte	27                      # DW_AT_comp_dir
+	.byte	14                      # DW_FORM_strp
+	.byte	0                       # EOM(1)
+	.byte	0                       # EOM(2)
+
+	.section	.debug_info,"",@progbits
+	.long	12                      # Length of Unit
+	.short	4                       # DWARF version number
+	.long	.Lsection_abbrev        # Offset Into Abbrev. Section
+	.byte	8                       # Address Size (in bytes)
+	.byte	1                       # Abbrev [1] DW_TAG_compile_unit
+	.long	.Linfo_string0          # DW_AT_comp_dir
+
+	.section        .debug_str,"MS",@progbits,1
+.Linfo_string0:
+        .asciz  "perfectly compressable data sample *****************************************"
@@ -0,0 +1,5 @@
+// RUN: not llvm-mc -filetype=obj -compress-debug-sections=zstd -triple x86_64-pc-linux-gnu %s -o - 2>&1 | FileCheck %s
+
+// REQUIRES: nozstd
+
+// CHECK: llvm-mc{{[^:]*}}: build tools with zstd to enable -compress-debug-sections=zstd
@@ -0,0 +1,30 @@
+# RUN: llvm-mc -filetype=obj -triple x86_64-pc-linux-gnu %s -o %t
+# RUN: llvm-objdump -d %t | FileCheck %s
+
+# Relaxing a branch can push the branches spanning it out of range, which the
+# next relaxation pass must notice, while the branches preceding it are
+# unaffected.
+
+	.text
+foo:
+	jmp foo
+	jne foo
+	jmp bar
+	.fill 124, 1, 0x90
+	jmp baz
+bar:
+	.uleb128 bar - foo
+	.fill 200, 1, 0x90
+baz:
+	jmp foo
+	ret
+
+# CHECK-LABEL: foo:
+# CHECK-NEXT:    0: eb fe          jmp -2 <foo>
+# CHECK-NEXT:    2: 75 fc          jne -4 <foo>
+# CHECK-NEXT:    4: e9 81 00 00 00 jmp 129 <bar>
+# CHECK:        85: e9 ca 00 00 00 jmp 202 <baz>
+# CHECK-LABEL: bar:
+# CHECK-NEXT:   8a: 8a 01
+# CHECK-LABEL: baz:
+# CHECK-NEXT:  154: e9 a7 fe ff ff jmp -345 <foo>
@@ -0,0 +1,60 @@
+; A module with debug info for opt-partitions.ll. Each partition brings back
+; its own copy of the distinct compile unit and global variables.
+
+@g = global i32 0, !dbg !0
+@s = internal global i32 1, !dbg !4
+
+define i32 @a(i32 %x) !dbg !12 {
+  call void @llvm.dbg.value(metadata i32 %x, i64 0, metadata !15, metadata !DIExpression()), !dbg !16
+  %v = load i32, i32* @s, !dbg !16
+  %y = add i32 %x, %v, !dbg !16
+  %z = add i32 %x, %v, !dbg !16
+  %r = mul i32 %y, %z, !dbg !16
+  ret i32 %r, !dbg !16
+}
+
+define i32 @b(i32 %x) !dbg !17 {
+  %v = load i32, i32* @g, !dbg !18
+  %r = add i32 %x, %v, !dbg !18
+  ret i32 %r, !dbg !18
+}
+
+define i32 @c(i32 %x) !dbg !19 {
+  %y = add i32 %x, 0, !dbg !20
+  ret i32 %y, !dbg !20
+}
+
+define i32 @d(i32 %x) !dbg !21 {
+  %y = mul i32 %x, 1, !dbg !22
+  ret i32 %y, !dbg !22
+}
+
+declare void @llvm.dbg.value(metadata, i64, metadata, metadata)
+
+!llvm.dbg.cu = !{!2}
+!llvm.module.flags = !{!9, !10}
+!llvm.ident = !{!11}
+
+!0 = !DIGlobalVariableExpression(var: !1)
+!1 = distinct !DIGlobalVariable(name: "g", scope: !2, file: !3, line: 1, type: !8, isLocal: false, isDefinition: true)
+!2 = distinct !DICompileUnit(language: DW_LANG_C99, file: !3, producer: "opt-partitions test", isOptimized: true, runtimeVersion: 0, emissionKind: FullDebug, enums: !6, globals: !7)
+!3 = !DIFile(filename: "opt-partitions.c", directory: "/build")
+!4 = !DIGlobalVariableExpression(var: !5)
+!5 = distinct !DIGlobalVariable(name: "s", scope: !2, file: !3, line: 2, type: !8, isLocal: true, isDefinition: true)
+!6 = !{}
+!7 = !{!0, !4}
+!8 = !DIBasicType(name: "int", size: 32, encoding: DW_ATE_signed)
+!9 = !{i32 2, !"Dwarf Version", i32 4}
+!10 = !{i32 2, !"Debug Info Version", i32 3}
+!11 = !{!"opt-partitions test"}
+!12 = distinct !DISubprogram(name: "a", scope: !3, file: !3, line: 4, type: !13, isLocal: false, isDefinition: true, scopeLine: 4, isOptimized: true, unit: !2, variables: !6)
+!13 = !DISubroutineType(types: !14)
+!14 = !{!8, !8}
+!15 = !DILocalVariable(name: "x", arg: 1, scope: !12, file: !3, line: 4, type: !8)
+!16 = !DILocation(line: 5, column: 3, scope: !12)
+!17 = distinct !DISubprogram(name: "b", scope: !3, file: !3, line: 8, type: !13, isLocal: false, isDefinition: true, scopeLine: 8, isOptimized: true, unit: !2, variables: !6)
+!18 = !DILocation(line: 9, column: 3, scope: !17)
+!19 = distinct !DISubprogram(name: "c", scope: !3, file: !3, line: 12, type: !13, isLocal: false, isDefinition: true, scopeLine: 12, isOptimized: true, unit: !2, variables: !6)
+!20 = !DILocation(line: 13, column: 3, scope: !19)
+!21 = distinct !DISubprogram(name: "d", scope: !3, file: !3, line: 16, type: !13, isLocal: false, isDefinition: true, scopeLine: 16, isOptimized: true, unit: !2, variables: !6)
+!22 = !DILocation(line: 17, column: 3, scope: !21)
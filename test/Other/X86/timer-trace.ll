@@ -0,0 +1,27 @@
+; RUN: llc < %s -o /dev/null -time-passes -timer-trace-file=%t.json 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=REPORT
+; RUN: FileCheck %s --check-prefix=TRACE < %t.json
+; RUN: llc < %s -o /dev/null -time-passes -fast-timers 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=FAST
+
+; REPORT: Pass execution timing report
+; REPORT: ---User Time---
+; REPORT: X86 DAG->DAG Instruction Selection
+
+; TRACE: {"traceEvents":[
+; TRACE-DAG: {"name":"X86 DAG->DAG Instruction Selection","cat":"pass","ph":"X","pid":1,"tid":{{[0-9]+}},"ts":{{[0-9.]+}},"dur":{{[0-9.]+}}}
+; TRACE-DAG: {"name":"Prologue/Epilogue Insertion & Frame Finalization","cat":"pass","ph":"X",
+; TRACE: ]}
+
+; Only the wall time is measured with -fast-timers.
+; FAST: Pass execution timing report
+; FAST-NOT: User Time
+; FAST: ---Wall Time---  --- Name ---
+; FAST: X86 DAG->DAG Instruction Selection
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @foo(i32 %a, i32 %b) {
+  %c = add i32 %a, %b
+  ret i32 %c
+}
@@ -0,0 +1,95 @@
+; With -j, opt optimizes partitions of the module in parallel, and relinks them
+; in the input order. Function passes give the same result as without -j.
+; RUN: opt -S -gvn -instcombine %s > %t.serial
+; RUN: opt -S -j 2 -j-function-local -gvn -instcombine %s > %t.j2
+; RUN: opt -S -j 4 -j-function-local -gvn -instcombine %s > %t.j4
+; RUN: diff %t.serial %t.j2
+; RUN: diff %t.serial %t.j4
+
+; With debug info, the partitions' copies of the compile unit are merged back.
+; RUN: opt -S -gvn -instcombine %S/Inputs/opt-partitions-debug.ll > %t.dbg.serial
+; RUN: opt -S -j 4 -j-function-local -gvn -instcombine \
+; RUN:   %S/Inputs/opt-partitions-debug.ll > %t.dbg.j4
+; RUN: diff %t.dbg.serial %t.dbg.j4
+; RUN: FileCheck --check-prefix=DBG %s < %t.dbg.j4
+
+; The -O<n> pipelines run on each partition.
+; RUN: opt -S -j 4 -O2 %s | FileCheck %s
+
+; RUN: not opt -j 2 -j-function-local -O2 %s 2>&1 \
+; RUN:   | FileCheck --check-prefix=ERR-OPT %s
+; RUN: not opt -j 2 -j-function-local -inline %s 2>&1 \
+; RUN:   | FileCheck --check-prefix=ERR-INLINE %s
+; RUN: not opt -j 2 -analyze -gvn %s 2>&1 \
+; RUN:   | FileCheck --check-prefix=ERR-ANALYZE %s
+
+; ERR-OPT: -j-function-local doesn't support the -O<n> and -std-link-opts pipelines
+; ERR-INLINE: -j-function-local: inline is not a function pass
+; ERR-ANALYZE: -analyze is not supported with -j
+
+; CHECK: ; ModuleID = '{{.*}}opt-partitions.ll'
+; CHECK: @llvm.global_ctors = appending global
+; CHECK: @g = {{.*}}global i32
+; CHECK: define void @init()
+; The linkonce_odr definition used by other partitions is kept.
+; CHECK: define linkonce_odr i32 @helper(
+; CHECK: define i32 @a(
+; CHECK: define i32 @b(
+; CHECK: define i32 @c(
+; CHECK: define i32 @d(
+; Each partition had a copy of the named metadata.
+; CHECK: !llvm.ident = !{!0}{{$}}
+
+; DBG: !llvm.dbg.cu = !{![[CU:[0-9]+]]}{{$}}
+; DBG: ![[CU]] = distinct !DICompileUnit(
+; DBG-NOT: !DICompileUnit(
+
+@llvm.global_ctors = appending global [1 x { i32, void ()*, i8* }] [{ i32, void ()*, i8* } { i32 65535, void ()* @init, i8* null }]
+@g = global i32 0
+@s = internal global i32 1
+
+define void @init() {
+  store i32 1, i32* @g
+  ret void
+}
+
+define linkonce_odr i32 @helper(i32 %x) {
+  %a = add i32 %x, 1
+  ret i32 %a
+}
+
+define i32 @a(i32 %x) {
+  %v = load i32, i32* @s
+  %y = add i32 %x, %v
+  %z = add i32 %x, %v
+  %r = mul i32 %y, %z
+  %h = call i32 @helper(i32 %r)
+  ret i32 %h
+}
+
+; @b and @c are in the same call graph SCC, and so in the same partition.
+define i32 @b(i32 %x) {
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %ret, label %rec
+rec:
+  %x1 = sub i32 %x, 1
+  %r = call i32 @c(i32 %x1)
+  ret i32 %r
+ret:
+  ret i32 0
+}
+
+define i32 @c(i32 %x) {
+  %r = call i32 @b(i32 %x)
+  %h = call i32 @helper(i32 %r)
+  ret i32 %h
+}
+
+define i32 @d(i32 %x) {
+  %y = add i32 %x, 0
+  %z = call i32 @a(i32 %y)
+  ret i32 %z
+}
+
+!llvm.ident = !{!0}
+!0 = !{!"opt-partitions test"}
@@ -0,0 +1,30 @@
+// RUN: llvm-mc -filetype=obj -triple=x86_64-pc-linux %s -o %t
+// RUN: llvm-objdump -d %t > %t.seq
+// RUN: llvm-objdump -d -num-threads=4 %t > %t.par
+// RUN: cmp %t.seq %t.par
+// RUN: FileCheck %s < %t.par
+
+// CHECK: foo:
+// CHECK: callq {{.*}} <bar>
+// CHECK: bar:
+// CHECK: jmp {{.*}} <foo+0x
+// CHECK: baz:
+// CHECK: retq
+
+        .text
+        .globl foo
+foo:
+        pushq %rbp
+        callq bar
+        popq %rbp
+        retq
+
+        .globl bar
+bar:
+        movl $42, %eax
+        jmp foo+1
+
+        .globl baz
+baz:
+        .fill 70000, 1, 0x90
+        retq
@@ -0,0 +1,30 @@
+; With -cluster-sccs, the mutually recursive external functions are kept in
+; the same partition.
+
+; RUN: llvm-split -j=2 -o %t %s
+; RUN: llvm-dis -o - %t0 | FileCheck --check-prefix=SPLIT0 %s
+; RUN: llvm-dis -o - %t1 | FileCheck --check-prefix=SPLIT1 %s
+
+; SPLIT0: declare void @f1()
+; SPLIT0: define void @f2()
+; SPLIT1: define void @f1()
+; SPLIT1: declare void @f2()
+
+; RUN: llvm-split -j=2 -cluster-sccs -o %t %s
+; RUN: llvm-dis -o - %t0 | FileCheck --check-prefix=CHECK0 %s
+; RUN: llvm-dis -o - %t1 | FileCheck --check-prefix=CHECK1 %s
+
+; CHECK0: define void @f1()
+; CHECK0: define void @f2()
+; CHECK1: declare void @f1()
+; CHECK1: declare void @f2()
+
+define void @f1() {
+  call void @f2()
+  ret void
+}
+
+define void @f2() {
+  call void @f1()
+  ret void
+}
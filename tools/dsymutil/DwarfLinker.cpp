@@ -35,8 +35,11 @@
 #include "llvm/Object/MachO.h"
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
+#include <deque>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -1156,6 +1159,10 @@ private:
 
     DwarfLinker &Linker;
 
+    /// \brief When set, the warnings found while looking for valid
+    /// relocations are stored here instead of being reported.
+    std::vector<std::string> *DeferredWarnings;
+
     /// \brief The valid relocations for the current DebugMapObject.
     /// This vector is sorted by relocation offset.
     std::vector<ValidReloc> ValidRelocs;
@@ -1168,8 +1175,17 @@ private:
     unsigned NextValidReloc;
 
   public:
-    RelocationManager(DwarfLinker &Linker)
-        : Linker(Linker), NextValidReloc(0) {}
+    RelocationManager(DwarfLinker &Linker,
+                      std::vector<std::string> *DeferredWarnings = nullptr)
+        : Linker(Linker), DeferredWarnings(DeferredWarnings),
+          NextValidReloc(0) {}
+
+    void reportWarning(const Twine &Warning) {
+      if (DeferredWarnings)
+        DeferredWarnings->push_back(Warning.str());
+      else
+        Linker.reportWarning(Warning);
+    }
 
     bool hasValidRelocs() const { return !ValidRelocs.empty(); }
     /// \brief Reset the NextValidReloc counter.
@@ -1426,10 +1442,37 @@ private:
   /// @{
   bool createStreamer(const Triple &TheTriple, StringRef OutputFilename);
 
-  /// \brief Attempt to load a debug object from disk.
-  ErrorOr<const object::ObjectFile &> loadObject(BinaryHolder &BinaryHolder,
-                                                 DebugMapObject &Obj,
-                                                 const DebugMap &Map);
+  /// \brief Attempt to load a debug object from disk. Warnings are
+  /// stored in \p DeferredWarnings when it is set.
+  ErrorOr<const object::ObjectFile &>
+  loadObject(BinaryHolder &BinaryHolder, DebugMapObject &Obj,
+             const DebugMap &Map,
+             std::vector<std::string> *DeferredWarnings = nullptr);
+
+  /// \brief The part of the link of a DebugMapObject that doesn't
+  /// depend on the objects linked before it: loading the object file,
+  /// finding the valid relocations in its debug_info and parsing its
+  /// DIEs. When linking with multiple threads, this is done on a
+  /// thread pool ahead of the ordered analysis and cloning stage.
+  struct LinkContext {
+    DebugMapObject &DMO;
+    /// The holder owning the object file, when it isn't the linker's.
+    std::unique_ptr<BinaryHolder> OwnedBinHolder;
+    const object::ObjectFile *ObjectFile = nullptr;
+    /// Warnings to report once the link of DMO starts.
+    std::vector<std::string> Warnings;
+    RelocationManager RelocMgr;
+    std::unique_ptr<DWARFContextInMemory> DwarfContext;
+
+    LinkContext(DwarfLinker &Linker, DebugMapObject &DMO)
+        : DMO(DMO), RelocMgr(Linker, &Warnings) {}
+  };
+
+  /// \brief Load \p Context.DMO using \p BinaryHolder and, if it has
+  /// valid relocations, parse its debug information. This doesn't
+  /// touch any linker state and can run concurrently.
+  void loadDebugObject(LinkContext &Context, BinaryHolder &BinaryHolder,
+                       const DebugMap &Map);
   /// @}
 
   std::string OutputFilename;
@@ -1921,14 +1964,14 @@ findValidRelocsMachO(const object::SectionRef &Section,
     if (isMachOPairedReloc(Obj.getAnyRelocationType(MachOReloc),
                            Obj.getArch())) {
       SkipNext = true;
-      Linker.reportWarning(" unsupported relocation in debug_info section.");
+      reportWarning(" unsupported relocation in debug_info section.");
       continue;
     }
 
     unsigned RelocSize = 1 << Obj.getAnyRelocationLength(MachOReloc);
     uint64_t Offset64 = Reloc.getOffset();
     if ((RelocSize != 4 && RelocSize != 8)) {
-      Linker.reportWarning(" unsupported relocation in debug_info section.");
+      reportWarning(" unsupported relocation in debug_info section.");
       continue;
     }
     uint32_t Offset = Offset64;
@@ -1953,7 +1996,7 @@ findValidRelocsMachO(const object::SectionRef &Section,
       Expected<StringRef> SymbolName = Sym->getName();
       if (!SymbolName) {
         consumeError(SymbolName.takeError());
-        Linker.reportWarning("error getting relocation symbol name.");
+        reportWarning("error getting relocation symbol name.");
         continue;
       }
       if (const auto *Mapping = DMO.lookupSymbol(*SymbolName))
@@ -1976,8 +2019,8 @@ bool DwarfLinker::RelocationManager::findValidRelocs(
   if (auto *MachOObj = dyn_cast<object::MachOObjectFile>(&Obj))
     findValidRelocsMachO(Section, *MachOObj, DMO);
   else
-    Linker.reportWarning(Twine("unsupported object file type: ") +
-                         Obj.getFileName());
+    reportWarning(Twine("unsupported object file type: ") +
+                  Obj.getFileName());
 
   if (ValidRelocs.empty())
     return false;
@@ -3255,19 +3298,49 @@ bool DwarfLinker::registerModuleReference(
 
 ErrorOr<const object::ObjectFile &>
 DwarfLinker::loadObject(BinaryHolder &BinaryHolder, DebugMapObject &Obj,
-                        const DebugMap &Map) {
+                        const DebugMap &Map,
+                        std::vector<std::string> *DeferredWarnings) {
+  auto Warn = [&](std::error_code EC) {
+    std::string Warning =
+        (Twine(Obj.getObjectFilename()) + ": " + EC.message()).str();
+    if (DeferredWarnings)
+      DeferredWarnings->push_back(std::move(Warning));
+    else
+      reportWarning(Warning);
+  };
+
   auto ErrOrObjs =
       BinaryHolder.GetObjectFiles(Obj.getObjectFilename(), Obj.getTimestamp());
   if (std::error_code EC = ErrOrObjs.getError()) {
-    reportWarning(Twine(Obj.getObjectFilename()) + ": " + EC.message());
+    Warn(EC);
     return EC;
   }
   auto ErrOrObj = BinaryHolder.Get(Map.getTriple());
   if (std::error_code EC = ErrOrObj.getError())
-    reportWarning(Twine(Obj.getObjectFilename()) + ": " + EC.message());
+    Warn(EC);
   return ErrOrObj;
 }
 
+void DwarfLinker::loadDebugObject(LinkContext &Context,
+                                  BinaryHolder &BinaryHolder,
+                                  const DebugMap &Map) {
+  auto ErrOrObj =
+      loadObject(BinaryHolder, Context.DMO, Map, &Context.Warnings);
+  if (!ErrOrObj)
+    return;
+  Context.ObjectFile = &*ErrOrObj;
+
+  // Look for relocations that correspond to debug map entries.
+  if (!Context.RelocMgr.findValidRelocsInDebugInfo(*ErrOrObj, Context.DMO))
+    return;
+
+  // Setup access to the debug info and extract all the DIEs now, so
+  // that the ordered part of the link doesn't have to.
+  Context.DwarfContext = llvm::make_unique<DWARFContextInMemory>(*ErrOrObj);
+  for (const auto &CU : Context.DwarfContext->compile_units())
+    CU->getUnitDIE(false);
+}
+
 void DwarfLinker::loadClangModule(StringRef Filename, StringRef ModulePath,
                                   StringRef ModuleName, uint64_t DwoId,
                                   DebugMap &ModuleMap, unsigned Indent) {
@@ -3415,25 +3488,64 @@ bool DwarfLinker::link(const DebugMap &Map) {
   UnitID = 0;
   DebugMap ModuleMap(Map.getTriple(), Map.getBinaryPath());
 
+  // When using multiple threads, the objects are loaded and parsed on a
+  // thread pool, a bounded number of objects ahead of the loop below
+  // which links them in debug map order. Everything that depends on the
+  // previously linked objects (ODR uniquing, liveness, string pool,
+  // output offsets) stays in that loop, so that the output doesn't
+  // depend on the number of threads. Verbose output is only readable
+  // when produced in order, thus it disables the thread pool.
+  unsigned Threads = Options.Threads ? Options.Threads
+                                     : heavyweight_hardware_concurrency();
+  std::deque<std::pair<std::unique_ptr<LinkContext>, std::shared_future<void>>>
+      Loading;
+  std::unique_ptr<ThreadPool> Pool;
+  if (Threads > 1 && !Options.Verbose)
+    Pool = llvm::make_unique<ThreadPool>(Threads);
+  auto NextToLoad = Map.objects().begin();
+  auto LoadAhead = [&]() {
+    while (NextToLoad != Map.objects().end() && Loading.size() < 2 * Threads) {
+      auto Context = llvm::make_unique<LinkContext>(*this, **NextToLoad++);
+      // A BinaryHolder only keeps one file mapped at a time, thus every
+      // object loaded ahead needs its own.
+      Context->OwnedBinHolder = llvm::make_unique<BinaryHolder>(false);
+      LinkContext *C = Context.get();
+      auto Future = Pool->async(
+          [this, C, &Map] { loadDebugObject(*C, *C->OwnedBinHolder, Map); });
+      Loading.emplace_back(std::move(Context), std::move(Future));
+    }
+  };
+
   for (const auto &Obj : Map.objects()) {
     CurrentDebugObject = Obj.get();
 
     if (Options.Verbose)
       outs() << "DEBUG MAP OBJECT: " << Obj->getObjectFilename() << "\n";
-    auto ErrOrObj = loadObject(BinHolder, *Obj, Map);
-    if (!ErrOrObj)
+
+    std::unique_ptr<LinkContext> Context;
+    if (Pool) {
+      LoadAhead();
+      Loading.front().second.wait();
+      Context = std::move(Loading.front().first);
+      Loading.pop_front();
+    } else {
+      Context = llvm::make_unique<LinkContext>(*this, *Obj);
+      loadDebugObject(*Context, BinHolder, Map);
+    }
+
+    for (const auto &Warning : Context->Warnings)
+      reportWarning(Warning);
+    if (!Context->ObjectFile)
       continue;
 
-    // Look for relocations that correspond to debug map entries.
-    RelocationManager RelocMgr(*this);
-    if (!RelocMgr.findValidRelocsInDebugInfo(*ErrOrObj, *Obj)) {
+    if (!Context->DwarfContext) {
       if (Options.Verbose)
         outs() << "No valid relocations found. Skipping.\n";
       continue;
     }
 
-    // Setup access to the debug info.
-    DWARFContextInMemory DwarfContext(*ErrOrObj);
+    RelocationManager &RelocMgr = Context->RelocMgr;
+    DWARFContextInMemory &DwarfContext = *Context->DwarfContext;
     startDebugObject(DwarfContext, *Obj);
 
     // In a first phase, just read in the debug info and load all clang modules.
@@ -82,6 +82,16 @@ static opt<bool>
           desc("Do not use ODR (One Definition Rule) for type uniquing."),
           init(false), cat(DsymCategory));
 
+static opt<unsigned> NumThreads(
+    "num-threads",
+    desc("Specifies the maximum number (n) of simultaneous threads to use\n"
+         "when linking. Object files are loaded and parsed ahead of the\n"
+         "(ordered) DWARF link on that many threads. Defaults to the number\n"
+         "of hardware threads; 1 links sequentially."),
+    value_desc("n"), init(0), cat(DsymCategory));
+static alias NumThreadsA("j", desc("Alias for --num-threads"),
+                         aliasopt(NumThreads));
+
 static opt<bool> DumpDebugMap(
     "dump-debug-map",
     desc("Parse and dump the debug map to standard output. Not DWARF link "
@@ -265,6 +275,7 @@ int main(int argc, char **argv) {
   Options.NoOutput = NoOutput;
   Options.NoODR = NoODR;
   Options.PrependPath = OsoPrependPath;
+  Options.Threads = NumThreads;
 
   llvm::InitializeAllTargetInfos();
   llvm::InitializeAllTargetMCs();
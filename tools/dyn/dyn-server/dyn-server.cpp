@@ -0,0 +1,248 @@
+//===-- dyn-server.cpp - Out-of-process translation server for DYN --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program translates and compiles code for DYN guests run with
+// -dyn-server or -dyn-server-socket, so that the guest process doesn't carry
+// the translator and the JIT, and so that a crash in either doesn't happen in
+// the guest.
+//
+// The guest is an ORC remote target: the translated code is written into it,
+// and it asks for the translation of each guest address it branches to. See
+// DYNRemote.h for the protocol.
+//
+//   dyn-server [options] <input fd> <output fd>
+// serves the guest that started it, and
+//   dyn-server [options] -listen=<path>
+// serves every guest connecting to the unix domain socket at <path>, each in
+// a process of its own.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../dyncore/DYNRemote.h"
+#include "../dyncore/DYNTranslator.h"
+#include "llvm/ExecutionEngine/Orc/OrcRemoteTargetClient.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define DEBUG_TYPE "dyn-server"
+
+using namespace llvm;
+using namespace orc;
+
+static cl::opt<std::string>
+    ListenPath("listen",
+               cl::desc("Serve the guests connecting to the unix domain "
+                        "socket at this path"),
+               cl::value_desc("path"), cl::init(""));
+
+static cl::list<int> InputFDs(cl::Positional,
+                              cl::desc("<input fd> <output fd>"),
+                              cl::ZeroOrMore);
+
+static ExitOnError ExitOnErr;
+
+typedef remote::OrcRemoteTargetClient<rpc::RawByteChannel> RemoteT;
+
+namespace {
+
+/// Runs translated code in a DYN guest.
+class RemoteDYNTarget : public DYNTarget {
+public:
+  RemoteDYNTarget(RemoteT &Remote, JITCompileCallbackManager &CCMgr,
+                  JITTargetAddress TranslateAtAddr)
+      : Remote(Remote), CCMgr(CCMgr), TranslateAtAddr(TranslateAtAddr) {}
+
+  std::unique_ptr<RuntimeDyld::MemoryManager> createMemoryManager() override {
+    std::unique_ptr<RemoteT::RCMemoryManager> MemMgr;
+    ExitOnErr(Remote.createRemoteMemoryManager(MemMgr));
+    return std::move(MemMgr);
+  }
+
+  JITCompileCallbackManager &getCompileCallbackManager() override {
+    return CCMgr;
+  }
+
+  std::unique_ptr<IndirectStubsManager> createIndirectStubsManager() override {
+    std::unique_ptr<RemoteT::RCIndirectStubsManager> StubsMgr;
+    ExitOnErr(Remote.createIndirectStubsManager(StubsMgr));
+    return std::move(StubsMgr);
+  }
+
+  JITTargetAddress getSymbolAddress(const std::string &Name) override {
+    return ExitOnErr(Remote.getSymbolAddress(Name));
+  }
+
+  JITTargetAddress getTranslateAtAddress() override { return TranslateAtAddr; }
+
+private:
+  RemoteT &Remote;
+  JITCompileCallbackManager &CCMgr;
+  JITTargetAddress TranslateAtAddr;
+};
+
+} // end anonymous namespace
+
+/// Translate the program of the guest at the other end of \p InFD and
+/// \p OutFD, until it exits.
+static Error serveGuest(int InFD, int OutFD) {
+  dyn::FDRawChannel Channel(InFD, OutFD);
+  auto RemoteOrErr = RemoteT::Create(Channel);
+  if (!RemoteOrErr)
+    return RemoteOrErr.takeError();
+  RemoteT &Remote = **RemoteOrErr;
+
+  auto GuestInfoOrErr = Remote.callB<dyn::GetGuestInfo>();
+  if (!GuestInfoOrErr)
+    return GuestInfoOrErr.takeError();
+  std::string GuestPath;
+  uint64_t VMAddrSlide;
+  JITTargetAddress TranslateAtAddr;
+  std::tie(GuestPath, VMAddrSlide, TranslateAtAddr) = *GuestInfoOrErr;
+  DEBUG(dbgs() << "Serving '" << GuestPath << "'\n");
+
+  auto CCMgrOrErr = Remote.enableCompileCallbacks(0);
+  if (!CCMgrOrErr)
+    return CCMgrOrErr.takeError();
+
+  auto SessionOrErr = DYNSession::create(
+      GuestPath, VMAddrSlide, /*ReadGuestMemory=*/false,
+      llvm::make_unique<RemoteDYNTarget>(Remote, *CCMgrOrErr,
+                                         TranslateAtAddr));
+  if (!SessionOrErr)
+    return SessionOrErr.takeError();
+  std::unique_ptr<DYNSession> Session = std::move(*SessionOrErr);
+
+  Remote.addHandler<dyn::TranslateAt>([&](uint64_t GuestAddr) {
+    return Session->translateAt(GuestAddr);
+  });
+
+  // Translation requests come in while we wait for the program to end.
+  const DYNProgramInfo &Info = Session->getProgramInfo();
+  auto ExitValOrErr = Remote.callB<dyn::RunGuest>(
+      Info.RegSetSize, Info.PCOffset, Info.PCSize, Info.InitRegSetFn,
+      Info.FiniRegSetFn, Info.StaticInitFns, Info.StaticExitFns,
+      Info.MainEntrypoint);
+  if (!ExitValOrErr) {
+    // The guest doesn't return when the program calls exit() itself.
+    std::error_code EC = errorToErrorCode(ExitValOrErr.takeError());
+    if (EC != std::errc::connection_reset)
+      return errorCodeToError(EC);
+    Session->programExited();
+    return Error::success();
+  }
+  DEBUG(dbgs() << "'" << GuestPath << "' exited with " << *ExitValOrErr
+               << "\n");
+
+  Session->programExited();
+
+  // Free the guest's code while it can still handle our calls.
+  Session.reset();
+  return Remote.terminateSession();
+}
+
+static Error errnoToError() {
+  return errorCodeToError(std::error_code(errno, std::generic_category()));
+}
+
+/// Serve the guests connecting to the socket at \p Path, each in a child
+/// process. Only returns on error.
+static Error listenForGuests(StringRef Path) {
+  sockaddr_un Addr;
+  if (Path.size() >= sizeof(Addr.sun_path))
+    return errorCodeToError(
+        std::make_error_code(std::errc::filename_too_long));
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  memcpy(Addr.sun_path, Path.data(), Path.size());
+
+  int ListenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (ListenFD < 0)
+    return errnoToError();
+  unlink(Addr.sun_path);
+  if (bind(ListenFD, (sockaddr *)&Addr, sizeof(Addr)) < 0 ||
+      listen(ListenFD, SOMAXCONN) < 0) {
+    Error Err = errnoToError();
+    close(ListenFD);
+    return Err;
+  }
+
+  // Reap the session processes as they finish.
+  signal(SIGCHLD, SIG_IGN);
+
+  while (true) {
+    int FD = accept(ListenFD, nullptr, nullptr);
+    if (FD < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      Error Err = errnoToError();
+      close(ListenFD);
+      return Err;
+    }
+
+    pid_t Pid = fork();
+    if (Pid < 0) {
+      errs() << "dyn-server: unable to serve guest: " << strerror(errno)
+             << "\n";
+    } else if (Pid == 0) {
+      // Each guest gets its own translator: a crash only affects one guest.
+      close(ListenFD);
+      ExitOnErr(serveGuest(FD, FD));
+      close(FD);
+      llvm_shutdown();
+      _exit(0);
+    }
+    close(FD);
+  }
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+  InitializeNativeTargetAsmParser();
+  InitializeAllTargets();
+  InitializeAllTargetInfos();
+  InitializeAllTargetDCs();
+  InitializeAllTargetMCs();
+  InitializeAllAsmParsers();
+  InitializeAllDisassemblers();
+
+  registerDYNTranslatorOptions();
+  cl::ParseCommandLineOptions(argc, argv, "DYN translation server\n");
+  ExitOnErr.setBanner(std::string(argv[0]) + ": ");
+
+  if (!ListenPath.empty()) {
+    ExitOnErr(listenForGuests(ListenPath));
+    return 1;
+  }
+
+  if (InputFDs.size() != 2) {
+    errs() << "Usage: " << argv[0] << " [options] <input fd> <output fd>\n"
+           << "       " << argv[0] << " [options] -listen=<path>\n";
+    return 1;
+  }
+
+  ExitOnErr(serveGuest(InputFDs[0], InputFDs[1]));
+  close(InputFDs[0]);
+  close(InputFDs[1]);
+  return 0;
+}
@@ -0,0 +1,125 @@
+//===-- DYNRemote.h - Protocol between DYN guests and dyn-server -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// With -dyn-server, the guest process only runs translated code: it is an ORC
+// remote target, and dyn-server, the ORC remote client, translates and
+// compiles the code into it. This file declares the calls that extend the
+// ORC remote-target protocol for DYN, and the channel both sides use.
+//
+// A session goes:
+//   dyn-server                            guest
+//     GetGuestInfo  ---------------------->
+//     (translate the init/fini functions, writing code into the guest)
+//     RunGuest      ---------------------->
+//                   <----------------------  TranslateAt, for each branch to
+//                                            untranslated code
+//                   <----------------------  RunGuest returns the exit value
+//     TerminateSession -------------------->
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_DYN_DYNCORE_DYNREMOTE_H
+#define LLVM_TOOLS_DYN_DYNCORE_DYNREMOTE_H
+
+#include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/Orc/OrcRemoteTargetRPCAPI.h"
+#include "llvm/ExecutionEngine/Orc/RawByteChannel.h"
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+namespace llvm {
+namespace dyn {
+
+/// Return the (path, VM address slide, translate-at function address) of the
+/// guest executable.
+class GetGuestInfo
+    : public orc::rpc::Function<
+          GetGuestInfo, std::tuple<std::string, uint64_t, JITTargetAddress>()> {
+public:
+  static const char *getName() { return "GetGuestInfo"; }
+};
+
+/// Run the translated program, as described by a DYNProgramInfo, and return
+/// its exit value.
+class RunGuest
+    : public orc::rpc::Function<
+          RunGuest,
+          int32_t(uint64_t RegSetSize, uint32_t PCOffset, uint32_t PCSize,
+                  JITTargetAddress InitRegSetFn, JITTargetAddress FiniRegSetFn,
+                  std::vector<uint64_t> StaticInitFns,
+                  std::vector<uint64_t> StaticExitFns,
+                  uint64_t MainEntrypoint)> {
+public:
+  static const char *getName() { return "RunGuest"; }
+};
+
+/// Return the host address of the translation of the guest function at
+/// GuestAddr, translating it if needed.
+class TranslateAt
+    : public orc::rpc::Function<TranslateAt,
+                                JITTargetAddress(uint64_t GuestAddr)> {
+public:
+  static const char *getName() { return "TranslateAt"; }
+};
+
+/// A channel over a pair of file descriptors, usually the two ends of a
+/// socket.
+class FDRawChannel final : public orc::rpc::RawByteChannel {
+public:
+  FDRawChannel(int InFD, int OutFD) : InFD(InFD), OutFD(OutFD) {}
+
+  Error readBytes(char *Dst, unsigned Size) override {
+    assert(Dst && "Attempt to read into null.");
+    ssize_t Completed = 0;
+    while (Completed < static_cast<ssize_t>(Size)) {
+      ssize_t Read = ::read(InFD, Dst + Completed, Size - Completed);
+      if (Read <= 0) {
+        auto ErrNo = errno;
+        if (Read < 0 && (ErrNo == EAGAIN || ErrNo == EINTR))
+          continue;
+        // A closed connection reads as 0 bytes, with a stale errno.
+        return errorCodeToError(std::error_code(
+            Read == 0 ? ECONNRESET : ErrNo, std::generic_category()));
+      }
+      Completed += Read;
+    }
+    return Error::success();
+  }
+
+  Error appendBytes(const char *Src, unsigned Size) override {
+    assert(Src && "Attempt to append from null.");
+    ssize_t Completed = 0;
+    while (Completed < static_cast<ssize_t>(Size)) {
+      ssize_t Written = ::write(OutFD, Src + Completed, Size - Completed);
+      if (Written < 0) {
+        auto ErrNo = errno;
+        if (ErrNo == EAGAIN || ErrNo == EINTR)
+          continue;
+        return errorCodeToError(
+            std::error_code(ErrNo, std::generic_category()));
+      }
+      Completed += Written;
+    }
+    return Error::success();
+  }
+
+  Error send() override { return Error::success(); }
+
+private:
+  int InFD, OutFD;
+};
+
+} // end namespace dyn
+} // end namespace llvm
+
+#endif // LLVM_TOOLS_DYN_DYNCORE_DYNREMOTE_H
@@ -0,0 +1,891 @@
+//===-- DYNTranslator.cpp - Translation of guest programs -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "dyn"
+#include "DYNTranslator.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/DC/DCFunction.h"
+#include "llvm/DC/DCTranslator.h"
+#include "llvm/DC/DCTranslatorUtils.h"
+#include "llvm/DC/LowerDCTranslateAt.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/JITSamplingProfiler.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/PooledMemoryManager.h"
+#include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/MC/MCAnalysis/MCModule.h"
+#include "llvm/MC/MCAnalysis/MCObjectDisassembler.h"
+#include "llvm/MC/MCAnalysis/MCObjectSymbolizer.h"
+#include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCDisassembler/MCDisassembler.h"
+#include "llvm/MC/MCInstPrinter.h"
+#include "llvm/MC/MCInstrAnalysis.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/MC/MCObjectFileInfo.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/Object/MachO.h"
+#include "llvm/Object/MachOUniversal.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <set>
+
+using namespace llvm;
+using namespace object;
+using namespace orc;
+
+namespace {
+
+/// The options of the translation. They are only constructed, and registered,
+/// on first use: libDYN parses its options from a static constructor, which
+/// may run before the static initializers of this file.
+struct DYNTranslatorOptions {
+  cl::opt<unsigned> TranslateOptLevel{
+      "dyn-translate-opt",
+      cl::desc("Optimization level of the translated IR, before it is "
+               "compiled [0-3]"),
+      cl::init(2)};
+
+  cl::opt<bool> JITHugePages{
+      "dyn-huge-pages",
+      cl::desc("Put translated code on huge pages, if possible"),
+      cl::init(false)};
+
+  cl::opt<bool> JITHostCPU{
+      "dyn-host-cpu",
+      cl::desc("Compile translated code for the host CPU and its features, "
+               "rather than for a generic CPU"),
+      cl::init(true)};
+
+  cl::opt<std::string> JITCacheDir{
+      "dyn-cache-dir",
+      cl::desc("Cache the compiled translated code in this directory across "
+               "runs"),
+      cl::init("")};
+
+  cl::opt<std::string> JITCachePolicy{
+      "dyn-cache-policy",
+      cl::desc("Pruning policy for -dyn-cache-dir, e.g. "
+               "'prune_after=24h:cache_size=50%'"),
+      cl::init("")};
+
+  cl::opt<std::string> JITSnapshot{
+      "dyn-snapshot",
+      cl::desc("Start from the translated code saved in this file by a "
+               "previous run, or save it there if there is none"),
+      cl::init("")};
+
+  cl::opt<unsigned long long> JITSnapshotAt{
+      "dyn-snapshot-at",
+      cl::desc("Save the -dyn-snapshot when the program first branches to "
+               "this guest address, rather than on exit"),
+      cl::init(0)};
+
+  cl::opt<unsigned> JITProfileUpdateMs{
+      "dyn-profile-update-ms",
+      cl::desc("Milliseconds between two updates of the guest function "
+               "hotness scores"),
+      cl::init(100)};
+
+  cl::opt<bool> JITProfileDumps{
+      "dyn-profile-dumps",
+      cl::desc("Report the hottest guest functions at every update of their "
+               "scores"),
+      cl::init(false)};
+};
+
+} // end anonymous namespace
+
+static DYNTranslatorOptions &getOptions() {
+  static DYNTranslatorOptions Options;
+  return Options;
+}
+
+void llvm::registerDYNTranslatorOptions() { getOptions(); }
+
+static const char *const DYNGroupName = "dyn";
+static const char *const DYNGroupDescription = "Dynamic Translation";
+
+static Error makeDYNError(const Twine &Msg) {
+  return make_error<StringError>(Msg, inconvertibleErrorCode());
+}
+
+static Triple getGuestTriple(const ObjectFile &Obj) {
+  Triple TheTriple("unknown-unknown-unknown");
+  TheTriple.setArch(Triple::ArchType(Obj.getArch()));
+  // TheTriple defaults to ELF, and COFF doesn't have an environment:
+  // the best we can do here is indicate that it is mach-o.
+  if (Obj.isMachO())
+    TheTriple.setObjectFormat(Triple::MachO);
+  return TheTriple;
+}
+
+static Expected<OwningBinary<MachOObjectFile>>
+openObjectFileAtPath(StringRef Path) {
+  Expected<OwningBinary<Binary>> BinaryOrErr = createBinary(Path);
+  if (!BinaryOrErr)
+    return BinaryOrErr.takeError();
+
+  std::unique_ptr<Binary> Bin;
+  std::unique_ptr<MemoryBuffer> Buf;
+  std::tie(Bin, Buf) = BinaryOrErr.get().takeBinary();
+
+  std::unique_ptr<MachOObjectFile> MOOF;
+
+  if (auto *FatBinPtr = dyn_cast<MachOUniversalBinary>(Bin.get())) {
+    for (auto &Obj : FatBinPtr->objects()) {
+      // FIXME: Realistically, we only support x86_64 for now.
+      // This won't be hardest place to fix.
+      if (Obj.getArchFlagName() != "x86_64")
+        continue;
+      auto SliceOrErr = Obj.getAsObjectFile();
+      if (!SliceOrErr)
+        return SliceOrErr.takeError();
+      MOOF = std::move(SliceOrErr.get());
+      break;
+    }
+  } else if (isa<MachOObjectFile>(Bin.get())) {
+    MOOF.reset(cast<MachOObjectFile>(Bin.release()));
+  }
+
+  if (!MOOF)
+    return makeDYNError("'" + Path + "': Unrecognized file type.");
+
+  return OwningBinary<MachOObjectFile>(std::move(MOOF), std::move(Buf));
+}
+
+/// Write \p Data to \p Path through a temporary file in the same directory,
+/// so that other processes never see a partial file.
+static std::error_code writeFileAtomically(StringRef Path, StringRef Data) {
+  StringRef Dir = sys::path::parent_path(Path);
+  if (!Dir.empty())
+    if (std::error_code EC = sys::fs::create_directories(Dir))
+      return EC;
+  SmallString<128> TempModel, TempPath;
+  sys::path::append(TempModel, Dir, "dyn-%%%%%%.tmp");
+  int TempFD;
+  if (std::error_code EC = sys::fs::createUniqueFile(
+          TempModel, TempFD, TempPath,
+          sys::fs::owner_read | sys::fs::owner_write))
+    return EC;
+  {
+    raw_fd_ostream OS(TempFD, /*shouldClose=*/true);
+    OS << Data;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return make_error_code(errc::io_error);
+    }
+  }
+  if (std::error_code EC = sys::fs::rename(TempPath, Path)) {
+    sys::fs::remove(TempPath);
+    return EC;
+  }
+  return std::error_code();
+}
+
+template <typename T>
+static std::vector<T> singletonSet(T t) {
+  std::vector<T> Vec;
+  Vec.push_back(std::move(t));
+  return Vec;
+}
+
+DYNTarget::~DYNTarget() {}
+
+namespace {
+
+/// Runs translated code in this process. The code of all the modules is
+/// packed together in a JITMemoryPool.
+class InProcessDYNTarget : public DYNTarget {
+public:
+  InProcessDYNTarget(
+      std::unique_ptr<JITCompileCallbackManager> CCMgr,
+      std::function<std::unique_ptr<IndirectStubsManager>()> ISMBuilder,
+      JITTargetAddress TranslateAtAddr)
+      : MemPool(getMemPoolOptions()), CCMgr(std::move(CCMgr)),
+        ISMBuilder(std::move(ISMBuilder)), TranslateAtAddr(TranslateAtAddr) {}
+
+  std::unique_ptr<RuntimeDyld::MemoryManager> createMemoryManager() override {
+    return make_unique<PooledMemoryManager>(MemPool);
+  }
+
+  JITCompileCallbackManager &getCompileCallbackManager() override {
+    return *CCMgr;
+  }
+
+  std::unique_ptr<IndirectStubsManager> createIndirectStubsManager() override {
+    return ISMBuilder();
+  }
+
+  JITTargetAddress getSymbolAddress(const std::string &Name) override {
+    return RTDyldMemoryManager::getSymbolAddressInProcess(Name);
+  }
+
+  JITTargetAddress getTranslateAtAddress() override { return TranslateAtAddr; }
+
+private:
+  static JITMemoryPool::Options getMemPoolOptions() {
+    JITMemoryPool::Options Opts;
+    Opts.UseHugePages = getOptions().JITHugePages;
+    return Opts;
+  }
+
+  JITMemoryPool MemPool;
+  std::unique_ptr<JITCompileCallbackManager> CCMgr;
+  std::function<std::unique_ptr<IndirectStubsManager>()> ISMBuilder;
+  JITTargetAddress TranslateAtAddr;
+};
+
+} // end anonymous namespace
+
+Expected<std::unique_ptr<DYNTarget>>
+llvm::createInProcessDYNTarget(JITTargetAddress TranslateAtAddr) {
+  // Add the program's symbols into the JIT's search space.
+  if (sys::DynamicLibrary::LoadLibraryPermanently(nullptr))
+    return makeDYNError("unable to load program symbols.");
+
+  Triple HostTriple(sys::getProcessTriple());
+  auto CompileCallbackMgr = createLocalCompileCallbackManager(HostTriple, 0);
+  if (!CompileCallbackMgr)
+    return makeDYNError("no compile callback manager for target " +
+                        HostTriple.str());
+
+  auto IndirectStubsMgrBuilder =
+      createLocalIndirectStubsManagerBuilder(HostTriple);
+  if (!IndirectStubsMgrBuilder)
+    return makeDYNError("no indirect stubs manager for target " +
+                        HostTriple.str());
+
+  return llvm::make_unique<InProcessDYNTarget>(
+      std::move(CompileCallbackMgr), std::move(IndirectStubsMgrBuilder),
+      TranslateAtAddr);
+}
+
+/// An on-disk cache of the objects compiled from translated modules.
+///
+/// Objects are keyed on the bitcode of the module they were compiled from,
+/// along with the target they were compiled for and the LLVM version, so that
+/// an entry is only ever reused for identical input. The translated IR refers
+/// to guest and host addresses directly: entries are only hit when the program
+/// is loaded at the same address as when they were written.
+///
+/// Entries are named "llvmcache-<key>", so that the directory can be managed
+/// with pruneCache().
+class DYNObjectCache : public ObjectCache {
+public:
+  DYNObjectCache(StringRef CacheDir, const TargetMachine &TM)
+      : CacheDir(CacheDir) {
+    raw_string_ostream OS(TargetKey);
+    OS << LLVM_VERSION_STRING << '\0' << TM.getTargetTriple().str() << '\0'
+       << TM.getTargetCPU() << '\0' << TM.getTargetFeatureString() << '\0'
+       << TM.getOptLevel();
+  }
+
+  std::unique_ptr<MemoryBuffer> getObject(const Module *M) override {
+    NamedRegionTimer T("cache", "Object Cache Lookup", DYNGroupName,
+                       DYNGroupDescription, TimePassesIsEnabled);
+    LastModule = M;
+    LastEntryPath = getEntryPath(*M);
+    ErrorOr<std::unique_ptr<MemoryBuffer>> ObjOrErr =
+        MemoryBuffer::getFile(LastEntryPath, /*FileSize=*/-1,
+                              /*RequiresNullTerminator=*/false);
+    // A missing entry just means that the module needs to be compiled.
+    if (!ObjOrErr)
+      return nullptr;
+    DEBUG(dbgs() << "Loaded cached object for " << M->getModuleIdentifier()
+                 << "\n");
+    return std::move(*ObjOrErr);
+  }
+
+  void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override {
+    // The compiler looks the module up right before compiling it: reuse the
+    // key computed then.
+    std::string EntryPath =
+        M == LastModule ? LastEntryPath : getEntryPath(*M);
+    LastModule = nullptr;
+
+    // Processes sharing the directory never see a partial entry. Failing to
+    // write one only means it will be compiled again.
+    writeFileAtomically(EntryPath, Obj.getBuffer());
+  }
+
+private:
+  std::string getEntryPath(const Module &M) const {
+    SmallVector<char, 0> Bitcode;
+    raw_svector_ostream OS(Bitcode);
+    WriteBitcodeToFile(&M, OS);
+
+    SHA1 Hasher;
+    Hasher.update(TargetKey);
+    Hasher.update(StringRef(Bitcode.data(), Bitcode.size()));
+
+    SmallString<128> EntryPath;
+    sys::path::append(EntryPath, CacheDir,
+                      "llvmcache-" + toHex(Hasher.result()));
+    return EntryPath.str();
+  }
+
+  std::string CacheDir;
+  std::string TargetKey;
+  const Module *LastModule = nullptr;
+  std::string LastEntryPath;
+};
+
+/// The JIT used to run translated code.
+///
+/// Every translated function is given an indirect stub when its module is
+/// added, and is only compiled, on its own, the first time the stub is
+/// called. The stub is then updated to point to the compiled code. This
+/// keeps the compile time proportional to the code that actually runs, rather
+/// than to everything translateRecursivelyAt reached.
+class DYNJIT {
+public:
+  typedef JITCompileCallbackManager CompileCallbackMgrT;
+  typedef RTDyldObjectLinkingLayer ObjLayerT;
+  typedef IRCompileLayer<ObjLayerT, SimpleCompiler> CompileLayerT;
+  typedef CompileOnDemandLayer<CompileLayerT, CompileCallbackMgrT> CODLayerT;
+
+  typedef CODLayerT::ModuleSetHandleT ModuleHandleT;
+
+  DYNJIT(TargetMachine &TM, DYNTarget &Target, StringRef CacheDir)
+      : DL(TM.createDataLayout()), Target(Target),
+        ObjectLayer(
+            [this](ObjLayerT::ObjHandleT H, const ObjLayerT::ObjectPtr &Obj,
+                   const LoadedObjectInfo &Info) {
+              if (!Profiler)
+                return;
+              Profiler->NotifyObjectEmitted(
+                  *Obj->getBinary(),
+                  static_cast<const RuntimeDyld::LoadedObjectInfo &>(Info));
+              // The layer drops the object once it is loaded, but the
+              // profiler needs it again when the code is freed.
+              ProfiledObjects[H->get()] = Obj;
+            },
+            ObjLayerT::NotifyFinalizedFtor(),
+            [this](ObjLayerT::ObjHandleT H) {
+              auto I = ProfiledObjects.find(H->get());
+              if (I == ProfiledObjects.end())
+                return;
+              // Don't attribute samples to code that is being freed.
+              Profiler->NotifyFreeingObject(*I->second->getBinary());
+              ProfiledObjects.erase(I);
+            }),
+        CompileLayer(ObjectLayer, SimpleCompiler(TM)),
+        CODLayer(CompileLayer, extractSingleFunction,
+                 Target.getCompileCallbackManager(),
+                 [&Target]() { return Target.createIndirectStubsManager(); }) {
+    if (!CacheDir.empty()) {
+      ObjCache = llvm::make_unique<DYNObjectCache>(CacheDir, TM);
+      CompileLayer.getCompiler().setObjectCache(ObjCache.get());
+    }
+  }
+
+  std::string mangle(const std::string &Name) {
+    std::string MangledName;
+    {
+      raw_string_ostream MangledNameStream(MangledName);
+      Mangler::getNameWithPrefix(MangledNameStream, Name, DL);
+    }
+    return MangledName;
+  }
+
+  void runPassesOnModule(Module &M) {
+    if (!LowerDCTranslateAtPass) {
+      auto *PI8Ty = Type::getInt8PtrTy(M.getContext());
+      auto *I64Ty = Type::getInt64Ty(M.getContext());
+
+      FunctionType *CallbackType =
+          FunctionType::get(PI8Ty, PI8Ty, /*isVarArg=*/false);
+
+      Value *TranslateAtFn = ConstantExpr::getIntToPtr(
+          ConstantInt::get(I64Ty, Target.getTranslateAtAddress()),
+          CallbackType->getPointerTo());
+
+      LowerDCTranslateAtPass.reset(createLowerDCTranslateAtPass(TranslateAtFn));
+
+      PM.add(LowerDCTranslateAtPass.get());
+    }
+
+    PM.run(M);
+  }
+
+  ModuleHandleT addModule(Module *M) {
+    // Dump the IR we found.
+    DEBUG(M->dump());
+
+    {
+      NamedRegionTimer T("passes", "Translated IR Passes", DYNGroupName,
+                         DYNGroupDescription, TimePassesIsEnabled);
+      runPassesOnModule(*M);
+    }
+
+    // We need a memory manager to allocate memory and resolve symbols for this
+    // new module. Create one that resolves symbols by looking back into the
+    // JIT, then into the process running the code.
+    auto Resolver = createLambdaResolver(
+        [&](const std::string &Name) {
+          if (auto Sym = findSymbol(Name))
+            return JITSymbol(Sym.getAddress(), Sym.getFlags());
+          else if (auto Addr = Target.getSymbolAddress(Name))
+            return JITSymbol(Addr, JITSymbolFlags::Exported);
+          return JITSymbol(nullptr);
+        },
+        [](const std::string &S) { return nullptr; });
+
+    return CODLayer.addModuleSet(singletonSet(std::move(M)),
+                                 Target.createMemoryManager(),
+                                 std::move(Resolver));
+  }
+
+  void removeModule(ModuleHandleT H) { CODLayer.removeModuleSet(H); }
+
+  /// Find the stub for \p Name. Calling it compiles the function if needed.
+  JITSymbol findSymbol(const std::string &Name) {
+    return CODLayer.findSymbol(Name, true);
+  }
+
+  JITSymbol findUnmangledSymbol(const std::string Name) {
+    return findSymbol(mangle(Name));
+  }
+
+  /// Start sampling the translated code run by the current thread.
+  void startProfiling() {
+    JITSamplingProfiler::Options Opts;
+    Opts.UpdateIntervalMs = getOptions().JITProfileUpdateMs;
+    Profiler = make_unique<JITSamplingProfiler>(Opts);
+    if (getOptions().JITProfileDumps)
+      Profiler->setUpdateCallback(
+          [this](JITSamplingProfiler &) { printProfile(errs()); });
+    if (auto Err = Profiler->start()) {
+      logAllUnhandledErrors(std::move(Err), errs(),
+                            "warning: unable to profile translated code: ");
+      Profiler.reset();
+    }
+  }
+
+  /// Stop sampling, and report the hottest guest functions.
+  void stopProfiling() {
+    if (!Profiler)
+      return;
+    Profiler->stop();
+    Profiler->update();
+    printProfile(errs());
+  }
+
+  /// Return the hotness of the translation \p Name of a guest function, 0 if
+  /// it isn't profiled. Scores decay by half at every update.
+  double getHotness(const std::string &Name) {
+    return Profiler ? Profiler->getHotness(mangle(Name)) : 0;
+  }
+
+  /// Print the hottest guest functions. Translated functions are named after
+  /// the guest address they start at.
+  void printProfile(raw_ostream &OS, unsigned N = 20) {
+    OS << "===- Hottest guest functions -===\n"
+       << "   Hotness    Samples  Guest address\n";
+    StringRef GuestFnPrefix = "fn_";
+    for (auto &FP : Profiler->getHottestFunctions(N)) {
+      StringRef Name = FP.Name;
+      if (char GlobalPrefix = DL.getGlobalPrefix())
+        Name.consume_front(StringRef(&GlobalPrefix, 1));
+      uint64_t GuestAddr;
+      OS << format("%10.2f %10llu  ", FP.Hotness,
+                   (unsigned long long)FP.Samples);
+      if (Name.consume_front(GuestFnPrefix) &&
+          !Name.getAsInteger(16, GuestAddr))
+        OS << format("0x%llx\n", (unsigned long long)GuestAddr);
+      else
+        OS << FP.Name << "\n";
+    }
+    OS << "Samples outside of translated code: "
+       << Profiler->getNumUnattributedSamples() << "\n";
+  }
+
+private:
+  static std::set<Function *> extractSingleFunction(Function &F) {
+    std::set<Function *> Partition;
+    Partition.insert(&F);
+    return Partition;
+  }
+
+  const DataLayout DL;
+  DYNTarget &Target;
+  std::unique_ptr<DYNObjectCache> ObjCache;
+  std::unique_ptr<JITSamplingProfiler> Profiler;
+  DenseMap<const void *, ObjLayerT::ObjectPtr> ProfiledObjects;
+  ObjLayerT ObjectLayer;
+  CompileLayerT CompileLayer;
+  CODLayerT CODLayer;
+
+  std::unique_ptr<Pass> LowerDCTranslateAtPass;
+  legacy::PassManager PM;
+};
+
+struct DYNSession::Impl {
+  std::unique_ptr<DYNTarget> Target;
+  OwningBinary<MachOObjectFile> MOOFAndBuffer;
+  std::string TripleName;
+
+  // FIXME: why are there unique_ptrs everywhere?
+  std::unique_ptr<const MCRegisterInfo> MRI;
+  std::unique_ptr<const MCAsmInfo> MAI;
+  std::unique_ptr<const MCSubtargetInfo> STI;
+  std::unique_ptr<const MCInstrInfo> MII;
+  std::unique_ptr<MCInstPrinter> MIP;
+  std::unique_ptr<const MCInstrAnalysis> MIA;
+  std::unique_ptr<const MCObjectFileInfo> MOFI;
+  std::unique_ptr<MCContext> MCCtx;
+  std::unique_ptr<MCDisassembler> DisAsm;
+  std::unique_ptr<MCMachObjectSymbolizer> MOS;
+  std::unique_ptr<MCObjectDisassembler> OD;
+  std::unique_ptr<MCModule> MCM;
+
+  std::unique_ptr<TargetMachine> TM;
+  LLVMContext Ctx;
+  std::unique_ptr<DCTranslator> DT;
+  std::vector<std::unique_ptr<Module>> SnapshotModules;
+  std::unique_ptr<DYNJIT> J;
+
+  DYNProgramInfo Info;
+
+  /// The translated modules are recorded in SnapshotBuffer, until the
+  /// snapshot is saved.
+  std::string SnapshotKey;
+  bool RecordingSnapshot = false;
+  SmallVector<char, 0> SnapshotBuffer;
+  std::unique_ptr<BitcodeWriter> SnapshotWriter;
+
+  Error init(StringRef GuestPath, uint64_t VMAddrSlide, bool ReadGuestMemory);
+  void addModule(Module *M);
+  bool restoreSnapshot();
+  void saveSnapshot();
+};
+
+/// A snapshot is a bitcode file holding the translated modules, after a
+/// header module identifying what they were translated from: only the same
+/// executable, loaded at the same address, can reuse them.
+static const char *const SnapshotKeyMDName = "dyn.snapshot.key";
+
+void DYNSession::Impl::addModule(Module *M) {
+  if (RecordingSnapshot)
+    SnapshotWriter->writeModule(M);
+  J->addModule(M);
+}
+
+bool DYNSession::Impl::restoreSnapshot() {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufOrErr =
+      MemoryBuffer::getFile(getOptions().JITSnapshot);
+  // No snapshot yet: this run will save it.
+  if (!BufOrErr)
+    return false;
+
+  auto WarnStale = [&](Error Err) {
+    logAllUnhandledErrors(std::move(Err), errs(),
+                          "warning: ignoring snapshot '" +
+                              getOptions().JITSnapshot + "': ");
+    return false;
+  };
+
+  Expected<std::vector<BitcodeModule>> BMsOrErr =
+      getBitcodeModuleList(**BufOrErr);
+  if (!BMsOrErr)
+    return WarnStale(BMsOrErr.takeError());
+  if (BMsOrErr->empty())
+    return WarnStale(makeDYNError("no header"));
+
+  Expected<std::unique_ptr<Module>> HeaderOrErr =
+      (*BMsOrErr)[0].parseModule(Ctx);
+  if (!HeaderOrErr)
+    return WarnStale(HeaderOrErr.takeError());
+  NamedMDNode *KeyMD = (*HeaderOrErr)->getNamedMetadata(SnapshotKeyMDName);
+  if (!KeyMD || KeyMD->getNumOperands() != 1 ||
+      KeyMD->getOperand(0)->getNumOperands() != 1)
+    return WarnStale(makeDYNError("no header"));
+  auto *Key = dyn_cast<MDString>(KeyMD->getOperand(0)->getOperand(0));
+  // The program or its load address changed.
+  if (!Key || Key->getString() != SnapshotKey)
+    return false;
+
+  std::vector<std::unique_ptr<Module>> Modules;
+  for (unsigned I = 1, E = BMsOrErr->size(); I != E; ++I) {
+    Expected<std::unique_ptr<Module>> MOrErr = (*BMsOrErr)[I].parseModule(Ctx);
+    if (!MOrErr)
+      return WarnStale(MOrErr.takeError());
+    Modules.push_back(std::move(*MOrErr));
+  }
+
+  NamedRegionTimer T("restore", "Snapshot Restore", DYNGroupName,
+                     DYNGroupDescription, TimePassesIsEnabled);
+  for (auto &M : Modules) {
+    J->addModule(M.get());
+    SnapshotModules.push_back(std::move(M));
+  }
+  DEBUG(dbgs() << "Restored " << SnapshotModules.size()
+               << " translated modules\n");
+  return true;
+}
+
+void DYNSession::Impl::saveSnapshot() {
+  RecordingSnapshot = false;
+  SnapshotWriter->writeStrtab();
+  SnapshotWriter.reset();
+
+  const std::string &Path = getOptions().JITSnapshot;
+  if (std::error_code EC = writeFileAtomically(
+          Path, StringRef(SnapshotBuffer.data(), SnapshotBuffer.size())))
+    errs() << "warning: unable to save snapshot '" << Path
+           << "': " << EC.message() << "\n";
+  SnapshotBuffer.clear();
+}
+
+Error DYNSession::Impl::init(StringRef GuestPath, uint64_t VMAddrSlide,
+                             bool ReadGuestMemory) {
+  auto MOOFOrErr = openObjectFileAtPath(GuestPath);
+  if (!MOOFOrErr)
+    return MOOFOrErr.takeError();
+  MOOFAndBuffer = std::move(*MOOFOrErr);
+  MachOObjectFile &MOOF = *MOOFAndBuffer.getBinary();
+
+  Triple TheTriple = getGuestTriple(MOOF);
+  std::string ErrorStr;
+  const llvm::Target *TheTarget =
+      TargetRegistry::lookupTarget("", TheTriple, ErrorStr);
+  if (!TheTarget)
+    return makeDYNError(ErrorStr);
+  TripleName = TheTriple.getTriple();
+
+  MRI.reset(TheTarget->createMCRegInfo(TripleName));
+  if (!MRI)
+    return makeDYNError("no register info for target " + TripleName);
+
+  // Set up disassembler.
+  MAI.reset(TheTarget->createMCAsmInfo(*MRI, TripleName));
+  if (!MAI)
+    return makeDYNError("no assembly info for target " + TripleName);
+
+  STI.reset(TheTarget->createMCSubtargetInfo(TripleName, "", ""));
+  if (!STI)
+    return makeDYNError("no subtarget info for target " + TripleName);
+
+  MII.reset(TheTarget->createMCInstrInfo());
+  if (!MII)
+    return makeDYNError("no instruction info for target " + TripleName);
+
+  MIP.reset(
+      TheTarget->createMCInstPrinter(TheTriple, 0, *MAI, *MII, *MRI));
+  if (!MIP)
+    return makeDYNError("no instprinter for target " + TripleName);
+
+  MIA.reset(TheTarget->createMCInstrAnalysis(MII.get()));
+  MOFI.reset(new MCObjectFileInfo);
+  MCCtx.reset(new MCContext(MAI.get(), MRI.get(), MOFI.get()));
+
+  DisAsm.reset(TheTarget->createMCDisassembler(*STI, *MCCtx));
+  if (!DisAsm)
+    return makeDYNError("no disassembler for target " + TripleName);
+
+  std::unique_ptr<MCRelocationInfo> RelInfo(
+      TheTarget->createMCRelocationInfo(TripleName, *MCCtx));
+  if (!RelInfo)
+    return makeDYNError("no reloc info for target " + TripleName);
+
+  // FIXME: Mach-O specific
+
+  // Explicitly use a Mach-O-specific symbolizer to give it dyld info.
+  MOS.reset(
+      new MCMachObjectSymbolizer(*MCCtx, std::move(RelInfo), MOOF, VMAddrSlide));
+
+  OD.reset(new MCObjectDisassembler(MOOF, *DisAsm, *MIA, MOS.get()));
+
+  // FIXME: We need either:
+  //  - a custom non-contiguous memory object, for every mapped region.
+  //  - a "raw" memory object, that just forwards to memory accesses.
+  // The problem with the latter is that it just crashes when we do invalid
+  // accesses. But, in general, we don't really care about undefined behavior
+  // anyway, so this isn't that big a deal right now.
+  // Just do a hack to access a big deal of reachable memory.
+  // Out of process, only the executable's sections are available.
+  if (ReadGuestMemory) {
+    OD->setFallbackRegion(0x1000,
+        ArrayRef<uint8_t>((uint8_t *)0x1000, (uint8_t *)0x7FFFFFFFFFFFFFFFULL));
+  }
+
+  MCM.reset(OD->buildEmptyModule());
+  if (!MCM)
+    return makeDYNError("unable to build the module of '" + GuestPath + "'");
+
+  // Compile the translated code for the CPU we are running on, rather than for
+  // the baseline of its architecture.
+  std::string HostCPU;
+  SmallVector<std::string, 16> HostAttrs;
+  if (getOptions().JITHostCPU) {
+    HostCPU = sys::getHostCPUName();
+    StringMap<bool> HostFeatures;
+    if (sys::getHostCPUFeatures(HostFeatures))
+      for (auto &Feature : HostFeatures)
+        HostAttrs.push_back((Feature.second ? "+" : "-") +
+                            Feature.first().str());
+  }
+
+  EngineBuilder Builder;
+  Builder.setOptLevel(CodeGenOpt::Default);
+  TM.reset(Builder.selectTarget(Triple(), "", HostCPU, HostAttrs));
+  if (!TM)
+    return makeDYNError("unable to select target machine for JIT");
+
+  const DataLayout DL = TM->createDataLayout();
+
+  const DYNTranslatorOptions &Opts = getOptions();
+  if (Opts.TranslateOptLevel > 3)
+    return makeDYNError("invalid -dyn-translate-opt level");
+  DT.reset(TheTarget->createDCTranslator(TheTriple, Ctx, DL,
+                                         Opts.TranslateOptLevel, *MII, *MRI,
+                                         *STI, *MIP));
+  if (!DT)
+    return makeDYNError("no dc translator for target " + TripleName);
+
+  // With a snapshot, keep the objects compiled from its modules too, so that
+  // restoring it skips code generation as well as translation.
+  std::string CacheDir = Opts.JITCacheDir;
+  if (CacheDir.empty() && !Opts.JITSnapshot.empty())
+    CacheDir = Opts.JITSnapshot + ".objects";
+  J = llvm::make_unique<DYNJIT>(*TM, *Target, CacheDir);
+
+  // First, get the init/fini functions, and add them to the JIT.
+  Function *InitRegSetFn = DT->getDCModule()->getOrCreateInitRegSetFunction();
+  Function *FiniRegSetFn = DT->getDCModule()->getOrCreateFiniRegSetFunction();
+  J->addModule(DT->finalizeTranslationModule());
+  Info.InitRegSetFn =
+      J->findUnmangledSymbol(InitRegSetFn->getName()).getAddress();
+  Info.FiniRegSetFn =
+      J->findUnmangledSymbol(FiniRegSetFn->getName()).getAddress();
+
+  const StructLayout *SL = DL.getStructLayout(DT->getRegSetDesc().RegSetType);
+  Info.RegSetSize = SL->getSizeInBytes();
+  std::tie(Info.PCSize, Info.PCOffset) =
+      DT->getRegSetDesc().getRegSizeOffsetInRegSet(MRI->getProgramCounter(), DL,
+                                                   *MRI);
+
+  Info.StaticInitFns = MOS->getStaticInitFunctions().vec();
+  Info.StaticExitFns = MOS->getStaticExitFunctions().vec();
+
+  auto MainEntrypoint = MOS->getMainEntrypoint();
+  if (!MainEntrypoint)
+    return makeDYNError("unable to find entrypoint.");
+  Info.MainEntrypoint = MOS->getEffectiveLoadAddr(*MainEntrypoint);
+
+  if (!Opts.JITSnapshot.empty()) {
+    StringRef GuestData = MOOF.getData();
+    raw_string_ostream OS(SnapshotKey);
+    OS << LLVM_VERSION_STRING << ' ' << TripleName << ' '
+       << toHex(SHA1::hash(ArrayRef<uint8_t>(GuestData.bytes_begin(),
+                                             GuestData.bytes_end())))
+       << ' ' << format_hex(VMAddrSlide, 18) << " -O"
+       << Opts.TranslateOptLevel;
+    OS.flush();
+
+    if (!restoreSnapshot()) {
+      RecordingSnapshot = true;
+      SnapshotWriter = llvm::make_unique<BitcodeWriter>(SnapshotBuffer);
+      Module Header("dyn-snapshot", Ctx);
+      Header.getOrInsertNamedMetadata(SnapshotKeyMDName)
+          ->addOperand(MDNode::get(Ctx, MDString::get(Ctx, SnapshotKey)));
+      SnapshotWriter->writeModule(&Header);
+    }
+  }
+
+  return Error::success();
+}
+
+Expected<std::unique_ptr<DYNSession>>
+DYNSession::create(StringRef GuestPath, uint64_t VMAddrSlide,
+                   bool ReadGuestMemory, std::unique_ptr<DYNTarget> Target) {
+  const DYNTranslatorOptions &Opts = getOptions();
+  if (!Opts.JITCacheDir.empty()) {
+    Expected<CachePruningPolicy> PolicyOrErr =
+        parseCachePruningPolicy(Opts.JITCachePolicy);
+    if (!PolicyOrErr)
+      return PolicyOrErr.takeError();
+    pruneCache(Opts.JITCacheDir, *PolicyOrErr);
+  }
+
+  auto I = llvm::make_unique<Impl>();
+  I->Target = std::move(Target);
+  if (auto Err = I->init(GuestPath, VMAddrSlide, ReadGuestMemory))
+    return std::move(Err);
+  return std::unique_ptr<DYNSession>(new DYNSession(std::move(I)));
+}
+
+DYNSession::DYNSession(std::unique_ptr<Impl> I) : I(std::move(I)) {}
+
+DYNSession::~DYNSession() {}
+
+const DYNProgramInfo &DYNSession::getProgramInfo() const { return I->Info; }
+
+JITTargetAddress DYNSession::translateAt(uint64_t GuestAddr) {
+  if (I->RecordingSnapshot && GuestAddr == getOptions().JITSnapshotAt)
+    I->saveSnapshot();
+
+  // The function may be translated already, in an earlier module or in the
+  // snapshot.
+  std::string Name = I->DT->getDCModule()->getFunctionName(GuestAddr);
+  if (JITTargetAddress Addr = I->J->findUnmangledSymbol(Name).getAddress())
+    return Addr;
+
+  {
+    NamedRegionTimer T("translate", "Translation", DYNGroupName,
+                       DYNGroupDescription, TimePassesIsEnabled);
+    translateRecursivelyAt(GuestAddr, *I->DT, *I->MCM, I->OD.get(),
+                           I->MOS.get());
+  }
+  DEBUG(dbgs() << "Translated " << format("0x%llx", GuestAddr) << " to "
+               << Name << "\n");
+  NamedRegionTimer T("jit", "JIT Compilation", DYNGroupName,
+                     DYNGroupDescription, TimePassesIsEnabled);
+  I->addModule(I->DT->finalizeTranslationModule());
+  return I->J->findUnmangledSymbol(Name).getAddress();
+}
+
+void DYNSession::programExited() {
+  if (I->RecordingSnapshot)
+    I->saveSnapshot();
+}
+
+void DYNSession::startProfiling() { I->J->startProfiling(); }
+
+void DYNSession::stopProfiling() { I->J->stopProfiling(); }
@@ -0,0 +1,128 @@
+//===-- DYNTranslator.h - Translation of guest programs ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the part of DYN that translates and compiles the guest
+// program. It is used both by the runtime injected in the guest process, and
+// by dyn-server, which does the same work out of process.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_DYN_DYNCORE_DYNTRANSLATOR_H
+#define LLVM_TOOLS_DYN_DYNCORE_DYNTRANSLATOR_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
+#include "llvm/Support/Error.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// The process that runs the translated code of a session.
+///
+/// The translated code can run in the process that translates it, or in
+/// another one, reached through the ORC remote-target RPC layer.
+class DYNTarget {
+public:
+  virtual ~DYNTarget();
+
+  /// Create the memory manager for the code of a translated module.
+  virtual std::unique_ptr<RuntimeDyld::MemoryManager>
+  createMemoryManager() = 0;
+
+  /// Return the compile callbacks used to compile functions on first call.
+  virtual orc::JITCompileCallbackManager &getCompileCallbackManager() = 0;
+
+  /// Create the manager of the stubs that call translated functions.
+  virtual std::unique_ptr<orc::IndirectStubsManager>
+  createIndirectStubsManager() = 0;
+
+  /// Return the address of the symbol \p Name outside of the translated code,
+  /// 0 if there is none.
+  virtual JITTargetAddress getSymbolAddress(const std::string &Name) = 0;
+
+  /// Return the address of the function that translated code calls to branch
+  /// to a guest address it doesn't know statically (see LowerDCTranslateAt).
+  virtual JITTargetAddress getTranslateAtAddress() = 0;
+};
+
+/// Create a target for running translated code in this process.
+///
+/// \p TranslateAtAddr is the address of the void*(void*) translate-at function.
+Expected<std::unique_ptr<DYNTarget>>
+createInProcessDYNTarget(JITTargetAddress TranslateAtAddr);
+
+/// Register the command line options of the translation. They must be
+/// registered before the options are parsed.
+void registerDYNTranslatorOptions();
+
+/// What the guest runtime needs to know to run a translated program.
+struct DYNProgramInfo {
+  /// The size of the register set the translated functions operate on.
+  uint64_t RegSetSize = 0;
+  /// Where the guest program counter is in the register set.
+  uint32_t PCOffset = 0;
+  uint32_t PCSize = 0;
+  /// The host functions that set up the register set, and that tear it down
+  /// and return the exit value of the program:
+  ///   void InitRegSet(uint8_t *RegSet, uint8_t *Stack, uint32_t StackSize,
+  ///                   uint32_t argc, char **argv);
+  ///   int FiniRegSet(uint8_t *RegSet);
+  JITTargetAddress InitRegSetFn = 0;
+  JITTargetAddress FiniRegSetFn = 0;
+  /// The guest addresses of the static initializers and finalizers, and of
+  /// the entrypoint.
+  std::vector<uint64_t> StaticInitFns;
+  std::vector<uint64_t> StaticExitFns;
+  uint64_t MainEntrypoint = 0;
+};
+
+/// The translation of a guest program, and the JIT compiling it.
+class DYNSession {
+public:
+  /// \brief Set up the translation of the guest executable at \p GuestPath,
+  ///        loaded \p VMAddrSlide bytes away from its preferred address.
+  ///
+  /// If \p ReadGuestMemory is set, this process is the guest: code outside of
+  /// the executable's sections is read directly from memory.
+  static Expected<std::unique_ptr<DYNSession>>
+  create(StringRef GuestPath, uint64_t VMAddrSlide, bool ReadGuestMemory,
+         std::unique_ptr<DYNTarget> Target);
+
+  ~DYNSession();
+
+  const DYNProgramInfo &getProgramInfo() const;
+
+  /// \brief Translate the guest function at \p GuestAddr, and what it calls,
+  ///        if not done already, and return the host address of its code.
+  JITTargetAddress translateAt(uint64_t GuestAddr);
+
+  /// \brief Tell the session that the program exited, so that it can save
+  ///        the -dyn-snapshot if it didn't already.
+  void programExited();
+
+  /// Start sampling the translated code run by the current thread.
+  void startProfiling();
+
+  /// Stop sampling, and report the hottest guest functions.
+  void stopProfiling();
+
+private:
+  struct Impl;
+  explicit DYNSession(std::unique_ptr<Impl> I);
+  std::unique_ptr<Impl> I;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_TOOLS_DYN_DYNCORE_DYNTRANSLATOR_H
@@ -1,268 +1,276 @@
-#define DEBUG_TYPE "dyn"
 #include "dyncore.h"
-#include "llvm/ADT/StringExtras.h"
-#include "llvm/ADT/Triple.h"
-#include "llvm/Analysis/ValueTracking.h"
-#include "llvm/DC/DCFunction.h"
-#include "llvm/DC/DCTranslator.h"
-#include "llvm/DC/DCTranslatorUtils.h"
-#include "llvm/DC/LowerDCTranslateAt.h"
-#include "llvm/ExecutionEngine/ExecutionEngine.h"
-#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
-#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
-#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
-#include "llvm/ExecutionEngine/Orc/LazyEmittingLayer.h"
-#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "DYNRemote.h"
+#include "DYNTranslator.h"
+#include "llvm/ExecutionEngine/Orc/OrcABISupport.h"
+#include "llvm/ExecutionEngine/Orc/OrcRemoteTargetServer.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
-#include "llvm/ExecutionEngine/SectionMemoryManager.h"
-#include "llvm/IR/Instructions.h"
-#include "llvm/MC/MCAnalysis/MCFunction.h"
-#include "llvm/MC/MCAnalysis/MCModule.h"
-#include "llvm/MC/MCAnalysis/MCObjectDisassembler.h"
-#include "llvm/MC/MCAnalysis/MCObjectSymbolizer.h"
-#include "llvm/MC/MCAsmInfo.h"
-#include "llvm/MC/MCContext.h"
-#include "llvm/MC/MCDisassembler/MCDisassembler.h"
-#include "llvm/MC/MCInst.h"
-#include "llvm/MC/MCInstBuilder.h"
-#include "llvm/MC/MCInstPrinter.h"
-#include "llvm/MC/MCInstrAnalysis.h"
-#include "llvm/MC/MCInstrInfo.h"
-#include "llvm/MC/MCObjectFileInfo.h"
-#include "llvm/MC/MCRegisterInfo.h"
-#include "llvm/MC/MCSubtargetInfo.h"
-#include "llvm/Object/MachO.h"
-#include "llvm/Object/MachOUniversal.h"
-#include "llvm/Object/ObjectFile.h"
-#include "llvm/Pass.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
-#include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
-#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
-#include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
+#include <cstring>
 #include <dlfcn.h>
+#include <functional>
 #include <mach-o/dyld.h>
 #include <memory>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DEBUG_TYPE "dyn"
 
 // See dyncore.h, this makes sure the DYNCore library is loaded.
 extern "C" void LLVMLinkInDYNCore() {}
 
 using namespace llvm;
-using namespace object;
 using namespace orc;
 
-static std::string TripleName;
+#ifdef __x86_64__
+typedef OrcX86_64_SysV HostOrcArch;
+#else
+typedef OrcGenericABI HostOrcArch;
+#endif
 
 static StringRef ToolName;
 
-static const Target *getTarget(const ObjectFile &Obj) {
-  // Figure out the target triple.
-  Triple TheTriple("unknown-unknown-unknown");
-  if (TripleName.empty()) {
-    TheTriple.setArch(Triple::ArchType(Obj.getArch()));
-    // TheTriple defaults to ELF, and COFF doesn't have an environment:
-    // the best we can do here is indicate that it is mach-o.
-    if (Obj.isMachO())
-      TheTriple.setObjectFormat(Triple::MachO);
-  } else {
-    TheTriple.setTriple(TripleName);
-  }
+static ExitOnError ExitOnErr;
 
-  // Get the Target.
-  std::string Error;
-  const Target *TheTarget = TargetRegistry::lookupTarget("", TheTriple, Error);
-  if (!TheTarget) {
-    errs() << ToolName << ": " << Error;
-    return 0;
-  }
+static cl::opt<bool>
+    JITProfile("dyn-profile",
+               cl::desc("Sample the translated code, and report the hottest "
+                        "guest functions on exit"),
+               cl::init(false));
 
-  // Update the triple name and return the found target.
-  TripleName = TheTriple.getTriple();
-  return TheTarget;
-}
+static cl::opt<std::string>
+    ServerPath("dyn-server",
+               cl::desc("Translate in a dyn-server process started from this "
+                        "executable, rather than in the guest process"),
+               cl::init(""));
 
-static OwningBinary<MachOObjectFile> openObjectFileAtPath(StringRef Path) {
-  Expected<OwningBinary<Binary>> BinaryOrErr = createBinary(Path);
-  if (auto E = BinaryOrErr.takeError()) {
-    logAllUnhandledErrors(std::move(E), errs(),
-                          (ToolName + ": '" + Path + "': ").str());
-    exit(1);
-  }
+static cl::list<std::string>
+    ServerArgs("dyn-server-arg",
+               cl::desc("Pass this argument to the -dyn-server process"),
+               cl::ZeroOrMore);
 
-  std::unique_ptr<Binary> Bin;
-  std::unique_ptr<MemoryBuffer> Buf;
-  std::tie(Bin, Buf) = BinaryOrErr.get().takeBinary();
-
-  auto *BinPtr = Bin.release();
-  std::unique_ptr<MachOObjectFile> MOOF;
-
-  if (auto *FatBinPtr = dyn_cast<MachOUniversalBinary>(BinPtr)) {
-    for (auto &Obj : FatBinPtr->objects()) {
-      // FIXME: Realistically, we only support x86_64 for now.
-      // This won't be hardest place to fix.
-      if (Obj.getArchFlagName() != "x86_64")
-        continue;
-      auto SliceOrErr = Obj.getAsObjectFile();
-      if (auto E = SliceOrErr.takeError()) {
-        logAllUnhandledErrors(std::move(E), errs(),
-                              (ToolName + ": '" + Path + "': ").str());
-        exit(1);
-      }
-      MOOF = std::move(SliceOrErr.get());
-      break;
-    }
-  } else if (auto *MOOFPtr = dyn_cast<MachOObjectFile>(BinPtr)) {
-    MOOF.reset(MOOFPtr);
-  }
+static cl::opt<std::string>
+    ServerSocket("dyn-server-socket",
+                 cl::desc("Translate in the dyn-server listening on this "
+                          "unix domain socket"),
+                 cl::init(""));
 
-  if (!MOOF) {
-    errs() << ToolName << ": '" << Path << "': "
-           << "Unrecognized file type.\n";
-    exit(1);
+static uint64_t loadRegFromSet(uint8_t *RegSet, unsigned Offset, unsigned Size){
+  RegSet += Offset;
+  switch (Size) {
+  default:
+    llvm_unreachable("Loading unhandled size from register set!");
+    // FIXME: Is this ever unaligned?  shouldn't be, since the StructType should
+    // have its members properly aligned
+  case 1: return *(uint8_t  *)RegSet;
+  case 2: return *(uint16_t *)RegSet;
+  case 4: return *(uint32_t *)RegSet;
+  case 8: return *(uint64_t *)RegSet;
   }
-
-  return OwningBinary<MachOObjectFile>(std::move(MOOF), std::move(Buf));
 }
 
-static void *__llvm_dc_translate_at(void *addr);
+/// Translate, if needed, the guest function at an address, and return the
+/// host address of its code. Either translates in this process, or asks the
+/// translation server.
+static std::function<JITTargetAddress(uint64_t)> TranslateAtImpl;
 
-template <typename T>
-static std::vector<T> singletonSet(T t) {
-  std::vector<T> Vec;
-  Vec.push_back(std::move(t));
-  return Vec;
+// FIXME: We need to handle cache invalidation when functions are freed.
+//static DenseMap<void *, void *> TranslationCache(128);
+
+static void *__llvm_dc_translate_at(void *addr) {
+  DEBUG(dbgs() << "__llvm_dc_translate_at " << addr << "\n");
+  return (void *)(intptr_t)TranslateAtImpl((uint64_t)addr);
 }
 
-class DYNJIT {
-public:
-  typedef RTDyldObjectLinkingLayer ObjLayerT;
-  typedef IRCompileLayer<ObjLayerT, SimpleCompiler> CompileLayerT;
-  typedef LazyEmittingLayer<CompileLayerT> LazyEmitLayerT;
+/// Run the translated program described by \p Info, and return its exit
+/// value.
+static int runTranslatedProgram(const DYNProgramInfo &Info, int argc,
+                                char **argv) {
+  std::vector<uint8_t> RegSet(Info.RegSetSize);
+  const unsigned StackSize = 4096 * 1024;
+  std::vector<uint8_t> StackPtr(StackSize);
 
-  typedef LazyEmitLayerT::ModuleSetHandleT ModuleHandleT;
+  auto InitRegSetFnFP =
+      (void (*)(uint8_t *, uint8_t *, uint32_t, uint32_t, char **))
+        (intptr_t)Info.InitRegSetFn;
+  auto RunInitRegSet = [&]() {
+    InitRegSetFnFP(RegSet.data(), StackPtr.data(), StackSize, argc, argv);
+  };
 
-  DYNJIT(TargetMachine &TM)
-      : DL(TM.createDataLayout()),
-        CompileLayer(ObjectLayer, SimpleCompiler(TM)),
-        LazyEmitLayer(CompileLayer) {}
+  RunInitRegSet();
 
-  std::string mangle(const std::string &Name) {
-    std::string MangledName;
-    {
-      raw_string_ostream MangledNameStream(MangledName);
-      Mangler::getNameWithPrefix(MangledNameStream, Name, DL);
+  auto RunGuestFunction = [&](uint64_t GuestAddr) {
+    auto FnPointer =
+        (void (*)(uint8_t *))(intptr_t)TranslateAtImpl(GuestAddr);
+    DEBUG(dbgs() << "Executing " << format("0x%llx", GuestAddr) << " at "
+                 << (void *)FnPointer << "\n");
+    return FnPointer(RegSet.data());
+  };
+
+  auto RunStaticInitExit = [&](ArrayRef<uint64_t> Fns) {
+    for (auto FnAddr : Fns) {
+      RunGuestFunction(FnAddr);
+      // Reset the register state. Since we don't look at the return address,
+      // this takes care of faking the push/pop.
+      RunInitRegSet();
     }
-    return MangledName;
-  }
+  };
 
-  void runPassesOnModule(Module &M) {
-    if (!LowerDCTranslateAtPass) {
-      auto *PI8Ty = Type::getInt8PtrTy(M.getContext());
-      auto *I64Ty = Type::getInt64Ty(M.getContext());
+  RunStaticInitExit(Info.StaticInitFns);
 
-      FunctionType *CallbackType =
-          FunctionType::get(PI8Ty, PI8Ty, /*isVarArg=*/false);
+  // Now we can start running real code.
+  uint64_t CurPC = Info.MainEntrypoint;
+  assert(dlsym(RTLD_MAIN_ONLY, "main") == (void *)CurPC);
+  do {
+    RunGuestFunction(CurPC);
+    CurPC = loadRegFromSet(RegSet.data(), Info.PCOffset, Info.PCSize);
+  } while (CurPC != ~0ULL);
 
-      Value *TranslateAtFn = ConstantExpr::getIntToPtr(
-          ConstantInt::get(
-              I64Ty, reinterpret_cast<uintptr_t>(&__llvm_dc_translate_at)),
-          CallbackType->getPointerTo());
+  auto FiniRegSetFnFP = (int (*)(uint8_t *))(intptr_t)Info.FiniRegSetFn;
+  int ExitVal = FiniRegSetFnFP(RegSet.data());
 
-      LowerDCTranslateAtPass.reset(createLowerDCTranslateAtPass(TranslateAtFn));
+  RunStaticInitExit(Info.StaticExitFns);
 
-      PM.add(LowerDCTranslateAtPass.get());
-    }
+  return ExitVal;
+}
 
-    PM.run(M);
-  }
+static Error errnoToError() {
+  return errorCodeToError(std::error_code(errno, std::generic_category()));
+}
 
-  ModuleHandleT addModule(Module *M) {
-    // Dump the IR we found.
-    DEBUG(M->dump());
-
-    runPassesOnModule(*M);
-
-    // We need a memory manager to allocate memory and resolve symbols for this
-    // new module. Create one that resolves symbols by looking back into the
-    // JIT.
-    auto Resolver = createLambdaResolver(
-        [&](const std::string &Name) {
-          if (auto Sym = findSymbol(Name))
-            return JITSymbol(Sym.getAddress(), Sym.getFlags());
-          else if (auto Addr =
-                       RTDyldMemoryManager::getSymbolAddressInProcess(Name))
-            return JITSymbol(Addr, JITSymbolFlags::Exported);
-          return JITSymbol(nullptr);
-        },
-        [](const std::string &S) { return nullptr; });
-
-    return LazyEmitLayer.addModuleSet(singletonSet(std::move(M)),
-                                      make_unique<SectionMemoryManager>(),
-                                      std::move(Resolver));
+/// Connect to the translation server: either the one listening on
+/// -dyn-server-socket, or a new -dyn-server process. Return the socket, and
+/// the pid of the server if we started it.
+static Expected<std::pair<int, pid_t>> connectToServer() {
+  if (!ServerSocket.empty()) {
+    sockaddr_un Addr;
+    if (ServerSocket.size() >= sizeof(Addr.sun_path))
+      return errorCodeToError(
+          std::make_error_code(std::errc::filename_too_long));
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sun_family = AF_UNIX;
+    strncpy(Addr.sun_path, ServerSocket.c_str(), sizeof(Addr.sun_path) - 1);
+
+    int FD = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (FD < 0)
+      return errnoToError();
+    if (connect(FD, (sockaddr *)&Addr, sizeof(Addr)) < 0) {
+      Error Err = errnoToError();
+      close(FD);
+      return std::move(Err);
+    }
+    return std::make_pair(FD, (pid_t)0);
   }
 
-  void removeModule(ModuleHandleT H) { LazyEmitLayer.removeModuleSet(H); }
+  int FDs[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, FDs) < 0)
+    return errnoToError();
 
-  JITSymbol findSymbol(const std::string &Name) {
-    return LazyEmitLayer.findSymbol(Name, true);
+  pid_t Pid = fork();
+  if (Pid < 0) {
+    Error Err = errnoToError();
+    close(FDs[0]);
+    close(FDs[1]);
+    return std::move(Err);
   }
 
-  JITSymbol findUnmangledSymbol(const std::string Name) {
-    return findSymbol(mangle(Name));
+  if (Pid == 0) {
+    // The server uses the same socket for both directions.
+    close(FDs[0]);
+    std::string FD = std::to_string(FDs[1]);
+    std::vector<const char *> Args;
+    Args.push_back(ServerPath.c_str());
+    for (auto &Arg : ServerArgs)
+      Args.push_back(Arg.c_str());
+    Args.push_back(FD.c_str());
+    Args.push_back(FD.c_str());
+    Args.push_back(nullptr);
+    execv(ServerPath.c_str(), const_cast<char **>(Args.data()));
+    errs() << ToolName << ": unable to execute '" << ServerPath
+           << "': " << strerror(errno) << "\n";
+    _exit(1);
   }
 
-private:
-  const DataLayout DL;
-  ObjLayerT ObjectLayer;
-  CompileLayerT CompileLayer;
-  LazyEmitLayerT LazyEmitLayer;
+  close(FDs[1]);
+  return std::make_pair(FDs[0], Pid);
+}
 
-  std::unique_ptr<Pass> LowerDCTranslateAtPass;
-  legacy::PassManager PM;
-};
+/// Run the program translated by a translation server, and return its exit
+/// value. This process is an ORC remote target that the server writes the
+/// translated code into, and that asks the server for the translation of
+/// every guest address it branches to.
+static int runWithServer(StringRef GuestPath, uint64_t VMAddrSlide, int argc,
+                         char **argv) {
+  int FD;
+  pid_t ServerPid;
+  std::tie(FD, ServerPid) = ExitOnErr(connectToServer());
+
+  auto SymbolLookup = [](const std::string &Name) {
+    return RTDyldMemoryManager::getSymbolAddressInProcess(Name);
+  };
 
-static uint64_t loadRegFromSet(uint8_t *RegSet, unsigned Offset, unsigned Size){
-  RegSet += Offset;
-  switch (Size) {
-  default:
-    llvm_unreachable("Loading unhandled size from register set!");
-    // FIXME: Is this ever unaligned?  shouldn't be, since the StructType should
-    // have its members properly aligned
-  case 1: return *(uint8_t  *)RegSet;
-  case 2: return *(uint16_t *)RegSet;
-  case 4: return *(uint32_t *)RegSet;
-  case 8: return *(uint64_t *)RegSet;
-  }
-}
+  auto RegisterEHFrames = [](uint8_t *Addr, uint32_t Size) {
+    RTDyldMemoryManager::registerEHFramesInProcess(Addr, Size);
+  };
 
-static DCTranslator *__dc_DT;
-static MCModule *__dc_MCM;
-static MCObjectSymbolizer *__dc_MOS;
-static MCObjectDisassembler *__dc_MCOD;
-static DYNJIT *__dc_JIT;
+  auto DeregisterEHFrames = [](uint8_t *Addr, uint32_t Size) {
+    RTDyldMemoryManager::deregisterEHFramesInProcess(Addr, Size);
+  };
 
-// FIXME: We need to handle cache invalidation when functions are freed.
-//static DenseMap<void *, void *> TranslationCache(128);
+  dyn::FDRawChannel Channel(FD, FD);
+  typedef remote::OrcRemoteTargetServer<dyn::FDRawChannel, HostOrcArch>
+      JITServer;
+  JITServer Server(Channel, SymbolLookup, RegisterEHFrames,
+                   DeregisterEHFrames);
+
+  Server.addHandler<dyn::GetGuestInfo>([&]() {
+    return std::make_tuple(
+        GuestPath.str(), VMAddrSlide,
+        static_cast<JITTargetAddress>(
+            reinterpret_cast<uintptr_t>(&__llvm_dc_translate_at)));
+  });
+
+  int ExitVal = 1;
+  Server.addHandler<dyn::RunGuest>(
+      [&](uint64_t RegSetSize, uint32_t PCOffset, uint32_t PCSize,
+          JITTargetAddress InitRegSetFn, JITTargetAddress FiniRegSetFn,
+          std::vector<uint64_t> StaticInitFns,
+          std::vector<uint64_t> StaticExitFns,
+          uint64_t MainEntrypoint) -> int32_t {
+        DYNProgramInfo Info;
+        Info.RegSetSize = RegSetSize;
+        Info.PCOffset = PCOffset;
+        Info.PCSize = PCSize;
+        Info.InitRegSetFn = InitRegSetFn;
+        Info.FiniRegSetFn = FiniRegSetFn;
+        Info.StaticInitFns = std::move(StaticInitFns);
+        Info.StaticExitFns = std::move(StaticExitFns);
+        Info.MainEntrypoint = MainEntrypoint;
+        ExitVal = runTranslatedProgram(Info, argc, argv);
+        return ExitVal;
+      });
+
+  // The server handles our calls while it waits for RunGuest to return.
+  TranslateAtImpl = [&](uint64_t GuestAddr) {
+    return ExitOnErr(Server.callB<dyn::TranslateAt>(GuestAddr));
+  };
 
-static void *__llvm_dc_translate_at(void *addr) {
-  void *ptr = nullptr;
-  translateRecursivelyAt((uint64_t)addr, *__dc_DT, *__dc_MCM, __dc_MCOD, __dc_MOS);
-  Function *F = __dc_DT->getDCModule()->getOrCreateFunction((uint64_t)addr);
-  DEBUG(dbgs() << "__llvm_dc_translate_at " << addr << "\n");
-  DEBUG(dbgs() << "Jumping to " << F->getName() << "\n");
-  ptr = (void*)__dc_JIT->findUnmangledSymbol(F->getName()).getAddress();
-  if (!ptr) {
-    __dc_JIT->addModule(__dc_DT->finalizeTranslationModule());
-    auto FnSymbol = __dc_JIT->findUnmangledSymbol(F->getName());
-    ptr = (void*)FnSymbol.getAddress();
-  }
-  return ptr;
+  while (!Server.receivedTerminate())
+    ExitOnErr(Server.handleOne());
+
+  close(FD);
+  if (ServerPid)
+    waitpid(ServerPid, nullptr, 0);
+  return ExitVal;
 }
 
 // FIXME: This is all mach-o hacks to get this working.
@@ -301,72 +309,12 @@ void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
   unsetenv("DYLD_INSERT_LIBRARIES");
 
   ToolName = "dyn";
+  ExitOnErr.setBanner(ToolName.str() + ": ");
+  registerDYNTranslatorOptions();
   cl::ParseEnvironmentOptions(ToolName.str().c_str(), "DCDYN_OPTIONS");
 
   std::string InputFilename = argv[0];
 
-  OwningBinary<MachOObjectFile> MOOFAndBuffer =
-      openObjectFileAtPath(InputFilename);
-  MachOObjectFile &MOOF = *MOOFAndBuffer.getBinary();
-
-  const Target *TheTarget = getTarget(MOOF);
-
-  // FIXME: why are there unique_ptrs everywhere?
-
-  std::unique_ptr<const MCRegisterInfo> MRI(
-    TheTarget->createMCRegInfo(TripleName));
-  if (!MRI) {
-    errs() << "error: no register info for target " << TripleName << "\n";
-    exit(1);
-  }
-
-  // Set up disassembler.
-  std::unique_ptr<const MCAsmInfo> MAI(
-    TheTarget->createMCAsmInfo(*MRI, TripleName));
-  if (!MAI) {
-    errs() << "error: no assembly info for target " << TripleName << "\n";
-    exit(1);
-  }
-
-  std::unique_ptr<const MCSubtargetInfo> STI(
-      TheTarget->createMCSubtargetInfo(TripleName, "", ""));
-  if (!STI) {
-    errs() << "error: no subtarget info for target " << TripleName << "\n";
-    exit(1);
-  }
-
-  std::unique_ptr<const MCInstrInfo> MII(TheTarget->createMCInstrInfo());
-  if (!MII) {
-    errs() << "error: no instruction info for target " << TripleName << "\n";
-    exit(1);
-  }
-
-  std::unique_ptr<MCInstPrinter> MIP(
-      TheTarget->createMCInstPrinter(Triple(TripleName), 0, *MAI, *MII, *MRI));
-  if (!MIP) {
-    errs() << "error: no instprinter for target " << TripleName << "\n";
-    exit(1);
-  }
-
-  std::unique_ptr<const MCInstrAnalysis> MIA(
-      TheTarget->createMCInstrAnalysis(MII.get()));
-  std::unique_ptr<const MCObjectFileInfo> MOFI(new MCObjectFileInfo);
-  MCContext MCCtx(MAI.get(), MRI.get(), MOFI.get());
-
-  std::unique_ptr<MCDisassembler> DisAsm(
-      TheTarget->createMCDisassembler(*STI, MCCtx));
-  if (!DisAsm) {
-    errs() << "error: no disassembler for target " << TripleName << "\n";
-    exit(1);
-  }
-
-  std::unique_ptr<MCRelocationInfo> RelInfo(
-      TheTarget->createMCRelocationInfo(TripleName, MCCtx));
-  if (!RelInfo) {
-    errs() << "error: no reloc info for target " << TripleName << "\n";
-    exit(1);
-  }
-
   // FIXME: Mach-O specific
 
   // FIXME: We need to handle shared libraries. For now everything we do is only
@@ -374,149 +322,35 @@ void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
   // The first image is the main executable.
   uint64_t VMAddrSlide = _dyld_get_image_vmaddr_slide(0);
 
-  // Explicitly use a Mach-O-specific symbolizer to give it dyld info.
-  std::unique_ptr<MCMachObjectSymbolizer> MOS(
-      new MCMachObjectSymbolizer(MCCtx, std::move(RelInfo), MOOF, VMAddrSlide));
-
-  std::unique_ptr<MCObjectDisassembler> OD(
-      new MCObjectDisassembler(MOOF, *DisAsm, *MIA, MOS.get()));
-
-  // FIXME: We need either:
-  //  - a custom non-contiguous memory object, for every mapped region.
-  //  - a "raw" memory object, that just forwards to memory accesses.
-  // The problem with the latter is that it just crashes when we do invalid
-  // accesses. But, in general, we don't really care about undefined behavior
-  // anyway, so this isn't that big a deal right now.
-  // Just do a hack to access a big deal of reachable memory.
-  {
-    OD->setFallbackRegion(0x1000,
-        ArrayRef<uint8_t>((uint8_t *)0x1000, (uint8_t *)0x7FFFFFFFFFFFFFFFULL));
-  }
-
-  std::unique_ptr<MCModule> MCM(OD->buildEmptyModule());
-
-  if (!MCM)
-    exit(1);
-
-  EngineBuilder Builder;
-  Builder.setOptLevel(CodeGenOpt::Default);
-  TargetMachine *TM = Builder.selectTarget();
-  if (!TM)
-    llvm_unreachable("Unable to select target machine for JIT!");
-
-  const DataLayout DL = TM->createDataLayout();
-  LLVMContext Ctx;
-
-  std::unique_ptr<DCTranslator> DT(TheTarget->createDCTranslator(
-      Triple(TripleName), Ctx, DL, /*OptLevel=*/2, *MII, *MRI, *STI, *MIP));
-  if (!DT) {
-    errs() << "error: no dc translator for target " << TripleName << "\n";
-    exit(1);
-  }
-
-  // Add the program's symbols into the JIT's search space.
-  if (sys::DynamicLibrary::LoadLibraryPermanently(nullptr)) {
-    errs() << "error: unable to load program symbols.\n";
-    exit(1);
-  }
-
-  DYNJIT J(*TM);
-
-  __dc_DT = DT.get();
-  __dc_MCM = MCM.get();
-  __dc_MOS = MOS.get();
-  __dc_MCOD = OD.get();
-  __dc_JIT = &J;
-
-  // Now run it !
-
-  // First, get the init/fini functions.
-  Function *InitRegSetFn = DT->getDCModule()->getOrCreateInitRegSetFunction();
-  Function *FiniRegSetFn = DT->getDCModule()->getOrCreateFiniRegSetFunction();
-
-  // Add these to the JIT.
-  J.addModule(DT->finalizeTranslationModule());
-
-  const StructLayout *SL = DL.getStructLayout(DT->getRegSetDesc().RegSetType);
-  std::vector<uint8_t> RegSet(SL->getSizeInBytes());
-  const unsigned StackSize = 4096 * 1024;
-  std::vector<uint8_t> StackPtr(StackSize);
-
-  unsigned RegSetPCSize, RegSetPCOffset;
-  std::tie(RegSetPCSize, RegSetPCOffset) =
-      DT->getRegSetDesc().getRegSizeOffsetInRegSet(MRI->getProgramCounter(), DL,
-                                                   *MRI);
-
-  auto InitRegSetFnFP =
-      (void (*)(uint8_t *, uint8_t *, uint32_t, uint32_t, char **))
-        (intptr_t)J.findUnmangledSymbol(InitRegSetFn->getName()).getAddress();
-  auto RunInitRegSet = [&]() {
-    InitRegSetFnFP(RegSet.data(), StackPtr.data(), StackSize, argc, argv);
-  };
-
-  RunInitRegSet();
-
-  auto GetIRFunction = [&](Function *Fn) {
-    auto FnSymbol = J.findUnmangledSymbol(Fn->getName());
-    uint64_t Addr = FnSymbol.getAddress();
-    DEBUG(dbgs() << "Jitted " << (void *)Addr << " for " << Fn->getName()
-                 << "\n");
-    return Addr;
-  };
-
-  auto RunIRFunction = [&](Function *Fn) {
-    DEBUG(dbgs() << "Jumping to " << Fn->getName() << "\n");
-    auto FnPointer = (void (*)(uint8_t *))(intptr_t)GetIRFunction(Fn);
-    return FnPointer(RegSet.data());
-  };
-
-  // Translate all static init functions.
-  auto TranslateAndRunStaticInitExit = [&](ArrayRef<uint64_t> Fns) {
-    translateRecursivelyAt(Fns, *DT, *MCM, OD.get(), MOS.get());
-
-    // Add these to the JIT, and run them.
-    Module *M = DT->finalizeTranslationModule();
-    DEBUG(M->print(dbgs(), nullptr));
-    J.addModule(M);
-    for (auto FnAddr : Fns) {
-      auto *Fn = DT->getDCModule()->getOrCreateFunction(FnAddr);
-      DEBUG(dbgs() << "Executing static init/fini function " << Fn->getName()
-                   << "\n");
-      RunIRFunction(Fn);
-      // Reset the register state. Since we don't look at the return address,
-      // this takes care of faking the push/pop.
-      RunInitRegSet();
-    }
-  };
-
-  TranslateAndRunStaticInitExit(MOS->getStaticInitFunctions());
-
-  auto MainEntrypoint = MOS->getMainEntrypoint();
-  if (!MainEntrypoint) {
-    errs() << "error: unable to find entrypoint.\n";
-    exit(1);
+  int exitVal;
+  if (!ServerPath.empty() || !ServerSocket.empty()) {
+    if (JITProfile)
+      errs() << "warning: -dyn-profile is not supported with a translation "
+                "server\n";
+    exitVal = runWithServer(InputFilename, VMAddrSlide, argc, argv);
+  } else {
+    std::unique_ptr<DYNTarget> Target =
+        ExitOnErr(createInProcessDYNTarget(static_cast<JITTargetAddress>(
+            reinterpret_cast<uintptr_t>(&__llvm_dc_translate_at))));
+    std::unique_ptr<DYNSession> Session = ExitOnErr(
+        DYNSession::create(InputFilename, VMAddrSlide,
+                           /*ReadGuestMemory=*/true, std::move(Target)));
+    TranslateAtImpl = [&](uint64_t GuestAddr) {
+      return Session->translateAt(GuestAddr);
+    };
+
+    if (JITProfile)
+      Session->startProfiling();
+
+    // Now run it !
+    exitVal = runTranslatedProgram(Session->getProgramInfo(), argc, argv);
+
+    Session->programExited();
+    Session->stopProfiling();
   }
 
-  // Now we can start running real code.
-  uint64_t CurPC = MOS->getEffectiveLoadAddr(*MainEntrypoint);
-  assert(dlsym(RTLD_MAIN_ONLY, "main") == (void *)CurPC);
-  do {
-    translateRecursivelyAt(CurPC, *DT, *MCM, OD.get(), MOS.get());
-    auto *Fn = DT->getDCModule()->getOrCreateFunction(CurPC);
-    DEBUG(dbgs() << "Executing function " << Fn->getName() << "\n");
-    J.addModule(DT->finalizeTranslationModule());
-    RunIRFunction(Fn);
-    CurPC = loadRegFromSet(RegSet.data(), RegSetPCOffset, RegSetPCSize);
-  } while (CurPC != ~0ULL);
-
-  auto FiniRegSetFnFP =
-      (int (*)(uint8_t *))(intptr_t)J.findUnmangledSymbol(
-                                          FiniRegSetFn->getName()).getAddress();
-  auto RunFiniRegSet = [&]() { return FiniRegSetFnFP(RegSet.data()); };
-
-  int exitVal = RunFiniRegSet();
-
-  TranslateAndRunStaticInitExit(MOS->getStaticExitFunctions());
-
+  // exit() doesn't unwind to Y: print the timer reports and write the trace
+  // file now.
+  llvm_shutdown();
   exit(exitVal);
 }
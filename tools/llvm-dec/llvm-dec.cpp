@@ -20,15 +20,18 @@
 #include "llvm/MC/MCObjectFileInfo.h"
 #include "llvm/MC/MCRegisterInfo.h"
 #include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Host.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
 
 using namespace llvm;
 using namespace object;
@@ -40,6 +43,20 @@ static cl::opt<std::string>
 TripleName("triple", cl::desc("Target triple to disassemble for, "
                               "see -version for available targets"));
 
+static cl::opt<std::string>
+MCPU("mcpu",
+     cl::desc("Target a specific cpu type with the translated code "
+              "(-mcpu=help for details, -mcpu=native for the host cpu)"),
+     cl::value_desc("cpu-name"),
+     cl::init(""));
+
+static cl::list<std::string>
+MAttrs("mattr",
+       cl::CommaSeparated,
+       cl::desc("Target specific attributes of the translated code "
+                "(-mattr=help for details)"),
+       cl::value_desc("a1,+a2,-a3,..."));
+
 // cl::opt<uint64_t> isn't currently supported (PR19665).
 static cl::opt<unsigned long long>
 TranslationEntrypoint("entrypoint",
@@ -93,6 +110,7 @@ int main(int argc, char **argv) {
   PrettyStackTraceProgram X(argc, argv);
   llvm_shutdown_obj Y;
 
+  InitializeAllTargets();
   InitializeAllTargetInfos();
   InitializeAllTargetDCs();
   InitializeAllTargetMCs();
@@ -198,8 +216,29 @@ int main(int argc, char **argv) {
   }
 
 
-  // FIXME: should we have a non-default datalayout?
-  DataLayout DL("");
+  // The translated code is meant to be compiled again: describe the target it
+  // will be compiled for, so that the IR uses its layout, and so that later
+  // compiles schedule and select for the requested CPU.
+  std::string CPU = MCPU;
+  SubtargetFeatures Features;
+  if (CPU == "native") {
+    CPU = sys::getHostCPUName();
+    StringMap<bool> HostFeatures;
+    if (sys::getHostCPUFeatures(HostFeatures))
+      for (auto &Feature : HostFeatures)
+        Features.AddFeature(Feature.first(), Feature.second);
+  }
+  for (auto &Attr : MAttrs)
+    Features.AddFeature(Attr);
+  std::string FeaturesStr = Features.getString();
+
+  std::unique_ptr<TargetMachine> TM(TheTarget->createTargetMachine(
+      TripleName, CPU, FeaturesStr, TargetOptions(), None));
+  if (!TM) {
+    errs() << "error: no target machine for target " << TripleName << "\n";
+    return 1;
+  }
+  const DataLayout DL = TM->createDataLayout();
 
   LLVMContext Ctx;
 
@@ -226,6 +265,15 @@ int main(int argc, char **argv) {
   translateRecursivelyAt(FuncEntrypoints, *DT, *MCM, OD.get(), MOS.get());
 
   Module *M = DT->finalizeTranslationModule();
+  M->setTargetTriple(TripleName);
+  for (auto &F : *M) {
+    if (F.isDeclaration())
+      continue;
+    if (!CPU.empty())
+      F.addFnAttr("target-cpu", CPU);
+    if (!FeaturesStr.empty())
+      F.addFnAttr("target-features", FeaturesStr);
+  }
   M->print(outs(), /*AnnotWriter=*/nullptr);
 
   return 0;
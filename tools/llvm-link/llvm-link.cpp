@@ -32,11 +32,14 @@
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Transforms/IPO/FunctionImport.h"
 #include "llvm/Transforms/IPO/Internalize.h"
 #include "llvm/Transforms/Utils/FunctionImportUtils.h"
 
+#include <deque>
 #include <memory>
 #include <utility>
 using namespace llvm;
@@ -110,6 +113,14 @@ static cl::opt<bool> PreserveAssemblyUseListOrder(
     cl::desc("Preserve use-list order when writing LLVM assembly."),
     cl::init(false), cl::Hidden);
 
+static cl::opt<unsigned> NumThreads(
+    "num-threads",
+    cl::desc("Number of threads parsing the input files ahead of the link "
+             "(0 = one per hardware thread)"),
+    cl::init(1));
+static cl::alias NumThreadsA("j", cl::desc("Alias for -num-threads"),
+                             cl::aliasopt(NumThreads));
+
 static ExitOnError ExitOnErr;
 
 // Read the specified bitcode file in and return it. This routine searches the
@@ -182,25 +193,131 @@ Module &ModuleLazyLoaderCache::operator()(const char *argv0,
 }
 } // anonymous namespace
 
+/// Print \p DI to the raw_ostream \p C, or to errs() if \p C is null.
 static void diagnosticHandler(const DiagnosticInfo &DI, void *C) {
+  raw_ostream &OS = C ? *static_cast<raw_ostream *>(C) : errs();
   unsigned Severity = DI.getSeverity();
   switch (Severity) {
   case DS_Error:
-    errs() << "ERROR: ";
+    OS << "ERROR: ";
     break;
   case DS_Warning:
     if (SuppressWarnings)
       return;
-    errs() << "WARNING: ";
+    OS << "WARNING: ";
     break;
   case DS_Remark:
   case DS_Note:
     llvm_unreachable("Only expecting warnings and errors");
   }
 
-  DiagnosticPrinterRawOStream DP(errs());
+  DiagnosticPrinterRawOStream DP(OS);
   DI.print(DP);
-  errs() << '\n';
+  OS << '\n';
+}
+
+namespace {
+
+/// Parses the input files on a thread pool, ahead of the link.
+///
+/// Modules cannot move between LLVMContexts, so every file is parsed, fully
+/// materialized and upgraded in a private context, then written back to an
+/// in-memory bitcode buffer. The linker thread only has to (lazily) read that
+/// buffer into the destination context, which is cheap compared to parsing
+/// textual IR, auto-upgrading old bitcode, or reading the file from disk.
+/// Modules are handed out in the order of the input files, and diagnostics
+/// are printed in that order too.
+class ParallelModuleLoader {
+  struct LoadedInput {
+    std::string FileName;
+    /// The module as bitcode, empty if it failed to load.
+    std::string Bitcode;
+    /// Everything the worker would have printed to errs().
+    std::string Diagnostics;
+  };
+
+  const char *Argv0;
+  const cl::list<std::string> &Files;
+  ThreadPool Pool;
+  unsigned MaxInFlight;
+  unsigned NextFile = 0;
+  std::deque<std::pair<std::shared_future<void>, std::unique_ptr<LoadedInput>>>
+      InFlight;
+  /// The input whose module was handed out last. A lazily loaded module
+  /// reads from its bitcode until it has been linked.
+  std::unique_ptr<LoadedInput> Current;
+
+  static void loadInput(const char *Argv0, LoadedInput &Input);
+  void scheduleMore();
+
+public:
+  ParallelModuleLoader(const char *Argv0, const cl::list<std::string> &Files,
+                       unsigned Threads)
+      : Argv0(Argv0), Files(Files), Pool(Threads), MaxInFlight(2 * Threads) {
+    scheduleMore();
+  }
+
+  /// Workers write into the inputs still in flight, which are destroyed
+  /// before the pool is.
+  ~ParallelModuleLoader() { Pool.wait(); }
+
+  /// Return the module of the next input file, read into \p Context, or null
+  /// if it could not be loaded.
+  std::unique_ptr<Module> loadNext(LLVMContext &Context);
+};
+
+} // anonymous namespace
+
+void ParallelModuleLoader::loadInput(const char *Argv0, LoadedInput &Input) {
+  raw_string_ostream OS(Input.Diagnostics);
+  LLVMContext Context;
+  Context.setDiagnosticHandler(diagnosticHandler, &OS, true);
+  if (Verbose)
+    OS << "Loading '" << Input.FileName << "'\n";
+
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseIRFile(Input.FileName, Err, Context);
+  if (!M) {
+    Err.print(Argv0, OS);
+    return;
+  }
+  UpgradeDebugInfo(*M);
+
+  raw_string_ostream BitcodeOS(Input.Bitcode);
+  WriteBitcodeToFile(M.get(), BitcodeOS, /*ShouldPreserveUseListOrder=*/true);
+  BitcodeOS.flush();
+}
+
+void ParallelModuleLoader::scheduleMore() {
+  while (NextFile < Files.size() && InFlight.size() < MaxInFlight) {
+    auto Input = llvm::make_unique<LoadedInput>();
+    Input->FileName = Files[NextFile++];
+    LoadedInput *InputPtr = Input.get();
+    const char *Argv0 = this->Argv0;
+    InFlight.emplace_back(
+        Pool.async([Argv0, InputPtr] { loadInput(Argv0, *InputPtr); }),
+        std::move(Input));
+  }
+}
+
+std::unique_ptr<Module>
+ParallelModuleLoader::loadNext(LLVMContext &Context) {
+  assert(!InFlight.empty() && "No more input files");
+  InFlight.front().first.wait();
+  Current = std::move(InFlight.front().second);
+  InFlight.pop_front();
+  scheduleMore();
+
+  errs() << Current->Diagnostics;
+  if (Current->Bitcode.empty())
+    return nullptr;
+
+  MemoryBufferRef Buffer(Current->Bitcode, Current->FileName);
+  std::unique_ptr<Module> Result =
+      ExitOnErr(DisableLazyLoad ? parseBitcodeFile(Buffer, Context)
+                                : getLazyBitcodeModule(Buffer, Context));
+  ExitOnErr(Result->materializeMetadata());
+  return Result;
 }
 
 /// Import any functions requested via the -import option.
@@ -275,8 +392,14 @@ static bool linkFiles(const char *argv0, LLVMContext &Context, Linker &L,
   unsigned ApplicableFlags = Flags & Linker::Flags::OverrideFromSrc;
   // Similar to some flags, internalization doesn't apply to the first file.
   bool InternalizeLinkedSymbols = false;
+  unsigned Threads = NumThreads ? NumThreads.getValue()
+                                : heavyweight_hardware_concurrency();
+  std::unique_ptr<ParallelModuleLoader> Loader;
+  if (Threads > 1 && Files.size() > 1)
+    Loader = llvm::make_unique<ParallelModuleLoader>(argv0, Files, Threads);
   for (const auto &File : Files) {
-    std::unique_ptr<Module> M = loadFile(argv0, File, Context);
+    std::unique_ptr<Module> M =
+        Loader ? Loader->loadNext(Context) : loadFile(argv0, File, Context);
     if (!M.get()) {
       errs() << argv0 << ": error loading file '" << File << "'\n";
       return false;
@@ -71,7 +71,9 @@ static cl::opt<DebugCompressionType> CompressDebugSections(
                clEnumValN(DebugCompressionType::Z, "zlib",
                           "Use zlib compression"),
                clEnumValN(DebugCompressionType::GNU, "zlib-gnu",
-                          "Use zlib-gnu compression (deprecated)")));
+                          "Use zlib-gnu compression (deprecated)"),
+               clEnumValN(DebugCompressionType::Zstd, "zstd",
+                          "Use zstd compression")));
 
 static cl::opt<bool>
 ShowInst("show-inst", cl::desc("Show internal instruction representation"));
@@ -502,9 +504,15 @@ int main(int argc, char **argv) {
   MAI->setRelaxELFRelocations(RelaxELFRel);
 
   if (CompressDebugSections != DebugCompressionType::None) {
-    if (!zlib::isAvailable()) {
-      errs() << ProgName
-             << ": build tools with zlib to enable -compress-debug-sections";
+    compression::Format Format =
+        CompressDebugSections == DebugCompressionType::Zstd
+            ? compression::Format::Zstd
+            : compression::Format::Zlib;
+    if (!compression::isAvailable(Format)) {
+      errs() << ProgName << ": build tools with "
+             << compression::getName(Format)
+             << " to enable -compress-debug-sections="
+             << compression::getName(Format) << '\n';
       return 1;
     }
     MAI->setCompressDebugSections(CompressDebugSections);
@@ -57,10 +57,13 @@
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cctype>
 #include <cstring>
+#include <deque>
+#include <mutex>
 #include <system_error>
 #include <utility>
 #include <unordered_map>
@@ -211,6 +214,13 @@ cl::opt<bool> PrintLines("line-numbers",
 cl::alias PrintLinesShort("l", cl::desc("Alias for -line-numbers"),
                           cl::aliasopt(PrintLines));
 
+static cl::opt<unsigned> DisassembleThreads(
+    "num-threads",
+    cl::desc("Disassemble text sections on this many threads, split at "
+             "symbol boundaries. The output is the same as with 1 (the "
+             "default)"),
+    cl::value_desc("n"), cl::init(1));
+
 cl::opt<unsigned long long>
     StartAddress("start-address", cl::desc("Disassemble beginning at address"),
                  cl::value_desc("address"), cl::init(0));
@@ -1171,6 +1181,61 @@ addDynamicElfSymbols(const ObjectFile *Obj,
     llvm_unreachable("Unsupported binary format");
 }
 
+namespace {
+/// The MC objects that keep state while disassembling and printing
+/// instructions. When disassembling on multiple threads, each thread
+/// needs its own set; they are recycled from one chunk to the next.
+struct DisassemblerState {
+  MCObjectFileInfo MOFI;
+  std::unique_ptr<MCContext> Ctx;
+  std::unique_ptr<MCDisassembler> DisAsm;
+  std::unique_ptr<MCInstPrinter> IP;
+};
+
+class DisassemblerStatePool {
+  const Target *TheTarget;
+  const MCAsmInfo &AsmInfo;
+  const MCRegisterInfo &MRI;
+  const MCSubtargetInfo &STI;
+  const MCInstrInfo &MII;
+  std::mutex Mutex;
+  std::vector<std::unique_ptr<DisassemblerState>> Free;
+
+public:
+  DisassemblerStatePool(const Target *TheTarget, const MCAsmInfo &AsmInfo,
+                        const MCRegisterInfo &MRI, const MCSubtargetInfo &STI,
+                        const MCInstrInfo &MII)
+      : TheTarget(TheTarget), AsmInfo(AsmInfo), MRI(MRI), STI(STI), MII(MII) {}
+
+  std::unique_ptr<DisassemblerState> acquire() {
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (!Free.empty()) {
+        std::unique_ptr<DisassemblerState> State = std::move(Free.back());
+        Free.pop_back();
+        return State;
+      }
+    }
+    // The objects were already successfully created once with the same
+    // parameters, they can't fail to be created here.
+    auto State = llvm::make_unique<DisassemblerState>();
+    State->Ctx = llvm::make_unique<MCContext>(&AsmInfo, &MRI, &State->MOFI);
+    State->MOFI.InitMCObjectFileInfo(Triple(TripleName), false,
+                                     CodeModel::Default, *State->Ctx);
+    State->DisAsm.reset(TheTarget->createMCDisassembler(STI, *State->Ctx));
+    State->IP.reset(TheTarget->createMCInstPrinter(
+        Triple(TripleName), AsmInfo.getAssemblerDialect(), AsmInfo, MII, MRI));
+    State->IP->setPrintImmHex(PrintImmHex);
+    return State;
+  }
+
+  void release(std::unique_ptr<DisassemblerState> State) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Free.push_back(std::move(State));
+  }
+};
+} // end anonymous namespace
+
 static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
   if (StartAddress > StopAddress)
     error("Start address should be less than stop address");
@@ -1329,6 +1394,23 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
   for (std::pair<const SectionRef, SectionSymbolsTy> &SecSyms : AllSymbols)
     array_pod_sort(SecSyms.second.begin(), SecSyms.second.end());
 
+  // Symbol ranges can be disassembled independently from each other, except
+  // when printing source lines or relocations, when the symbolizers are used
+  // or with -debug, which all depend on the order of the instructions.
+  std::unique_ptr<ThreadPool> Pool;
+  std::unique_ptr<DisassemblerStatePool> States;
+  bool CanDisassembleInParallel =
+      DisassembleThreads > 1 && !PrintSource && !PrintLines && !Symbolize &&
+      !(Obj->isELF() && Obj->getArch() == Triple::amdgcn);
+#ifndef NDEBUG
+  CanDisassembleInParallel &= !DebugFlag;
+#endif
+  if (CanDisassembleInParallel) {
+    Pool = llvm::make_unique<ThreadPool>(DisassembleThreads);
+    States = llvm::make_unique<DisassemblerStatePool>(TheTarget, *AsmInfo,
+                                                      *MRI, *STI, *MII);
+  }
+
   for (const SectionRef &Section : ToolSectionFilter(*Obj)) {
     if (!DisassembleAll && (!Section.isText() || Section.isVirtual()))
       continue;
@@ -1409,71 +1491,24 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
                                                             : ELF::STT_OBJECT));
     }
 
-    SmallString<40> Comments;
-    raw_svector_ostream CommentStream(Comments);
-
     StringRef BytesStr;
     error(Section.getContents(BytesStr));
     ArrayRef<uint8_t> Bytes(reinterpret_cast<const uint8_t *>(BytesStr.data()),
                             BytesStr.size());
 
-    uint64_t Size;
-    uint64_t Index;
-
     std::vector<RelocationRef>::const_iterator rel_cur = Rels.begin();
     std::vector<RelocationRef>::const_iterator rel_end = Rels.end();
-    // Disassemble symbol by symbol.
-    for (unsigned si = 0, se = Symbols.size(); si != se; ++si) {
-      uint64_t Start = std::get<0>(Symbols[si]) - SectionAddr;
-      // The end is either the section end or the beginning of the next
-      // symbol.
-      uint64_t End =
-          (si == se - 1) ? SectSize : std::get<0>(Symbols[si + 1]) - SectionAddr;
-      // Don't try to disassemble beyond the end of section contents.
-      if (End > SectSize)
-        End = SectSize;
-      // If this symbol has the same address as the next symbol, then skip it.
-      if (Start >= End)
-        continue;
-
-      // Check if we need to skip symbol
-      // Skip if the symbol's data is not between StartAddress and StopAddress
-      if (End + SectionAddr < StartAddress ||
-          Start + SectionAddr > StopAddress) {
-        continue;
-      }
-
-      // Stop disassembly at the stop address specified
-      if (End + SectionAddr > StopAddress)
-        End = StopAddress - SectionAddr;
-
-      if (Obj->isELF() && Obj->getArch() == Triple::amdgcn) {
-        // make size 4 bytes folded
-        End = Start + ((End - Start) & ~0x3ull);
-        if (std::get<2>(Symbols[si]) == ELF::STT_AMDGPU_HSA_KERNEL) {
-          // skip amd_kernel_code_t at the begining of kernel symbol (256 bytes)
-          Start += 256;
-        }
-        if (si == se - 1 ||
-            std::get<2>(Symbols[si + 1]) == ELF::STT_AMDGPU_HSA_KERNEL) {
-          // cut trailing zeroes at the end of kernel
-          // cut up to 256 bytes
-          const uint64_t EndAlign = 256;
-          const auto Limit = End - (std::min)(EndAlign, End - Start);
-          while (End > Limit &&
-            *reinterpret_cast<const support::ulittle32_t*>(&Bytes[End - 4]) == 0)
-            End -= 4;
-        }
-      }
 
-      outs() << '\n' << std::get<1>(Symbols[si]) << ":\n";
-
-#ifndef NDEBUG
-      raw_ostream &DebugOut = DebugFlag ? dbgs() : nulls();
-#else
-      raw_ostream &DebugOut = nulls();
-#endif
+    // Disassemble the [Start, End) range of the symbol at index si to OS.
+    auto DisassembleSymbol = [&](unsigned si, uint64_t Start, uint64_t End,
+                                 MCDisassembler &DisAsm, MCInstPrinter &IP,
+                                 raw_ostream &OS, raw_ostream &DebugOut) {
+      SmallString<40> Comments;
+      raw_svector_ostream CommentStream(Comments);
+      uint64_t Size;
+      uint64_t Index;
 
+      OS << '\n' << std::get<1>(Symbols[si]) << ":\n";
       for (Index = Start; Index < End; Index += Size) {
         MCInst Inst;
 
@@ -1496,12 +1531,12 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
           if (DAI != DataMappingSymsAddr.end() && *DAI == Index) {
             // Switch to data.
             while (Index < End) {
-              outs() << format("%8" PRIx64 ":", SectionAddr + Index);
-              outs() << "\t";
+              OS << format("%8" PRIx64 ":", SectionAddr + Index);
+              OS << "\t";
               if (Index + 4 <= End) {
                 Stride = 4;
-                dumpBytes(Bytes.slice(Index, 4), outs());
-                outs() << "\t.word\t";
+                dumpBytes(Bytes.slice(Index, 4), OS);
+                OS << "\t.word\t";
                 uint32_t Data = 0;
                 if (Obj->isLittleEndian()) {
                   const auto Word =
@@ -1513,11 +1548,11 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
                       Bytes.data() + Index);
                   Data = *Word;
                 }
-                outs() << "0x" << format("%08" PRIx32, Data);
+                OS << "0x" << format("%08" PRIx32, Data);
               } else if (Index + 2 <= End) {
                 Stride = 2;
-                dumpBytes(Bytes.slice(Index, 2), outs());
-                outs() << "\t\t.short\t";
+                dumpBytes(Bytes.slice(Index, 2), OS);
+                OS << "\t\t.short\t";
                 uint16_t Data = 0;
                 if (Obj->isLittleEndian()) {
                   const auto Short =
@@ -1530,15 +1565,15 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
                                                                   Index);
                   Data = *Short;
                 }
-                outs() << "0x" << format("%04" PRIx16, Data);
+                OS << "0x" << format("%04" PRIx16, Data);
               } else {
                 Stride = 1;
-                dumpBytes(Bytes.slice(Index, 1), outs());
-                outs() << "\t\t.byte\t";
-                outs() << "0x" << format("%02" PRIx8, Bytes.slice(Index, 1)[0]);
+                dumpBytes(Bytes.slice(Index, 1), OS);
+                OS << "\t\t.byte\t";
+                OS << "0x" << format("%02" PRIx8, Bytes.slice(Index, 1)[0]);
               }
               Index += Stride;
-              outs() << "\n";
+              OS << "\n";
               auto TAI = std::lower_bound(TextMappingSymsAddr.begin(),
                                           TextMappingSymsAddr.end(), Index);
               if (TAI != TextMappingSymsAddr.end() && *TAI == Index)
@@ -1563,11 +1598,11 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
                 ((SectionAddr + Index) > StopAddress))
               continue;
             if (NumBytes == 0) {
-              outs() << format("%8" PRIx64 ":", SectionAddr + Index);
-              outs() << "\t";
+              OS << format("%8" PRIx64 ":", SectionAddr + Index);
+              OS << "\t";
             }
             Byte = Bytes.slice(Index)[0];
-            outs() << format(" %02x", Byte);
+            OS << format(" %02x", Byte);
             AsciiData[NumBytes] = isprint(Byte) ? Byte : '.';
 
             uint8_t IndentOffset = 0;
@@ -1582,9 +1617,9 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
             }
             if (NumBytes == 8) {
               AsciiData[8] = '\0';
-              outs() << std::string(IndentOffset, ' ') << "         ";
-              outs() << reinterpret_cast<char *>(AsciiData);
-              outs() << '\n';
+              OS << std::string(IndentOffset, ' ') << "         ";
+              OS << reinterpret_cast<char *>(AsciiData);
+              OS << '\n';
               NumBytes = 0;
             }
           }
@@ -1594,16 +1629,16 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
 
         // Disassemble a real instruction or a data when disassemble all is
         // provided
-        bool Disassembled = DisAsm->getInstruction(Inst, Size, Bytes.slice(Index),
+        bool Disassembled = DisAsm.getInstruction(Inst, Size, Bytes.slice(Index),
                                                    SectionAddr + Index, DebugOut,
                                                    CommentStream);
         if (Size == 0)
           Size = 1;
 
-        PIP.printInst(*IP, Disassembled ? &Inst : nullptr,
-                      Bytes.slice(Index, Size), SectionAddr + Index, outs(), "",
+        PIP.printInst(IP, Disassembled ? &Inst : nullptr,
+                      Bytes.slice(Index, Size), SectionAddr + Index, OS, "",
                       *STI, &SP);
-        outs() << CommentStream.str();
+        OS << CommentStream.str();
         Comments.clear();
 
         // Try to resolve the target of a call, tail call, etc. to a specific
@@ -1627,11 +1662,13 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
                       const std::pair<uint64_t, SectionRef> &RHS) {
                     return LHS < RHS.first;
                   });
+              TargetSectionSymbols = nullptr;
               if (SectionAddress != SectionAddresses.begin()) {
                 --SectionAddress;
-                TargetSectionSymbols = &AllSymbols[SectionAddress->second];
-              } else {
-                TargetSectionSymbols = nullptr;
+                // Don't insert into AllSymbols, other threads may read it.
+                auto SecSyms = AllSymbols.find(SectionAddress->second);
+                if (SecSyms != AllSymbols.end())
+                  TargetSectionSymbols = &SecSyms->second;
               }
             }
 
@@ -1648,16 +1685,16 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
                 --TargetSym;
                 uint64_t TargetAddress = std::get<0>(*TargetSym);
                 StringRef TargetName = std::get<1>(*TargetSym);
-                outs() << " <" << TargetName;
+                OS << " <" << TargetName;
                 uint64_t Disp = Target - TargetAddress;
                 if (Disp)
-                  outs() << "+0x" << utohexstr(Disp);
-                outs() << '>';
+                  OS << "+0x" << utohexstr(Disp);
+                OS << '>';
               }
             }
           }
         }
-        outs() << "\n";
+        OS << "\n";
 
         // Print relocation for instruction.
         while (rel_cur != rel_end) {
@@ -1676,12 +1713,113 @@ static void DisassembleObject(const ObjectFile *Obj, bool InlineRelocs) {
           if (addr >= Index + Size) break;
           rel_cur->getTypeName(name);
           error(getRelocationValueString(*rel_cur, val));
-          outs() << format(Fmt.data(), SectionAddr + addr) << name
+          OS << format(Fmt.data(), SectionAddr + addr) << name
                  << "\t" << val << "\n";
           ++rel_cur;
         }
       }
+    };
+
+    const uint64_t ChunkSize = 64 * 1024;
+    std::vector<std::tuple<unsigned, uint64_t, uint64_t>> Chunk;
+    uint64_t ChunkBytes = 0;
+    std::deque<std::pair<std::unique_ptr<std::string>, std::shared_future<void>>>
+        InFlight;
+    auto OutputChunk = [&]() {
+      InFlight.front().second.wait();
+      outs() << *InFlight.front().first;
+      InFlight.pop_front();
+    };
+    auto FlushChunk = [&]() {
+      if (Chunk.empty())
+        return;
+      if (InFlight.size() >= 2 * DisassembleThreads)
+        OutputChunk();
+      auto Buffer = llvm::make_unique<std::string>();
+      std::string *Out = Buffer.get();
+      auto Future = Pool->async(
+          [&DisassembleSymbol, &States, Out](
+              const std::vector<std::tuple<unsigned, uint64_t, uint64_t>>
+                  &Ranges) {
+            std::unique_ptr<DisassemblerState> State = States->acquire();
+            raw_string_ostream OS(*Out);
+            for (const auto &R : Ranges)
+              DisassembleSymbol(std::get<0>(R), std::get<1>(R), std::get<2>(R),
+                                *State->DisAsm, *State->IP, OS, nulls());
+            OS.flush();
+            States->release(std::move(State));
+          },
+          std::move(Chunk));
+      InFlight.emplace_back(std::move(Buffer), std::move(Future));
+      Chunk.clear();
+      ChunkBytes = 0;
+    };
+
+    // Disassemble symbol by symbol.
+    for (unsigned si = 0, se = Symbols.size(); si != se; ++si) {
+      uint64_t Start = std::get<0>(Symbols[si]) - SectionAddr;
+      // The end is either the section end or the beginning of the next
+      // symbol.
+      uint64_t End =
+          (si == se - 1) ? SectSize : std::get<0>(Symbols[si + 1]) - SectionAddr;
+      // Don't try to disassemble beyond the end of section contents.
+      if (End > SectSize)
+        End = SectSize;
+      // If this symbol has the same address as the next symbol, then skip it.
+      if (Start >= End)
+        continue;
+
+      // Check if we need to skip symbol
+      // Skip if the symbol's data is not between StartAddress and StopAddress
+      if (End + SectionAddr < StartAddress ||
+          Start + SectionAddr > StopAddress) {
+        continue;
+      }
+
+      // Stop disassembly at the stop address specified
+      if (End + SectionAddr > StopAddress)
+        End = StopAddress - SectionAddr;
+
+      if (Obj->isELF() && Obj->getArch() == Triple::amdgcn) {
+        // make size 4 bytes folded
+        End = Start + ((End - Start) & ~0x3ull);
+        if (std::get<2>(Symbols[si]) == ELF::STT_AMDGPU_HSA_KERNEL) {
+          // skip amd_kernel_code_t at the begining of kernel symbol (256 bytes)
+          Start += 256;
+        }
+        if (si == se - 1 ||
+            std::get<2>(Symbols[si + 1]) == ELF::STT_AMDGPU_HSA_KERNEL) {
+          // cut trailing zeroes at the end of kernel
+          // cut up to 256 bytes
+          const uint64_t EndAlign = 256;
+          const auto Limit = End - (std::min)(EndAlign, End - Start);
+          while (End > Limit &&
+            *reinterpret_cast<const support::ulittle32_t*>(&Bytes[End - 4]) == 0)
+            End -= 4;
+        }
+      }
+
+      if (!Pool || !Rels.empty()) {
+#ifndef NDEBUG
+        raw_ostream &DebugOut = DebugFlag ? dbgs() : nulls();
+#else
+        raw_ostream &DebugOut = nulls();
+#endif
+        DisassembleSymbol(si, Start, End, *DisAsm, *IP, outs(), DebugOut);
+        continue;
+      }
+
+      // Group the symbols in chunks of at least ChunkSize bytes, decoded
+      // and printed to a buffer on the thread pool. The buffers are output
+      // in order, and at most 2 chunks per thread are in flight.
+      Chunk.emplace_back(si, Start, End);
+      ChunkBytes += End - Start;
+      if (ChunkBytes >= ChunkSize)
+        FlushChunk();
     }
+    FlushChunk();
+    while (!InFlight.empty())
+      OutputChunk();
   }
 }
 
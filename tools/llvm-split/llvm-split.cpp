@@ -40,6 +40,10 @@ static cl::opt<bool>
     PreserveLocals("preserve-locals", cl::Prefix, cl::init(false),
                    cl::desc("Split without externalizing locals"));
 
+static cl::opt<bool>
+    ClusterSCCs("cluster-sccs", cl::init(false),
+                cl::desc("Keep the functions of each call graph SCC together"));
+
 int main(int argc, char **argv) {
   LLVMContext Context;
   SMDiagnostic Err;
@@ -67,7 +71,7 @@ int main(int argc, char **argv) {
 
     // Declare success.
     Out->keep();
-  }, PreserveLocals);
+  }, PreserveLocals, ClusterSCCs);
 
   return 0;
 }
@@ -26,10 +26,13 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <string>
+#include <tuple>
 
 using namespace llvm;
 using namespace symbolize;
@@ -88,11 +91,32 @@ static cl::opt<int> ClPrintSourceContextLines(
 static cl::opt<bool> ClVerbose("verbose", cl::init(false),
                                cl::desc("Print verbose line info"));
 
+static cl::opt<unsigned> ClCacheSize(
+    "cache-size", cl::init(0),
+    cl::desc("Maximum size in MB of the binaries kept open, the least "
+             "recently used ones are closed first (0 for no limit)"));
+
+static cl::opt<bool> ClBatch(
+    "batch", cl::init(false),
+    cl::desc("Read all the input before symbolizing it, grouped by module "
+             "and sorted by address. The output is in input order"));
+
+static cl::opt<unsigned> ClThreads(
+    "threads", cl::init(1),
+    cl::desc("Number of threads symbolizing different modules in -batch "
+             "mode"));
+
+static cl::opt<bool> ClUseAddressIndex(
+    "use-address-index", cl::init(false),
+    cl::desc("Answer DWARF queries from a precomputed address index, kept "
+             "in a .addrindex file next to the binary and rebuilt when "
+             "missing or out of date"));
+
 template<typename T>
-static bool error(Expected<T> &ResOrErr) {
+static bool error(Expected<T> &ResOrErr, raw_ostream &ErrOS) {
   if (ResOrErr)
     return false;
-  logAllUnhandledErrors(ResOrErr.takeError(), errs(),
+  logAllUnhandledErrors(ResOrErr.takeError(), ErrOS,
                         "LLVMSymbolizer: error reading file: ");
   return true;
 }
@@ -140,6 +164,92 @@ static bool parseCommand(StringRef InputString, bool &IsData,
   return !StringRef(pos, offset_length).getAsInteger(0, ModuleOffset);
 }
 
+static void symbolizeInput(LLVMSymbolizer &Symbolizer, bool IsData,
+                           const std::string &ModuleName,
+                           uint64_t ModuleOffset, raw_ostream &OS,
+                           raw_ostream &ErrOS) {
+  DIPrinter Printer(OS, ClPrintFunctions != FunctionNameKind::None,
+                    ClPrettyPrint, ClPrintSourceContextLines, ClVerbose);
+
+  if (ClPrintAddress) {
+    OS << "0x";
+    OS.write_hex(ModuleOffset);
+    StringRef Delimiter = (ClPrettyPrint == true) ? ": " : "\n";
+    OS << Delimiter;
+  }
+  if (IsData) {
+    auto ResOrErr = Symbolizer.symbolizeData(ModuleName, ModuleOffset);
+    Printer << (error(ResOrErr, ErrOS) ? DIGlobal() : ResOrErr.get());
+  } else if (ClPrintInlining) {
+    auto ResOrErr = Symbolizer.symbolizeInlinedCode(ModuleName, ModuleOffset);
+    Printer << (error(ResOrErr, ErrOS) ? DIInliningInfo()
+                                       : ResOrErr.get());
+  } else {
+    auto ResOrErr = Symbolizer.symbolizeCode(ModuleName, ModuleOffset);
+    Printer << (error(ResOrErr, ErrOS) ? DILineInfo() : ResOrErr.get());
+  }
+  OS << "\n";
+}
+
+namespace {
+struct BatchQuery {
+  std::string Input;
+  bool IsValid;
+  bool IsData;
+  std::string ModuleName;
+  uint64_t ModuleOffset;
+  std::string Output;
+  std::string Errors;
+};
+} // end anonymous namespace
+
+/// Symbolize all the queries read from the standard input. The queries
+/// are grouped by module and sorted by address, so that the debug info
+/// of every module is loaded once and walked in order. Each module is
+/// symbolized by a symbolizer of its own, so that different modules
+/// can be symbolized on different threads, and is closed when done.
+static void symbolizeBatch(const LLVMSymbolizer::Options &Opts,
+                           ArrayRef<BatchQuery *> Queries, unsigned Threads) {
+  std::vector<BatchQuery *> Sorted;
+  for (BatchQuery *Q : Queries)
+    if (Q->IsValid)
+      Sorted.push_back(Q);
+  std::stable_sort(Sorted.begin(), Sorted.end(),
+                   [](const BatchQuery *LHS, const BatchQuery *RHS) {
+                     return std::tie(LHS->ModuleName, LHS->ModuleOffset) <
+                            std::tie(RHS->ModuleName, RHS->ModuleOffset);
+                   });
+
+  auto SymbolizeModule = [&Opts](ArrayRef<BatchQuery *> ModuleQueries) {
+    LLVMSymbolizer Symbolizer(Opts);
+    for (BatchQuery *Q : ModuleQueries) {
+      raw_string_ostream OS(Q->Output);
+      raw_string_ostream ErrOS(Q->Errors);
+      symbolizeInput(Symbolizer, Q->IsData, Q->ModuleName, Q->ModuleOffset,
+                     OS, ErrOS);
+    }
+  };
+
+  std::unique_ptr<ThreadPool> Pool;
+  if (Threads > 1)
+    Pool = llvm::make_unique<ThreadPool>(Threads);
+  ArrayRef<BatchQuery *> Remaining = Sorted;
+  while (!Remaining.empty()) {
+    const std::string &ModuleName = Remaining.front()->ModuleName;
+    size_t Size = 1;
+    while (Size < Remaining.size() &&
+           Remaining[Size]->ModuleName == ModuleName)
+      ++Size;
+    if (Pool)
+      Pool->async(SymbolizeModule, Remaining.take_front(Size));
+    else
+      SymbolizeModule(Remaining.take_front(Size));
+    Remaining = Remaining.drop_front(Size);
+  }
+  if (Pool)
+    Pool->wait();
+}
+
 int main(int argc, char **argv) {
   // Print stack trace if we signal out.
   sys::PrintStackTraceOnErrorSignal(argv[0]);
@@ -160,14 +270,39 @@ int main(int argc, char **argv) {
                 "\" (must have the '.dSYM' extension).\n";
     }
   }
-  LLVMSymbolizer Symbolizer(Opts);
-
-  DIPrinter Printer(outs(), ClPrintFunctions != FunctionNameKind::None,
-                    ClPrettyPrint, ClPrintSourceContextLines, ClVerbose);
+  Opts.MaxCacheSize = uint64_t(ClCacheSize) << 20;
+  Opts.UseAddressIndex = ClUseAddressIndex;
 
   const int kMaxInputStringLength = 1024;
   char InputString[kMaxInputStringLength];
 
+  if (ClBatch) {
+    std::vector<std::unique_ptr<BatchQuery>> Queries;
+    while (fgets(InputString, sizeof(InputString), stdin)) {
+      auto Q = llvm::make_unique<BatchQuery>();
+      Q->Input = InputString;
+      Q->IsValid = parseCommand(StringRef(InputString), Q->IsData,
+                                Q->ModuleName, Q->ModuleOffset);
+      Queries.push_back(std::move(Q));
+    }
+    std::vector<BatchQuery *> QueryPtrs;
+    for (auto &Q : Queries)
+      QueryPtrs.push_back(Q.get());
+    symbolizeBatch(Opts, QueryPtrs, ClThreads);
+
+    for (auto &Q : Queries) {
+      if (!Q->IsValid) {
+        outs() << Q->Input;
+        continue;
+      }
+      errs() << Q->Errors;
+      outs() << Q->Output;
+    }
+    return 0;
+  }
+
+  LLVMSymbolizer Symbolizer(Opts);
+
   while (true) {
     if (!fgets(InputString, sizeof(InputString), stdin))
       break;
@@ -181,24 +316,8 @@ int main(int argc, char **argv) {
       continue;
     }
 
-    if (ClPrintAddress) {
-      outs() << "0x";
-      outs().write_hex(ModuleOffset);
-      StringRef Delimiter = (ClPrettyPrint == true) ? ": " : "\n";
-      outs() << Delimiter;
-    }
-    if (IsData) {
-      auto ResOrErr = Symbolizer.symbolizeData(ModuleName, ModuleOffset);
-      Printer << (error(ResOrErr) ? DIGlobal() : ResOrErr.get());
-    } else if (ClPrintInlining) {
-      auto ResOrErr = Symbolizer.symbolizeInlinedCode(ModuleName, ModuleOffset);
-      Printer << (error(ResOrErr) ? DIInliningInfo()
-                                             : ResOrErr.get());
-    } else {
-      auto ResOrErr = Symbolizer.symbolizeCode(ModuleName, ModuleOffset);
-      Printer << (error(ResOrErr) ? DILineInfo() : ResOrErr.get());
-    }
-    outs() << "\n";
+    symbolizeInput(Symbolizer, IsData, ModuleName, ModuleOffset, outs(),
+                   errs());
     outs().flush();
   }
 
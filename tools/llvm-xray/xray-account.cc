@@ -21,6 +21,8 @@
 #include "xray-registry.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/XRay/InstrumentationMap.h"
 #include "llvm/XRay/Trace.h"
 
@@ -111,6 +113,12 @@ static cl::opt<int> AccountTop("top", cl::desc("only show the top N results"),
 static cl::alias AccountTop2("p", cl::desc("Alias for -top"),
                              cl::aliasopt(AccountTop), cl::sub(Account));
 
+static cl::opt<unsigned> AccountThreads(
+    "threads",
+    cl::desc("number of threads used to account the thread buffers of FDR "
+             "mode logs; 0 uses all available cores"),
+    cl::value_desc("N"), cl::sub(Account), cl::init(0));
+
 static cl::opt<std::string>
     AccountInstrMap("instr_map",
                     cl::desc("binary with the instrumentation map, or "
@@ -212,6 +220,24 @@ bool LatencyAccountant::accountRecord(const XRayRecord &Record) {
   return true;
 }
 
+void LatencyAccountant::mergeFrom(LatencyAccountant &&Other) {
+  for (auto &FL : Other.FunctionLatencies) {
+    auto &Latencies = FunctionLatencies[FL.first];
+    Latencies.insert(Latencies.end(), FL.second.begin(), FL.second.end());
+  }
+  for (auto &TS : Other.PerThreadFunctionStack)
+    PerThreadFunctionStack[TS.first] = std::move(TS.second);
+  for (const auto &MM : Other.PerThreadMinMaxTSC) {
+    setMinMax(PerThreadMinMaxTSC[MM.first], MM.second.first);
+    setMinMax(PerThreadMinMaxTSC[MM.first], MM.second.second);
+  }
+  for (const auto &MM : Other.PerCPUMinMaxTSC) {
+    setMinMax(PerCPUMinMaxTSC[MM.first], MM.second.first);
+    setMinMax(PerCPUMinMaxTSC[MM.first], MM.second.second);
+  }
+  Other.FunctionLatencies.clear();
+}
+
 namespace {
 
 // We consolidate the data into a struct which we can output in various forms.
@@ -432,38 +458,93 @@ static CommandRegistration Unused(&Account, []() -> Error {
   symbolize::LLVMSymbolizer Symbolizer(Opts);
   llvm::xray::FuncIdConversionHelper FuncIdHelper(AccountInstrMap, Symbolizer,
                                                   FunctionAddresses);
-  xray::LatencyAccountant FCA(FuncIdHelper, AccountDeduceSiblingCalls);
-  auto TraceOrErr = loadTraceFile(AccountInput);
-  if (!TraceOrErr)
+  auto ReaderOrErr = openTraceFile(AccountInput);
+  if (!ReaderOrErr)
     return joinErrors(
         make_error<StringError>(
             Twine("Failed loading input file '") + AccountInput + "'",
             std::make_error_code(std::errc::executable_format_error)),
-        TraceOrErr.takeError());
-
-  auto &T = *TraceOrErr;
-  for (const auto &Record : T) {
-    if (FCA.accountRecord(Record))
-      continue;
-    for (const auto &ThreadStack : FCA.getPerThreadFunctionStack()) {
-      errs() << "Thread ID: " << ThreadStack.first << "\n";
-      auto Level = ThreadStack.second.size();
-      for (const auto &Entry : llvm::reverse(ThreadStack.second))
-        errs() << "#" << Level-- << "\t"
-               << FuncIdHelper.SymbolOrNumber(Entry.first) << '\n';
+        ReaderOrErr.takeError());
+
+  // The records of each group of thread buffers are accounted separately, and
+  // concurrently if there is more than one group. Failures are reported once
+  // all the groups are done, because symbolizing function ids is not
+  // thread-safe.
+  auto &R = **ReaderOrErr;
+  auto Groups = R.getThreadBufferGroups();
+  struct GroupResult {
+    xray::LatencyAccountant FCA;
+    std::vector<LatencyAccountant::PerThreadFunctionStackMap> FailedStacks;
+    Error Err;
+  };
+  std::vector<GroupResult> Results;
+  Results.reserve(Groups.size());
+  for (size_t I = 0, E = Groups.size(); I != E; ++I)
+    Results.push_back(
+        {xray::LatencyAccountant(FuncIdHelper, AccountDeduceSiblingCalls),
+         {},
+         Error::success()});
+
+  auto AccountGroup = [&](size_t I) {
+    auto &Result = Results[I];
+    ErrorAsOutParameter ErrAsOutParam(&Result.Err);
+    for (const TraceBuffer *B : Groups[I]) {
+      for (const auto &Record : R.records(*B, Result.Err)) {
+        if (Result.FCA.accountRecord(Record))
+          continue;
+        Result.FailedStacks.push_back(Result.FCA.getPerThreadFunctionStack());
+        if (!AccountKeepGoing)
+          return;
+      }
+      if (Result.Err)
+        return;
     }
-    if (!AccountKeepGoing)
-      return make_error<StringError>(
-          Twine("Failed accounting function calls in file '") + AccountInput +
-              "'.",
-          std::make_error_code(std::errc::executable_format_error));
+  };
+  if (Groups.size() == 1) {
+    AccountGroup(0);
+  } else {
+    ThreadPool Pool(AccountThreads ? AccountThreads
+                                   : heavyweight_hardware_concurrency());
+    for (size_t I = 0, E = Groups.size(); I != E; ++I)
+      Pool.async(AccountGroup, I);
+    Pool.wait();
   }
+
+  xray::LatencyAccountant FCA(FuncIdHelper, AccountDeduceSiblingCalls);
+  Error Err = Error::success();
+  bool Failed = false;
+  for (auto &Result : Results) {
+    for (const auto &Stacks : Result.FailedStacks) {
+      for (const auto &ThreadStack : Stacks) {
+        errs() << "Thread ID: " << ThreadStack.first << "\n";
+        auto Level = ThreadStack.second.size();
+        for (const auto &Entry : llvm::reverse(ThreadStack.second))
+          errs() << "#" << Level-- << "\t"
+                 << FuncIdHelper.SymbolOrNumber(Entry.first) << '\n';
+      }
+      Failed = true;
+    }
+    Err = joinErrors(std::move(Err), std::move(Result.Err));
+    FCA.mergeFrom(std::move(Result.FCA));
+  }
+  if (Err)
+    return joinErrors(
+        make_error<StringError>(
+            Twine("Failed loading input file '") + AccountInput + "'",
+            std::make_error_code(std::errc::executable_format_error)),
+        std::move(Err));
+  if (Failed && !AccountKeepGoing)
+    return make_error<StringError>(
+        Twine("Failed accounting function calls in file '") + AccountInput +
+            "'.",
+        std::make_error_code(std::errc::executable_format_error));
+
   switch (AccountOutputFormat) {
   case AccountOutputFormats::TEXT:
-    FCA.exportStatsAsText(OS, T.getFileHeader());
+    FCA.exportStatsAsText(OS, R.getFileHeader());
     break;
   case AccountOutputFormats::CSV:
-    FCA.exportStatsAsCSV(OS, T.getFileHeader());
+    FCA.exportStatsAsCSV(OS, R.getFileHeader());
     break;
   }
 
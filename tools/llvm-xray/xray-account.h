@@ -79,6 +79,11 @@ public:
   ///
   bool accountRecord(const XRayRecord &Record);
 
+  /// Merges the latencies, TSC ranges and function stacks that \p Other
+  /// gathered from the records of a disjoint set of threads into this
+  /// accountant.
+  void mergeFrom(LatencyAccountant &&Other);
+
   const FunctionStack *
   getThreadFunctionStack(llvm::sys::ProcessInfo::ProcessId TId) const {
     auto I = PerThreadFunctionStack.find(TId);
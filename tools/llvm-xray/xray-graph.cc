@@ -21,6 +21,8 @@
 #include "xray-registry.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/XRay/InstrumentationMap.h"
 #include "llvm/XRay/Trace.h"
 #include "llvm/XRay/YAMLXRayRecord.h"
@@ -66,6 +68,12 @@ static cl::alias
                              cl::desc("Alias for -deduce-sibling-calls"),
                              cl::sub(GraphC));
 
+static cl::opt<unsigned> GraphThreads(
+    "threads",
+    cl::desc("number of threads used to process the thread buffers of FDR "
+             "mode logs; 0 uses all available cores"),
+    cl::value_desc("N"), cl::sub(GraphC), cl::init(0));
+
 static cl::opt<GraphRenderer::StatType>
     GraphEdgeLabel("edge-label",
                    cl::desc("Output graphs with edges labeled with this field"),
@@ -209,8 +217,9 @@ Error GraphRenderer::accountRecord(const XRayRecord &Record) {
   auto &ThreadStack = PerThreadFunctionStack[Record.TId];
   switch (Record.Type) {
   case RecordTypes::ENTER: {
-    if (Record.FuncId != 0 && G.count(Record.FuncId) == 0)
-      G[Record.FuncId].SymbolName = FuncIdHelper.SymbolOrNumber(Record.FuncId);
+    // Symbol names are filled in once the whole trace has been accounted.
+    if (Record.FuncId != 0)
+      G[Record.FuncId];
     ThreadStack.push_back({Record.FuncId, Record.TSC});
     break;
   }
@@ -256,6 +265,32 @@ Error GraphRenderer::accountRecord(const XRayRecord &Record) {
   return Error::success();
 }
 
+// Merges the statistics accumulated by updateStat in B into A.
+static void mergeStat(GraphRenderer::TimeStat &A,
+                      const GraphRenderer::TimeStat &B) {
+  if (B.Count == 0)
+    return;
+  A.Count += B.Count;
+  if (A.Min > B.Min || A.Min == 0)
+    A.Min = B.Min;
+  if (A.Max < B.Max)
+    A.Max = B.Max;
+  A.Sum += B.Sum;
+}
+
+void GraphRenderer::mergeFrom(GraphRenderer &&Other) {
+  for (const auto &V : Other.G.vertices())
+    mergeStat(G[V.first].S, V.second.S);
+  for (auto &E : Other.G.edges()) {
+    auto &EA = G[E.first];
+    EA.Timings.insert(EA.Timings.end(), E.second.Timings.begin(),
+                      E.second.Timings.end());
+    mergeStat(EA.S, E.second.S);
+  }
+  for (auto &TS : Other.PerThreadFunctionStack)
+    PerThreadFunctionStack[TS.first] = std::move(TS.second);
+}
+
 template <typename U>
 void GraphRenderer::getStats(U begin, U end, GraphRenderer::TimeStat &S) {
   if (begin == end) return;
@@ -441,34 +476,116 @@ Expected<GraphRenderer> GraphRenderer::Factory::getGraphRenderer() {
   symbolize::LLVMSymbolizer::Options Opts(
       symbolize::FunctionNameKind::LinkageName, true, true, false, "");
   symbolize::LLVMSymbolizer Symbolizer(Opts);
-  const auto &Header = Trace.getFileHeader();
+  const auto &Header = Reader->getFileHeader();
 
   llvm::xray::FuncIdConversionHelper FuncIdHelper(InstrMap, Symbolizer,
                                                   FunctionAddresses);
 
-  xray::GraphRenderer GR(FuncIdHelper, DeduceSiblingCalls);
-  for (const auto &Record : Trace) {
-    auto E = GR.accountRecord(Record);
-    if (!E)
-      continue;
+  // Every group of thread buffers is accounted into a graph of its own, and
+  // concurrently if there is more than one group. Failures are reported once
+  // all the groups are done, because symbolizing function ids is not
+  // thread-safe.
+  auto Groups = Reader->getThreadBufferGroups();
+  struct GroupResult {
+    GraphRenderer GR;
+    std::vector<std::pair<PerThreadFunctionStackMap, std::string>> Failures;
+    Error Err;
+  };
+  std::vector<GroupResult> Results;
+  Results.reserve(Groups.size());
+  for (size_t I = 0, E = Groups.size(); I != E; ++I)
+    Results.push_back({GraphRenderer(FuncIdHelper, DeduceSiblingCalls),
+                       {},
+                       Error::success()});
+
+  auto AccountGroup = [&](size_t I) {
+    auto &Result = Results[I];
+    ErrorAsOutParameter ErrAsOutParam(&Result.Err);
+    auto AccountRecord = [&](const XRayRecord &Record) -> bool {
+      auto E = Result.GR.accountRecord(Record);
+      if (!E)
+        return true;
+      Result.Failures.emplace_back(Result.GR.getPerThreadFunctionStack(),
+                                   toString(std::move(E)));
+      return GraphKeepGoing;
+    };
+
+    // Only the buffers of FDR mode logs are in per-thread TSC order; the
+    // records of other logs have to be sorted up front.
+    if (Reader->getFormat() != TraceReader::LogFormat::FDR) {
+      std::vector<XRayRecord> Records;
+      for (const TraceBuffer *B : Groups[I]) {
+        Records.insert(Records.end(), Reader->records_begin(*B, Result.Err),
+                       Reader->records_end(*B));
+        if (Result.Err)
+          return;
+      }
+      std::sort(Records.begin(), Records.end(),
+                [&](const XRayRecord &L, const XRayRecord &R) {
+                  return L.TSC < R.TSC;
+                });
+      for (const auto &Record : Records)
+        if (!AccountRecord(Record))
+          return;
+      return;
+    }
 
-    for (const auto &ThreadStack : GR.getPerThreadFunctionStack()) {
-      errs() << "Thread ID: " << ThreadStack.first << "\n";
-      auto Level = ThreadStack.second.size();
-      for (const auto &Entry : llvm::reverse(ThreadStack.second))
-        errs() << "#" << Level-- << "\t"
-               << FuncIdHelper.SymbolOrNumber(Entry.FuncId) << '\n';
+    for (const TraceBuffer *B : Groups[I]) {
+      for (const auto &Record : Reader->records(*B, Result.Err))
+        if (!AccountRecord(Record))
+          return;
+      if (Result.Err)
+        return;
     }
+  };
+  if (Groups.size() == 1) {
+    AccountGroup(0);
+  } else {
+    ThreadPool Pool(Threads ? Threads : heavyweight_hardware_concurrency());
+    for (size_t I = 0, E = Groups.size(); I != E; ++I)
+      Pool.async(AccountGroup, I);
+    Pool.wait();
+  }
+
+  // The graph of the first group becomes the final one.
+  auto &GR = Results.front().GR;
+  Error Err = Error::success();
+  for (auto &Result : Results) {
+    for (const auto &Failure : Result.Failures) {
+      for (const auto &ThreadStack : Failure.first) {
+        errs() << "Thread ID: " << ThreadStack.first << "\n";
+        auto Level = ThreadStack.second.size();
+        for (const auto &Entry : llvm::reverse(ThreadStack.second))
+          errs() << "#" << Level-- << "\t"
+                 << FuncIdHelper.SymbolOrNumber(Entry.FuncId) << '\n';
+      }
 
-    if (!GraphKeepGoing)
-      return joinErrors(make_error<StringError>(
-                            "Error encountered generating the call graph.",
-                            std::make_error_code(std::errc::invalid_argument)),
-                        std::move(E));
+      auto E = make_error<StringError>(
+          Failure.second, std::make_error_code(std::errc::invalid_argument));
+      if (!GraphKeepGoing) {
+        consumeError(std::move(Err));
+        for (auto &Other : Results)
+          consumeError(std::move(Other.Err));
+        return joinErrors(
+            make_error<StringError>(
+                "Error encountered generating the call graph.",
+                std::make_error_code(std::errc::invalid_argument)),
+            std::move(E));
+      }
 
-    handleAllErrors(std::move(E),
-                    [&](const ErrorInfoBase &E) { E.log(errs()); });
+      handleAllErrors(std::move(E),
+                      [&](const ErrorInfoBase &E) { E.log(errs()); });
+    }
+    Err = joinErrors(std::move(Err), std::move(Result.Err));
+    if (&Result.GR != &GR)
+      GR.mergeFrom(std::move(Result.GR));
   }
+  if (Err)
+    return Err;
+
+  for (auto &V : GR.G.vertices())
+    if (V.first != 0)
+      V.second.SymbolName = FuncIdHelper.SymbolOrNumber(V.first);
 
   GR.G.GraphEdgeMax = {};
   GR.G.GraphVertexMax = {};
@@ -496,14 +613,18 @@ static CommandRegistration Unused(&GraphC, []() -> Error {
   F.DeduceSiblingCalls = GraphDeduceSiblingCalls;
   F.InstrMap = GraphInstrMap;
 
-  auto TraceOrErr = loadTraceFile(GraphInput, true);
+  F.Threads = GraphThreads;
 
-  if (!TraceOrErr)
-    return make_error<StringError>(
-        Twine("Failed loading input file '") + GraphInput + "'",
-        make_error_code(llvm::errc::invalid_argument));
+  auto ReaderOrErr = openTraceFile(GraphInput);
+
+  if (!ReaderOrErr)
+    return joinErrors(
+        make_error<StringError>(
+            Twine("Failed loading input file '") + GraphInput + "'",
+            make_error_code(llvm::errc::invalid_argument)),
+        ReaderOrErr.takeError());
 
-  F.Trace = std::move(*TraceOrErr);
+  F.Reader = std::move(*ReaderOrErr);
   auto GROrError = F.getGraphRenderer();
   if (!GROrError)
     return GROrError.takeError();
@@ -140,6 +140,11 @@ public:
   /// FIXME: Make this more robust against small irregularities.
   Error accountRecord(const XRayRecord &Record);
 
+  /// Merges the graph that \p Other built from the records of a disjoint set of
+  /// threads into this one. Vertices are left unnamed until the final graph
+  /// is produced, so that renderers can be populated concurrently.
+  void mergeFrom(GraphRenderer &&Other);
+
   const PerThreadFunctionStackMap &getPerThreadFunctionStack() const {
     return PerThreadFunctionStack;
   }
@@ -149,7 +154,10 @@ public:
     bool KeepGoing;
     bool DeduceSiblingCalls;
     std::string InstrMap;
-    ::llvm::xray::Trace Trace;
+    std::unique_ptr<TraceReader> Reader;
+    /// Number of threads used to process the thread buffers of FDR mode logs;
+    /// 0 uses all available cores.
+    unsigned Threads;
     Expected<GraphRenderer> getGraphRenderer();
   };
 
@@ -15,6 +15,8 @@
 #include "BreakpointPrinter.h"
 #include "NewPMDriver.h"
 #include "PassPrinters.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/CallGraphSCCPass.h"
@@ -22,6 +24,8 @@
 #include "llvm/Analysis/RegionPass.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/Bitcode/BitcodeWriterPass.h"
 #include "llvm/CodeGen/CommandFlags.h"
 #include "llvm/CodeGen/TargetPassConfig.h"
@@ -37,6 +41,7 @@
 #include "llvm/InitializePasses.h"
 #include "llvm/LinkAllIR.h"
 #include "llvm/LinkAllPasses.h"
+#include "llvm/Linker/Linker.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/FileSystem.h"
@@ -49,6 +54,7 @@
 #include "llvm/Support/SystemUtils.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Target/TargetMachine.h"
@@ -56,8 +62,12 @@
 #include "llvm/Transforms/IPO/AlwaysInliner.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
 #include <algorithm>
+#include <map>
 #include <memory>
+#include <tuple>
 using namespace llvm;
 using namespace opt_tool;
 
@@ -247,6 +257,16 @@ static cl::opt<std::string>
                     cl::desc("YAML output filename for pass remarks"),
                     cl::value_desc("filename"));
 
+static cl::opt<unsigned> NumPartitions(
+    "j", cl::init(1), cl::value_desc("N"),
+    cl::desc("Split the module in N partitions along the call graph SCCs, and "
+             "optimize them in parallel"));
+
+static cl::opt<bool> PartitionFunctionLocal(
+    "j-function-local",
+    cl::desc("With -j, only allow function passes, so that the partitioning "
+             "doesn't change the result"));
+
 static inline void addPass(legacy::PassManagerBase &PM, Pass *P) {
   // Add the pass to the pass manager...
   PM.add(P);
@@ -347,6 +367,438 @@ static TargetMachine* GetTargetMachine(Triple TheTriple, StringRef CPUStr,
                                         CMModel, GetCodeGenOptLevel());
 }
 
+//===----------------------------------------------------------------------===//
+// Pipeline construction.
+//
+
+static void addTargetAnalysisPasses(legacy::PassManager &Passes,
+                                    TargetMachine *TM,
+                                    const Triple &ModuleTriple) {
+  // Add an appropriate TargetLibraryInfo pass for the module's triple.
+  TargetLibraryInfoImpl TLII(ModuleTriple);
+
+  // The -disable-simplify-libcalls flag actually disables all builtin optzns.
+  if (DisableSimplifyLibCalls)
+    TLII.disableAllFunctions();
+  Passes.add(new TargetLibraryInfoWrapperPass(TLII));
+
+  // Add internal analysis passes from the target machine.
+  Passes.add(createTargetTransformInfoWrapperPass(TM ? TM->getTargetIRAnalysis()
+                                                     : TargetIRAnalysis()));
+
+  if (TM) {
+    // FIXME: We should dyn_cast this when supported.
+    auto &LTM = static_cast<LLVMTargetMachine &>(*TM);
+    Pass *TPC = LTM.createPassConfig(Passes);
+    Passes.add(TPC);
+  }
+}
+
+static bool hasOptLevel() {
+  return OptLevelO0 || OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz ||
+         OptLevelO3;
+}
+
+/// Create the function pass manager of the -O<n> pipelines, if any.
+static std::unique_ptr<legacy::FunctionPassManager>
+createFunctionPasses(Module &M, TargetMachine *TM) {
+  if (!hasOptLevel())
+    return nullptr;
+  auto FPasses = llvm::make_unique<legacy::FunctionPassManager>(&M);
+  FPasses->add(createTargetTransformInfoWrapperPass(
+      TM ? TM->getTargetIRAnalysis() : TargetIRAnalysis()));
+  return FPasses;
+}
+
+/// Add the passes and pipelines of the command line to Passes and FPasses, in
+/// order. The analysis printers of -analyze write to AnalysisOS.
+static void addCommandLinePasses(const char *Argv0,
+                                 legacy::PassManager &Passes,
+                                 legacy::FunctionPassManager *FPasses,
+                                 TargetMachine *TM, raw_ostream *AnalysisOS) {
+  struct {
+    cl::opt<bool> &Opt;
+    unsigned OptLevel, SizeLevel;
+    bool Pending;
+  } Levels[] = {{OptLevelO0, 0, 0, OptLevelO0}, {OptLevelO1, 1, 0, OptLevelO1},
+                {OptLevelO2, 2, 0, OptLevelO2}, {OptLevelOs, 2, 1, OptLevelOs},
+                {OptLevelOz, 2, 2, OptLevelOz}, {OptLevelO3, 3, 0, OptLevelO3}};
+  bool AddStandardLinkOpts = StandardLinkOpts;
+
+  // Create a new optimization pass for each one specified on the command line
+  for (unsigned i = 0; i < PassList.size(); ++i) {
+    if (AddStandardLinkOpts &&
+        StandardLinkOpts.getPosition() < PassList.getPosition(i)) {
+      AddStandardLinkPasses(Passes);
+      AddStandardLinkOpts = false;
+    }
+
+    for (auto &L : Levels) {
+      if (L.Pending && L.Opt.getPosition() < PassList.getPosition(i)) {
+        AddOptimizationPasses(Passes, *FPasses, TM, L.OptLevel, L.SizeLevel);
+        L.Pending = false;
+      }
+    }
+
+    const PassInfo *PassInf = PassList[i];
+    Pass *P = nullptr;
+    if (PassInf->getNormalCtor())
+      P = PassInf->getNormalCtor()();
+    else
+      errs() << Argv0 << ": cannot create pass: "
+             << PassInf->getPassName() << "\n";
+    if (P) {
+      PassKind Kind = P->getPassKind();
+      addPass(Passes, P);
+
+      if (AnalyzeOnly) {
+        switch (Kind) {
+        case PT_BasicBlock:
+          Passes.add(createBasicBlockPassPrinter(PassInf, *AnalysisOS, Quiet));
+          break;
+        case PT_Region:
+          Passes.add(createRegionPassPrinter(PassInf, *AnalysisOS, Quiet));
+          break;
+        case PT_Loop:
+          Passes.add(createLoopPassPrinter(PassInf, *AnalysisOS, Quiet));
+          break;
+        case PT_Function:
+          Passes.add(createFunctionPassPrinter(PassInf, *AnalysisOS, Quiet));
+          break;
+        case PT_CallGraphSCC:
+          Passes.add(createCallGraphPassPrinter(PassInf, *AnalysisOS, Quiet));
+          break;
+        default:
+          Passes.add(createModulePassPrinter(PassInf, *AnalysisOS, Quiet));
+          break;
+        }
+      }
+    }
+
+    if (PrintEachXForm)
+      Passes.add(
+          createPrintModulePass(errs(), "", PreserveAssemblyUseListOrder));
+  }
+
+  if (AddStandardLinkOpts)
+    AddStandardLinkPasses(Passes);
+
+  for (auto &L : Levels)
+    if (L.Pending)
+      AddOptimizationPasses(Passes, *FPasses, TM, L.OptLevel, L.SizeLevel);
+}
+
+//===----------------------------------------------------------------------===//
+// Partitioned optimization (-j).
+//
+
+/// Check that the options can be used with -j.
+static bool checkPartitionedOptions(const char *Argv0) {
+  const char *Unsupported = nullptr;
+  if (PassPipeline.getNumOccurrences() > 0)
+    Unsupported = "-passes";
+  else if (AnalyzeOnly)
+    Unsupported = "-analyze";
+  else if (PrintBreakpoints)
+    Unsupported = "-print-breakpoints-for-testing";
+  else if (RunTwice)
+    Unsupported = "-run-twice";
+  else if (OutputThinLTOBC)
+    Unsupported = "-thinlto-bc";
+  else if (!RemarksFilename.empty())
+    Unsupported = "-pass-remarks-output";
+  if (Unsupported) {
+    errs() << Argv0 << ": " << Unsupported << " is not supported with -j\n";
+    return false;
+  }
+
+  if (!PartitionFunctionLocal)
+    return true;
+  if (hasOptLevel() || StandardLinkOpts) {
+    errs() << Argv0 << ": -j-function-local doesn't support the -O<n> and "
+                       "-std-link-opts pipelines\n";
+    return false;
+  }
+  for (const PassInfo *PassInf : PassList) {
+    if (!PassInf->getNormalCtor())
+      continue;
+    std::unique_ptr<Pass> P(PassInf->getNormalCtor()());
+    PassKind Kind = P->getPassKind();
+    if (Kind != PT_BasicBlock && Kind != PT_Region && Kind != PT_Loop &&
+        Kind != PT_Function && !P->getAsImmutablePass()) {
+      errs() << Argv0 << ": -j-function-local: " << PassInf->getPassArgument()
+             << " is not a function pass\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Optimize the partition serialized in BC in its own context, and replace BC
+/// with the optimized partition.
+static void optimizePartition(const char *Argv0, SmallString<0> &BC) {
+  LLVMContext Ctx;
+  Ctx.setDiscardValueNames(DiscardValueNames);
+  if (!DisableDITypeMap)
+    Ctx.enableDebugTypeODRUniquing();
+
+  Expected<std::unique_ptr<Module>> MOrErr = parseBitcodeFile(
+      MemoryBufferRef(StringRef(BC.data(), BC.size()), "<split-module>"), Ctx);
+  if (!MOrErr)
+    report_fatal_error("Failed to read bitcode");
+  Module &M = **MOrErr;
+
+  Triple ModuleTriple(M.getTargetTriple());
+  std::unique_ptr<TargetMachine> TM;
+  if (ModuleTriple.getArch())
+    TM.reset(GetTargetMachine(ModuleTriple, getCPUStr(), getFeaturesStr(),
+                              InitTargetOptionsFromCodeGenFlags()));
+
+  legacy::PassManager Passes;
+  addTargetAnalysisPasses(Passes, TM.get(), ModuleTriple);
+  std::unique_ptr<legacy::FunctionPassManager> FPasses =
+      createFunctionPasses(M, TM.get());
+  addCommandLinePasses(Argv0, Passes, FPasses.get(), TM.get(), nullptr);
+
+  if (FPasses) {
+    FPasses->doInitialization();
+    for (Function &F : M)
+      FPasses->run(F);
+    FPasses->doFinalization();
+  }
+
+  if (!NoVerify && !VerifyEach)
+    Passes.add(createVerifierPass());
+
+  BC.clear();
+  raw_svector_ostream OS(BC);
+  Passes.add(createBitcodeWriterPass(OS, PreserveBitcodeUseListOrder));
+  Passes.run(M);
+}
+
+/// Move the globals of List to the order of Names. The globals that aren't in
+/// Names, e.g., that the passes created, go last.
+template <typename ListT>
+static void restoreOrder(ListT &List, ArrayRef<std::string> Names) {
+  StringMap<unsigned> Positions;
+  for (unsigned I = 0, E = Names.size(); I != E; ++I)
+    Positions[Names[I]] = I;
+  auto getPosition = [&](const GlobalValue *GV) {
+    auto It = Positions.find(GV->getName());
+    return It == Positions.end() ? Names.size() : It->second;
+  };
+
+  std::vector<typename ListT::value_type *> Sorted;
+  for (auto &GV : List)
+    Sorted.push_back(&GV);
+  std::stable_sort(Sorted.begin(), Sorted.end(),
+                   [&](const GlobalValue *A, const GlobalValue *B) {
+                     return getPosition(A) < getPosition(B);
+                   });
+  for (auto *GV : Sorted)
+    List.splice(List.end(), List, GV->getIterator());
+}
+
+/// Map the distinct nodes reachable from Dup to the nodes at the same position
+/// under Orig, of which they are copies.
+static void mapDistinctCopies(Metadata *Orig, Metadata *Dup,
+                              ValueToValueMapTy &VM) {
+  SmallVector<std::pair<MDNode *, MDNode *>, 16> Worklist;
+  SmallPtrSet<MDNode *, 32> Visited;
+  auto Push = [&](Metadata *O, Metadata *D) {
+    auto *ON = dyn_cast_or_null<MDNode>(O);
+    auto *DN = dyn_cast_or_null<MDNode>(D);
+    if (ON && DN && ON != DN && Visited.insert(DN).second)
+      Worklist.push_back({ON, DN});
+  };
+
+  Push(Orig, Dup);
+  while (!Worklist.empty()) {
+    MDNode *O, *D;
+    std::tie(O, D) = Worklist.pop_back_val();
+    if (O->getMetadataID() != D->getMetadataID() ||
+        O->isDistinct() != D->isDistinct() ||
+        O->getNumOperands() != D->getNumOperands())
+      continue;
+    if (D->isDistinct())
+      VM.MD()[D].reset(O);
+    for (unsigned I = 0, E = O->getNumOperands(); I != E; ++I)
+      Push(O->getOperand(I), D->getOperand(I));
+  }
+}
+
+/// Merge the copies of the named metadata, e.g., !llvm.dbg.cu, that each
+/// partition brings back. NamedMDSizes has the number of operands of each
+/// named metadata of the input.
+static void mergePartitionMetadata(Module &M,
+                                   const StringMap<unsigned> &NamedMDSizes) {
+  // The operands of the partitions follow each other. Distinct nodes, e.g.,
+  // the DICompileUnits, can't be uniqued: map the copies of the partitions to
+  // those of the first one, and remap everything that refers to them.
+  ValueToValueMapTy VM;
+  bool HasCopies = false;
+  for (NamedMDNode &NMD : M.named_metadata()) {
+    unsigned Size = NamedMDSizes.lookup(NMD.getName());
+    if (!Size || NMD.getNumOperands() % Size)
+      continue;
+    for (unsigned I = Size, E = NMD.getNumOperands(); I != E; ++I) {
+      mapDistinctCopies(NMD.getOperand(I % Size), NMD.getOperand(I), VM);
+      HasCopies = true;
+    }
+  }
+
+  // CloneModule copies the variables the globals' !dbg attachments refer to,
+  // with their compile unit, before CloneFunctionInto keeps the unit itself:
+  // these copies aren't in the globals of the listed units. Map them to the
+  // listed variables of the first partition with the same name and location.
+  NamedMDNode *CUs = M.getNamedMetadata("llvm.dbg.cu");
+  unsigned NumCUs = CUs ? NamedMDSizes.lookup(CUs->getName()) : 0;
+  if (NumCUs && CUs->getNumOperands() % NumCUs == 0) {
+    typedef std::tuple<StringRef, StringRef, StringRef, unsigned> VarKey;
+    auto getKey = [](DIGlobalVariable *V) {
+      return VarKey(V->getFilename(), V->getName(), V->getLinkageName(),
+                    V->getLine());
+    };
+    std::map<VarKey, DIGlobalVariableExpression *> Listed;
+    for (unsigned I = 0; I != NumCUs; ++I) {
+      auto *CU = cast<DICompileUnit>(CUs->getOperand(I));
+      for (auto *E : CU->getGlobalVariables())
+        if (DIGlobalVariable *V = E->getVariable())
+          Listed.insert({getKey(V), E});
+    }
+
+    SmallVector<DIGlobalVariableExpression *, 1> Attached;
+    for (GlobalVariable &GV : M.globals()) {
+      Attached.clear();
+      GV.getDebugInfo(Attached);
+      for (auto *E : Attached) {
+        DIGlobalVariable *V = E->getVariable();
+        auto I = V ? Listed.find(getKey(V)) : Listed.end();
+        if (I != Listed.end() && I->second != E) {
+          mapDistinctCopies(I->second, E, VM);
+          HasCopies = true;
+        }
+      }
+    }
+  }
+
+  const RemapFlags Flags = RF_MoveDistinctMDs | RF_IgnoreMissingLocals;
+  if (HasCopies) {
+    for (Function &F : M)
+      RemapFunction(F, VM, Flags);
+    for (GlobalVariable &GV : M.globals()) {
+      SmallVector<std::pair<unsigned, MDNode *>, 1> MDs;
+      GV.getAllMetadata(MDs);
+      GV.clearMetadata();
+      for (auto &MD : MDs)
+        GV.addMetadata(MD.first, *MapMetadata(MD.second, VM, Flags));
+    }
+  }
+
+  for (NamedMDNode &NMD : M.named_metadata()) {
+    if (&NMD == M.getModuleFlagsMetadata())
+      continue;
+    SetVector<MDNode *> Ops;
+    for (MDNode *Op : NMD.operands())
+      Ops.insert(HasCopies ? MapMetadata(Op, VM, Flags) : Op);
+    NMD.clearOperands();
+    for (MDNode *Op : Ops)
+      NMD.addOperand(Op);
+  }
+}
+
+/// Optimize M in NumPartitions partitions, in parallel, and return the
+/// relinked module.
+static std::unique_ptr<Module> optimizePartitioned(const char *Argv0,
+                                                   std::unique_ptr<Module> M) {
+  LLVMContext &Context = M->getContext();
+  std::string ModuleID = M->getModuleIdentifier();
+
+  // The relinked module has the globals of the partitions in turn; remember
+  // the input order to restore it, so that the output is the same for any
+  // number of partitions.
+  std::vector<std::string> FunctionOrder, GlobalOrder;
+  for (Function &F : *M)
+    FunctionOrder.push_back(F.getName());
+  for (GlobalVariable &GV : M->globals())
+    GlobalOrder.push_back(GV.getName());
+  StringMap<unsigned> NamedMDSizes;
+  for (NamedMDNode &NMD : M->named_metadata())
+    NamedMDSizes[NMD.getName()] = NMD.getNumOperands();
+
+  // A partition would remove the linkonce definitions it doesn't use itself,
+  // even if other partitions do: make them weak until the partitions are
+  // relinked.
+  StringMap<GlobalValue::LinkageTypes> LinkOnceLinkages;
+  for (GlobalValue &GV : M->global_values())
+    if (GV.hasLinkOnceLinkage() && !GV.use_empty()) {
+      LinkOnceLinkages[GV.getName()] = GV.getLinkage();
+      GV.setLinkage(GV.hasLinkOnceODRLinkage() ? GlobalValue::WeakODRLinkage
+                                               : GlobalValue::WeakAnyLinkage);
+    }
+
+  std::vector<SmallString<0>> Partitions(NumPartitions);
+  {
+    // Create ThreadPool in nested scope so that threads will be joined
+    // on destruction.
+    ThreadPool OptThreadPool(NumPartitions);
+    unsigned PartitionCount = 0;
+
+    SplitModule(
+        std::move(M), NumPartitions,
+        [&](std::unique_ptr<Module> MPart) {
+          // The partitions that don't define the appending globals, e.g.,
+          // llvm.global_ctors, get declarations of them, which can't be
+          // relinked.
+          for (auto I = MPart->global_begin(), E = MPart->global_end();
+               I != E;) {
+            GlobalVariable &GV = *I++;
+            if (GV.isDeclaration() && GV.getName().startswith("llvm.") &&
+                GV.use_empty())
+              GV.eraseFromParent();
+          }
+
+          // Serialize the partitions while still on the main thread, and
+          // optimize them in separate contexts, like splitCodeGen.
+          SmallString<0> &BC = Partitions[PartitionCount++];
+          raw_svector_ostream BCOS(BC);
+          WriteBitcodeToFile(MPart.get(), BCOS);
+          OptThreadPool.async([Argv0, &BC] { optimizePartition(Argv0, BC); });
+        },
+        /*PreserveLocals=*/true, /*ClusterCallGraphSCCs=*/true);
+  }
+
+  // Relink the partitions, in order.
+  std::unique_ptr<Module> Linked;
+  for (SmallString<0> &BC : Partitions) {
+    Expected<std::unique_ptr<Module>> MOrErr = parseBitcodeFile(
+        MemoryBufferRef(StringRef(BC.data(), BC.size()), "<split-module>"),
+        Context);
+    if (!MOrErr)
+      report_fatal_error("Failed to read bitcode");
+    if (!Linked) {
+      Linked = std::move(*MOrErr);
+      continue;
+    }
+    if (Linker::linkModules(*Linked, std::move(*MOrErr))) {
+      errs() << Argv0 << ": error: failed to relink the partitions\n";
+      return nullptr;
+    }
+  }
+
+  Linked->setModuleIdentifier(ModuleID);
+  for (auto &Entry : LinkOnceLinkages)
+    if (GlobalValue *GV = Linked->getNamedValue(Entry.getKey()))
+      if (!GV->isDeclaration())
+        GV->setLinkage(Entry.getValue());
+  restoreOrder(Linked->getFunctionList(), FunctionOrder);
+  restoreOrder(Linked->getGlobalList(), GlobalOrder);
+
+  // Each partition has a copy of the named metadata, e.g., !llvm.ident.
+  mergePartitionMetadata(*Linked, NamedMDSizes);
+  return Linked;
+}
+
 #ifdef LINK_POLLY_INTO_TOOLS
 namespace polly {
 void initializePollyPasses(llvm::PassRegistry &Registry);
@@ -413,6 +865,9 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  if (NumPartitions > 1 && !checkPartitionedOptions(argv[0]))
+    return 1;
+
   SMDiagnostic Err;
 
   Context.setDiscardValueNames(DiscardValueNames);
@@ -543,25 +998,17 @@ int main(int argc, char **argv) {
   // about to build.
   //
   legacy::PassManager Passes;
-
-  // Add an appropriate TargetLibraryInfo pass for the module's triple.
-  TargetLibraryInfoImpl TLII(ModuleTriple);
-
-  // The -disable-simplify-libcalls flag actually disables all builtin optzns.
-  if (DisableSimplifyLibCalls)
-    TLII.disableAllFunctions();
-  Passes.add(new TargetLibraryInfoWrapperPass(TLII));
-
-  // Add internal analysis passes from the target machine.
-  Passes.add(createTargetTransformInfoWrapperPass(TM ? TM->getTargetIRAnalysis()
-                                                     : TargetIRAnalysis()));
-
   std::unique_ptr<legacy::FunctionPassManager> FPasses;
-  if (OptLevelO0 || OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz ||
-      OptLevelO3) {
-    FPasses.reset(new legacy::FunctionPassManager(M.get()));
-    FPasses->add(createTargetTransformInfoWrapperPass(
-        TM ? TM->getTargetIRAnalysis() : TargetIRAnalysis()));
+
+  if (NumPartitions > 1) {
+    // The partitions are optimized on their own; only verify and write the
+    // relinked module.
+    M = optimizePartitioned(argv[0], std::move(M));
+    if (!M)
+      return 1;
+  } else {
+    addTargetAnalysisPasses(Passes, TM.get(), ModuleTriple);
+    FPasses = createFunctionPasses(*M, TM.get());
   }
 
   if (PrintBreakpoints) {
@@ -582,113 +1029,9 @@ int main(int argc, char **argv) {
     NoOutput = true;
   }
 
-  if (TM) {
-    // FIXME: We should dyn_cast this when supported.
-    auto &LTM = static_cast<LLVMTargetMachine &>(*TM);
-    Pass *TPC = LTM.createPassConfig(Passes);
-    Passes.add(TPC);
-  }
-
-  // Create a new optimization pass for each one specified on the command line
-  for (unsigned i = 0; i < PassList.size(); ++i) {
-    if (StandardLinkOpts &&
-        StandardLinkOpts.getPosition() < PassList.getPosition(i)) {
-      AddStandardLinkPasses(Passes);
-      StandardLinkOpts = false;
-    }
-
-    if (OptLevelO0 && OptLevelO0.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 0, 0);
-      OptLevelO0 = false;
-    }
-
-    if (OptLevelO1 && OptLevelO1.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 1, 0);
-      OptLevelO1 = false;
-    }
-
-    if (OptLevelO2 && OptLevelO2.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 0);
-      OptLevelO2 = false;
-    }
-
-    if (OptLevelOs && OptLevelOs.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 1);
-      OptLevelOs = false;
-    }
-
-    if (OptLevelOz && OptLevelOz.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 2);
-      OptLevelOz = false;
-    }
-
-    if (OptLevelO3 && OptLevelO3.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 3, 0);
-      OptLevelO3 = false;
-    }
-
-    const PassInfo *PassInf = PassList[i];
-    Pass *P = nullptr;
-    if (PassInf->getNormalCtor())
-      P = PassInf->getNormalCtor()();
-    else
-      errs() << argv[0] << ": cannot create pass: "
-             << PassInf->getPassName() << "\n";
-    if (P) {
-      PassKind Kind = P->getPassKind();
-      addPass(Passes, P);
-
-      if (AnalyzeOnly) {
-        switch (Kind) {
-        case PT_BasicBlock:
-          Passes.add(createBasicBlockPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        case PT_Region:
-          Passes.add(createRegionPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        case PT_Loop:
-          Passes.add(createLoopPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        case PT_Function:
-          Passes.add(createFunctionPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        case PT_CallGraphSCC:
-          Passes.add(createCallGraphPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        default:
-          Passes.add(createModulePassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        }
-      }
-    }
-
-    if (PrintEachXForm)
-      Passes.add(
-          createPrintModulePass(errs(), "", PreserveAssemblyUseListOrder));
-  }
-
-  if (StandardLinkOpts) {
-    AddStandardLinkPasses(Passes);
-    StandardLinkOpts = false;
-  }
-
-  if (OptLevelO0)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 0, 0);
-
-  if (OptLevelO1)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 1, 0);
-
-  if (OptLevelO2)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 0);
-
-  if (OptLevelOs)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 1);
-
-  if (OptLevelOz)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 2);
-
-  if (OptLevelO3)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 3, 0);
+  if (NumPartitions <= 1)
+    addCommandLinePasses(argv[0], Passes, FPasses.get(), TM.get(),
+                         Out ? &Out->os() : nullptr);
 
   if (FPasses) {
     FPasses->doInitialization();
@@ -492,4 +492,19 @@ TEST(StringMapCustomTest, EmplaceTest) {
   EXPECT_EQ(42, Map["abcd"].Data);
 }
 
+TEST(StringMapCustomTest, ManyKeysWithCommonPrefix) {
+  // Symbol tables are full of names that only differ near the end.
+  StringMap<unsigned> Map;
+  std::string Prefix = "_ZN4llvm12_GLOBAL__N_117SomeLongClassName";
+  for (unsigned i = 0; i < 10000; ++i)
+    Map[(Twine(Prefix) + Twine(i) + "Ev").str()] = i;
+  EXPECT_EQ(10000u, Map.size());
+  for (unsigned i = 0; i < 10000; ++i) {
+    auto I = Map.find((Twine(Prefix) + Twine(i) + "Ev").str());
+    ASSERT_NE(Map.end(), I);
+    EXPECT_EQ(i, I->second);
+  }
+  EXPECT_EQ(Map.end(), Map.find(Prefix));
+}
+
 } // end anonymous namespace
@@ -0,0 +1,148 @@
+//===- MCJITSamplingProfilerTest.cpp - Unit tests for the JIT profiler ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MCJITTestBase.h"
+#include "llvm/ExecutionEngine/JITSamplingProfiler.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <chrono>
+
+using namespace llvm;
+
+namespace {
+
+class MCJITSamplingProfilerTest : public testing::Test, public MCJITTestBase {
+protected:
+  void SetUp() override { M.reset(createEmptyModule("<main>")); }
+
+  // The JIT notifies the profiler when it frees its code.
+  void TearDown() override { TheJIT.reset(); }
+
+  // JIT "accumulate" and "add", with a profiler registered before they are
+  // loaded.
+  void createJITWithProfiler(const JITSamplingProfiler::Options &Opts =
+                                 JITSamplingProfiler::Options()) {
+    Profiler = llvm::make_unique<JITSamplingProfiler>(Opts);
+    insertAccumulateFunction(M.get());
+    insertAddFunction(M.get());
+    createJIT(std::move(M));
+    TheJIT->RegisterJITEventListener(Profiler.get());
+    TheJIT->finalizeObject();
+  }
+
+  // Run "accumulate" until the sampler has attributed a few samples to it.
+  void sampleHotFunction(bool UseHardwareCounters) {
+    JITSamplingProfiler::Options Opts;
+    Opts.UseHardwareCounters = UseHardwareCounters;
+    Opts.CyclesPerSample = 100000;
+    Opts.TimerIntervalUs = 100;
+    createJITWithProfiler(Opts);
+    auto *Accumulate =
+        (int32_t(*)(int32_t))TheJIT->getFunctionAddress("accumulate");
+    ASSERT_NE(nullptr, Accumulate);
+
+    if (Error Err = Profiler->start()) {
+      // No way to sample on this host.
+      consumeError(std::move(Err));
+      return;
+    }
+    if (!UseHardwareCounters)
+      EXPECT_EQ(JITSamplingProfiler::SampleSource::Timer,
+                Profiler->getSampleSource());
+    else
+      EXPECT_NE(JITSamplingProfiler::SampleSource::None,
+                Profiler->getSampleSource());
+
+    // Spin in JITed code until a few samples are taken there.
+    auto Deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    uint64_t Samples = 0;
+    volatile int32_t Sink = 0;
+    while (Samples < 20 && std::chrono::steady_clock::now() < Deadline) {
+      for (unsigned I = 0; I != 1000; ++I)
+        Sink = Sink + Accumulate(1000);
+      Profiler->update();
+      auto Hottest = Profiler->getHottestFunctions(1);
+      Samples = Hottest.empty() ? 0 : Hottest[0].Samples;
+    }
+    Profiler->stop();
+    EXPECT_EQ(JITSamplingProfiler::SampleSource::None,
+              Profiler->getSampleSource());
+
+    auto Hottest = Profiler->getHottestFunctions(1);
+    ASSERT_EQ(1u, Hottest.size());
+    // The names are those of the object's symbols, e.g., "_accumulate" on
+    // Darwin.
+    StringRef Name = Hottest[0].Name;
+    if (char GlobalPrefix = TheJIT->getDataLayout().getGlobalPrefix())
+      Name.consume_front(StringRef(&GlobalPrefix, 1));
+    EXPECT_EQ("accumulate", Name.str());
+    EXPECT_GE(Hottest[0].Samples, 20u);
+  }
+
+  std::unique_ptr<JITSamplingProfiler> Profiler;
+};
+
+TEST_F(MCJITSamplingProfilerTest, AttributionAndDecay) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  createJITWithProfiler();
+  uint64_t AccumulateAddr = TheJIT->getFunctionAddress("accumulate");
+  uint64_t AddAddr = TheJIT->getFunctionAddress("add");
+  ASSERT_NE(0u, AccumulateAddr);
+  ASSERT_NE(0u, AddAddr);
+
+  for (unsigned I = 0; I != 8; ++I)
+    Profiler->recordSample(AccumulateAddr + 1);
+  for (unsigned I = 0; I != 2; ++I)
+    Profiler->recordSample(AddAddr);
+  Profiler->recordSample(0);
+
+  // Samples only count once they are folded into the profile.
+  EXPECT_EQ(0, Profiler->getHotness(AccumulateAddr));
+  Profiler->update();
+  EXPECT_EQ(8, Profiler->getHotness(AccumulateAddr));
+  EXPECT_EQ(2, Profiler->getHotness(AddAddr + 1));
+  EXPECT_EQ(1u, Profiler->getNumUnattributedSamples());
+
+  // Scores halve at each update, sample counts stay.
+  Profiler->recordSample(AddAddr);
+  Profiler->update();
+  EXPECT_EQ(4, Profiler->getHotness(AccumulateAddr));
+  EXPECT_EQ(2, Profiler->getHotness(AddAddr));
+
+  std::vector<JITSamplingProfiler::FunctionProfile> Hottest =
+      Profiler->getHottestFunctions(1);
+  ASSERT_EQ(1u, Hottest.size());
+  EXPECT_EQ(AccumulateAddr, Hottest[0].Address);
+  EXPECT_EQ(8u, Hottest[0].Samples);
+  EXPECT_EQ(2u, Profiler->getHottestFunctions(10).size());
+
+  std::string Report;
+  raw_string_ostream OS(Report);
+  Profiler->print(OS);
+  EXPECT_NE(std::string::npos, OS.str().find("accumulate"));
+
+  // Freeing the code forgets its functions.
+  TheJIT.reset();
+  EXPECT_EQ(0, Profiler->getHotness(AccumulateAddr));
+  EXPECT_TRUE(Profiler->getHottestFunctions(10).empty());
+}
+
+TEST_F(MCJITSamplingProfilerTest, SampleHotFunction) {
+  SKIP_UNSUPPORTED_PLATFORM;
+  sampleHotFunction(/*UseHardwareCounters=*/true);
+}
+
+TEST_F(MCJITSamplingProfilerTest, SampleHotFunctionWithTimer) {
+  SKIP_UNSUPPORTED_PLATFORM;
+  sampleHotFunction(/*UseHardwareCounters=*/false);
+}
+
+} // end anonymous namespace
@@ -114,6 +114,30 @@ TEST_F(MCJITTest, return_global) {
     << "Invalid value for global returned from JITted function";
 }
 
+// Enough relocations for RuntimeDyld to resolve them on several threads.
+TEST_F(MCJITTest, many_relocations) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  const unsigned NumGlobals = 10000;
+  Type *Int32Ty = Type::getInt32Ty(Context);
+  std::vector<Constant *> Pointers;
+  for (unsigned i = 0; i < NumGlobals; ++i)
+    Pointers.push_back(
+        insertGlobalInt32(M.get(), "g" + std::to_string(i), i));
+  ArrayType *TableTy = ArrayType::get(Int32Ty->getPointerTo(), NumGlobals);
+  new GlobalVariable(*M, TableTy, false, GlobalValue::ExternalLinkage,
+                     ConstantArray::get(TableTy, Pointers), "table");
+
+  createJIT(std::move(M));
+  int32_t **Table = (int32_t **)TheJIT->getGlobalValueAddress("table");
+  ASSERT_TRUE(Table != nullptr);
+  for (unsigned i = 0; i < NumGlobals; ++i) {
+    ASSERT_EQ((uint64_t)Table[i],
+              TheJIT->getGlobalValueAddress("g" + std::to_string(i)));
+    ASSERT_EQ((int32_t)i, *Table[i]);
+  }
+}
+
 // FIXME: This case fails due to a bug with getPointerToGlobal().
 // The bug is due to MCJIT not having an implementation of getPointerToGlobal()
 // which results in falling back on the ExecutionEngine implementation that
@@ -0,0 +1,155 @@
+//===- ConcurrentIRCompileLayerTest.cpp - Unit tests for the compile layer ===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/ConcurrentIRCompileLayer.h"
+#include "OrcTestCommon.h"
+#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/Constants.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+namespace {
+
+class ConcurrentIRCompileLayerTest : public testing::Test,
+                                     public OrcExecutionTest {
+protected:
+  typedef ConcurrentIRCompileLayer<RTDyldObjectLinkingLayer> CompileLayerT;
+
+  static std::unique_ptr<TargetMachine> buildTM() {
+    return std::unique_ptr<TargetMachine>(EngineBuilder().selectTarget());
+  }
+
+  // Build a module defining "int32_t Name() { return Value; }".
+  std::unique_ptr<Module> createReturnModule(LLVMContext &Ctx, StringRef Name,
+                                             int32_t Value) {
+    ModuleBuilder MB(Ctx, TM->getTargetTriple().str(), "dummy");
+    MB.getModule()->setDataLayout(TM->createDataLayout());
+    Function *F = MB.createFunctionDecl<int32_t(void)>(Name);
+    IRBuilder<> Builder(BasicBlock::Create(Ctx, "entry", F));
+    Builder.CreateRet(ConstantInt::getSigned(Builder.getInt32Ty(), Value));
+    return MB.takeModule();
+  }
+
+  // Build a module defining "int32_t Name() { return Callee() + 1; }".
+  std::unique_ptr<Module> createCallModule(LLVMContext &Ctx, StringRef Name,
+                                           StringRef Callee) {
+    ModuleBuilder MB(Ctx, TM->getTargetTriple().str(), "dummy");
+    MB.getModule()->setDataLayout(TM->createDataLayout());
+    Function *CalleeDecl = MB.createFunctionDecl<int32_t(void)>(Callee);
+    Function *F = MB.createFunctionDecl<int32_t(void)>(Name);
+    IRBuilder<> Builder(BasicBlock::Create(Ctx, "entry", F));
+    Builder.CreateRet(
+        Builder.CreateAdd(Builder.CreateCall(CalleeDecl), Builder.getInt32(1)));
+    return MB.takeModule();
+  }
+
+  template <typename LayerT>
+  std::shared_ptr<JITSymbolResolver> createResolver(LayerT &Layer) {
+    return createLambdaResolver(
+        [&Layer](const std::string &Name) {
+          return Layer.findSymbol(Name, true);
+        },
+        [](const std::string &Name) { return JITSymbol(nullptr); });
+  }
+
+  template <typename LayerT>
+  typename LayerT::ModuleSetHandleT add(LayerT &Layer,
+                                        std::unique_ptr<Module> M) {
+    std::vector<std::unique_ptr<Module>> Ms;
+    Ms.push_back(std::move(M));
+    return Layer.addModuleSet(std::move(Ms),
+                              std::make_shared<SectionMemoryManager>(),
+                              createResolver(Layer));
+  }
+
+  template <typename LayerT>
+  int32_t call(LayerT &Layer, const std::string &Name) {
+    auto Sym = Layer.findSymbol(Name, true);
+    EXPECT_TRUE(!!Sym) << "Missing symbol " << Name;
+    if (!Sym)
+      return -1;
+    auto *Fn = (int32_t(*)())(uintptr_t)Sym.getAddress();
+    return Fn();
+  }
+};
+
+TEST_F(ConcurrentIRCompileLayerTest, SeparateContexts) {
+  if (!TM)
+    return;
+
+  // The modules calling each other are compiled in parallel, and linked when
+  // they are looked up.
+  const unsigned NumModules = 8;
+  std::vector<std::unique_ptr<LLVMContext>> Contexts;
+  RTDyldObjectLinkingLayer ObjLayer;
+  CompileLayerT CompileLayer(ObjLayer, buildTM, 4);
+  for (unsigned I = 0; I != NumModules; ++I) {
+    Contexts.push_back(llvm::make_unique<LLVMContext>());
+    std::string Name = "f" + std::to_string(I);
+    if (I == 0)
+      add(CompileLayer, createReturnModule(*Contexts.back(), Name, 42));
+    else
+      add(CompileLayer, createCallModule(*Contexts.back(), Name,
+                                         "f" + std::to_string(I - 1)));
+  }
+
+  EXPECT_EQ(42 + (int32_t)NumModules - 1,
+            call(CompileLayer, "f" + std::to_string(NumModules - 1)));
+  EXPECT_EQ(42, call(CompileLayer, "f0"));
+  EXPECT_FALSE(CompileLayer.findSymbol("g", true));
+}
+
+TEST_F(ConcurrentIRCompileLayerTest, SharedContext) {
+  if (!TM)
+    return;
+
+  // Modules sharing a context are compiled one at a time. The context can't be
+  // used while they are, so create them all before adding them.
+  const unsigned NumModules = 16;
+  std::vector<std::unique_ptr<Module>> Ms;
+  for (unsigned I = 0; I != NumModules; ++I)
+    Ms.push_back(createReturnModule(Context, "f" + std::to_string(I), I));
+
+  RTDyldObjectLinkingLayer ObjLayer;
+  CompileLayerT CompileLayer(ObjLayer, buildTM, 4);
+  for (auto &M : Ms)
+    add(CompileLayer, std::move(M));
+
+  for (unsigned I = NumModules; I != 0; --I)
+    EXPECT_EQ((int32_t)I - 1,
+              call(CompileLayer, "f" + std::to_string(I - 1)));
+}
+
+TEST_F(ConcurrentIRCompileLayerTest, RemoveModuleSet) {
+  if (!TM)
+    return;
+
+  auto M1 = createReturnModule(Context, "foo", 1);
+  auto M2 = createReturnModule(Context, "bar", 2);
+  RTDyldObjectLinkingLayer ObjLayer;
+  CompileLayerT CompileLayer(ObjLayer, buildTM, 2);
+  auto H1 = add(CompileLayer, std::move(M1));
+  auto H2 = add(CompileLayer, std::move(M2));
+
+  // Removing a set, compiled or not, removes its symbols.
+  CompileLayer.removeModuleSet(H1);
+  EXPECT_FALSE(CompileLayer.findSymbol("foo", true));
+
+  CompileLayer.emitAndFinalize(H2);
+  EXPECT_TRUE(!!CompileLayer.findSymbolIn(H2, "bar", true));
+  EXPECT_EQ(2, call(CompileLayer, "bar"));
+  CompileLayer.removeModuleSet(H2);
+  EXPECT_FALSE(CompileLayer.findSymbol("bar", true));
+}
+
+} // end anonymous namespace
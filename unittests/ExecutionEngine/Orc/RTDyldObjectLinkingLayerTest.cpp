@@ -121,6 +121,45 @@ TEST(RTDyldObjectLinkingLayerTest, TestSetProcessAllSections) {
   }
 }
 
+TEST(RTDyldObjectLinkingLayerTest, TestNotifyFreed) {
+  LLVMContext Context;
+  auto M = llvm::make_unique<Module>("", Context);
+  M->setTargetTriple("x86_64-unknown-linux-gnu");
+  Type *Int32Ty = IntegerType::get(Context, 32);
+  new GlobalVariable(*M, Int32Ty, false, GlobalValue::ExternalLinkage,
+                     ConstantInt::get(Int32Ty, 42), "foo");
+
+  OrcNativeTarget::initialize();
+  std::unique_ptr<TargetMachine> TM(
+    EngineBuilder().selectTarget(Triple(M->getTargetTriple()), "", "",
+                                 SmallVector<std::string, 1>()));
+  if (!TM)
+    return;
+
+  auto Obj =
+    std::make_shared<object::OwningBinary<object::ObjectFile>>(
+      SimpleCompiler(*TM)(*M));
+  auto Resolver = std::make_shared<NullResolver>();
+
+  int FreedCount = 0;
+  {
+    RTDyldObjectLinkingLayer ObjLayer(
+        RTDyldObjectLinkingLayer::NotifyLoadedFtor(),
+        RTDyldObjectLinkingLayer::NotifyFinalizedFtor(),
+        [&](RTDyldObjectLinkingLayer::ObjHandleT) { ++FreedCount; });
+
+    auto H = ObjLayer.addObject(
+        Obj, std::make_shared<SectionMemoryManager>(), Resolver);
+    ObjLayer.emitAndFinalize(H);
+    ObjLayer.addObject(Obj, std::make_shared<SectionMemoryManager>(),
+                       Resolver);
+
+    ObjLayer.removeObject(H);
+    EXPECT_EQ(1, FreedCount) << "Removing an object should notify";
+  }
+  EXPECT_EQ(2, FreedCount) << "Destroying the layer should notify";
+}
+
 TEST_F(RTDyldObjectLinkingLayerExecutionTest, NoDuplicateFinalization) {
   if (!TM)
     return;
@@ -0,0 +1,170 @@
+//===- PooledMemoryManagerTest.cpp - Unit tests for the pooled JIT memory -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/PooledMemoryManager.h"
+#include "llvm/Support/Process.h"
+#include "gtest/gtest.h"
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+static JITMemoryPool::Options getOptions(bool UseDualMapping) {
+  JITMemoryPool::Options Opts;
+  Opts.SlabSize = 1024 * 1024;
+  Opts.UseDualMapping = UseDualMapping;
+  return Opts;
+}
+
+class PooledMemoryManagerTest : public ::testing::TestWithParam<bool> {};
+
+TEST_P(PooledMemoryManagerTest, BasicAllocations) {
+  JITMemoryPool Pool(getOptions(GetParam()));
+  PooledMemoryManager MemMgr1(Pool), MemMgr2(Pool);
+
+  uint8_t *code1 = MemMgr1.allocateCodeSection(256, 0, 1, "");
+  uint8_t *data1 = MemMgr1.allocateDataSection(256, 0, 2, "", true);
+  uint8_t *code2 = MemMgr2.allocateCodeSection(256, 0, 1, "");
+  uint8_t *data2 = MemMgr2.allocateDataSection(256, 0, 2, "", false);
+
+  EXPECT_NE((uint8_t*)nullptr, code1);
+  EXPECT_NE((uint8_t*)nullptr, code2);
+  EXPECT_NE((uint8_t*)nullptr, data1);
+  EXPECT_NE((uint8_t*)nullptr, data2);
+
+  // Initialize the data
+  for (unsigned i = 0; i < 256; ++i) {
+    code1[i] = 1;
+    code2[i] = 2;
+    data1[i] = 3;
+    data2[i] = 4;
+  }
+
+  // Verify the data (this is checking for overlaps in the addresses)
+  for (unsigned i = 0; i < 256; ++i) {
+    EXPECT_EQ(1, code1[i]);
+    EXPECT_EQ(2, code2[i]);
+    EXPECT_EQ(3, data1[i]);
+    EXPECT_EQ(4, data2[i]);
+  }
+
+  std::string Error;
+  EXPECT_FALSE(MemMgr1.finalizeMemory(&Error));
+
+  // The code is visible where it runs from.
+  const uint8_t *Exec1 = (const uint8_t *)Pool.getExecutableAddress(code1);
+  const uint8_t *Exec2 = (const uint8_t *)Pool.getExecutableAddress(code2);
+  EXPECT_EQ(1, Exec1[255]);
+  EXPECT_EQ(2, Exec2[255]);
+}
+
+TEST_P(PooledMemoryManagerTest, LargeAllocations) {
+  JITMemoryPool Pool(getOptions(GetParam()));
+  PooledMemoryManager MemMgr(Pool);
+
+  // Larger than a slab.
+  uint8_t *code1 = MemMgr.allocateCodeSection(0x200000, 0, 1, "");
+  uint8_t *data1 = MemMgr.allocateDataSection(0x200000, 0, 2, "", true);
+  uint8_t *code2 = MemMgr.allocateCodeSection(0x100, 0, 3, "");
+  uint8_t *data2 = MemMgr.allocateDataSection(0x200000, 0, 4, "", false);
+
+  EXPECT_NE((uint8_t*)nullptr, code1);
+  EXPECT_NE((uint8_t*)nullptr, code2);
+  EXPECT_NE((uint8_t*)nullptr, data1);
+  EXPECT_NE((uint8_t*)nullptr, data2);
+
+  code1[0x1FFFFF] = 1;
+  code2[0xFF] = 2;
+  data1[0x1FFFFF] = 3;
+  data2[0x1FFFFF] = 4;
+
+  std::string Error;
+  EXPECT_FALSE(MemMgr.finalizeMemory(&Error));
+  EXPECT_EQ(1, ((uint8_t *)Pool.getExecutableAddress(code1))[0x1FFFFF]);
+  EXPECT_EQ(2, ((uint8_t *)Pool.getExecutableAddress(code2))[0xFF]);
+  EXPECT_EQ(3, data1[0x1FFFFF]);
+  EXPECT_EQ(4, data2[0x1FFFFF]);
+}
+
+TEST_P(PooledMemoryManagerTest, Alignment) {
+  JITMemoryPool Pool(getOptions(GetParam()));
+  PooledMemoryManager MemMgr(Pool);
+
+  for (unsigned Align : {1, 16, 64, 4096}) {
+    uint8_t *Code = MemMgr.allocateCodeSection(10, Align, 0, "");
+    uint8_t *RO = MemMgr.allocateDataSection(10, Align, 0, "", true);
+    uint8_t *RW = MemMgr.allocateDataSection(10, Align, 0, "", false);
+    EXPECT_EQ(0U, (uintptr_t)Code % Align);
+    EXPECT_EQ(0U, Pool.getExecutableAddress(Code) % Align);
+    EXPECT_EQ(0U, (uintptr_t)RO % Align);
+    EXPECT_EQ(0U, (uintptr_t)RW % Align);
+  }
+}
+
+TEST_P(PooledMemoryManagerTest, PermissionsAreBatched) {
+  JITMemoryPool Pool(getOptions(GetParam()));
+  std::vector<std::unique_ptr<PooledMemoryManager>> MemMgrs;
+
+  // Many small objects, all loaded before the first finalization.
+  for (unsigned I = 0; I < 32; ++I) {
+    MemMgrs.emplace_back(new PooledMemoryManager(Pool));
+    EXPECT_NE((uint8_t*)nullptr,
+              MemMgrs.back()->allocateCodeSection(64, 16, 0, ""));
+    EXPECT_NE((uint8_t*)nullptr,
+              MemMgrs.back()->allocateDataSection(64, 16, 1, "", true));
+  }
+
+  std::string Error;
+  EXPECT_FALSE(MemMgrs.back()->finalizeMemory(&Error));
+  EXPECT_EQ(Pool.isCodeDualMapped() ? 1U : 2U, Pool.getNumProtectCalls());
+
+  // Finalizing again with nothing new is free.
+  EXPECT_FALSE(MemMgrs.front()->finalizeMemory(&Error));
+  EXPECT_EQ(Pool.isCodeDualMapped() ? 1U : 2U, Pool.getNumProtectCalls());
+}
+
+TEST_P(PooledMemoryManagerTest, CodeIsPacked) {
+  JITMemoryPool Pool(getOptions(GetParam()));
+  PooledMemoryManager MemMgr1(Pool), MemMgr2(Pool);
+  uint8_t *Code1 = MemMgr1.allocateCodeSection(64, 16, 0, "");
+  std::string Error;
+  EXPECT_FALSE(MemMgr1.finalizeMemory(&Error));
+  uint8_t *Code2 = MemMgr2.allocateCodeSection(64, 16, 0, "");
+  EXPECT_FALSE(MemMgr2.finalizeMemory(&Error));
+
+  // With dual mapping, consecutive objects share pages. Without it, the rest
+  // of Code1's page can't be written to once it is executable.
+  if (Pool.isCodeDualMapped())
+    EXPECT_EQ(Code1 + 64, Code2);
+  else
+    EXPECT_EQ(Code1 + sys::Process::getPageSize(), Code2);
+}
+
+TEST_P(PooledMemoryManagerTest, RWDataIsRecycled) {
+  JITMemoryPool Pool(getOptions(GetParam()));
+
+  uint8_t *Data1;
+  {
+    PooledMemoryManager MemMgr(Pool);
+    Data1 = MemMgr.allocateDataSection(100, 8, 0, "", false);
+    EXPECT_NE((uint8_t*)nullptr, Data1);
+  }
+
+  PooledMemoryManager MemMgr(Pool);
+  // Same size class.
+  EXPECT_EQ(Data1, MemMgr.allocateDataSection(120, 16, 0, "", false));
+  EXPECT_NE(Data1, MemMgr.allocateDataSection(120, 16, 0, "", false));
+}
+
+INSTANTIATE_TEST_CASE_P(PooledMemoryManagerTests, PooledMemoryManagerTest,
+                        ::testing::Bool(),);
+
+} // end anonymous namespace
@@ -0,0 +1,109 @@
+//===- ArchiveTest.cpp - Tests for Archive.cpp ----------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Object/Archive.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <string>
+
+using namespace llvm;
+using namespace llvm::object;
+
+namespace {
+
+// Append an archive member header for Name and Size to OS.
+void writeMemberHeader(raw_ostream &OS, StringRef Name, unsigned Size) {
+  OS << left_justify(Name, 16) << left_justify("0", 12)
+     << left_justify("0", 6) << left_justify("0", 6)
+     << left_justify("644", 8) << left_justify(std::to_string(Size), 10)
+     << "`\n";
+}
+
+// Append a big-endian 32-bit integer to OS.
+void writeBE32(raw_ostream &OS, uint32_t V) {
+  OS << char(V >> 24) << char(V >> 16) << char(V >> 8) << char(V);
+}
+
+// Create a GNU archive with the members a.o and b.o, with a symbol table
+// where "foo" is defined by both, and "bar" by b.o.
+std::string createGNUArchive() {
+  const char Names[] = "foo\0bar\0foo\0";
+  const unsigned SymTabSize = 4 + 3 * 4 + sizeof(Names) - 1;
+  const unsigned MemberSize = 2;
+  const unsigned AOffset = 8 + 60 + SymTabSize;
+  const unsigned BOffset = AOffset + 60 + MemberSize;
+
+  std::string Buf;
+  raw_string_ostream OS(Buf);
+  OS << "!<arch>\n";
+  writeMemberHeader(OS, "/", SymTabSize);
+  writeBE32(OS, 3);
+  writeBE32(OS, AOffset);
+  writeBE32(OS, BOffset);
+  writeBE32(OS, BOffset);
+  OS << StringRef(Names, sizeof(Names) - 1);
+  writeMemberHeader(OS, "a.o/", MemberSize);
+  OS << "a\n";
+  writeMemberHeader(OS, "b.o/", MemberSize);
+  OS << "b\n";
+  return OS.str();
+}
+
+StringRef findSymMemberName(const Archive &A, StringRef Sym) {
+  Expected<Optional<Archive::Child>> ChildOrErr = A.findSym(Sym);
+  if (!ChildOrErr) {
+    consumeError(ChildOrErr.takeError());
+    return "<error>";
+  }
+  if (!*ChildOrErr)
+    return "<none>";
+  Expected<StringRef> NameOrErr = (*ChildOrErr)->getName();
+  if (!NameOrErr) {
+    consumeError(NameOrErr.takeError());
+    return "<error>";
+  }
+  return *NameOrErr;
+}
+
+TEST(Archive, FindSym) {
+  std::string Buf = createGNUArchive();
+  Expected<std::unique_ptr<Archive>> AOrErr =
+      Archive::create(MemoryBufferRef(Buf, "test.a"));
+  ASSERT_TRUE(!!AOrErr);
+  const Archive &A = **AOrErr;
+  ASSERT_EQ(Archive::K_GNU, A.kind());
+  ASSERT_EQ(3u, A.getNumberOfSymbols());
+
+  // The first definition in the symbol table wins, like in a linker.
+  EXPECT_EQ("a.o", findSymMemberName(A, "foo"));
+  EXPECT_EQ("b.o", findSymMemberName(A, "bar"));
+  EXPECT_EQ("<none>", findSymMemberName(A, "baz"));
+  EXPECT_EQ("<none>", findSymMemberName(A, ""));
+
+  // The lookups after the first use the index.
+  EXPECT_EQ("b.o", findSymMemberName(A, "bar"));
+  EXPECT_EQ("a.o", findSymMemberName(A, "foo"));
+}
+
+TEST(Archive, FindSymNoSymbolTable) {
+  std::string Buf = "!<arch>\n";
+  raw_string_ostream OS(Buf);
+  writeMemberHeader(OS, "a.o/", 2);
+  OS << "a\n";
+  OS.flush();
+
+  Expected<std::unique_ptr<Archive>> AOrErr =
+      Archive::create(MemoryBufferRef(Buf, "test.a"));
+  ASSERT_TRUE(!!AOrErr);
+  EXPECT_FALSE((*AOrErr)->hasSymbolTable());
+  EXPECT_EQ("<none>", findSymMemberName(**AOrErr, "foo"));
+}
+
+} // end anonymous namespace
@@ -11,6 +11,7 @@
 #include "llvm/Support/Process.h"
 #include "gtest/gtest.h"
 #include <cstdlib>
+#include <cstring>
 
 using namespace llvm;
 using namespace sys;
@@ -362,4 +363,47 @@ INSTANTIATE_TEST_CASE_P(AllocationTests,
 			MappedMemoryTest,
 			::testing::ValuesIn(MemoryFlags),);
 
+TEST(MemoryTest, HugeHint) {
+  std::error_code EC;
+  MemoryBlock M = Memory::allocateMappedMemory(
+      100, nullptr, Memory::MF_READ | Memory::MF_WRITE | Memory::MF_HUGE_HINT,
+      EC);
+  EXPECT_EQ(std::error_code(), EC);
+  ASSERT_NE((void *)nullptr, M.base());
+  EXPECT_LE(100U, M.size());
+
+  // The hint doesn't get in the way of changing the protection.
+  memset(M.base(), 1, 100);
+  EXPECT_FALSE(Memory::protectMappedMemory(
+      M, Memory::MF_READ | Memory::MF_HUGE_HINT));
+  EXPECT_EQ(1, static_cast<char *>(M.base())[99]);
+
+  EXPECT_FALSE(Memory::releaseMappedMemory(M));
+}
+
+TEST(MemoryTest, DualMapped) {
+  MemoryBlock Writable, Alias;
+  std::error_code EC =
+      Memory::allocateDualMappedMemory(100, Memory::MF_READ, Writable, Alias);
+  if (EC == std::errc::function_not_supported)
+    return;
+  EXPECT_EQ(std::error_code(), EC);
+  ASSERT_NE((void *)nullptr, Writable.base());
+  ASSERT_NE((void *)nullptr, Alias.base());
+  EXPECT_NE(Writable.base(), Alias.base());
+  EXPECT_EQ(Writable.size(), Alias.size());
+  EXPECT_LE(100U, Alias.size());
+
+  // Writes show through the alias.
+  int *W = static_cast<int *>(Writable.base());
+  const int *A = static_cast<const int *>(Alias.base());
+  W[0] = 1;
+  W[20] = 2;
+  EXPECT_EQ(1, A[0]);
+  EXPECT_EQ(2, A[20]);
+
+  EXPECT_FALSE(Memory::releaseMappedMemory(Writable));
+  EXPECT_FALSE(Memory::releaseMappedMemory(Alias));
+}
+
 }  // anonymous namespace
@@ -0,0 +1,121 @@
+#!/usr/bin/env python
+#
+# Compare the optimization levels of the DC translator on a set of programs.
+#
+# For each program and level, this outputs:
+#   - the time llvm-dec takes to translate and optimize the program,
+#   - the number of IR instructions in the translated functions,
+#   - the size of the code llc compiles them to,
+#   - with --run, the run time of the program under DYN, translated at that
+#     level (OS X-only).
+#
+# Example usage:
+#   > utils/dc-opt-bench.py --bin-dir=build/bin a.out b.out
+#   > utils/dc-opt-bench.py --bin-dir=build/bin --run --dyn=build/lib/libDYN.dylib \
+#       a.out -- <program arguments>
+
+from __future__ import print_function
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+def translate(args, program, level):
+    start = time.time()
+    ir = subprocess.check_output(
+        [os.path.join(args.bin_dir, 'llvm-dec'), '-O%d' % level] +
+        args.dec_args + [program])
+    return ir, time.time() - start
+
+def count_ir_instructions(ir):
+    count = 0
+    in_function = False
+    for line in ir.decode().splitlines():
+        if line.startswith('define '):
+            in_function = True
+        elif line.startswith('}'):
+            in_function = False
+        elif in_function and re.match(r'  \S', line):
+            count += 1
+    return count
+
+def compiled_code_size(args, ir):
+    # Indirect branches go through the DYN runtime, like LowerDCTranslateAt
+    # makes them.
+    ir = re.sub(br'@llvm\.dc\.translate\.at\b', b'@__llvm_dc_translate_at', ir)
+    with tempfile.NamedTemporaryFile(suffix='.o') as obj:
+        llc = subprocess.Popen(
+            [os.path.join(args.bin_dir, 'llc'), '-O2', '-filetype=obj',
+             '-o', obj.name], stdin=subprocess.PIPE)
+        llc.communicate(ir)
+        if llc.returncode != 0:
+            raise RuntimeError('llc failed')
+        out = subprocess.check_output(
+            [os.path.join(args.bin_dir, 'llvm-size'), '-A', obj.name])
+    for line in out.decode().splitlines():
+        fields = line.split()
+        if fields and fields[0] in ('.text', '__text'):
+            return int(fields[1])
+    return 0
+
+def run_time(args, program, level):
+    env = dict(os.environ)
+    env['DCDYN_OPTIONS'] = ' '.join(
+        ['-dyn-translate-opt=%d' % level] + args.dyn_options)
+    env['DYLD_INSERT_LIBRARIES'] = args.dyn
+    best = None
+    for _ in range(args.runs):
+        start = time.time()
+        subprocess.call([program] + args.program_args, env=env)
+        elapsed = time.time() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare the DC translator optimization levels')
+    parser.add_argument('--bin-dir', default='bin',
+                        help='directory of llvm-dec, llc and llvm-size')
+    parser.add_argument('--levels', default='0,1,2,3',
+                        help='comma-separated optimization levels')
+    parser.add_argument('--dec-arg', dest='dec_args', action='append',
+                        default=[], help='extra llvm-dec argument')
+    parser.add_argument('--run', action='store_true',
+                        help='also time the programs under DYN')
+    parser.add_argument('--dyn', default='lib/libDYN.dylib',
+                        help='path to libDYN.dylib')
+    parser.add_argument('--dyn-option', dest='dyn_options', action='append',
+                        default=[], help='extra DCDYN_OPTIONS option')
+    parser.add_argument('--runs', type=int, default=5,
+                        help='runs per program and level; the best is kept')
+    parser.add_argument('programs', nargs='+')
+    argv = sys.argv[1:]
+    program_args = []
+    if '--' in argv:
+        program_args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    args = parser.parse_args(argv)
+    args.program_args = program_args
+    levels = [int(l) for l in args.levels.split(',')]
+
+    columns = ['program', 'level', 'translate (s)', 'IR insts', 'code size']
+    if args.run:
+        columns.append('run (s)')
+    print('\t'.join(columns))
+    for program in args.programs:
+        for level in levels:
+            ir, elapsed = translate(args, program, level)
+            row = [os.path.basename(program), '-O%d' % level,
+                   '%.3f' % elapsed, str(count_ir_instructions(ir)),
+                   str(compiled_code_size(args, ir))]
+            if args.run:
+                row.append('%.3f' % run_time(args, program, level))
+            print('\t'.join(row))
+            sys.stdout.flush()
+
+if __name__ == '__main__':
+    main()
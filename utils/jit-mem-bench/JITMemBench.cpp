@@ -0,0 +1,231 @@
+//===- JITMemBench - Benchmark the JIT memory managers --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program loads many small synthetic objects, one function each, the way
+// a dynamic translator does, with a SectionMemoryManager or a
+// PooledMemoryManager per object. It outputs the time spent allocating and
+// finalizing their memory, then calls the functions in a random order and
+// outputs the run time and, where available, the number of iTLB misses.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/PooledMemoryManager.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+static cl::opt<unsigned>
+    NumObjects("objects", cl::desc("Number of objects to load"),
+               cl::init(20000));
+
+static cl::opt<unsigned>
+    MaxFunctionSize("max-function-size",
+                    cl::desc("Largest function size, in bytes"),
+                    cl::init(1024));
+
+static cl::opt<unsigned> NumRounds("rounds",
+                                   cl::desc("Times to call every function"),
+                                   cl::init(50));
+
+static cl::opt<bool> HugePages("huge-pages",
+                               cl::desc("Back the pool with huge pages"),
+                               cl::init(false));
+
+static cl::opt<bool> NoDualMapping("no-dual-mapping",
+                                   cl::desc("Don't dual map pooled code"),
+                                   cl::init(false));
+
+namespace {
+
+/// Counts the iTLB misses of the current thread, if the system lets us.
+class ITLBMissCounter {
+public:
+  ITLBMissCounter() {
+#ifdef __linux__
+    perf_event_attr Attr;
+    memset(&Attr, 0, sizeof(Attr));
+    Attr.size = sizeof(Attr);
+    Attr.type = PERF_TYPE_HW_CACHE;
+    Attr.config = PERF_COUNT_HW_CACHE_ITLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    Attr.disabled = 1;
+    Attr.exclude_kernel = 1;
+    Attr.exclude_hv = 1;
+    FD = syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+#endif
+  }
+
+  ~ITLBMissCounter() {
+#ifdef __linux__
+    if (FD >= 0)
+      close(FD);
+#endif
+  }
+
+  bool isAvailable() const { return FD >= 0; }
+
+  void start() {
+#ifdef __linux__
+    if (FD >= 0) {
+      ioctl(FD, PERF_EVENT_IOC_RESET, 0);
+      ioctl(FD, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t stop() {
+    uint64_t Count = 0;
+#ifdef __linux__
+    if (FD >= 0) {
+      ioctl(FD, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(FD, &Count, sizeof(Count)) != sizeof(Count))
+        Count = 0;
+    }
+#endif
+    return Count;
+  }
+
+private:
+  int FD = -1;
+};
+
+typedef int (*FunctionPtr)(int);
+
+struct Object {
+  size_t CodeSize;
+  int Value;
+};
+
+} // end anonymous namespace
+
+/// Write a function returning its argument plus \p Value, padded to \p Size
+/// bytes with traps.
+static void writeFunction(uint8_t *Code, size_t Size, int Value) {
+  memset(Code, 0xCC, Size);
+  // lea eax, [rdi + Value]; ret
+  Code[0] = 0x8D;
+  Code[1] = 0x47;
+  Code[2] = static_cast<uint8_t>(Value);
+  Code[3] = 0xC3;
+}
+
+static void printTime(StringRef What, const TimeRecord &Time) {
+  outs() << "  " << What << ": " << format("%.3f", Time.getWallTime() * 1000)
+         << " ms\n";
+}
+
+template <typename CreateMemMgrFtor, typename GetAddressFtor>
+static void benchmark(StringRef Name, const std::vector<Object> &Objects,
+                      CreateMemMgrFtor CreateMemMgr,
+                      GetAddressFtor GetExecutableAddress) {
+  outs() << Name << ":\n";
+
+  std::vector<std::unique_ptr<RTDyldMemoryManager>> MemMgrs;
+  std::vector<FunctionPtr> Functions;
+  MemMgrs.reserve(Objects.size());
+  Functions.reserve(Objects.size());
+
+  TimeRecord AllocStart = TimeRecord::getCurrentTime(true);
+  for (const Object &O : Objects) {
+    MemMgrs.push_back(CreateMemMgr());
+    RTDyldMemoryManager &MemMgr = *MemMgrs.back();
+    uint8_t *Code = MemMgr.allocateCodeSection(O.CodeSize, 16, 0, ".text");
+    uint8_t *ROData = MemMgr.allocateDataSection(32, 16, 1, ".rodata", true);
+    uint8_t *RWData = MemMgr.allocateDataSection(32, 16, 2, ".data", false);
+    if (!Code || !ROData || !RWData) {
+      errs() << "error: allocation failed\n";
+      exit(1);
+    }
+    writeFunction(Code, O.CodeSize, O.Value);
+    std::string ErrMsg;
+    if (MemMgr.finalizeMemory(&ErrMsg)) {
+      errs() << "error: " << ErrMsg << "\n";
+      exit(1);
+    }
+    Functions.push_back(
+        reinterpret_cast<FunctionPtr>(GetExecutableAddress(Code)));
+  }
+  TimeRecord Alloc = TimeRecord::getCurrentTime(false);
+  Alloc -= AllocStart;
+  printTime("allocate and finalize", Alloc);
+
+#if defined(__x86_64__) || defined(_M_X64)
+  std::vector<FunctionPtr> CallOrder(Functions);
+  std::shuffle(CallOrder.begin(), CallOrder.end(), std::mt19937(0));
+
+  ITLBMissCounter Counter;
+  int Sum = 0;
+  TimeRecord RunStart = TimeRecord::getCurrentTime(true);
+  Counter.start();
+  for (unsigned R = 0; R < NumRounds; ++R)
+    for (FunctionPtr F : CallOrder)
+      Sum = F(Sum);
+  uint64_t Misses = Counter.stop();
+  TimeRecord Run = TimeRecord::getCurrentTime(false);
+  Run -= RunStart;
+  printTime("run", Run);
+  if (Counter.isAvailable())
+    outs() << "  iTLB misses: " << Misses << "\n";
+  else
+    outs() << "  iTLB misses: unavailable\n";
+  outs() << "  (checksum " << Sum << ")\n";
+#endif
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "JIT memory manager benchmark\n");
+
+  if (MaxFunctionSize < 16) {
+    errs() << "error: -max-function-size must be at least 16\n";
+    return 1;
+  }
+
+  std::mt19937 Rand(0);
+  std::uniform_int_distribution<size_t> Size(16, MaxFunctionSize);
+  std::vector<Object> Objects(NumObjects);
+  for (Object &O : Objects) {
+    O.CodeSize = Size(Rand);
+    O.Value = Rand() % 64;
+  }
+
+  benchmark(
+      "SectionMemoryManager", Objects,
+      []() { return make_unique<SectionMemoryManager>(); },
+      [](uint8_t *Addr) { return reinterpret_cast<uint64_t>(Addr); });
+
+  JITMemoryPool::Options Opts;
+  Opts.UseHugePages = HugePages;
+  Opts.UseDualMapping = !NoDualMapping;
+  JITMemoryPool Pool(Opts);
+  benchmark(
+      "PooledMemoryManager", Objects,
+      [&]() { return make_unique<PooledMemoryManager>(Pool); },
+      [&](uint8_t *Addr) { return Pool.getExecutableAddress(Addr); });
+  outs() << "  code dual mapped: " << (Pool.isCodeDualMapped() ? "yes" : "no")
+         << ", protection changes: " << Pool.getNumProtectCalls() << "\n";
+
+  return 0;
+}
@@ -0,0 +1,266 @@
+//===- StringHashBench - Benchmark the string hash of StringMap -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program compares HashString, the byte-at-a-time Bernstein hash that
+// StringMap used, with the truncated xxHash64 it uses now, over corpora of
+// symbol names. For each corpus and hash, it outputs the hashing time, the
+// number of 32-bit hash collisions, and the probes and time needed to look up
+// every name in a table probed like StringMap's. It then outputs the time to
+// insert and look up the corpus in an actual StringMap.
+//
+// The synthetic corpora are modeled on the symbol tables of MCContext and of
+// the linkers: Itanium-mangled names sharing long prefixes, short C names, and
+// assembler-temporary labels. -names reads an extra corpus, one name per line,
+// e.g., the output of `llvm-nm -just-symbol-name`.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<unsigned> NumNames("names-per-corpus",
+                                  cl::desc("Number of synthetic names"),
+                                  cl::init(200000));
+
+static cl::opt<unsigned> NumRounds("rounds",
+                                   cl::desc("Times to hash or look up a corpus"),
+                                   cl::init(10));
+
+static cl::opt<std::string>
+    NamesFile("names", cl::desc("Also benchmark the names in this file, one "
+                                "per line"),
+              cl::value_desc("filename"), cl::init(""));
+
+namespace {
+
+typedef unsigned (*HashFn)(StringRef);
+
+struct Corpus {
+  std::string Name;
+  std::vector<std::string> Strings;
+};
+
+/// A hash table probed like StringMapImpl::LookupBucketFor, with the hash as
+/// a parameter, holding the full hash values in a separate array as
+/// StringMap does.
+class ProbedTable {
+public:
+  ProbedTable(HashFn Hash, size_t NumItems) : Hash(Hash) {
+    // StringMap grows to keep its load factor at most 3/4.
+    NumBuckets = 16;
+    while (NumItems * 4 > NumBuckets * 3)
+      NumBuckets *= 2;
+    Keys.resize(NumBuckets);
+    Hashes.resize(NumBuckets);
+  }
+
+  void insert(StringRef Key) {
+    unsigned BucketNo = lookupBucketFor(Key);
+    Keys[BucketNo] = Key;
+  }
+
+  /// Return the bucket of \p Key, or of the empty bucket where it should go.
+  unsigned lookupBucketFor(StringRef Key) {
+    unsigned FullHashValue = Hash(Key);
+    unsigned BucketNo = FullHashValue & (NumBuckets - 1);
+    unsigned ProbeAmt = 1;
+    while (true) {
+      ++NumProbes;
+      if (!Keys[BucketNo].data()) {
+        Hashes[BucketNo] = FullHashValue;
+        return BucketNo;
+      }
+      if (Hashes[BucketNo] == FullHashValue && Keys[BucketNo] == Key)
+        return BucketNo;
+      BucketNo = (BucketNo + ProbeAmt) & (NumBuckets - 1);
+      ++ProbeAmt;
+    }
+  }
+
+  uint64_t NumProbes = 0;
+
+private:
+  HashFn Hash;
+  unsigned NumBuckets;
+  std::vector<StringRef> Keys;
+  std::vector<unsigned> Hashes;
+};
+
+} // end anonymous namespace
+
+static unsigned bernsteinHash(StringRef S) { return HashString(S); }
+
+static unsigned truncatedXXHash64(StringRef S) {
+  return static_cast<unsigned>(xxHash64(S));
+}
+
+static double msSince(const TimeRecord &Start) {
+  TimeRecord Time = TimeRecord::getCurrentTime(false);
+  Time -= Start;
+  return Time.getWallTime() * 1000;
+}
+
+/// Build Itanium-mangled names, e.g., of the methods of class templates
+/// instantiated in a few namespaces, which share long prefixes.
+static Corpus makeMangledCorpus(std::mt19937 &Rand) {
+  static const char *const Namespaces[] = {"4llvm", "4llvm3orc", "3std",
+                                           "4llvm2cl", "5clang4sema"};
+  static const char *const Classes[] = {"12SmallVectorImpl", "8DenseMap",
+                                        "9StringMap", "11ManagedStatic",
+                                        "22MachineFunctionPass"};
+  static const char *const Methods[] = {"4push_back", "4grow", "6insert",
+                                        "5clear", "13runOnFunction"};
+  Corpus C{"mangled", {}};
+  for (unsigned I = 0; I < NumNames; ++I) {
+    std::string S = "_ZN";
+    S += Namespaces[Rand() % array_lengthof(Namespaces)];
+    S += Classes[Rand() % array_lengthof(Classes)];
+    S += "I";
+    std::string Arg = "T" + utostr(I);
+    S += "N" + utostr(Arg.size()) + Arg + "E";
+    S += "E";
+    S += Methods[Rand() % array_lengthof(Methods)];
+    S += "Ev";
+    C.Strings.push_back(std::move(S));
+  }
+  return C;
+}
+
+/// Build short C identifiers.
+static Corpus makeCCorpus(std::mt19937 &Rand) {
+  static const char *const Words[] = {"get", "set", "init", "buf", "len",
+                                      "node", "list", "free", "alloc", "read"};
+  Corpus C{"c", {}};
+  for (unsigned I = 0; I < NumNames; ++I) {
+    std::string S = Words[Rand() % array_lengthof(Words)];
+    S += "_";
+    S += Words[Rand() % array_lengthof(Words)];
+    S += utostr(I);
+    C.Strings.push_back(std::move(S));
+  }
+  return C;
+}
+
+/// Build the temporary labels the assembler creates, which only differ in
+/// their trailing digits.
+static Corpus makeLabelCorpus() {
+  Corpus C{"labels", {}};
+  for (unsigned I = 0; I < NumNames; ++I)
+    C.Strings.push_back(".LBB" + utostr(I / 64) + "_" + utostr(I % 64));
+  return C;
+}
+
+static void benchmarkHash(StringRef HashName, HashFn Hash,
+                          ArrayRef<StringRef> Names) {
+  outs() << "  " << HashName << ":\n";
+
+  unsigned Sum = 0;
+  TimeRecord Start = TimeRecord::getCurrentTime(true);
+  for (unsigned R = 0; R < NumRounds; ++R)
+    for (StringRef S : Names)
+      Sum += Hash(S);
+  double HashTime = msSince(Start);
+
+  std::unordered_set<unsigned> Seen;
+  unsigned Collisions = 0;
+  for (StringRef S : Names)
+    if (!Seen.insert(Hash(S)).second)
+      ++Collisions;
+
+  ProbedTable Table(Hash, Names.size());
+  for (StringRef S : Names)
+    Table.insert(S);
+  Table.NumProbes = 0;
+  Start = TimeRecord::getCurrentTime(true);
+  for (unsigned R = 0; R < NumRounds; ++R)
+    for (StringRef S : Names)
+      Sum += Table.lookupBucketFor(S);
+  double LookupTime = msSince(Start);
+
+  outs() << "    hash: " << format("%.2f", HashTime) << " ms\n";
+  outs() << "    32-bit collisions: " << Collisions << "\n";
+  outs() << "    probes per lookup: "
+         << format("%.3f", double(Table.NumProbes) /
+                               (double(Names.size()) * NumRounds))
+         << "\n";
+  outs() << "    lookup: " << format("%.2f", LookupTime) << " ms\n";
+  outs() << "    (checksum " << Sum << ")\n";
+}
+
+static void benchmarkStringMap(ArrayRef<StringRef> Names) {
+  TimeRecord Start = TimeRecord::getCurrentTime(true);
+  StringMap<unsigned> Map;
+  for (StringRef S : Names)
+    ++Map[S];
+  double InsertTime = msSince(Start);
+
+  unsigned Sum = 0;
+  Start = TimeRecord::getCurrentTime(true);
+  for (unsigned R = 0; R < NumRounds; ++R)
+    for (StringRef S : Names)
+      Sum += Map.find(S)->second;
+  double LookupTime = msSince(Start);
+
+  outs() << "  StringMap:\n";
+  outs() << "    insert: " << format("%.2f", InsertTime) << " ms\n";
+  outs() << "    lookup: " << format("%.2f", LookupTime) << " ms\n";
+  outs() << "    (checksum " << Sum << ")\n";
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "StringMap hash benchmark\n");
+
+  std::mt19937 Rand(0);
+  std::vector<Corpus> Corpora;
+  Corpora.push_back(makeMangledCorpus(Rand));
+  Corpora.push_back(makeCCorpus(Rand));
+  Corpora.push_back(makeLabelCorpus());
+
+  if (!NamesFile.empty()) {
+    auto BufOrErr = MemoryBuffer::getFile(NamesFile);
+    if (!BufOrErr) {
+      errs() << "error: " << NamesFile << ": "
+             << BufOrErr.getError().message() << "\n";
+      return 1;
+    }
+    SmallVector<StringRef, 0> Lines;
+    (*BufOrErr)->getBuffer().split(Lines, '\n', -1, /*KeepEmpty=*/false);
+    StringSet<> Unique;
+    Corpus C{NamesFile, {}};
+    for (StringRef L : Lines) {
+      L = L.trim();
+      if (!L.empty() && Unique.insert(L).second)
+        C.Strings.push_back(L);
+    }
+    Corpora.push_back(std::move(C));
+  }
+
+  for (const Corpus &C : Corpora) {
+    std::vector<StringRef> Names(C.Strings.begin(), C.Strings.end());
+    outs() << C.Name << " (" << Names.size() << " names):\n";
+    benchmarkHash("HashString", bernsteinHash, Names);
+    benchmarkHash("xxHash64", truncatedXXHash64, Names);
+    benchmarkStringMap(Names);
+  }
+
+  return 0;
+}